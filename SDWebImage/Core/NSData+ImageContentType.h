@@ -28,6 +28,26 @@ static const SDImageFormat SDImageFormatHEIC      = 5;
 static const SDImageFormat SDImageFormatHEIF      = 6;
 static const SDImageFormat SDImageFormatPDF       = 7;
 static const SDImageFormat SDImageFormatSVG       = 8;
+static const SDImageFormat SDImageFormatBMP       = 9;
+static const SDImageFormat SDImageFormatICO       = 10;
+// AVIF and JPEG XL are detected with the values used by the coder plugins, `SDImageFormatAVIF` (15) in SDWebImageAVIFCoder and `SDImageFormatJPEGXL` (17) in SDWebImageJPEGXLCoder. They are not declared here to avoid the redefinition
+/// AVIF和JPEG XL按编码器插件使用的值检测，即SDWebImageAVIFCoder中的`SDImageFormatAVIF`(15)和SDWebImageJPEGXLCoder中的`SDImageFormatJPEGXL`(17)。为避免重复定义，此处不声明它们
+
+/**
+ The confidence of the detected image format.
+ 检测出的图像格式的可信度
+ */
+typedef NS_ENUM(NSInteger, SDImageFormatConfidence) {
+    /// No signature matched, the format is `SDImageFormatUndefined`
+    /// 没有匹配的签名，格式为`SDImageFormatUndefined`
+    SDImageFormatConfidenceNone = 0,
+    /// The data is shorter than the signature but matches so far, or only a weak heuristic matched
+    /// 数据比签名短但目前为止匹配，或仅匹配了较弱的启发式规则
+    SDImageFormatConfidenceLow,
+    /// The complete signature matched
+    /// 完整签名匹配
+    SDImageFormatConfidenceHigh
+};
 
 /**
  NSData category about the image content type and UTI.
@@ -44,6 +64,17 @@ static const SDImageFormat SDImageFormatSVG       = 8;
  */
 + (SDImageFormat)sd_imageFormatForImageData:(nullable NSData *)data;
 
+/**
+ *  Return image format and the confidence. The signatures are matched with a constant table, without allocation. All the ISOBMFF brands in the `ftyp` box are checked for HEIC, HEIF and AVIF.
+ *  返回图像格式和可信度。签名使用常量表匹配，无需分配内存。会检查`ftyp`盒子中的所有ISOBMFF品牌来识别HEIC、HEIF和AVIF
+ *
+ *  @param data the input image data - 输入图像数据
+ *  @param confidence the confidence of the returned format - 返回格式的可信度
+ *
+ *  @return the image format as `SDImageFormat` (enum) - SDImageFormat类型表达的图像格式（枚举）
+ */
++ (SDImageFormat)sd_imageFormatForImageData:(nullable NSData *)data confidence:(nullable SDImageFormatConfidence *)confidence;
+
 /**
  *  Convert SDImageFormat to UTType - 将 SDImageFormat 格式转化成 UTType
  *
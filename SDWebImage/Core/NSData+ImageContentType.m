@@ -15,86 +15,282 @@
 #endif
 #import "SDImageIOAnimatedCoderInternal.h"
 
-#define kSVGTagEnd @"</svg>"
+#define kSVGTagEnd "</svg>"
 
-@implementation NSData (ImageContentType)
+/// The prefix copied on stack for matching, which covers every signature and the compatible brands of a typical `ftyp` box
+/// 复制到栈上用于匹配的前缀长度，覆盖所有签名和典型`ftyp`盒子的兼容品牌
+static const size_t kSDImageSignaturePrefixLength = 128;
+/// The SVG end tag is searched in the last bytes
+/// 在最后这些字节中搜索SVG结束标签
+static const size_t kSDImageSVGTailLength = 100;
+/// A partial match need at least these bytes to count as a low confidence match
+/// 部分匹配至少需要这些字节才算作低可信度匹配
+static const size_t kSDImageSignatureMinPartialLength = 2;
 
-+ (SDImageFormat)sd_imageFormatForImageData:(nullable NSData *)data {
-    if (!data) {
-        // 如果为传入二进制数据就返回“未定义类型”
-        return SDImageFormatUndefined;
+#define SD_FOURCC(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+static inline uint32_t SDReadUInt32BE(const uint8_t *bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static inline uint32_t SDReadUInt32LE(const uint8_t *bytes) {
+    return ((uint32_t)bytes[3] << 24) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[1] << 8) | (uint32_t)bytes[0];
+}
+
+#pragma mark - ISOBMFF brands
+
+// The brands registered by ISO/IEC 23008-12 (HEIF) and the AV1 Image File Format, see https://mp4ra.org/#/brands
+static const uint32_t kSDHEICBrands[] = {
+    SD_FOURCC('h','e','i','c'), SD_FOURCC('h','e','i','x'), SD_FOURCC('h','e','i','m'), SD_FOURCC('h','e','i','s'),
+    SD_FOURCC('h','e','v','c'), SD_FOURCC('h','e','v','x'), SD_FOURCC('h','e','v','m'), SD_FOURCC('h','e','v','s'),
+};
+static const uint32_t kSDHEIFBrands[] = {
+    SD_FOURCC('m','i','f','1'), SD_FOURCC('m','s','f','1'), SD_FOURCC('m','i','f','2'), SD_FOURCC('m','i','a','f'),
+    SD_FOURCC('M','i','H','B'), SD_FOURCC('M','i','H','A'), SD_FOURCC('M','i','H','E'), SD_FOURCC('M','i','P','r'),
+    SD_FOURCC('a','v','c','i'), SD_FOURCC('a','v','c','s'), SD_FOURCC('j','p','e','g'), SD_FOURCC('j','p','g','s'),
+    SD_FOURCC('v','v','i','c'), SD_FOURCC('v','v','i','s'), SD_FOURCC('e','v','b','i'), SD_FOURCC('e','v','b','s'),
+    SD_FOURCC('j','2','k','i'), SD_FOURCC('j','2','i','s'),
+};
+static const uint32_t kSDAVIFBrands[] = {
+    SD_FOURCC('a','v','i','f'), SD_FOURCC('a','v','i','s'), SD_FOURCC('a','v','i','o'),
+};
+// The structural brands, which say nothing about the coding format
+static const uint32_t kSDHEIFGenericBrands[] = {
+    SD_FOURCC('m','i','f','1'), SD_FOURCC('m','s','f','1'), SD_FOURCC('m','i','f','2'), SD_FOURCC('m','i','a','f'),
+};
+
+#define SD_ARRAY_CONTAINS(array, value) SDBrandListContains(array, sizeof(array) / sizeof(array[0]), value)
+
+static inline BOOL SDBrandListContains(const uint32_t *brands, size_t count, uint32_t brand) {
+    for (size_t i = 0; i < count; i++) {
+        if (brands[i] == brand) {
+            return YES;
+        }
     }
-    // 获取图片二进制数据的第一个字节, 8 bit
-    // File signatures table: http://www.garykessler.net/library/file_sigs.html
-    uint8_t c;
-    [data getBytes:&c length:1];
-    switch (c) {
-        // 根据字节的不同返回不同的类型
-        case 0xFF:
-            return SDImageFormatJPEG;
-        case 0x89:
-            return SDImageFormatPNG;
-        case 0x47:
-            return SDImageFormatGIF;
-        case 0x49:
-        case 0x4D:
-            return SDImageFormatTIFF;
-        case 0x52: {
-            // WebP格式的判断要复杂些:
-            // 首先图片二进制的长度要超过12个字节, 并且开头的12个字节通过ASCII编码后的字符要以“RIFF”, 并且以“WEBP”结束
-            if (data.length >= 12) {
-                //RIFF....WEBP
-                NSString *testString = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(0, 12)] encoding:NSASCIIStringEncoding];
-                if ([testString hasPrefix:@"RIFF"] && [testString hasSuffix:@"WEBP"]) {
-                    return SDImageFormatWebP;
-                }
-            }
-            break;
+    return NO;
+}
+
+static SDImageFormat SDImageFormatFromBrand(uint32_t brand) {
+    if (SD_ARRAY_CONTAINS(kSDAVIFBrands, brand)) {
+        return kSDImageFormatAVIF;
+    }
+    if (SD_ARRAY_CONTAINS(kSDHEICBrands, brand)) {
+        return SDImageFormatHEIC;
+    }
+    if (SD_ARRAY_CONTAINS(kSDHEIFBrands, brand)) {
+        return SDImageFormatHEIF;
+    }
+    return SDImageFormatUndefined;
+}
+
+#pragma mark - Resolvers
+
+// Called after the complete signature matched, to validate the rest of the header or refine the format. Return `SDImageFormatConfidenceNone` to reject the match
+typedef SDImageFormatConfidence (*SDImageSignatureResolver)(const uint8_t *bytes, size_t length, SDImageFormat *format);
+
+static SDImageFormatConfidence SDImageResolveISOBMFF(const uint8_t *bytes, size_t length, SDImageFormat *format) {
+    // ftyp box: size(4) 'ftyp'(4) major_brand(4) minor_version(4) compatible_brands(4 * n)
+    uint64_t boxSize = SDReadUInt32BE(bytes);
+    size_t headerSize = 8;
+    if (boxSize == 1) {
+        // 64-bit largesize
+        if (length < 16) {
+            return SDImageFormatConfidenceLow;
         }
-        case 0x00: {
-            // HEIC格式的图片判断也比其他的要复杂些:
-            // 首先图片二进制的长度也要超过12个字节, 然后从第4个字节开始取8个字节并通过ASCII编码转换成字符串,
-            // 如果字符串中包含"ftypheic"、“ftypheix”、“ftyphevc”和“ftyphevx”中的任意一个字符串就可以
-            if (data.length >= 12) {
-                //....ftypheic ....ftypheix ....ftyphevc ....ftyphevx
-                NSString *testString = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(4, 8)] encoding:NSASCIIStringEncoding];
-                if ([testString isEqualToString:@"ftypheic"]
-                    || [testString isEqualToString:@"ftypheix"]
-                    || [testString isEqualToString:@"ftyphevc"]
-                    || [testString isEqualToString:@"ftyphevx"]) {
-                    return SDImageFormatHEIC;
-                }
-                //....ftypmif1 ....ftypmsf1
-                // HEIF格式的图片判断
-                // 如果字符串中包含"ftypmif1"、“ftypmsf1”中的任意一个字符串就可以
-                if ([testString isEqualToString:@"ftypmif1"] || [testString isEqualToString:@"ftypmsf1"]) {
-                    return SDImageFormatHEIF;
-                }
-            }
+        boxSize = ((uint64_t)SDReadUInt32BE(bytes + 8) << 32) | SDReadUInt32BE(bytes + 12);
+        headerSize = 16;
+    } else if (boxSize == 0) {
+        // extends to the end of file, nothing can follow it, so it's not an image
+        return SDImageFormatConfidenceNone;
+    }
+    if (boxSize < headerSize + 8) {
+        return SDImageFormatConfidenceNone;
+    }
+    if (length < headerSize + 4) {
+        return SDImageFormatConfidenceLow;
+    }
+    uint32_t majorBrand = SDReadUInt32BE(bytes + headerSize);
+    BOOL genericMajorBrand = SD_ARRAY_CONTAINS(kSDHEIFGenericBrands, majorBrand);
+    SDImageFormat majorFormat = SDImageFormatFromBrand(majorBrand);
+    if (majorFormat != SDImageFormatUndefined && !genericMajorBrand) {
+        // The major brand tell the coding format
+        *format = majorFormat;
+        return SDImageFormatConfidenceHigh;
+    }
+    // The major brand is structural or unknown, look into the compatible brands. AVIF is preferred over HEIC, because the AVIF files often use `mif1` as major brand, while a `mif1` HEIC file keeps decoding as HEIF
+    SDImageFormat compatibleFormat = SDImageFormatUndefined;
+    size_t end = (size_t)MIN(boxSize, (uint64_t)length);
+    for (size_t offset = headerSize + 8; offset + 4 <= end; offset += 4) {
+        SDImageFormat brandFormat = SDImageFormatFromBrand(SDReadUInt32BE(bytes + offset));
+        if (brandFormat == kSDImageFormatAVIF) {
+            compatibleFormat = brandFormat;
             break;
         }
-        case 0x25: {
-            // PDF格式
-            // 二进制数据长度要超过4个字节, 然后从第1个字节开始截取3个字节并通过ASCII编码转换成字符串
-            // 如果字符串中包含“PDF”就可以
-            if (data.length >= 4) {
-                //%PDF
-                NSString *testString = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(1, 3)] encoding:NSASCIIStringEncoding];
-                if ([testString isEqualToString:@"PDF"]) {
-                    return SDImageFormatPDF;
+        if (!genericMajorBrand && (compatibleFormat == SDImageFormatUndefined || brandFormat == SDImageFormatHEIC)) {
+            compatibleFormat = brandFormat;
+        }
+    }
+    if (compatibleFormat != SDImageFormatUndefined) {
+        *format = compatibleFormat;
+        return SDImageFormatConfidenceHigh;
+    }
+    if (genericMajorBrand) {
+        *format = SDImageFormatHEIF;
+        return SDImageFormatConfidenceHigh;
+    }
+    // Other ISOBMFF file, such as MP4 video
+    return SDImageFormatConfidenceNone;
+}
+
+static SDImageFormatConfidence SDImageResolveBMP(const uint8_t *bytes, size_t length, SDImageFormat *format) {
+    // BITMAPFILEHEADER(14) followed by the DIB header, whose first field is its size
+    if (length < 18) {
+        return SDImageFormatConfidenceLow;
+    }
+    switch (SDReadUInt32LE(bytes + 14)) {
+        case 12: // BITMAPCOREHEADER
+        case 40: // BITMAPINFOHEADER
+        case 52: // BITMAPV2INFOHEADER
+        case 56: // BITMAPV3INFOHEADER
+        case 64: // OS22XBITMAPHEADER
+        case 108: // BITMAPV4HEADER
+        case 124: // BITMAPV5HEADER
+            return SDImageFormatConfidenceHigh;
+        default:
+            return SDImageFormatConfidenceNone;
+    }
+}
+
+static SDImageFormatConfidence SDImageResolveICO(const uint8_t *bytes, size_t length, SDImageFormat *format) {
+    // ICONDIR: reserved(2) type(2) count(2), followed by the 16 bytes ICONDIRENTRY whose 4th byte is reserved 0
+    if (length < 10) {
+        return SDImageFormatConfidenceLow;
+    }
+    uint16_t count = (uint16_t)(bytes[4] | (bytes[5] << 8));
+    if (count == 0 || bytes[9] != 0) {
+        return SDImageFormatConfidenceNone;
+    }
+    return SDImageFormatConfidenceHigh;
+}
+
+#pragma mark - Signatures
+
+typedef struct SDImageSignature {
+    SDImageFormat format;
+    uint8_t offset;
+    uint8_t length;
+    const char *pattern;
+    const char *mask; // '.' skips the byte, NULL compares all the bytes
+    SDImageSignatureResolver resolver; // optional
+} SDImageSignature;
+
+#define SD_SIGNATURE(format, offset, pattern, mask, resolver) {format, offset, sizeof(pattern) - 1, pattern, mask, resolver}
+
+// File signatures table: http://www.garykessler.net/library/file_sigs.html
+// The first complete match with confidence wins, so the `ftyp` box (whose size may look like an ICO header) goes before ICO
+// 文件签名表。第一个完整且有可信度的匹配胜出，因此`ftyp`盒子(其大小可能看起来像ICO头)排在ICO之前
+static const SDImageSignature kSDImageSignatures[] = {
+    SD_SIGNATURE(SDImageFormatJPEG, 0, "\xFF\xD8\xFF", NULL, NULL),
+    SD_SIGNATURE(kSDImageFormatJPEGXL, 0, "\xFF\x0A", NULL, NULL), // naked codestream
+    SD_SIGNATURE(kSDImageFormatJPEGXL, 0, "\x00\x00\x00\x0CJXL \x0D\x0A\x87\x0A", NULL, NULL), // container
+    SD_SIGNATURE(SDImageFormatPNG, 0, "\x89PNG\x0D\x0A\x1A\x0A", NULL, NULL),
+    SD_SIGNATURE(SDImageFormatGIF, 0, "GIF87a", NULL, NULL),
+    SD_SIGNATURE(SDImageFormatGIF, 0, "GIF89a", NULL, NULL),
+    SD_SIGNATURE(SDImageFormatWebP, 0, "RIFF\0\0\0\0WEBP", "xxxx....xxxx", NULL),
+    SD_SIGNATURE(SDImageFormatHEIF, 4, "ftyp", NULL, SDImageResolveISOBMFF),
+    SD_SIGNATURE(SDImageFormatTIFF, 0, "II*\0", NULL, NULL),
+    SD_SIGNATURE(SDImageFormatTIFF, 0, "MM\0*", NULL, NULL),
+    SD_SIGNATURE(SDImageFormatTIFF, 0, "II+\0", NULL, NULL), // BigTIFF
+    SD_SIGNATURE(SDImageFormatTIFF, 0, "MM\0+", NULL, NULL), // BigTIFF
+    SD_SIGNATURE(SDImageFormatBMP, 0, "BM", NULL, SDImageResolveBMP),
+    SD_SIGNATURE(SDImageFormatICO, 0, "\0\0\x01\0", NULL, SDImageResolveICO),
+    SD_SIGNATURE(SDImageFormatICO, 0, "\0\0\x02\0", NULL, SDImageResolveICO), // CUR
+    SD_SIGNATURE(SDImageFormatPDF, 0, "%PDF-", NULL, NULL),
+};
+
+// Return the number of the compared bytes if the available bytes all match, 0 otherwise
+static inline size_t SDImageSignatureMatch(const SDImageSignature *signature, const uint8_t *bytes, size_t length) {
+    size_t end = MIN((size_t)signature->offset + signature->length, length);
+    size_t compared = 0;
+    for (size_t i = signature->offset; i < end; i++) {
+        size_t index = i - signature->offset;
+        if (signature->mask && signature->mask[index] == '.') {
+            continue;
+        }
+        if (bytes[i] != (uint8_t)signature->pattern[index]) {
+            return 0;
+        }
+        compared++;
+    }
+    return compared;
+}
+
+static BOOL SDImageDataHasSVGTail(NSData *data) {
+    size_t tailLength = MIN(kSDImageSVGTailLength, data.length);
+    uint8_t tail[kSDImageSVGTailLength];
+    [data getBytes:tail range:NSMakeRange(data.length - tailLength, tailLength)];
+    size_t tagLength = sizeof(kSVGTagEnd) - 1;
+    for (size_t i = tailLength; i >= tagLength; i--) {
+        if (memcmp(tail + i - tagLength, kSVGTagEnd, tagLength) == 0) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
+@implementation NSData (ImageContentType)
+
++ (SDImageFormat)sd_imageFormatForImageData:(nullable NSData *)data {
+    return [self sd_imageFormatForImageData:data confidence:NULL];
+}
+
++ (SDImageFormat)sd_imageFormatForImageData:(nullable NSData *)data confidence:(nullable SDImageFormatConfidence *)confidence {
+    SDImageFormat format = SDImageFormatUndefined;
+    SDImageFormatConfidence formatConfidence = SDImageFormatConfidenceNone;
+    // 如果为传入二进制数据就返回“未定义类型”
+    if (data.length > 0) {
+        // Copy the prefix on stack, the matching does not allocate
+        // 将前缀复制到栈上，匹配过程不分配内存
+        uint8_t bytes[kSDImageSignaturePrefixLength];
+        size_t length = MIN(data.length, kSDImageSignaturePrefixLength);
+        [data getBytes:bytes length:length];
+        size_t count = sizeof(kSDImageSignatures) / sizeof(kSDImageSignatures[0]);
+        for (size_t i = 0; i < count; i++) {
+            const SDImageSignature *signature = &kSDImageSignatures[i];
+            size_t compared = SDImageSignatureMatch(signature, bytes, length);
+            if (compared == 0) {
+                continue;
+            }
+            SDImageFormat signatureFormat = signature->format;
+            SDImageFormatConfidence signatureConfidence;
+            if (length < (size_t)signature->offset + signature->length) {
+                // The data is shorter than the signature
+                signatureConfidence = compared >= kSDImageSignatureMinPartialLength ? SDImageFormatConfidenceLow : SDImageFormatConfidenceNone;
+            } else if (signature->resolver) {
+                signatureConfidence = signature->resolver(bytes, length, &signatureFormat);
+            } else {
+                signatureConfidence = SDImageFormatConfidenceHigh;
+            }
+            if (signatureConfidence > formatConfidence) {
+                format = signatureFormat;
+                formatConfidence = signatureConfidence;
+                if (formatConfidence == SDImageFormatConfidenceHigh) {
+                    break;
                 }
             }
         }
-        case 0x3C: {
-            // Check end with SVG tag
-            // 检查是否以SVG标志结尾
-            if ([data rangeOfData:[kSVGTagEnd dataUsingEncoding:NSUTF8StringEncoding] options:NSDataSearchBackwards range: NSMakeRange(data.length - MIN(100, data.length), MIN(100, data.length))].location != NSNotFound) {
-                return SDImageFormatSVG;
-            }
+        // Check end with SVG tag
+        // 检查是否以SVG标志结尾
+        if (formatConfidence == SDImageFormatConfidenceNone && bytes[0] == '<' && SDImageDataHasSVGTail(data)) {
+            format = SDImageFormatSVG;
+            formatConfidence = SDImageFormatConfidenceHigh;
         }
     }
+    if (confidence) {
+        *confidence = formatConfidence;
+    }
     // 如果上述情况都不满足, 则返回未定义类型
-    return SDImageFormatUndefined;
+    return format;
 }
 
 // 根据传入的图片类型, 返回对应的格式标识
@@ -128,6 +324,18 @@
         case SDImageFormatSVG:
             UTType = kSDUTTypeSVG;
             break;
+        case SDImageFormatBMP:
+            UTType = kSDUTTypeBMP;
+            break;
+        case SDImageFormatICO:
+            UTType = kSDUTTypeICO;
+            break;
+        case kSDImageFormatAVIF:
+            UTType = kSDUTTypeAVIF;
+            break;
+        case kSDImageFormatJPEGXL:
+            UTType = kSDUTTypeJPEGXL;
+            break;
         default:
             // default is kUTTypeImage abstract type
             UTType = kSDUTTypeImage;
@@ -159,6 +367,14 @@
         imageFormat = SDImageFormatPDF;
     } else if (CFStringCompare(uttype, kSDUTTypeSVG, 0) == kCFCompareEqualTo) {
         imageFormat = SDImageFormatSVG;
+    } else if (CFStringCompare(uttype, kSDUTTypeBMP, 0) == kCFCompareEqualTo) {
+        imageFormat = SDImageFormatBMP;
+    } else if (CFStringCompare(uttype, kSDUTTypeICO, 0) == kCFCompareEqualTo) {
+        imageFormat = SDImageFormatICO;
+    } else if (CFStringCompare(uttype, kSDUTTypeAVIF, 0) == kCFCompareEqualTo) {
+        imageFormat = kSDImageFormatAVIF;
+    } else if (CFStringCompare(uttype, kSDUTTypeJPEGXL, 0) == kCFCompareEqualTo) {
+        imageFormat = kSDImageFormatJPEGXL;
     } else {
         imageFormat = SDImageFormatUndefined;
     }
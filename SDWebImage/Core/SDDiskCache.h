@@ -16,7 +16,9 @@
 @protocol SDDiskCache <NSObject>
 
 // All of these method are called from the same global queue to avoid blocking on main queue and thread-safe problem. But it's also recommend to ensure thread-safe yourself using lock or other ways.
+// When `SDImageCacheConfig.maxConcurrentDiskOperationCount` is larger than 1, the methods for different keys may be called concurrently, the methods for the same key are still called in order.
 // 所有这些方法都从同一个全局队列中调用，以避免主队列阻塞和线程安全问题。但也建议您自己使用lock或其他方式来确保线程安全。
+// 当`SDImageCacheConfig.maxConcurrentDiskOperationCount`大于1时，不同key的方法可能被并发调用，同一key的方法仍按顺序调用
 @required
 /**
  Create a new disk cache based on the specified path. You can check `maxDiskSize` and `maxDiskAge` used for disk cache.
@@ -120,7 +122,9 @@
 /**
  Returns the number of data in this cache.
  This method may blocks the calling thread until file read finished.
+ @note This method is called directly from any thread, not from the IO queue, so it should be thread-safe.
  返回当前在硬盘缓存中的数据数量
+ @note 此方法会在任意线程直接调用，而不是在IO队列中，因此需要保证线程安全
  
  @return The total data count.
  */
@@ -129,16 +133,42 @@
 /**
  Returns the total size (in bytes) of data in this cache.
  This method may blocks the calling thread until file read finished.
+ @note This method is called directly from any thread, not from the IO queue, so it should be thread-safe.
  返回当前在硬盘缓存中的数据大小（单位字节）
+ @note 此方法会在任意线程直接调用，而不是在IO队列中，因此需要保证线程安全
  
  @return The total data size in bytes.
  */
 - (NSUInteger)totalSize;
 
+@optional
+/**
+ Removes the expired data incrementally. Each call deletes at most `countLimit` files, or runs at most `timeLimit` seconds, then returns so the caller can interleave other disk operations. The eviction plan is kept between calls.
+ This method may blocks the calling thread until file delete finished.
+ 增量删除过期数据。每次调用最多删除`countLimit`个文件，或最多运行`timeLimit`秒，然后返回，以便调用方穿插执行其他硬盘操作。清理计划在调用之间保持
+ 
+ @param countLimit The maximum file count to delete in this call, 0 means no limit. 本次调用最多删除的文件数，0表示无限制
+ @param timeLimit The maximum duration of this call, 0 means no limit. 本次调用的最大时长，0表示无限制
+ @return YES if the eviction finished, NO if the caller should call again. 清理完成返回YES，需要再次调用返回NO
+ */
+- (BOOL)removeExpiredDataWithCountLimit:(NSUInteger)countLimit timeLimit:(NSTimeInterval)timeLimit;
+
+/**
+ Move the file into the cache as the data for the key, replacing the existing one. The file should be on the same volume as the cache directory (such as a temporary file inside it), so the move is an atomic rename and no bytes are copied. The source file is removed if the move failed.
+ This method may blocks the calling thread until file move finished.
+ 将文件作为key的数据移入缓存，替换已有的数据。文件应与缓存目录在同一个卷上(例如缓存目录中的临时文件)，这样移动就是一次原子重命名，不拷贝任何字节。移动失败时源文件会被删除
+ 
+ @param path The file path to move. 要移动的文件路径
+ @param key The key with which to associate the data. 绑定数据的key
+ */
+- (void)moveDataFromPath:(nonnull NSString *)path forKey:(nonnull NSString *)key;
+
 @end
 
 /**
  The built-in disk cache.
+ @note The file metadata (size, dates and access count) is kept in a persistent index inside the cache directory (hidden files), which is updated incrementally. So `totalSize`, `totalCount` and `removeExpiredData` never walk the directory. The index is rebuilt by scanning the directory once when missing.
+ @note 文件元数据(大小、日期和访问次数)保存在缓存目录中的持久化索引里(隐藏文件)，并增量更新。因此`totalSize`、`totalCount`和`removeExpiredData`不再遍历目录。索引缺失时会扫描一次目录重建
  */
 @interface SDDiskCache : NSObject <SDDiskCache>
 /**
@@ -9,20 +9,67 @@
 #import "SDDiskCache.h"
 #import "SDImageCacheConfig.h"
 #import "SDFileAttributeHelper.h"
+#import "SDDiskCacheIndex.h"
+#import "SDInternalMacros.h"
 #import <CommonCrypto/CommonDigest.h>
+#import <sys/mman.h>
+#import <sys/stat.h>
+#import <fcntl.h>
+#import <unistd.h>
 
 /// 硬盘缓存扩展属性名称
 static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDiskCache";
 
+// Map the file when its size reaches the threshold. `fallback` is set to YES when the file is smaller than the threshold, or the mapping failed, the caller should use the plain read
+static NSData * _Nullable SDDiskCacheMappedDataWithContentsOfFile(NSString * _Nonnull filePath, NSUInteger threshold, BOOL * _Nonnull fallback) {
+    *fallback = NO;
+    int fd = open(filePath.fileSystemRepresentation, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        // File not exist
+        return nil;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || (NSUInteger)st.st_size < threshold) {
+        close(fd);
+        *fallback = YES;
+        return nil;
+    }
+    size_t length = (size_t)st.st_size;
+    void *bytes = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps a reference to the file, the descriptor is no longer needed
+    close(fd);
+    if (bytes == MAP_FAILED) {
+        *fallback = YES;
+        return nil;
+    }
+    // The coders read the whole file from the beginning, prefetch the pages in order
+    madvise(bytes, length, MADV_SEQUENTIAL);
+    madvise(bytes, length, MADV_WILLNEED);
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:length deallocator:^(void * _Nonnull bytes, NSUInteger length) {
+        munmap(bytes, length);
+    }];
+}
+
 @interface SDDiskCache ()
 /// 硬盘缓存路径
 @property (nonatomic, copy) NSString *diskCachePath;
 /// 文件管理器
 @property (nonatomic, strong, nonnull) NSFileManager *fileManager;
+/// 持久化元数据索引
+@property (nonatomic, strong, nonnull) SDDiskCacheIndex *index;
+/// 未完成的清理计划
+@property (nonatomic, copy, nullable) NSArray<SDDiskCacheIndexEntry *> *evictionPlan;
 
 @end
 
-@implementation SDDiskCache
+@implementation SDDiskCache {
+    NSUInteger _evictionCursor;
+    NSUInteger _evictionExpiredCount;
+    NSUInteger _evictionRemainingSize;
+    NSUInteger _evictionTargetSize;
+    // a lock to keep the eviction plan thread-safe, the data methods for different keys may be called concurrently
+    SD_LOCK_DECLARE(_evictionLock);
+}
 /// 禁用初始化方法
 - (instancetype)init {
     NSAssert(NO, @"Use `initWithCachePath:` with the disk cache path");
@@ -46,6 +93,8 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
     } else {
         self.fileManager = [NSFileManager new];
     }
+    self.index = [[SDDiskCacheIndex alloc] initWithDirectory:self.diskCachePath fileManager:self.fileManager];
+    SD_LOCK_INIT(_evictionLock);
 }
 /// 是否包含指定key的数据
 - (BOOL)containsDataForKey:(NSString *)key {
@@ -65,20 +114,38 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
 - (NSData *)dataForKey:(NSString *)key {
     NSParameterAssert(key);
     NSString *filePath = [self cachePathForKey:key];
-    NSData *data = [NSData dataWithContentsOfFile:filePath options:self.config.diskCacheReadingOptions error:nil];
+    NSData *data = [self dataWithContentsOfFile:filePath];
     if (data) {
+        [self.index recordAccessForFileName:filePath.lastPathComponent size:data.length];
         return data;
     }
     
     // fallback because of https://github.com/rs/SDWebImage/pull/976 that added the extension to the disk file name
     // checking the key with and without the extension
-    data = [NSData dataWithContentsOfFile:filePath.stringByDeletingPathExtension options:self.config.diskCacheReadingOptions error:nil];
+    data = [self dataWithContentsOfFile:filePath.stringByDeletingPathExtension];
     if (data) {
+        [self.index recordAccessForFileName:filePath.stringByDeletingPathExtension.lastPathComponent size:data.length];
         return data;
     }
     
+    // The file may be removed by others, keep the index consistent
+    /// 文件可能被其他方删除，保持索引一致
+    [self.index removeEntryForFileName:filePath.lastPathComponent];
     return nil;
 }
+/// Read the file, use the zero-copy mapping for large file when enabled
+/// 读取文件，启用时对大文件使用零拷贝映射
+- (nullable NSData *)dataWithContentsOfFile:(NSString *)filePath {
+    NSUInteger threshold = self.config.diskCacheMappedReadingThreshold;
+    if (threshold > 0 && (self.config.diskCacheWritingOptions & NSDataWritingAtomic)) {
+        BOOL fallback = NO;
+        NSData *data = SDDiskCacheMappedDataWithContentsOfFile(filePath, threshold, &fallback);
+        if (!fallback) {
+            return data;
+        }
+    }
+    return [NSData dataWithContentsOfFile:filePath options:self.config.diskCacheReadingOptions error:nil];
+}
 /// 为指定key绑定data
 - (void)setData:(NSData *)data forKey:(NSString *)key {
     NSParameterAssert(data);
@@ -92,7 +159,10 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
     // transform to NSURL
     NSURL *fileURL = [NSURL fileURLWithPath:cachePathForKey];
     
-    [data writeToURL:fileURL options:self.config.diskCacheWritingOptions error:nil];
+    if (![data writeToURL:fileURL options:self.config.diskCacheWritingOptions error:nil]) {
+        return;
+    }
+    [self.index recordWriteForFileName:cachePathForKey.lastPathComponent size:data.length];
     
     // disable iCloud backup
     if (self.config.shouldDisableiCloud) {
@@ -100,6 +170,25 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
         [fileURL setResourceValue:@YES forKey:NSURLIsExcludedFromBackupKey error:nil];
     }
 }
+/// 将文件移入缓存作为key的数据
+- (void)moveDataFromPath:(NSString *)path forKey:(NSString *)key {
+    NSParameterAssert(path);
+    NSParameterAssert(key);
+    NSString *cachePathForKey = [self cachePathForKey:key];
+    NSDictionary<NSFileAttributeKey, id> *attributes = [self.fileManager attributesOfItemAtPath:path error:nil];
+    // `rename` replaces the existing file atomically
+    if (!attributes || rename(path.fileSystemRepresentation, cachePathForKey.fileSystemRepresentation) != 0) {
+        [self.fileManager removeItemAtPath:path error:nil];
+        return;
+    }
+    [self.index recordWriteForFileName:cachePathForKey.lastPathComponent size:(NSUInteger)attributes.fileSize];
+    
+    // disable iCloud backup
+    if (self.config.shouldDisableiCloud) {
+        // ignore iCloud backup resource value error
+        [[NSURL fileURLWithPath:cachePathForKey] setResourceValue:@YES forKey:NSURLIsExcludedFromBackupKey error:nil];
+    }
+}
 /// 指定key的拓展数据
 - (NSData *)extendedDataForKey:(NSString *)key {
     NSParameterAssert(key);
@@ -126,15 +215,18 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
         // Override 覆盖
         [SDFileAttributeHelper setExtendedAttribute:SDDiskCacheExtendedAttributeName value:extendedData atPath:cachePathForKey traverseLink:NO overwrite:YES error:nil];
     }
+    [self.index recordChangeForFileName:cachePathForKey.lastPathComponent];
 }
 /// 删除指定key的data
 - (void)removeDataForKey:(NSString *)key {
     NSParameterAssert(key);
     NSString *filePath = [self cachePathForKey:key];
     [self.fileManager removeItemAtPath:filePath error:nil];
+    [self.index removeEntryForFileName:filePath.lastPathComponent];
 }
 /// 清理所有数据
 - (void)removeAllData {
+    [self.index removeAllEntries];
     [self.fileManager removeItemAtPath:self.diskCachePath error:nil];
     [self.fileManager createDirectoryAtPath:self.diskCachePath
             withIntermediateDirectories:YES
@@ -143,106 +235,148 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
 }
 /// 删除过期数据
 - (void)removeExpiredData {
-    NSURL *diskCacheURL = [NSURL fileURLWithPath:self.diskCachePath isDirectory:YES];
-    
-    // Compute content date key to be used for tests
-    /// 计算用于测试的内容日期键
-    NSURLResourceKey cacheContentDateKey = NSURLContentModificationDateKey;
-    switch (self.config.diskCacheExpireType) {
-        case SDImageCacheConfigExpireTypeAccessDate:
-            cacheContentDateKey = NSURLContentAccessDateKey;
-            break;
-        case SDImageCacheConfigExpireTypeModificationDate:
-            cacheContentDateKey = NSURLContentModificationDateKey;
-            break;
-        case SDImageCacheConfigExpireTypeCreationDate:
-            cacheContentDateKey = NSURLCreationDateKey;
-            break;
-        case SDImageCacheConfigExpireTypeChangeDate:
-            cacheContentDateKey = NSURLAttributeModificationDateKey;
-            break;
-        default:
+    // Start a new plan and finish it in one pass
+    /// 重新制定清理计划并一次完成
+    SD_LOCK(_evictionLock);
+    self.evictionPlan = nil;
+    [self _removeExpiredDataWithCountLimit:0 timeLimit:0];
+    SD_UNLOCK(_evictionLock);
+}
+/// 增量删除过期数据
+- (BOOL)removeExpiredDataWithCountLimit:(NSUInteger)countLimit timeLimit:(NSTimeInterval)timeLimit {
+    SD_LOCK(_evictionLock);
+    BOOL finished = [self _removeExpiredDataWithCountLimit:countLimit timeLimit:timeLimit];
+    SD_UNLOCK(_evictionLock);
+    return finished;
+}
+
+// Make sure to call with lock held by caller
+- (BOOL)_removeExpiredDataWithCountLimit:(NSUInteger)countLimit timeLimit:(NSTimeInterval)timeLimit {
+    if (!self.evictionPlan) {
+        [self prepareEvictionPlan];
+    }
+    NSArray<SDDiskCacheIndexEntry *> *plan = self.evictionPlan;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    NSUInteger removedCount = 0;
+    while (_evictionCursor < plan.count) {
+        if ((countLimit > 0 && removedCount >= countLimit) || (timeLimit > 0 && CFAbsoluteTimeGetCurrent() - startTime >= timeLimit)) {
+            return NO;
+        }
+        BOOL isExpired = _evictionCursor < _evictionExpiredCount;
+        if (!isExpired && _evictionRemainingSize < _evictionTargetSize) {
+            // Fall below the low watermark
+            /// 已经低于低水位
             break;
+        }
+        SDDiskCacheIndexEntry *entry = plan[_evictionCursor];
+        _evictionCursor++;
+        // The file may be written or accessed between slices, skip it because the plan is out of date
+        /// 文件可能在切片之间被写入或访问，计划已过时，跳过
+        SDDiskCacheIndexEntry *currentEntry = [self.index entryForFileName:entry.fileName];
+        if (!currentEntry || [self contentDateForIndexEntry:currentEntry] != [self contentDateForIndexEntry:entry] || currentEntry.priority != entry.priority) {
+            continue;
+        }
+        [self removeFileForIndexEntry:entry];
+        removedCount++;
+        if (!isExpired) {
+            _evictionRemainingSize -= MIN(_evictionRemainingSize, entry.size);
+            if ([self usesGDSF]) {
+                // Aging, the following files start from the priority of the evicted one
+                /// 老化，之后的文件从被淘汰文件的优先级开始
+                self.index.inflation = entry.priority;
+            }
+        }
     }
-    /// 资源键
-    NSArray<NSString *> *resourceKeys = @[NSURLIsDirectoryKey, cacheContentDateKey, NSURLTotalFileAllocatedSizeKey];
-    
-    // This enumerator prefetches useful properties for our cache files.
-    /// 这个枚举器为我们的缓存文件预取有用的属性
-    NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtURL:diskCacheURL
-                                               includingPropertiesForKeys:resourceKeys
-                                                                  options:NSDirectoryEnumerationSkipsHiddenFiles
-                                                             errorHandler:NULL];
-    
-    NSDate *expirationDate = (self.config.maxDiskAge < 0) ? nil: [NSDate dateWithTimeIntervalSinceNow:-self.config.maxDiskAge];
-    NSMutableDictionary<NSURL *, NSDictionary<NSString *, id> *> *cacheFiles = [NSMutableDictionary dictionary];
+    self.evictionPlan = nil;
+    return YES;
+}
+/// Build the eviction plan: the expired entries first, then the remaining entries sorted by the eviction policy if the size exceeds the high watermark
+/// 制定清理计划：先是过期的条目，如果大小超过高水位，接着是按淘汰策略排序的剩余条目
+- (void)prepareEvictionPlan {
+    // The priority is computed when reading the entries, so the GDSF cost follows the current policy
+    /// 优先级在读取条目时计算，因此GDSF的代价跟随当前的策略
+    self.index.byteOrientedCost = self.config.diskCacheEvictionPolicy == SDImageCacheConfigDiskEvictionPolicyGDSFByteHitRatio;
+    // Only read the persistent index, never walk the directory
+    /// 只读取持久化索引，不再遍历目录
+    NSArray<SDDiskCacheIndexEntry *> *entries = [self.index allEntries];
+    NSTimeInterval expirationDate = [NSDate date].timeIntervalSince1970 - self.config.maxDiskAge;
+    NSMutableArray<SDDiskCacheIndexEntry *> *expiredEntries = [NSMutableArray array];
+    NSMutableArray<SDDiskCacheIndexEntry *> *remainingEntries = [NSMutableArray arrayWithCapacity:entries.count];
     NSUInteger currentCacheSize = 0;
     
-    // Enumerate all of the files in the cache directory.  This loop has two purposes:
-    // 枚举缓存目录中的所有文件。这个循环有两个目的:
-    //  1. Removing files that are older than the expiration date.  删除过期的文件
-    //  2. Storing file attributes for the size-based cleanup pass. 为基于大小的清理传递存储文件属性
-    NSMutableArray<NSURL *> *urlsToDelete = [[NSMutableArray alloc] init];
-    for (NSURL *fileURL in fileEnumerator) {
-        NSError *error;
-        NSDictionary<NSString *, id> *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:&error];
-        
-        // Skip directories and errors.
-        if (error || !resourceValues || [resourceValues[NSURLIsDirectoryKey] boolValue]) {
+    // Enumerate all of the index entries.  This loop has two purposes:
+    // 枚举所有索引条目。这个循环有两个目的:
+    //  1. Collecting files that are older than the expiration date.  收集过期的文件
+    //  2. Collecting the remaining entries for the size-based cleanup pass. 为基于大小的清理收集剩余的条目
+    for (SDDiskCacheIndexEntry *entry in entries) {
+        if (self.config.maxDiskAge >= 0 && [self contentDateForIndexEntry:entry] <= expirationDate) {
+            [expiredEntries addObject:entry];
             continue;
         }
-        
-        // Remove files that are older than the expiration date;
-        /// 添加过期文件路径至待删除数组
-        NSDate *modifiedDate = resourceValues[cacheContentDateKey];
-        if (expirationDate && [[modifiedDate laterDate:expirationDate] isEqualToDate:expirationDate]) {
-            [urlsToDelete addObject:fileURL];
-            continue;
-        }
-        
-        // Store a reference to this file and account for its total size.
-        /// 计算并存储缓存总文件大小
-        NSNumber *totalAllocatedSize = resourceValues[NSURLTotalFileAllocatedSizeKey];
-        currentCacheSize += totalAllocatedSize.unsignedIntegerValue;
-        cacheFiles[fileURL] = resourceValues;
+        currentCacheSize += entry.size;
+        [remainingEntries addObject:entry];
     }
     
-    /// 删除文件
-    for (NSURL *fileURL in urlsToDelete) {
-        [self.fileManager removeItemAtURL:fileURL error:nil];
-    }
+    NSMutableArray<SDDiskCacheIndexEntry *> *plan = expiredEntries;
+    _evictionExpiredCount = expiredEntries.count;
+    _evictionCursor = 0;
+    _evictionRemainingSize = currentCacheSize;
+    _evictionTargetSize = 0;
     
-    // If our remaining disk cache exceeds a configured maximum size, perform a second
+    // If our remaining disk cache exceeds the high watermark, perform a second
     // size-based cleanup pass.  We delete the oldest files first.
-    /// 如果剩余的磁盘缓存超过了配置的最大大小，则执行第二次基于大小的清理。我们先删除最老的文件
+    /// 如果剩余的磁盘缓存超过了高水位，则执行第二次基于大小的清理。我们先删除最老的文件
     NSUInteger maxDiskSize = self.config.maxDiskSize;
-    if (maxDiskSize > 0 && currentCacheSize > maxDiskSize) {
-        // Target half of our maximum cache size for this cleanup pass.
-        /// 这次清理的目标是最大缓存大小的一半
-        const NSUInteger desiredCacheSize = maxDiskSize / 2;
-        
-        // Sort the remaining cache files by their last modification time or last access time (oldest first).
-        /// 根据最后修改时间或最后访问时间(最早的先)对剩余的缓存文件进行排序。
-        NSArray<NSURL *> *sortedFiles = [cacheFiles keysSortedByValueWithOptions:NSSortConcurrent
-                                                                 usingComparator:^NSComparisonResult(id obj1, id obj2) {
-                                                                     return [obj1[cacheContentDateKey] compare:obj2[cacheContentDateKey]];
-                                                                 }];
+    double highWatermark = self.config.diskCacheHighWatermark;
+    if (maxDiskSize > 0 && currentCacheSize > maxDiskSize * highWatermark) {
+        // Target the low watermark for this cleanup pass, which never exceeds the high watermark.
+        /// 这次清理的目标是低水位，且不超过高水位
+        _evictionTargetSize = (NSUInteger)(maxDiskSize * MIN(self.config.diskCacheLowWatermark, highWatermark));
         
-        // Delete files until we fall below our desired cache size.
-        /// 删除文件，直到低于我们想要的缓存大小
-        for (NSURL *fileURL in sortedFiles) {
-            if ([self.fileManager removeItemAtURL:fileURL error:nil]) {
-                NSDictionary<NSString *, id> *resourceValues = cacheFiles[fileURL];
-                NSNumber *totalAllocatedSize = resourceValues[NSURLTotalFileAllocatedSizeKey];
-                currentCacheSize -= totalAllocatedSize.unsignedIntegerValue;
-                
-                if (currentCacheSize < desiredCacheSize) {
-                    break;
-                }
+        // Sort the remaining cache files by their date (oldest first), or GDSF priority (lowest first).
+        // The ties are broken by the access date (least recently used first), then the file name, so the plan is deterministic
+        /// 根据日期(最早的先)或GDSF优先级(最低的先)对剩余的缓存文件进行排序。
+        /// 相同时按访问日期(最久未使用的先)，再按文件名排序，使计划是确定的
+        BOOL useGDSF = [self usesGDSF];
+        [remainingEntries sortUsingComparator:^NSComparisonResult(SDDiskCacheIndexEntry * _Nonnull entry1, SDDiskCacheIndexEntry * _Nonnull entry2) {
+            double value1 = useGDSF ? entry1.priority : [self contentDateForIndexEntry:entry1];
+            double value2 = useGDSF ? entry2.priority : [self contentDateForIndexEntry:entry2];
+            if (value1 != value2) {
+                return value1 < value2 ? NSOrderedAscending : NSOrderedDescending;
             }
-        }
+            if (entry1.accessDate != entry2.accessDate) {
+                return entry1.accessDate < entry2.accessDate ? NSOrderedAscending : NSOrderedDescending;
+            }
+            return [entry1.fileName compare:entry2.fileName];
+        }];
+        [plan addObjectsFromArray:remainingEntries];
+    }
+    self.evictionPlan = plan;
+}
+/// 是否使用GDSF淘汰策略
+- (BOOL)usesGDSF {
+    SDImageCacheConfigDiskEvictionPolicy policy = self.config.diskCacheEvictionPolicy;
+    return policy == SDImageCacheConfigDiskEvictionPolicyGDSF || policy == SDImageCacheConfigDiskEvictionPolicyGDSFByteHitRatio;
+}
+/// 索引条目中用于过期检查的日期
+- (NSTimeInterval)contentDateForIndexEntry:(SDDiskCacheIndexEntry *)entry {
+    switch (self.config.diskCacheExpireType) {
+        case SDImageCacheConfigExpireTypeAccessDate:
+            return entry.accessDate;
+        case SDImageCacheConfigExpireTypeCreationDate:
+            return entry.creationDate;
+        case SDImageCacheConfigExpireTypeChangeDate:
+            return entry.changeDate;
+        case SDImageCacheConfigExpireTypeModificationDate:
+        default:
+            return entry.modificationDate;
     }
 }
+/// 删除索引条目对应的文件
+- (void)removeFileForIndexEntry:(SDDiskCacheIndexEntry *)entry {
+    [self.fileManager removeItemAtPath:[self.diskCachePath stringByAppendingPathComponent:entry.fileName] error:nil];
+    [self.index removeEntryForFileName:entry.fileName];
+}
 /// 指定key的数据缓存路径
 - (nullable NSString *)cachePathForKey:(NSString *)key {
     NSParameterAssert(key);
@@ -250,21 +384,11 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
 }
 /// 缓存的总文件大小
 - (NSUInteger)totalSize {
-    NSUInteger size = 0;
-    NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtPath:self.diskCachePath];
-    for (NSString *fileName in fileEnumerator) {
-        NSString *filePath = [self.diskCachePath stringByAppendingPathComponent:fileName];
-        NSDictionary<NSString *, id> *attrs = [self.fileManager attributesOfItemAtPath:filePath error:nil];
-        size += [attrs fileSize];
-    }
-    return size;
+    return self.index.totalSize;
 }
 /// 缓存文件的总个数
 - (NSUInteger)totalCount {
-    NSUInteger count = 0;
-    NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtPath:self.diskCachePath];
-    count = fileEnumerator.allObjects.count;
-    return count;
+    return self.index.totalCount;
 }
 
 #pragma mark - Cache paths
@@ -317,6 +441,11 @@ static NSString * const SDDiskCacheExtendedAttributeName = @"com.hackemist.SDDis
         /// 删除旧路径
         [self.fileManager removeItemAtPath:srcPath error:nil];
     }
+    // The files are changed without index, rebuild it
+    /// 文件在索引之外被修改，重建索引
+    if ([dstPath isEqualToString:self.diskCachePath]) {
+        [self.index rebuild];
+    }
 }
 
 #pragma mark - Hash
@@ -0,0 +1,92 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <CoreGraphics/CoreGraphics.h>
+#import "SDWebImageCompat.h"
+
+/**
+ A pool of reusable pixel buffers for the decoded bitmaps. The buffers are grouped into size classes keyed by width, height, bytes per row and bitmap info. The decoder draws into a buffer taken from the pool, and the buffer goes back to the pool when the decoded image is released (such as evicted from memory cache), so the next decoding of the same size skips the allocation and page faults.
+ The idle buffers kept in the pool are limited by `maxPooledBytes`, and they are purged on memory warning.
+ 解码位图的可复用像素缓冲池。缓冲区按宽、高、每行字节数和位图信息分为不同的尺寸类别。解码器在从池中取出的缓冲区上绘制，当解码后的图片被释放(例如从内存缓存中淘汰)时缓冲区回到池中，因此下一次相同尺寸的解码可以跳过内存分配和缺页
+ 池中保留的空闲缓冲区受`maxPooledBytes`限制，并在内存警告时清除
+ */
+@interface SDImageBufferPool : NSObject
+
+/**
+ The shared pool used by `SDImageCoderHelper`.
+ `SDImageCoderHelper`使用的共享缓冲池
+ */
+@property (nonatomic, class, readonly, nonnull) SDImageBufferPool *sharedPool;
+
+/**
+ The maximum total bytes of the idle buffers kept in the pool, the returned buffer is freed when the pool is full. 0 means disable pooling, `SDImageCoderHelper` then use the plain bitmap context.
+ Defaults to 0, the pooling is opt-in. Set it to a positive value (such as 16MB) to enable the pooling for `sharedPool`.
+ @warning The idle buffers are not counted by the memory cache cost limit, they hold up to this many bytes of memory in addition to the memory cache, until the next memory warning or `removeAllBuffers`.
+ 池中保留的空闲缓冲区的最大总字节数，池满时归还的缓冲区会被释放。0表示禁用缓冲池，此时`SDImageCoderHelper`使用普通的位图上下文
+ 默认为0，缓冲池需要主动开启。将其设置为正值(例如16MB)以对`sharedPool`启用缓冲池
+ @warning 空闲缓冲区不计入内存缓存的开销上限，在下一次内存警告或`removeAllBuffers`之前，它们会在内存缓存之外额外占用最多该字节数的内存
+ */
+@property (atomic, assign) NSUInteger maxPooledBytes;
+
+/**
+ The current total bytes of the idle buffers in the pool.
+ 池中空闲缓冲区的当前总字节数
+ */
+@property (nonatomic, assign, readonly) NSUInteger pooledBytes;
+
+/**
+ The number of the acquisitions served by an idle buffer.
+ 由空闲缓冲区满足的获取次数
+ */
+@property (nonatomic, assign, readonly) NSUInteger hitCount;
+
+/**
+ The number of the acquisitions which allocate a new buffer.
+ 需要分配新缓冲区的获取次数
+ */
+@property (nonatomic, assign, readonly) NSUInteger missCount;
+
+/**
+ Return the bytes per row used by the pool for the width and bytes per pixel, which is aligned for the rendering. Return 0 if the size overflows.
+ 返回缓冲池对给定宽度和每像素字节数使用的每行字节数，该值已为渲染对齐。如果大小溢出则返回0
+ */
++ (size_t)bytesPerRowForWidth:(size_t)width bytesPerPixel:(size_t)bytesPerPixel;
+
+/**
+ Take a buffer of `bytesPerRow * height` bytes from the pool, or allocate a new one. The content is undefined. The buffer must be returned by `recycleBuffer:width:height:bytesPerRow:bitmapInfo:` with the same size class, or freed by `free()`.
+ 从池中取出一个`bytesPerRow * height`字节的缓冲区，或分配一个新的。内容未定义。缓冲区必须使用相同的尺寸类别通过`recycleBuffer:width:height:bytesPerRow:bitmapInfo:`归还，或使用`free()`释放
+
+ @return The buffer, or NULL if the allocation failed or `bytesPerRow * height` overflows 缓冲区，分配失败或`bytesPerRow * height`溢出时为NULL
+ */
+- (nullable void *)acquireBufferWithWidth:(size_t)width height:(size_t)height bytesPerRow:(size_t)bytesPerRow bitmapInfo:(CGBitmapInfo)bitmapInfo NS_RETURNS_INNER_POINTER;
+
+/**
+ Return the buffer to its size class, it's freed if the pool is full.
+ 将缓冲区归还到其尺寸类别，池满时会被释放
+ */
+- (void)recycleBuffer:(nonnull void *)buffer width:(size_t)width height:(size_t)height bytesPerRow:(size_t)bytesPerRow bitmapInfo:(CGBitmapInfo)bitmapInfo;
+
+/**
+ Create a CGImage backed by the buffer without copying. The buffer is returned to this pool when the CGImage is released. This follows The Create Rule. If failed, the buffer is recycled and return NULL.
+ 使用缓冲区创建CGImage而不拷贝。CGImage被释放时缓冲区会归还到该缓冲池。遵循Create规则。如果失败，缓冲区会被回收并返回NULL
+ */
+- (nullable CGImageRef)CGImageCreateWithBuffer:(nonnull void *)buffer width:(size_t)width height:(size_t)height bytesPerRow:(size_t)bytesPerRow bitmapInfo:(CGBitmapInfo)bitmapInfo colorSpace:(nonnull CGColorSpaceRef)colorSpace CF_RETURNS_RETAINED;
+
+/**
+ Free all the idle buffers. The buffers in use still go back to the pool later.
+ 释放所有空闲缓冲区。正在使用的缓冲区之后仍会回到池中
+ */
+- (void)removeAllBuffers;
+
+/**
+ Reset `hitCount` and `missCount` to 0.
+ 将`hitCount`和`missCount`重置为0
+ */
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,270 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDImageBufferPool.h"
+#import "SDInternalMacros.h"
+
+/// The default byte cap of the idle buffers, the pooling is opt-in
+/// 空闲缓冲区的默认字节上限，缓冲池需要主动开启
+static const NSUInteger kSDImageBufferPoolDefaultMaxPooledBytes = 0;
+/// The row alignment, which matches what Core Graphics use for the bitmap context
+/// 行对齐，与Core Graphics位图上下文使用的对齐一致
+static const size_t kSDImageBufferPoolRowAlignment = 64;
+
+/// Return the buffer length, or 0 if `bytesPerRow * height` overflows
+/// 返回缓冲区长度，如果`bytesPerRow * height`溢出则返回0
+static inline size_t SDImageBufferPoolBufferLength(size_t bytesPerRow, size_t height) {
+    size_t length;
+    if (__builtin_mul_overflow(bytesPerRow, height, &length)) {
+        return 0;
+    }
+    return length;
+}
+
+static inline NSString * SDImageBufferPoolSizeClass(size_t width, size_t height, size_t bytesPerRow, CGBitmapInfo bitmapInfo) {
+    return [NSString stringWithFormat:@"%zux%zu-%zu-%u", width, height, bytesPerRow, bitmapInfo];
+}
+
+/// An idle buffer in the pool
+/// 池中的一个空闲缓冲区
+@interface SDImageBufferPoolEntry : NSObject {
+    @package
+    void *_buffer;
+    size_t _length;
+    NSString *_sizeClass;
+}
+@end
+
+@implementation SDImageBufferPoolEntry
+@end
+
+/// The info passed to the data provider, return the buffer to the pool on release
+/// 传递给数据提供者的信息，释放时将缓冲区归还到池中
+typedef struct SDImageBufferPoolReleaseInfo {
+    void *pool; // retained
+    size_t width;
+    size_t height;
+    size_t bytesPerRow;
+    CGBitmapInfo bitmapInfo;
+} SDImageBufferPoolReleaseInfo;
+
+static void SDImageBufferPoolReleaseData(void *info, const void *data, size_t size) {
+    SDImageBufferPoolReleaseInfo *releaseInfo = info;
+    SDImageBufferPool *pool = (__bridge_transfer SDImageBufferPool *)releaseInfo->pool;
+    [pool recycleBuffer:(void *)data width:releaseInfo->width height:releaseInfo->height bytesPerRow:releaseInfo->bytesPerRow bitmapInfo:releaseInfo->bitmapInfo];
+    free(releaseInfo);
+}
+
+@interface SDImageBufferPool () {
+    SD_LOCK_DECLARE(_lock); // a lock to keep the access to the idle buffers and statistics thread-safe
+    NSMutableDictionary<NSString *, NSMutableArray<SDImageBufferPoolEntry *> *> *_sizeClasses; // size class -> idle buffers, the last is the most recently returned
+    NSMutableArray<SDImageBufferPoolEntry *> *_idleEntries; // all the idle buffers, the first is the least recently returned
+    NSUInteger _pooledBytes;
+    NSUInteger _hitCount;
+    NSUInteger _missCount;
+}
+
+@end
+
+@implementation SDImageBufferPool
+
++ (SDImageBufferPool *)sharedPool {
+    static dispatch_once_t onceToken;
+    static SDImageBufferPool *pool;
+    dispatch_once(&onceToken, ^{
+        pool = [[SDImageBufferPool alloc] init];
+    });
+    return pool;
+}
+
+- (void)dealloc {
+    [self removeAllBuffers];
+#if SD_UIKIT
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
+#endif
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        SD_LOCK_INIT(_lock);
+        _sizeClasses = [NSMutableDictionary dictionary];
+        _idleEntries = [NSMutableArray array];
+        _maxPooledBytes = kSDImageBufferPoolDefaultMaxPooledBytes;
+#if SD_UIKIT
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(didReceiveMemoryWarning:)
+                                                     name:UIApplicationDidReceiveMemoryWarningNotification
+                                                   object:nil];
+#endif
+    }
+    return self;
+}
+
+#if SD_UIKIT
+- (void)didReceiveMemoryWarning:(NSNotification *)notification {
+    [self removeAllBuffers];
+}
+#endif
+
++ (size_t)bytesPerRowForWidth:(size_t)width bytesPerPixel:(size_t)bytesPerPixel {
+    size_t bytesPerRow;
+    if (__builtin_mul_overflow(width, bytesPerPixel, &bytesPerRow) || bytesPerRow > SIZE_MAX - (kSDImageBufferPoolRowAlignment - 1)) {
+        return 0;
+    }
+    return (bytesPerRow + kSDImageBufferPoolRowAlignment - 1) / kSDImageBufferPoolRowAlignment * kSDImageBufferPoolRowAlignment;
+}
+
+#pragma mark - Statistics
+
+- (NSUInteger)pooledBytes {
+    SD_LOCK(_lock);
+    NSUInteger pooledBytes = _pooledBytes;
+    SD_UNLOCK(_lock);
+    return pooledBytes;
+}
+
+- (NSUInteger)hitCount {
+    SD_LOCK(_lock);
+    NSUInteger hitCount = _hitCount;
+    SD_UNLOCK(_lock);
+    return hitCount;
+}
+
+- (NSUInteger)missCount {
+    SD_LOCK(_lock);
+    NSUInteger missCount = _missCount;
+    SD_UNLOCK(_lock);
+    return missCount;
+}
+
+- (void)resetStatistics {
+    SD_LOCK(_lock);
+    _hitCount = 0;
+    _missCount = 0;
+    SD_UNLOCK(_lock);
+}
+
+#pragma mark - Buffers
+
+// Make sure to call with lock held by caller
+- (void)_removeEntry:(SDImageBufferPoolEntry *)entry {
+    NSMutableArray<SDImageBufferPoolEntry *> *entries = _sizeClasses[entry->_sizeClass];
+    [entries removeObjectIdenticalTo:entry];
+    if (entries.count == 0) {
+        [_sizeClasses removeObjectForKey:entry->_sizeClass];
+    }
+    [_idleEntries removeObjectIdenticalTo:entry];
+    _pooledBytes -= entry->_length;
+}
+
+- (void *)acquireBufferWithWidth:(size_t)width height:(size_t)height bytesPerRow:(size_t)bytesPerRow bitmapInfo:(CGBitmapInfo)bitmapInfo {
+    if (width == 0 || height == 0 || bytesPerRow == 0) {
+        return NULL;
+    }
+    size_t length = SDImageBufferPoolBufferLength(bytesPerRow, height);
+    if (length == 0) {
+        return NULL;
+    }
+    NSString *sizeClass = SDImageBufferPoolSizeClass(width, height, bytesPerRow, bitmapInfo);
+    SD_LOCK(_lock);
+    // Prefer the most recently returned one, whose pages are more likely still resident
+    SDImageBufferPoolEntry *entry = _sizeClasses[sizeClass].lastObject;
+    if (entry) {
+        [self _removeEntry:entry];
+        _hitCount++;
+    } else {
+        _missCount++;
+    }
+    SD_UNLOCK(_lock);
+    if (entry) {
+        return entry->_buffer;
+    }
+    return malloc(length);
+}
+
+- (void)recycleBuffer:(void *)buffer width:(size_t)width height:(size_t)height bytesPerRow:(size_t)bytesPerRow bitmapInfo:(CGBitmapInfo)bitmapInfo {
+    if (!buffer) {
+        return;
+    }
+    size_t length = SDImageBufferPoolBufferLength(bytesPerRow, height);
+    NSUInteger maxPooledBytes = self.maxPooledBytes;
+    if (length == 0 || length > maxPooledBytes) {
+        free(buffer);
+        return;
+    }
+    SDImageBufferPoolEntry *entry = [SDImageBufferPoolEntry new];
+    entry->_buffer = buffer;
+    entry->_length = length;
+    entry->_sizeClass = SDImageBufferPoolSizeClass(width, height, bytesPerRow, bitmapInfo);
+    NSMutableArray<SDImageBufferPoolEntry *> *evictedEntries = [NSMutableArray array];
+    SD_LOCK(_lock);
+    // Evict the least recently returned buffers to make room, so the stale size classes do not hold the cap forever
+    // 淘汰最久之前归还的缓冲区以腾出空间，使过时的尺寸类别不会一直占用上限
+    while (_pooledBytes + length > maxPooledBytes && _idleEntries.count > 0) {
+        SDImageBufferPoolEntry *evictedEntry = _idleEntries.firstObject;
+        [self _removeEntry:evictedEntry];
+        [evictedEntries addObject:evictedEntry];
+    }
+    NSMutableArray<SDImageBufferPoolEntry *> *entries = _sizeClasses[entry->_sizeClass];
+    if (!entries) {
+        entries = [NSMutableArray array];
+        _sizeClasses[entry->_sizeClass] = entries;
+    }
+    [entries addObject:entry];
+    [_idleEntries addObject:entry];
+    _pooledBytes += length;
+    SD_UNLOCK(_lock);
+    // Free outside the lock
+    for (SDImageBufferPoolEntry *evictedEntry in evictedEntries) {
+        free(evictedEntry->_buffer);
+    }
+}
+
+- (CGImageRef)CGImageCreateWithBuffer:(void *)buffer width:(size_t)width height:(size_t)height bytesPerRow:(size_t)bytesPerRow bitmapInfo:(CGBitmapInfo)bitmapInfo colorSpace:(CGColorSpaceRef)colorSpace {
+    if (!buffer) {
+        return NULL;
+    }
+    size_t length = SDImageBufferPoolBufferLength(bytesPerRow, height);
+    if (length == 0) {
+        [self recycleBuffer:buffer width:width height:height bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+        return NULL;
+    }
+    SDImageBufferPoolReleaseInfo *releaseInfo = malloc(sizeof(SDImageBufferPoolReleaseInfo));
+    if (!releaseInfo) {
+        [self recycleBuffer:buffer width:width height:height bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+        return NULL;
+    }
+    *releaseInfo = (SDImageBufferPoolReleaseInfo){(__bridge_retained void *)self, width, height, bytesPerRow, bitmapInfo};
+    CGDataProviderRef provider = CGDataProviderCreateWithData(releaseInfo, buffer, length, SDImageBufferPoolReleaseData);
+    if (!provider) {
+        // The release callback is never called, balance the retained pool and give back the buffer here
+        // 释放回调不会被调用，在此平衡持有的池并归还缓冲区
+        CFRelease(releaseInfo->pool);
+        free(releaseInfo);
+        [self recycleBuffer:buffer width:width height:height bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+        return NULL;
+    }
+    CGImageRef imageRef = CGImageCreate(width, height, 8, 32, bytesPerRow, colorSpace, bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CGDataProviderRelease(provider);
+    return imageRef;
+}
+
+- (void)removeAllBuffers {
+    SD_LOCK(_lock);
+    NSArray<SDImageBufferPoolEntry *> *idleEntries = [_idleEntries copy];
+    [_idleEntries removeAllObjects];
+    [_sizeClasses removeAllObjects];
+    _pooledBytes = 0;
+    SD_UNLOCK(_lock);
+    for (SDImageBufferPoolEntry *entry in idleEntries) {
+        free(entry->_buffer);
+    }
+}
+
+@end
@@ -13,6 +13,7 @@
 #import "SDImageCacheDefine.h"
 #import "SDMemoryCache.h"
 #import "SDDiskCache.h"
+#import "SDImageCacheQueryOperation.h"
 
 /// Image Cache Options
 /// 图像缓存选项
@@ -189,6 +190,13 @@ typedef NS_OPTIONS(NSUInteger, SDImageCacheOptions) {
  */
 - (nullable NSString *)cachePathForKey:(nullable NSString *)key;
 
+/**
+ Return a new unique file path inside a hidden sub directory of the disk cache directory, which is on the same volume as the cache files. It's used to stream a download, then move the file into the cache by `storeImage:imageFileAtPath:forKey:toMemory:completion:`. The stale files left by the killed downloads are removed when the expired data is removed.
+ // 返回硬盘缓存目录的隐藏子目录中一个新的唯一文件路径，它与缓存文件在同一个卷上。用于流式下载，然后通过`storeImage:imageFileAtPath:forKey:toMemory:completion:`将文件移入缓存。被终止的下载遗留的过时文件会在删除过期数据时被删除
+ @return The temporary file path, the file is not created // 临时文件路径，文件尚未创建
+ */
+- (nonnull NSString *)uniqueTemporaryFilePath;
+
 #pragma mark - Store Ops
 
 /**
@@ -238,6 +246,22 @@ typedef NS_OPTIONS(NSUInteger, SDImageCacheOptions) {
             toDisk:(BOOL)toDisk
         completion:(nullable SDWebImageNoParamsBlock)completionBlock;
 
+/**
+ * Asynchronously store an image into memory cache, and move the image file into disk cache at the given key. The file is moved by an atomic rename when the disk cache supports `moveDataFromPath:forKey:`, so the image data is never loaded into memory.
+ * 异步存储，将图像存储到内存缓存，并将图像文件移入硬盘缓存。当硬盘缓存支持`moveDataFromPath:forKey:`时通过原子重命名移动文件，因此图像数据不会被加载到内存
+ *
+ * @param image           The image to store into memory cache
+ * @param path            The image data file, it's moved or removed after the operation is finished. It should be inside the disk cache directory, see `uniqueTemporaryFilePath`
+ * @param key             The unique image cache key, usually it's image absolute URL
+ * @param toMemory        Store the image to memory cache if YES
+ * @param completionBlock A block executed after the operation is finished
+ */
+- (void)storeImage:(nullable UIImage *)image
+   imageFileAtPath:(nonnull NSString *)path
+            forKey:(nullable NSString *)key
+          toMemory:(BOOL)toMemory
+        completion:(nullable SDWebImageNoParamsBlock)completionBlock;
+
 /**
  * Synchronously store image into memory cache at the given key.
  * 同步存储，
@@ -357,7 +381,11 @@ typedef NS_OPTIONS(NSUInteger, SDImageCacheOptions) {
  * 指定从哪里查找.默认为“.all”, 即从内存和硬盘中查找。可以选择只从内存或只从硬盘中查找，传递”.none '无效，立即用nil回调
  * @param doneBlock The completion block. Will not get called if the operation is cancelled
  *
- * @return a NSOperation instance containing the cache op
+ * @note The concurrent async disk queries for the same key and decode options (thumbnail size, scale, first frame only, etc) share one in-flight read/decode and receive the same image. Cancelling one query does not affect the others, the shared read/decode is cancelled when all of them are cancelled.
+ * @note 相同key和解码选项(缩略图大小、缩放比例、仅首帧等)的并发异步硬盘查询共享一次进行中的读取/解码，并收到同一个图片。取消一个查询不影响其他查询，所有查询都取消时才取消共享的读取/解码
+ *
+ * @return a NSOperation instance containing the cache op. When querying the disk, it's a `SDImageCacheQueryOperation` which records the duration of each stage
+ * 包含缓存操作的NSOperation实例。查询硬盘时为`SDImageCacheQueryOperation`，记录每个阶段的耗时
  */
 - (nullable NSOperation *)queryCacheOperationForKey:(nullable NSString *)key options:(SDImageCacheOptions)options context:(nullable SDWebImageContext *)context cacheType:(SDImageCacheType)queryCacheType done:(nullable SDImageCacheQueryCompletionBlock)doneBlock;
 
@@ -501,4 +529,19 @@ typedef NS_OPTIONS(NSUInteger, SDImageCacheOptions) {
  */
 @interface SDImageCache (SDImageCache) <SDImageCache>
 
+/**
+ Query the cached images for many keys at once, from both memory and disk cache, see `queryImagesForKeys:options:context:cacheType:progress:completion:`
+ 一次查询多个key的缓存图片，包括内存和硬盘缓存
+
+ @param keys The image cache keys
+ @param options A mask to specify options to use for this query
+ @param context A context contains different options to perform specify changes or processes, see `SDWebImageContextOption`.
+ @param completionBlock The coalesced completion block, called after all the keys are resolved. If the operation is cancelled, it's called with the partial results resolved before cancellation
+ @return The operation for this query
+ */
+- (nullable id<SDWebImageOperation>)queryImagesForKeys:(nonnull NSArray<NSString *> *)keys
+                                               options:(SDWebImageOptions)options
+                                               context:(nullable SDWebImageContext *)context
+                                            completion:(nullable SDImageCacheBatchQueryCompletionBlock)completionBlock;
+
 @end
@@ -14,9 +14,22 @@
 #import "UIImage+MemoryCacheCost.h"
 #import "UIImage+Metadata.h"
 #import "UIImage+ExtendedCacheData.h"
+#import "SDDecodedImageDiskCache.h"
+#import "SDDiskIOScheduler.h"
+#import "SDImageCacheQueryOperation.h"
+#import "SDImageCacheQueryOperationInternal.h"
+#import "SDImageCacheInflightQuery.h"
+#import "SDImageCachesManagerOperation.h"
+#import "SDInternalMacros.h"
 
 /// 默认硬盘缓存目录
 static NSString * _defaultDiskCacheDirectory;
+/// The hidden sub directory for the streaming download files, the disk cache index skips it
+/// 流式下载文件的隐藏子目录，硬盘缓存索引会跳过它
+static NSString * const SDImageCacheTemporaryDirectoryName = @".SDImageCache.downloads";
+/// A temporary file not modified for such a long time is left by a crashed or killed download, the download timeout is much shorter
+/// 超过这么长时间未修改的临时文件是崩溃或被终止的下载遗留的，下载超时时间远小于此值
+static const NSTimeInterval SDImageCacheTemporaryFileExpireAge = 60 * 60;
 
 @interface SDImageCache ()
 
@@ -29,13 +42,29 @@ static NSString * _defaultDiskCacheDirectory;
 @property (nonatomic, copy, readwrite, nonnull) SDImageCacheConfig *config;
 /// 硬盘缓存路径
 @property (nonatomic, copy, readwrite, nonnull) NSString *diskCachePath;
-/// io队列
-@property (nonatomic, strong, nullable) dispatch_queue_t ioQueue;
+/// io调度器
+@property (nonatomic, strong, nonnull) SDDiskIOScheduler *ioScheduler;
+/// 解码队列
+@property (nonatomic, strong, nonnull) NSOperationQueue *decodeQueue;
+/// 已解码硬盘缓存层
+@property (nonatomic, strong, nullable) SDDecodedImageDiskCache *decodedDiskCache;
+/// 进行中的硬盘查询
+@property (nonatomic, strong, nonnull) NSMutableDictionary<NSString *, SDImageCacheInflightQuery *> *inflightQueries;
+
+#pragma mark - Helpers used by the batch query
++ (SDImageCacheOptions)cacheOptionsFromImageOptions:(SDWebImageOptions)options;
++ (SDWebImageOptions)imageOptionsFromCacheOptions:(SDImageCacheOptions)cacheOptions;
+- (nullable NSData *)diskImageDataBySearchingAllPathsForKey:(nullable NSString *)key;
+- (nullable UIImage *)_imageFromMemoryCacheForKey:(nonnull NSString *)key options:(SDImageCacheOptions)options context:(nullable SDWebImageContext *)context;
+- (void)_populateDecodedDiskCacheWithImage:(nullable UIImage *)image forKey:(nonnull NSString *)key;
+- (void)_unarchiveObjectWithImage:(nullable UIImage *)image extendedData:(nullable NSData *)extendedData;
 
 @end
 
 
-@implementation SDImageCache
+@implementation SDImageCache {
+    SD_LOCK_DECLARE(_inflightQueriesLock); // a lock to keep the access to `inflightQueries` thread-safe
+}
 
 #pragma mark - Singleton, init, dealloc
 /// 共享图片缓存对象
@@ -79,15 +108,25 @@ static NSString * _defaultDiskCacheDirectory;
         /// 命名空间不应该为nil
         NSAssert(ns, @"Cache namespace should not be nil");
         
-        // Create IO serial queue
-        /// 创建IO队列
-        _ioQueue = dispatch_queue_create("com.hackemist.SDImageCache", DISPATCH_QUEUE_SERIAL);
         /// 默认配置
         if (!config) {
             config = SDImageCacheConfig.defaultCacheConfig;
         }
         _config = [config copy];
         
+        // Create IO scheduler, the operations for the same key are serial
+        /// 创建IO调度器，同一key的操作是串行的
+        _ioScheduler = [[SDDiskIOScheduler alloc] initWithLabel:@"com.hackemist.SDImageCache" laneCount:_config.maxConcurrentDiskOperationCount];
+        // Create decode queue, the decoding is out of the IO scheduler
+        /// 创建解码队列，解码在IO调度器之外进行
+        _decodeQueue = [NSOperationQueue new];
+        _decodeQueue.name = @"com.hackemist.SDImageCache.decode";
+        _decodeQueue.maxConcurrentOperationCount = _config.maxConcurrentDecodeOperationCount > 0 ? _config.maxConcurrentDecodeOperationCount : NSProcessInfo.processInfo.activeProcessorCount;
+        // The in-flight disk queries, the concurrent queries for the same key share one read/decode
+        /// 进行中的硬盘查询，相同key的并发查询共享一次读取/解码
+        _inflightQueries = [NSMutableDictionary dictionary];
+        SD_LOCK_INIT(_inflightQueriesLock);
+        
         // Init the memory cache
         /// 初始化内存缓存对象
         NSAssert([config.memoryCacheClass conformsToProtocol:@protocol(SDMemoryCache)], @"Custom memory cache class must conform to `SDMemoryCache` protocol");
@@ -104,6 +143,12 @@ static NSString * _defaultDiskCacheDirectory;
         NSAssert([config.diskCacheClass conformsToProtocol:@protocol(SDDiskCache)], @"Custom disk cache class must conform to `SDDiskCache` protocol");
         _diskCache = [[config.diskCacheClass alloc] initWithCachePath:_diskCachePath config:_config];
         
+        // Init the decoded disk cache tier if need
+        /// 如需要则初始化已解码硬盘缓存层
+        if (_config.decodedDiskCacheLimit > 0) {
+            _decodedDiskCache = [[SDDecodedImageDiskCache alloc] initWithCachePath:[_diskCachePath stringByAppendingPathExtension:@"decoded"] config:_config];
+        }
+        
         // Check and migrate disk cache directory if need
         /// 如需要则检查并迁移硬盘缓存目录
         [self migrateDiskCacheDirectory];
@@ -144,6 +189,28 @@ static NSString * _defaultDiskCacheDirectory;
     }
     return [self.diskCache cachePathForKey:key];
 }
+/// 唯一的临时文件路径，位于隐藏子目录中，不会被硬盘缓存索引
+- (nonnull NSString *)uniqueTemporaryFilePath {
+    // Inside the hidden sub directory, so the disk cache index ignore it, and the stale files can be swept without walking the whole cache directory
+    NSString *temporaryDirectory = [self.diskCachePath stringByAppendingPathComponent:SDImageCacheTemporaryDirectoryName];
+    [[NSFileManager defaultManager] createDirectoryAtPath:temporaryDirectory withIntermediateDirectories:YES attributes:nil error:nil];
+    NSString *fileName = [NSString stringWithFormat:@"%@.download", NSUUID.UUID.UUIDString];
+    return [temporaryDirectory stringByAppendingPathComponent:fileName];
+}
+/// Remove the temporary files left by the crashed or killed downloads
+/// 删除崩溃或被终止的下载遗留的临时文件
+- (void)removeStaleTemporaryFiles {
+    NSFileManager *fileManager = [NSFileManager new];
+    NSString *temporaryDirectory = [self.diskCachePath stringByAppendingPathComponent:SDImageCacheTemporaryDirectoryName];
+    NSDate *expirationDate = [NSDate dateWithTimeIntervalSinceNow:-SDImageCacheTemporaryFileExpireAge];
+    for (NSString *fileName in [fileManager contentsOfDirectoryAtPath:temporaryDirectory error:nil]) {
+        NSString *filePath = [temporaryDirectory stringByAppendingPathComponent:fileName];
+        NSDate *modificationDate = [fileManager attributesOfItemAtPath:filePath error:nil].fileModificationDate;
+        if (!modificationDate || [modificationDate compare:expirationDate] == NSOrderedAscending) {
+            [fileManager removeItemAtPath:filePath error:nil];
+        }
+    }
+}
 /// 用户缓存目录
 + (nullable NSString *)userCacheDirectory {
     /// 缓存路径
@@ -159,9 +226,9 @@ static NSString * _defaultDiskCacheDirectory;
             NSString *newDefaultPath = [[[self.class userCacheDirectory] stringByAppendingPathComponent:@"com.hackemist.SDImageCache"] stringByAppendingPathComponent:@"default"];
             // ~/Library/Caches/default/com.hackemist.SDWebImageCache.default/
             NSString *oldDefaultPath = [[[self.class userCacheDirectory] stringByAppendingPathComponent:@"default"] stringByAppendingPathComponent:@"com.hackemist.SDWebImageCache.default"];
-            dispatch_async(self.ioQueue, ^{
+            [self.ioScheduler dispatchBarrierAsync:^{
                 [((SDDiskCache *)self.diskCache) moveCacheDirectoryFromPath:oldDefaultPath toPath:newDefaultPath];
-            });
+            }];
         });
     }
 }
@@ -215,7 +282,7 @@ static NSString * _defaultDiskCacheDirectory;
         }
         return;
     }
-    dispatch_async(self.ioQueue, ^{
+    [self.ioScheduler dispatchAsyncForKey:key block:^{
         @autoreleasepool {
             NSData *data = imageData;
             if (!data && [image conformsToProtocol:@protocol(SDAnimatedImage)]) {
@@ -251,7 +318,7 @@ static NSString * _defaultDiskCacheDirectory;
                 completionBlock();
             });
         }
-    });
+    }];
 }
 
 - (void)_archivedDataWithImage:(UIImage *)image forKey:(NSString *)key {
@@ -286,6 +353,52 @@ static NSString * _defaultDiskCacheDirectory;
         [self.diskCache setExtendedData:extendedData forKey:key];
     }
 }
+- (void)storeImage:(nullable UIImage *)image
+   imageFileAtPath:(nonnull NSString *)path
+            forKey:(nullable NSString *)key
+          toMemory:(BOOL)toMemory
+        completion:(nullable SDWebImageNoParamsBlock)completionBlock {
+    if (!key) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        if (completionBlock) {
+            completionBlock();
+        }
+        return;
+    }
+    if (image && toMemory && self.config.shouldCacheImagesInMemory) {
+        NSUInteger cost = image.sd_memoryCost;
+        [self.memoryCache setObject:image forKey:key cost:cost];
+    }
+    [self.ioScheduler dispatchAsyncForKey:key block:^{
+        @autoreleasepool {
+            [self _storeImageFileToDisk:path forKey:key];
+            [self _archivedDataWithImage:image forKey:key];
+        }
+        
+        if (completionBlock) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completionBlock();
+            });
+        }
+    }];
+}
+
+// Make sure to call from io queue by caller
+- (void)_storeImageFileToDisk:(nonnull NSString *)path forKey:(nonnull NSString *)key {
+    if ([self.diskCache respondsToSelector:@selector(moveDataFromPath:forKey:)]) {
+        [self.diskCache moveDataFromPath:path forKey:key];
+    } else {
+        // The custom disk cache can not move file, write a mapped view so the data is still not loaded into memory
+        NSData *imageData = [NSData dataWithContentsOfFile:path options:NSDataReadingMappedIfSafe error:nil];
+        if (imageData) {
+            [self.diskCache setData:imageData forKey:key];
+        }
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    }
+    // The decoded image is out of date
+    [self.decodedDiskCache removeImageForKey:key];
+}
+
 /// 保存图像到内存
 - (void)storeImageToMemory:(UIImage *)image forKey:(NSString *)key {
     if (!image || !key) {
@@ -301,9 +414,9 @@ static NSString * _defaultDiskCacheDirectory;
         return;
     }
     
-    dispatch_sync(self.ioQueue, ^{
+    [self.ioScheduler dispatchSyncForKey:key block:^{
         [self _storeImageDataToDisk:imageData forKey:key];
-    });
+    }];
 }
 
 // Make sure to call from io queue by caller
@@ -313,19 +426,21 @@ static NSString * _defaultDiskCacheDirectory;
     }
     
     [self.diskCache setData:imageData forKey:key];
+    // The decoded image is out of date
+    [self.decodedDiskCache removeImageForKey:key];
 }
 
 #pragma mark - Query and Retrieve Ops
 /// 给定key的图片是否存在硬盘中
 - (void)diskImageExistsWithKey:(nullable NSString *)key completion:(nullable SDImageCacheCheckCompletionBlock)completionBlock {
-    dispatch_async(self.ioQueue, ^{
+    [self.ioScheduler dispatchAsyncForKey:key block:^{
         BOOL exists = [self _diskImageDataExistsWithKey:key];
         if (completionBlock) {
             dispatch_async(dispatch_get_main_queue(), ^{
                 completionBlock(exists);
             });
         }
-    });
+    }];
 }
 
 - (BOOL)diskImageDataExistsWithKey:(nullable NSString *)key {
@@ -334,9 +449,9 @@ static NSString * _defaultDiskCacheDirectory;
     }
     
     __block BOOL exists = NO;
-    dispatch_sync(self.ioQueue, ^{
+    [self.ioScheduler dispatchSyncForKey:key block:^{
         exists = [self _diskImageDataExistsWithKey:key];
-    });
+    }];
     
     return exists;
 }
@@ -351,14 +466,14 @@ static NSString * _defaultDiskCacheDirectory;
 }
 
 - (void)diskImageDataQueryForKey:(NSString *)key completion:(SDImageCacheQueryDataCompletionBlock)completionBlock {
-    dispatch_async(self.ioQueue, ^{
+    [self.ioScheduler dispatchAsyncForKey:key block:^{
         NSData *imageData = [self diskImageDataBySearchingAllPathsForKey:key];
         if (completionBlock) {
             dispatch_async(dispatch_get_main_queue(), ^{
                 completionBlock(imageData);
             });
         }
-    });
+    }];
 }
 
 - (nullable NSData *)diskImageDataForKey:(nullable NSString *)key {
@@ -366,9 +481,9 @@ static NSString * _defaultDiskCacheDirectory;
         return nil;
     }
     __block NSData *imageData = nil;
-    dispatch_sync(self.ioQueue, ^{
+    [self.ioScheduler dispatchSyncForKey:key block:^{
         imageData = [self diskImageDataBySearchingAllPathsForKey:key];
-    });
+    }];
     
     return imageData;
 }
@@ -477,11 +592,37 @@ static NSString * _defaultDiskCacheDirectory;
     return [self diskImageForKey:key data:data options:0 context:nil];
 }
 
+// Whether the query uses the default decoding, the decoded disk cache tier only contains the default decoded image
+/// 查询是否使用默认解码，已解码硬盘缓存层只包含默认解码的图片
+static inline BOOL SDImageCacheCanUseDecodedDiskCache(SDImageCacheOptions options, SDWebImageContext * _Nullable context) {
+    if (options & (SDImageCacheScaleDownLargeImages | SDImageCacheAvoidDecodeImage | SDImageCacheMatchAnimatedImageClass)) {
+        return NO;
+    }
+    if (context[SDWebImageContextImageThumbnailPixelSize] || context[SDWebImageContextImageCoder] || context[SDWebImageContextAnimatedImageClass] || context[SDWebImageContextImageScaleFactor]) {
+        return NO;
+    }
+    return YES;
+}
+
 - (nullable UIImage *)diskImageForKey:(nullable NSString *)key data:(nullable NSData *)data options:(SDImageCacheOptions)options context:(SDWebImageContext *)context {
     if (!data) {
         return nil;
     }
-    UIImage *image = SDImageCacheDecodeImageData(data, key, [[self class] imageOptionsFromCacheOptions:options], context);
+    UIImage *image;
+    BOOL shouldUseDecodedDiskCache = self.decodedDiskCache && key && SDImageCacheCanUseDecodedDiskCache(options, context);
+    if (shouldUseDecodedDiskCache) {
+        // Map the decoded pixels, skip the decoding
+        /// 映射已解码的像素，跳过解码
+        image = [self.decodedDiskCache imageForKey:key];
+    }
+    if (!image) {
+        image = SDImageCacheDecodeImageData(data, key, [[self class] imageOptionsFromCacheOptions:options], context);
+        if (shouldUseDecodedDiskCache) {
+            // Write back in the key's IO lane, which serializes with the removal of the key
+            /// 在key的IO通道中回写，与该key的删除操作串行
+            [self _populateDecodedDiskCacheWithImage:image forKey:key];
+        }
+    }
     /// 解档图像和key
     [self _unarchiveObjectWithImage:image forKey:key];
     return image;
@@ -494,7 +635,11 @@ static NSString * _defaultDiskCacheDirectory;
     // Check extended data
     /// 检查扩展数据
     NSData *extendedData = [self.diskCache extendedDataForKey:key];
-    if (!extendedData) {
+    [self _unarchiveObjectWithImage:image extendedData:extendedData];
+}
+
+- (void)_unarchiveObjectWithImage:(UIImage *)image extendedData:(NSData *)extendedData {
+    if (!image || !extendedData) {
         return;
     }
     id extendedObject;
@@ -519,6 +664,75 @@ static NSString * _defaultDiskCacheDirectory;
     image.sd_extendedObject = extendedObject;
 }
 
+// Check the in-memory cache, and apply the first frame and animated class options to the cached image
+/// 检查内存缓存，并对缓存的图片应用首帧和动图类选项
+- (nullable UIImage *)_imageFromMemoryCacheForKey:(nonnull NSString *)key options:(SDImageCacheOptions)options context:(nullable SDWebImageContext *)context {
+    UIImage *image = [self imageFromMemoryCacheForKey:key];
+    /// 如果图像存在
+    if (image) {
+        if (options & SDImageCacheDecodeFirstFrameOnly) {
+            // Ensure static image
+            Class animatedImageClass = image.class;
+            if (image.sd_isAnimated || ([animatedImageClass isSubclassOfClass:[UIImage class]] && [animatedImageClass conformsToProtocol:@protocol(SDAnimatedImage)])) {
+#if SD_MAC
+                image = [[NSImage alloc] initWithCGImage:image.CGImage scale:image.scale orientation:kCGImagePropertyOrientationUp];
+#else
+                image = [[UIImage alloc] initWithCGImage:image.CGImage scale:image.scale orientation:image.imageOrientation];
+#endif
+            }
+        } else if (options & SDImageCacheMatchAnimatedImageClass) {
+            // Check image class matching
+            Class animatedImageClass = image.class;
+            Class desiredImageClass = context[SDWebImageContextAnimatedImageClass];
+            if (desiredImageClass && ![animatedImageClass isSubclassOfClass:desiredImageClass]) {
+                image = nil;
+            }
+        }
+    }
+    return image;
+}
+
+// Populate the decoded disk cache tier in the key's IO lane after decoding
+/// 解码后在key的IO通道中写入已解码硬盘缓存层
+- (void)_populateDecodedDiskCacheWithImage:(nullable UIImage *)image forKey:(nonnull NSString *)key {
+    if (!image || ![self.decodedDiskCache shouldStoreImage:image forKey:key]) {
+        return;
+    }
+    [self.ioScheduler dispatchAsyncForKey:key block:^{
+        // The data may be removed during decoding
+        /// 数据可能在解码期间被删除
+        if ([self.diskCache containsDataForKey:key]) {
+            [self.decodedDiskCache storeImage:image forKey:key];
+        }
+    }];
+}
+
+// The key of the in-flight query table, the cache key plus the options and context which affect the decoded image
+/// 进行中查询表的key，即缓存key加上影响解码图片的选项和上下文
+static inline NSString * _Nonnull SDImageCacheInflightKey(NSString * _Nonnull key, SDImageCacheOptions options, SDWebImageContext * _Nullable context) {
+    SDImageCacheOptions decodeOptions = options & (SDImageCacheScaleDownLargeImages | SDImageCacheDecodeFirstFrameOnly | SDImageCachePreloadAllFrames | SDImageCacheAvoidDecodeImage | SDImageCacheMatchAnimatedImageClass);
+    Class animatedImageClass = context[SDWebImageContextAnimatedImageClass];
+    id imageCoder = context[SDWebImageContextImageCoder];
+    return [NSString stringWithFormat:@"%@|%lu|%@|%@|%@|%@|%p|%@", key, (unsigned long)decodeOptions, context[SDWebImageContextImageThumbnailPixelSize], context[SDWebImageContextImagePreserveAspectRatio], context[SDWebImageContextImageScaleFactor], animatedImageClass ? NSStringFromClass(animatedImageClass) : @"", imageCoder, context[SDWebImageContextStoreCacheType]];
+}
+
+// Map the QoS class of the calling thread to the decode operation
+/// 将调用线程的QoS类映射到解码操作
+static inline NSQualityOfService SDQualityOfServiceFromQOSClass(qos_class_t qosClass) {
+    switch (qosClass) {
+        case QOS_CLASS_USER_INTERACTIVE:
+            return NSQualityOfServiceUserInteractive;
+        case QOS_CLASS_USER_INITIATED:
+            return NSQualityOfServiceUserInitiated;
+        case QOS_CLASS_UTILITY:
+            return NSQualityOfServiceUtility;
+        case QOS_CLASS_BACKGROUND:
+            return NSQualityOfServiceBackground;
+        default:
+            return NSQualityOfServiceDefault;
+    }
+}
+
 - (nullable NSOperation *)queryCacheOperationForKey:(NSString *)key done:(SDImageCacheQueryCompletionBlock)doneBlock {
     return [self queryCacheOperationForKey:key options:0 done:doneBlock];
 }
@@ -551,28 +765,7 @@ static NSString * _defaultDiskCacheDirectory;
     /// 首先在检查内存缓存
     UIImage *image;
     if (queryCacheType != SDImageCacheTypeDisk) {
-        image = [self imageFromMemoryCacheForKey:key];
-    }
-    /// 如果图像存在
-    if (image) {
-        if (options & SDImageCacheDecodeFirstFrameOnly) {
-            // Ensure static image
-            Class animatedImageClass = image.class;
-            if (image.sd_isAnimated || ([animatedImageClass isSubclassOfClass:[UIImage class]] && [animatedImageClass conformsToProtocol:@protocol(SDAnimatedImage)])) {
-#if SD_MAC
-                image = [[NSImage alloc] initWithCGImage:image.CGImage scale:image.scale orientation:kCGImagePropertyOrientationUp];
-#else
-                image = [[UIImage alloc] initWithCGImage:image.CGImage scale:image.scale orientation:image.imageOrientation];
-#endif
-            }
-        } else if (options & SDImageCacheMatchAnimatedImageClass) {
-            // Check image class matching
-            Class animatedImageClass = image.class;
-            Class desiredImageClass = context[SDWebImageContextAnimatedImageClass];
-            if (desiredImageClass && ![animatedImageClass isSubclassOfClass:desiredImageClass]) {
-                image = nil;
-            }
-        }
+        image = [self _imageFromMemoryCacheForKey:key options:options context:context];
     }
     /// 是否仅在内存中查找
     BOOL shouldQueryMemoryOnly = (queryCacheType == SDImageCacheTypeMemory) || (image && !(options & SDImageCacheQueryMemoryData));
@@ -585,13 +778,80 @@ static NSString * _defaultDiskCacheDirectory;
     
     // Second check the disk cache...
     /// 第二步检查硬盘缓存
-    NSOperation *operation = [NSOperation new];
     // Check whether we need to synchronously query disk
     /// 检查是否需要同步查询硬盘
     // 1. in-memory cache hit & memoryDataSync 内存缓存找到 & 同步检查内存
     // 2. in-memory cache miss & diskDataSync 内存缓存未找到 & 同步查找硬盘
     BOOL shouldQueryDiskSync = ((image && options & SDImageCacheQueryMemoryDataSync) ||
                                 (!image && options & SDImageCacheQueryDiskDataSync));
+    if (!image && !shouldQueryDiskSync) {
+        // Attach to the in-flight query for the same key and decode options
+        /// 附加到相同key和解码选项的进行中查询
+        return [self _coalescedQueryDiskForKey:key options:options context:context done:doneBlock];
+    }
+    SDImageCacheQueryOperation *operation = [SDImageCacheQueryOperation new];
+    [self _queryDiskForKey:key memoryImage:image options:options context:context operation:operation sync:shouldQueryDiskSync done:doneBlock];
+    return operation;
+}
+
+// Read the data on the IO scheduler, decode on the decode queue, then insert into memory cache and complete. The cancellation is checked between the stages
+/// 在IO调度器上读取数据，在解码队列上解码，然后写入内存缓存并回调。在阶段之间检查取消
+- (void)_queryDiskForKey:(nonnull NSString *)key memoryImage:(nullable UIImage *)image options:(SDImageCacheOptions)options context:(nullable SDWebImageContext *)context operation:(nonnull SDImageCacheQueryOperation *)operation sync:(BOOL)shouldQueryDiskSync done:(nullable SDImageCacheQueryCompletionBlock)doneBlock {
+    BOOL shouldUseDecodedDiskCache = self.decodedDiskCache && SDImageCacheCanUseDecodedDiskCache(options, context);
+    BOOL shouldCacheToMomery = YES;
+    if (context[SDWebImageContextStoreCacheType]) {
+        SDImageCacheType cacheType = [context[SDWebImageContextStoreCacheType] integerValue];
+        shouldCacheToMomery = (cacheType == SDImageCacheTypeAll || cacheType == SDImageCacheTypeMemory);
+    }
+    // The decoding inherits the QoS of the caller
+    /// 解码继承调用方的QoS
+    NSQualityOfService decodeQualityOfService = SDQualityOfServiceFromQOSClass(qos_class_self());
+    
+    // Stage 3: memory cache insert and completion
+    /// 阶段3：写入内存缓存并回调
+    void(^finishBlock)(UIImage *, NSData *) = ^(UIImage *diskImage, NSData *diskData) {
+        // decode image data only if in-memory cache missed, so only cache the image from disk
+        /// 仅在内存缓存丢失时解码图像数据，因此只缓存来自硬盘的图片
+        if (diskImage && diskImage != image && shouldCacheToMomery && self.config.shouldCacheImagesInMemory) {
+            NSUInteger cost = diskImage.sd_memoryCost;
+            [self.memoryCache setObject:diskImage forKey:key cost:cost];
+        }
+        operation.totalDuration = CFAbsoluteTimeGetCurrent() - operation.startTime;
+        if (doneBlock) {
+            if (shouldQueryDiskSync) {
+                doneBlock(diskImage, diskData, SDImageCacheTypeDisk);
+            } else {
+                dispatch_async(dispatch_get_main_queue(), ^{
+                    doneBlock(diskImage, diskData, SDImageCacheTypeDisk);
+                });
+            }
+        }
+    };
+    
+    // Stage 2: decode outside the IO scheduler, so one large image does not block the other disk reads
+    /// 阶段2：在IO调度器之外解码，因此一张大图不会阻塞其他硬盘读取
+    void(^decodeBlock)(NSData *, NSData *, CFAbsoluteTime) = ^(NSData *diskData, NSData *extendedData, CFAbsoluteTime enqueueTime) {
+        if (operation.isCancelled) {
+            if (doneBlock) {
+                doneBlock(nil, nil, SDImageCacheTypeNone);
+            }
+            return;
+        }
+        @autoreleasepool {
+            UIImage *diskImage = SDImageCacheDecodeImageData(diskData, key, [[self class] imageOptionsFromCacheOptions:options], context);
+            if (shouldUseDecodedDiskCache) {
+                [self _populateDecodedDiskCacheWithImage:diskImage forKey:key];
+            }
+            [self _unarchiveObjectWithImage:diskImage extendedData:extendedData];
+            operation.decodeDuration = CFAbsoluteTimeGetCurrent() - enqueueTime;
+            finishBlock(diskImage, diskData);
+        }
+    };
+    
+    // Stage 1: read the data (and the already decoded image) on the IO scheduler
+    /// 阶段1：在IO调度器上读取数据(以及已解码的图片)
+    __block NSData *pendingDiskData;
+    __block NSData *pendingExtendedData;
     void(^queryDiskBlock)(void) =  ^{
         if (operation.isCancelled) {
             if (doneBlock) {
@@ -601,47 +861,118 @@ static NSString * _defaultDiskCacheDirectory;
         }
         
         @autoreleasepool {
+            CFAbsoluteTime ioStartTime = CFAbsoluteTimeGetCurrent();
+            operation.waitDuration = ioStartTime - operation.startTime;
             NSData *diskData = [self diskImageDataBySearchingAllPathsForKey:key];
             UIImage *diskImage;
+            NSData *extendedData;
             if (image) {
                 // the image is from in-memory cache, but need image data
                 // 该图片对象来自内存缓存, 但需要图像数据
                 diskImage = image;
             } else if (diskData) {
-                BOOL shouldCacheToMomery = YES;
-                if (context[SDWebImageContextStoreCacheType]) {
-                    SDImageCacheType cacheType = [context[SDWebImageContextStoreCacheType] integerValue];
-                    shouldCacheToMomery = (cacheType == SDImageCacheTypeAll || cacheType == SDImageCacheTypeMemory);
+                if (shouldUseDecodedDiskCache) {
+                    // Map the decoded pixels, skip the decoding
+                    /// 映射已解码的像素，跳过解码
+                    diskImage = [self.decodedDiskCache imageForKey:key];
                 }
-                // decode image data only if in-memory cache missed
-                /// 仅在内存缓存丢失时解码图像数据
-                diskImage = [self diskImageForKey:key data:diskData options:options context:context];
-                if (shouldCacheToMomery && diskImage && self.config.shouldCacheImagesInMemory) {
-                    NSUInteger cost = diskImage.sd_memoryCost;
-                    [self.memoryCache setObject:diskImage forKey:key cost:cost];
+                extendedData = [self.diskCache extendedDataForKey:key];
+                if (diskImage) {
+                    [self _unarchiveObjectWithImage:diskImage extendedData:extendedData];
                 }
             }
+            operation.ioDuration = CFAbsoluteTimeGetCurrent() - ioStartTime;
             
-            if (doneBlock) {
-                if (shouldQueryDiskSync) {
-                    doneBlock(diskImage, diskData, SDImageCacheTypeDisk);
-                } else {
-                    dispatch_async(dispatch_get_main_queue(), ^{
-                        doneBlock(diskImage, diskData, SDImageCacheTypeDisk);
-                    });
-                }
+            if (diskImage || !diskData) {
+                finishBlock(diskImage, diskData);
+            } else if (shouldQueryDiskSync) {
+                // Decode on the calling thread after leaving the IO scheduler
+                /// 离开IO调度器后在调用线程解码
+                pendingDiskData = diskData;
+                pendingExtendedData = extendedData;
+            } else {
+                CFAbsoluteTime enqueueTime = CFAbsoluteTimeGetCurrent();
+                NSBlockOperation *decodeOperation = [NSBlockOperation blockOperationWithBlock:^{
+                    decodeBlock(diskData, extendedData, enqueueTime);
+                }];
+                decodeOperation.qualityOfService = decodeQualityOfService;
+                [self.decodeQueue addOperation:decodeOperation];
             }
         }
     };
     
-    // Query in ioQueue to keep IO-safe
-    // iO安全
+    // Query in the key's IO lane to keep IO-safe, the queries for different keys run concurrently
+    // iO安全，不同key的查询并发执行
     if (shouldQueryDiskSync) {
-        dispatch_sync(self.ioQueue, queryDiskBlock);
+        [self.ioScheduler dispatchSyncForKey:key block:queryDiskBlock];
+        if (pendingDiskData) {
+            decodeBlock(pendingDiskData, pendingExtendedData, CFAbsoluteTimeGetCurrent());
+        }
     } else {
-        dispatch_async(self.ioQueue, queryDiskBlock);
+        [self.ioScheduler dispatchAsyncForKey:key block:queryDiskBlock];
     }
+}
+
+// All the queries for the same key and decode options share one read/decode, the shared one is cancelled only when all the queries are cancelled
+/// 相同key和解码选项的所有查询共享一次读取/解码，只有所有查询都取消时才取消共享的读取/解码
+- (nonnull SDImageCacheQueryOperation *)_coalescedQueryDiskForKey:(nonnull NSString *)key options:(SDImageCacheOptions)options context:(nullable SDWebImageContext *)context done:(nullable SDImageCacheQueryCompletionBlock)doneBlock {
+    NSString *inflightKey = SDImageCacheInflightKey(key, options, context);
+    SDImageCacheQueryOperation *operation = [SDImageCacheQueryOperation new];
+    SD_LOCK(_inflightQueriesLock);
+    SDImageCacheInflightQuery *inflightQuery = self.inflightQueries[inflightKey];
+    BOOL shouldStartQuery = !inflightQuery;
+    if (shouldStartQuery) {
+        inflightQuery = [SDImageCacheInflightQuery new];
+        self.inflightQueries[inflightKey] = inflightQuery;
+    }
+    [inflightQuery addSubscriber:operation doneBlock:doneBlock];
+    SD_UNLOCK(_inflightQueriesLock);
     
+    __weak SDImageCacheQueryOperation *weakOperation = operation;
+    operation.cancellationHandler = ^{
+        SDImageCacheQueryOperation *strongOperation = weakOperation;
+        if (!strongOperation) {
+            return;
+        }
+        SD_LOCK(self->_inflightQueriesLock);
+        SDImageCacheQueryCompletionBlock subscriberDoneBlock = [inflightQuery removeSubscriber:strongOperation];
+        BOOL shouldCancelQuery = subscriberDoneBlock && inflightQuery.subscriberCount == 0;
+        if (shouldCancelQuery && self.inflightQueries[inflightKey] == inflightQuery) {
+            [self.inflightQueries removeObjectForKey:inflightKey];
+        }
+        SD_UNLOCK(self->_inflightQueriesLock);
+        if (shouldCancelQuery) {
+            [inflightQuery.operation cancel];
+        }
+        if (subscriberDoneBlock) {
+            // Keep the same behavior as the single query, the cancelled query is called back from IO scheduler
+            /// 与单独查询保持相同的行为，取消的查询从IO调度器回调
+            [self.ioScheduler dispatchAsyncForKey:key block:^{
+                subscriberDoneBlock(nil, nil, SDImageCacheTypeNone);
+            }];
+        }
+    };
+    
+    if (shouldStartQuery) {
+        [self _queryDiskForKey:key memoryImage:nil options:options context:context operation:inflightQuery.operation sync:NO done:^(UIImage * _Nullable diskImage, NSData * _Nullable diskData, SDImageCacheType cacheType) {
+            SD_LOCK(self->_inflightQueriesLock);
+            if (self.inflightQueries[inflightKey] == inflightQuery) {
+                [self.inflightQueries removeObjectForKey:inflightKey];
+            }
+            NSMapTable<SDImageCacheQueryOperation *, SDImageCacheQueryCompletionBlock> *subscribers = [inflightQuery removeAllSubscribers];
+            SD_UNLOCK(self->_inflightQueriesLock);
+            CFAbsoluteTime finishTime = CFAbsoluteTimeGetCurrent();
+            for (SDImageCacheQueryOperation *subscriber in subscribers) {
+                subscriber.cancellationHandler = nil;
+                subscriber.waitDuration = inflightQuery.operation.waitDuration;
+                subscriber.ioDuration = inflightQuery.operation.ioDuration;
+                subscriber.decodeDuration = inflightQuery.operation.decodeDuration;
+                subscriber.totalDuration = finishTime - subscriber.startTime;
+                SDImageCacheQueryCompletionBlock subscriberDoneBlock = [subscribers objectForKey:subscriber];
+                subscriberDoneBlock(diskImage, diskData, cacheType);
+            }
+        }];
+    }
     return operation;
 }
 
@@ -665,15 +996,16 @@ static NSString * _defaultDiskCacheDirectory;
     }
 
     if (fromDisk) {
-        dispatch_async(self.ioQueue, ^{
+        [self.ioScheduler dispatchAsyncForKey:key block:^{
             [self.diskCache removeDataForKey:key];
+            [self.decodedDiskCache removeImageForKey:key];
             
             if (completion) {
                 dispatch_async(dispatch_get_main_queue(), ^{
                     completion();
                 });
             }
-        });
+        }];
     } else if (completion) {
         completion();
     }
@@ -691,9 +1023,9 @@ static NSString * _defaultDiskCacheDirectory;
     if (!key) {
         return;
     }
-    dispatch_sync(self.ioQueue, ^{
+    [self.ioScheduler dispatchSyncForKey:key block:^{
         [self _removeImageFromDiskForKey:key];
-    });
+    }];
 }
 
 // Make sure to call from io queue by caller
@@ -703,6 +1035,7 @@ static NSString * _defaultDiskCacheDirectory;
     }
     
     [self.diskCache removeDataForKey:key];
+    [self.decodedDiskCache removeImageForKey:key];
 }
 
 #pragma mark - Cache clean Ops
@@ -712,25 +1045,53 @@ static NSString * _defaultDiskCacheDirectory;
 }
 
 - (void)clearDiskOnCompletion:(nullable SDWebImageNoParamsBlock)completion {
-    dispatch_async(self.ioQueue, ^{
+    [self.ioScheduler dispatchBarrierAsync:^{
         [self.diskCache removeAllData];
+        [self.decodedDiskCache removeAllImages];
         if (completion) {
             dispatch_async(dispatch_get_main_queue(), ^{
                 completion();
             });
         }
-    });
+    }];
 }
 
 - (void)deleteOldFilesWithCompletionBlock:(nullable SDWebImageNoParamsBlock)completionBlock {
-    dispatch_async(self.ioQueue, ^{
+    NSUInteger sliceCount = self.config.diskCacheEvictionSliceCount;
+    NSTimeInterval sliceDuration = self.config.diskCacheEvictionSliceDuration;
+    if ((sliceCount > 0 || sliceDuration > 0) && [self.diskCache respondsToSelector:@selector(removeExpiredDataWithCountLimit:timeLimit:)]) {
+        [self deleteOldFilesSliceWithCountLimit:sliceCount timeLimit:sliceDuration completionBlock:completionBlock];
+        return;
+    }
+    [self.ioScheduler dispatchBarrierAsync:^{
         [self.diskCache removeExpiredData];
+        [self.decodedDiskCache removeExpiredImages];
+        [self removeStaleTemporaryFiles];
         if (completionBlock) {
             dispatch_async(dispatch_get_main_queue(), ^{
                 completionBlock();
             });
         }
-    });
+    }];
+}
+
+// Each slice is re-enqueued into the tail of one IO lane instead of a barrier, so the other lanes keep running and the pending disk queries are not blocked by the whole eviction. A file written or accessed meanwhile is skipped because the plan is revalidated against the index
+/// 每个切片重新加入一个IO通道的尾部而不是作为屏障，因此其他通道继续执行，等待中的硬盘查询不会被整个清理阻塞。期间被写入或访问的文件会因计划根据索引重新校验而被跳过
+- (void)deleteOldFilesSliceWithCountLimit:(NSUInteger)countLimit timeLimit:(NSTimeInterval)timeLimit completionBlock:(nullable SDWebImageNoParamsBlock)completionBlock {
+    [self.ioScheduler dispatchAsyncForKey:nil block:^{
+        BOOL finished = [self.diskCache removeExpiredDataWithCountLimit:countLimit timeLimit:timeLimit];
+        if (!finished) {
+            [self deleteOldFilesSliceWithCountLimit:countLimit timeLimit:timeLimit completionBlock:completionBlock];
+            return;
+        }
+        [self.decodedDiskCache removeExpiredImages];
+        [self removeStaleTemporaryFiles];
+        if (completionBlock) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                completionBlock();
+            });
+        }
+    }];
 }
 
 #pragma mark - UIApplicationWillTerminateNotification
@@ -742,9 +1103,11 @@ static NSString * _defaultDiskCacheDirectory;
     if (!self.config.shouldRemoveExpiredDataWhenTerminate) {
         return;
     }
-    dispatch_sync(self.ioQueue, ^{
+    [self.ioScheduler dispatchBarrierSync:^{
         [self.diskCache removeExpiredData];
-    });
+        [self.decodedDiskCache removeExpiredImages];
+        [self removeStaleTemporaryFiles];
+    }];
 }
 #endif
 
@@ -777,24 +1140,18 @@ static NSString * _defaultDiskCacheDirectory;
 
 #pragma mark - Cache Info
 
+// The built-in disk caches keep the totals in a thread-safe index, read them directly instead of waiting for all the IO lanes
+// 内置的硬盘缓存在线程安全的索引中维护总量，直接读取而不必等待所有IO通道
 - (NSUInteger)totalDiskSize {
-    __block NSUInteger size = 0;
-    dispatch_sync(self.ioQueue, ^{
-        size = [self.diskCache totalSize];
-    });
-    return size;
+    return [self.diskCache totalSize];
 }
 
 - (NSUInteger)totalDiskCount {
-    __block NSUInteger count = 0;
-    dispatch_sync(self.ioQueue, ^{
-        count = [self.diskCache totalCount];
-    });
-    return count;
+    return [self.diskCache totalCount];
 }
 
 - (void)calculateSizeWithCompletionBlock:(nullable SDImageCacheCalculateSizeBlock)completionBlock {
-    dispatch_async(self.ioQueue, ^{
+    [self.ioScheduler dispatchBarrierAsync:^{
         NSUInteger fileCount = [self.diskCache totalCount];
         NSUInteger totalSize = [self.diskCache totalSize];
         if (completionBlock) {
@@ -802,10 +1159,24 @@ static NSString * _defaultDiskCacheDirectory;
                 completionBlock(fileCount, totalSize);
             });
         }
-    });
+    }];
 }
 
 #pragma mark - Helper
++ (SDImageCacheOptions)cacheOptionsFromImageOptions:(SDWebImageOptions)options {
+    SDImageCacheOptions cacheOptions = 0;
+    if (options & SDWebImageQueryMemoryData) cacheOptions |= SDImageCacheQueryMemoryData;
+    if (options & SDWebImageQueryMemoryDataSync) cacheOptions |= SDImageCacheQueryMemoryDataSync;
+    if (options & SDWebImageQueryDiskDataSync) cacheOptions |= SDImageCacheQueryDiskDataSync;
+    if (options & SDWebImageScaleDownLargeImages) cacheOptions |= SDImageCacheScaleDownLargeImages;
+    if (options & SDWebImageAvoidDecodeImage) cacheOptions |= SDImageCacheAvoidDecodeImage;
+    if (options & SDWebImageDecodeFirstFrameOnly) cacheOptions |= SDImageCacheDecodeFirstFrameOnly;
+    if (options & SDWebImagePreloadAllFrames) cacheOptions |= SDImageCachePreloadAllFrames;
+    if (options & SDWebImageMatchAnimatedImageClass) cacheOptions |= SDImageCacheMatchAnimatedImageClass;
+    
+    return cacheOptions;
+}
+
 + (SDWebImageOptions)imageOptionsFromCacheOptions:(SDImageCacheOptions)cacheOptions {
     SDWebImageOptions options = 0;
     if (cacheOptions & SDImageCacheScaleDownLargeImages) options |= SDWebImageScaleDownLargeImages;
@@ -828,19 +1199,191 @@ static NSString * _defaultDiskCacheDirectory;
 }
 
 - (id<SDWebImageOperation>)queryImageForKey:(NSString *)key options:(SDWebImageOptions)options context:(nullable SDWebImageContext *)context cacheType:(SDImageCacheType)cacheType completion:(nullable SDImageCacheQueryCompletionBlock)completionBlock {
-    SDImageCacheOptions cacheOptions = 0;
-    if (options & SDWebImageQueryMemoryData) cacheOptions |= SDImageCacheQueryMemoryData;
-    if (options & SDWebImageQueryMemoryDataSync) cacheOptions |= SDImageCacheQueryMemoryDataSync;
-    if (options & SDWebImageQueryDiskDataSync) cacheOptions |= SDImageCacheQueryDiskDataSync;
-    if (options & SDWebImageScaleDownLargeImages) cacheOptions |= SDImageCacheScaleDownLargeImages;
-    if (options & SDWebImageAvoidDecodeImage) cacheOptions |= SDImageCacheAvoidDecodeImage;
-    if (options & SDWebImageDecodeFirstFrameOnly) cacheOptions |= SDImageCacheDecodeFirstFrameOnly;
-    if (options & SDWebImagePreloadAllFrames) cacheOptions |= SDImageCachePreloadAllFrames;
-    if (options & SDWebImageMatchAnimatedImageClass) cacheOptions |= SDImageCacheMatchAnimatedImageClass;
-    
+    SDImageCacheOptions cacheOptions = [[self class] cacheOptionsFromImageOptions:options];
     return [self queryCacheOperationForKey:key options:cacheOptions context:context cacheType:cacheType done:completionBlock];
 }
 
+- (id<SDWebImageOperation>)queryImagesForKeys:(NSArray<NSString *> *)keys options:(SDWebImageOptions)options context:(nullable SDWebImageContext *)context completion:(nullable SDImageCacheBatchQueryCompletionBlock)completionBlock {
+    return [self queryImagesForKeys:keys options:options context:context cacheType:SDImageCacheTypeAll progress:nil completion:completionBlock];
+}
+
+- (id<SDWebImageOperation>)queryImagesForKeys:(NSArray<NSString *> *)keys options:(SDWebImageOptions)options context:(nullable SDWebImageContext *)context cacheType:(SDImageCacheType)queryCacheType progress:(nullable SDImageCacheBatchQueryProgressBlock)progressBlock completion:(nullable SDImageCacheBatchQueryCompletionBlock)completionBlock {
+    SDImageCacheOptions cacheOptions = [[self class] cacheOptionsFromImageOptions:options];
+    NSMutableDictionary<NSString *, UIImage *> *images = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString *, NSNumber *> *cacheTypes = [NSMutableDictionary dictionary];
+    // Invalid cache type
+    /// 非法缓存类型
+    if (queryCacheType == SDImageCacheTypeNone) {
+        if (completionBlock) {
+            completionBlock(images, cacheTypes);
+        }
+        return nil;
+    }
+    
+    // First check the in-memory cache for all the keys at once
+    /// 首先一次性检查所有key的内存缓存
+    NSMutableOrderedSet<NSString *> *diskKeys = [NSMutableOrderedSet orderedSet];
+    NSMutableDictionary<NSString *, UIImage *> *memoryImages = [NSMutableDictionary dictionary];
+    NSMutableOrderedSet<NSString *> *resolvedMemoryKeys = [NSMutableOrderedSet orderedSet];
+    for (NSString *key in keys) {
+        if ([resolvedMemoryKeys containsObject:key] || [diskKeys containsObject:key]) {
+            continue;
+        }
+        UIImage *image;
+        if (queryCacheType != SDImageCacheTypeDisk) {
+            image = [self _imageFromMemoryCacheForKey:key options:cacheOptions context:context];
+        }
+        if (image && !(cacheOptions & SDImageCacheQueryMemoryData)) {
+            images[key] = image;
+            cacheTypes[key] = @(SDImageCacheTypeMemory);
+            [resolvedMemoryKeys addObject:key];
+            continue;
+        }
+        if (queryCacheType == SDImageCacheTypeMemory) {
+            [resolvedMemoryKeys addObject:key];
+            continue;
+        }
+        if (image) {
+            // the image is from in-memory cache, but need image data
+            // 该图片对象来自内存缓存, 但需要图像数据
+            memoryImages[key] = image;
+        }
+        [diskKeys addObject:key];
+    }
+    // The progress of the memory results, called synchronously if all the keys are resolved from memory, else on the main queue before the disk results
+    /// 内存结果的进度回调，如果所有key都在内存中解析则同步调用，否则在主队列中先于硬盘结果调用
+    NSDictionary<NSString *, UIImage *> *resolvedMemoryImages = [images copy];
+    void(^memoryProgressBlock)(void) = ^{
+        for (NSString *key in resolvedMemoryKeys) {
+            UIImage *image = resolvedMemoryImages[key];
+            progressBlock(image, nil, image ? SDImageCacheTypeMemory : SDImageCacheTypeNone, key);
+        }
+    };
+    if (diskKeys.count == 0) {
+        if (progressBlock) {
+            memoryProgressBlock();
+        }
+        if (completionBlock) {
+            completionBlock(images, cacheTypes);
+        }
+        return nil;
+    }
+    
+    // Second issue the disk reads as one batch, one IO hop for each lane, then decode in parallel
+    /// 第二步将硬盘读取作为一批发出，每个通道一次IO跳转，然后并行解码
+    SDImageCachesManagerOperation *operation = [SDImageCachesManagerOperation new];
+    [operation beginWithTotalCount:diskKeys.count];
+    // Called once on the main queue, with all the results when finished, or the partial results when cancelled
+    /// 在主队列调用一次，完成时带上所有结果，取消时带上部分结果
+    void(^finishBlock)(void) = ^{
+        @synchronized (operation) {
+            if (operation.isFinished) {
+                return;
+            }
+            [operation done];
+        }
+        if (completionBlock) {
+            NSDictionary<NSString *, UIImage *> *resultImages;
+            NSDictionary<NSString *, NSNumber *> *resultCacheTypes;
+            @synchronized (images) {
+                resultImages = [images copy];
+                resultCacheTypes = [cacheTypes copy];
+            }
+            completionBlock(resultImages, resultCacheTypes);
+        }
+    };
+    operation.cancelBlock = ^{
+        dispatch_async(dispatch_get_main_queue(), finishBlock);
+    };
+    if (progressBlock && resolvedMemoryKeys.count > 0) {
+        dispatch_async(dispatch_get_main_queue(), ^{
+            if (!operation.isCancelled) {
+                memoryProgressBlock();
+            }
+        });
+    }
+    NSDictionary<NSString *, UIImage *> *pendingMemoryImages = [memoryImages copy];
+    SDWebImageOptions imageOptions = [[self class] imageOptionsFromCacheOptions:cacheOptions];
+    BOOL shouldUseDecodedDiskCache = self.decodedDiskCache && SDImageCacheCanUseDecodedDiskCache(cacheOptions, context);
+    BOOL shouldCacheToMomery = YES;
+    if (context[SDWebImageContextStoreCacheType]) {
+        SDImageCacheType cacheType = [context[SDWebImageContextStoreCacheType] integerValue];
+        shouldCacheToMomery = (cacheType == SDImageCacheTypeAll || cacheType == SDImageCacheTypeMemory);
+    }
+    NSQualityOfService decodeQualityOfService = SDQualityOfServiceFromQOSClass(qos_class_self());
+    dispatch_group_t group = dispatch_group_create();
+    void(^resolveBlock)(NSString *, UIImage *, NSData *, BOOL) = ^(NSString *key, UIImage *image, NSData *data, BOOL fromDisk) {
+        if (fromDisk && image && shouldCacheToMomery && self.config.shouldCacheImagesInMemory) {
+            NSUInteger cost = image.sd_memoryCost;
+            [self.memoryCache setObject:image forKey:key cost:cost];
+        }
+        if (image) {
+            @synchronized (images) {
+                images[key] = image;
+                cacheTypes[key] = @(SDImageCacheTypeDisk);
+            }
+        }
+        if (progressBlock) {
+            dispatch_async(dispatch_get_main_queue(), ^{
+                if (!operation.isCancelled) {
+                    progressBlock(image, data, image ? SDImageCacheTypeDisk : SDImageCacheTypeNone, key);
+                }
+            });
+        }
+    };
+    for (NSUInteger i = 0; i < diskKeys.count; i++) {
+        dispatch_group_enter(group);
+    }
+    [self.ioScheduler dispatchAsyncForKeys:diskKeys.array block:^(NSArray<NSString *> * _Nonnull laneKeys) {
+        for (NSString *key in laneKeys) {
+            if (operation.isCancelled) {
+                dispatch_group_leave(group);
+                continue;
+            }
+            @autoreleasepool {
+                NSData *diskData = [self diskImageDataBySearchingAllPathsForKey:key];
+                UIImage *memoryImage = pendingMemoryImages[key];
+                UIImage *diskImage = memoryImage;
+                NSData *extendedData;
+                if (!diskImage && diskData) {
+                    if (shouldUseDecodedDiskCache) {
+                        diskImage = [self.decodedDiskCache imageForKey:key];
+                    }
+                    extendedData = [self.diskCache extendedDataForKey:key];
+                    if (diskImage) {
+                        [self _unarchiveObjectWithImage:diskImage extendedData:extendedData];
+                    }
+                }
+                if (diskImage || !diskData) {
+                    resolveBlock(key, diskImage, diskData, !memoryImage);
+                    dispatch_group_leave(group);
+                    continue;
+                }
+                NSBlockOperation *decodeOperation = [NSBlockOperation blockOperationWithBlock:^{
+                    if (!operation.isCancelled) {
+                        @autoreleasepool {
+                            UIImage *image = SDImageCacheDecodeImageData(diskData, key, imageOptions, context);
+                            if (shouldUseDecodedDiskCache) {
+                                [self _populateDecodedDiskCacheWithImage:image forKey:key];
+                            }
+                            [self _unarchiveObjectWithImage:image extendedData:extendedData];
+                            resolveBlock(key, image, diskData, YES);
+                        }
+                    }
+                    dispatch_group_leave(group);
+                }];
+                decodeOperation.qualityOfService = decodeQualityOfService;
+                [self.decodeQueue addOperation:decodeOperation];
+            }
+        }
+    }];
+    // One coalesced callback for all the keys
+    /// 所有key合并为一次回调
+    dispatch_group_notify(group, dispatch_get_main_queue(), finishBlock);
+    
+    return operation;
+}
+
 - (void)storeImage:(UIImage *)image imageData:(NSData *)imageData forKey:(nullable NSString *)key cacheType:(SDImageCacheType)cacheType completion:(nullable SDWebImageNoParamsBlock)completionBlock {
     switch (cacheType) {
         case SDImageCacheTypeNone: {
@@ -34,6 +34,41 @@ typedef NS_ENUM(NSUInteger, SDImageCacheConfigExpireType) {
     SDImageCacheConfigExpireTypeChangeDate,
 };
 
+/// Memory Cache Admission/Eviction Policy
+/// 内存缓存准入/淘汰策略
+typedef NS_ENUM(NSUInteger, SDImageCacheConfigMemoryCachePolicy) {
+    /**
+     * Least recently used, new object is always admitted and the least recently used one get evicted (Default)
+     * 最近最少使用，新对象总是被接纳，最近最少使用的对象被淘汰(默认值)
+     */
+    SDImageCacheConfigMemoryCachePolicyLRU,
+    /**
+     * W-TinyLFU. New object enters a small window LRU, when the window overflows, the candidate is admitted into a segmented main LRU only if its estimated access frequency (count-min sketch) is higher than the main victim. This protects the hot set from being flushed by one-time scans, such as a long feed or prefetch batch.
+     * W-TinyLFU。新对象进入一个小的窗口LRU，当窗口溢出时，只有当候选者的估计访问频率(count-min草图)高于主空间的淘汰者时，才会被接纳进入分段的主LRU。这可以保护热点集合不被一次性扫描冲掉，例如长列表或预加载批次
+     */
+    SDImageCacheConfigMemoryCachePolicyTinyLFU,
+};
+
+/// Disk Cache Size-based Eviction Policy
+/// 硬盘缓存基于大小的淘汰策略
+typedef NS_ENUM(NSUInteger, SDImageCacheConfigDiskEvictionPolicy) {
+    /**
+     * Delete the oldest files first, the date is checked against `diskCacheExpireType` (Default)
+     * 先删除最老的文件，日期根据`diskCacheExpireType`判断(默认值)
+     */
+    SDImageCacheConfigDiskEvictionPolicyDate,
+    /**
+     * Greedy-Dual-Size-Frequency with a uniform cost (cost = 1), which maximizes the hit ratio. Each file has a priority `H = L + frequency * cost / size`, where `L` is the priority of the last evicted file (aging). Delete the lowest priority files first, so large and rarely accessed images are evicted before small and frequently accessed ones, and old popularity fades as `L` grows. The ties are broken by the access date, the least recently used first.
+     * 使用统一代价(代价 = 1)的Greedy-Dual-Size-Frequency，以最大化命中率。每个文件的优先级为`H = L + 频率 * 代价 / 大小`，其中`L`为上一个被淘汰文件的优先级(老化)。先删除优先级最低的文件，因此大且很少访问的图片会在小且经常访问的图片之前被淘汰，且旧的热度会随着`L`的增长而衰减。优先级相同时按访问日期决定，最久未使用的先删除
+     */
+    SDImageCacheConfigDiskEvictionPolicyGDSF,
+    /**
+     * Greedy-Dual-Size-Frequency with a byte-oriented cost (cost = file size), which maximizes the byte hit ratio. The priority becomes `H = L + frequency`, so the size no longer penalizes the large images.
+     * 使用面向字节的代价(代价 = 文件大小)的Greedy-Dual-Size-Frequency，以最大化字节命中率。优先级变为`H = L + 频率`，因此大小不再惩罚大图片
+     */
+    SDImageCacheConfigDiskEvictionPolicyGDSFByteHitRatio,
+};
+
 /**
  The class contains all the config for image cache
  这个类包括所有对于图像缓存的配置
@@ -100,6 +135,36 @@ typedef NS_ENUM(NSUInteger, SDImageCacheConfigExpireType) {
  */
 @property (assign, nonatomic) NSDataReadingOptions diskCacheReadingOptions;
 
+/**
+ * The file size threshold (in bytes) to read the disk cache with a zero-copy memory mapping. The files equal or larger than this size are mapped with `mmap` and advised for sequential access, then handed to the coders without copying into heap. The smaller files still use a plain read, because mapping has a fixed syscall and page fault cost.
+ * @note This only works for `SDDiskCache` and when `diskCacheWritingOptions` contains `NSDataWritingAtomic`, because the atomic write replaces the file instead of truncating it, so the mapped pages are always valid.
+ * Defaults to 0. Which means disabled, `diskCacheReadingOptions` is used.
+ * 以零拷贝内存映射读取硬盘缓存的文件大小阈值(字节)。大于等于此大小的文件会通过`mmap`映射并建议顺序访问，然后直接交给解码器而不复制到堆内存。较小的文件仍然使用普通读取，因为映射有固定的系统调用和缺页开销
+ * @note 仅对`SDDiskCache`且`diskCacheWritingOptions`包含`NSDataWritingAtomic`时生效，因为原子写入会替换文件而不是截断文件，所以映射的页面总是有效的
+ * 默认为0，表示禁用，使用`diskCacheReadingOptions`
+ */
+@property (assign, nonatomic) NSUInteger diskCacheMappedReadingThreshold;
+
+/**
+ * The maximum number of the concurrent disk operations of `SDImageCache`. The operations are hashed into this number of serial lanes by the cache key, so the disk queries for different keys run concurrently, while the operations for the same key keep the submission order. The whole-cache operations (clear, expiration, size query) still run exclusively.
+ * @note When this is larger than 1, the disk cache methods for different keys may be called concurrently, so the custom disk cache class must be thread-safe. `SDDiskCache` is thread-safe.
+ * Defaults to 1. Which means all the disk operations are serial.
+ * `SDImageCache`并发硬盘操作的最大数量。操作按缓存key散列到此数量的串行通道中，因此不同key的硬盘查询并发执行，而同一key的操作保持提交顺序。整个缓存的操作(清理、过期、大小查询)仍然独占执行
+ * @note 大于1时，不同key的硬盘缓存方法可能被并发调用，因此自定义硬盘缓存类必须是线程安全的。`SDDiskCache`是线程安全的
+ * 默认为1，表示所有硬盘操作都是串行的
+ */
+@property (assign, nonatomic) NSUInteger maxConcurrentDiskOperationCount;
+
+/**
+ * The maximum number of the concurrent image decoding of `SDImageCache` disk query. The disk query reads the data on the IO scheduler, then decodes it on a dedicated decode queue, so one large image decoding does not block the other disk reads. The decoding inherits the quality of service of the query caller.
+ * @note The sync query (`SDImageCacheQueryDiskDataSync`) still decodes on the calling thread.
+ * Defaults to 0. Which means using the active processor count.
+ * `SDImageCache`硬盘查询的最大并发解码数。硬盘查询在IO调度器上读取数据，然后在专用的解码队列上解码，因此一张大图的解码不会阻塞其他硬盘读取。解码继承查询调用方的服务质量
+ * @note 同步查询(`SDImageCacheQueryDiskDataSync`)仍然在调用线程解码
+ * 默认为0，表示使用活跃处理器数
+ */
+@property (assign, nonatomic) NSUInteger maxConcurrentDecodeOperationCount;
+
 /**
  * The writing options while writing cache to disk.
  * Defaults to `NSDataWritingAtomic`. You can set this to `NSDataWritingWithoutOverwriting` to prevent overwriting an existing file.
@@ -127,6 +192,60 @@ typedef NS_ENUM(NSUInteger, SDImageCacheConfigExpireType) {
  */
 @property (assign, nonatomic) NSUInteger maxDiskSize;
 
+/**
+ * The size-based cleanup starts when the disk cache size exceeds `maxDiskSize * diskCacheHighWatermark`.
+ * The value is clamped to 0...1, NaN is ignored. Defaults to 1.0.
+ * 当硬盘缓存大小超过`maxDiskSize * diskCacheHighWatermark`时开始基于大小的清理
+ * 该值会被限制在0...1之间，NaN会被忽略。默认为1.0
+ */
+@property (assign, nonatomic) double diskCacheHighWatermark;
+
+/**
+ * The size-based cleanup deletes the oldest files until the disk cache size falls below `maxDiskSize * diskCacheLowWatermark`.
+ * The value is clamped to 0...1, NaN is ignored. If it's greater than `diskCacheHighWatermark`, the cleanup uses `diskCacheHighWatermark` instead.
+ * Defaults to 0.5. Which matches the previous behavior (delete until half of `maxDiskSize`).
+ * 基于大小的清理会删除最老的文件，直到硬盘缓存大小低于`maxDiskSize * diskCacheLowWatermark`
+ * 该值会被限制在0...1之间，NaN会被忽略。如果大于`diskCacheHighWatermark`，清理时会使用`diskCacheHighWatermark`代替
+ * 默认为0.5，与之前的行为一致(删除至`maxDiskSize`的一半)
+ */
+@property (assign, nonatomic) double diskCacheLowWatermark;
+
+/**
+ * The maximum file count to delete in one slice of disk cache eviction. When this or `diskCacheEvictionSliceDuration` is not 0, `deleteOldFilesWithCompletionBlock:` trims in small slices and each slice is re-enqueued into the IO queue, so the disk queries are interleaved with the eviction instead of waiting behind one monolithic sweep.
+ * @note This only works when the disk cache implements `removeExpiredDataWithCountLimit:timeLimit:`.
+ * Defaults to 0. Which means no slicing.
+ * 一次硬盘缓存清理切片中最多删除的文件数。当此值或`diskCacheEvictionSliceDuration`不为0时，`deleteOldFilesWithCompletionBlock:`以小切片清理，每个切片重新加入IO队列，因此硬盘查询与清理交替执行，而不是等待一次完整的清理
+ * @note 仅当硬盘缓存实现了`removeExpiredDataWithCountLimit:timeLimit:`时生效
+ * 默认为0，表示不切片
+ */
+@property (assign, nonatomic) NSUInteger diskCacheEvictionSliceCount;
+
+/**
+ * The maximum duration of one slice of disk cache eviction, in seconds. See `diskCacheEvictionSliceCount`.
+ * Defaults to 0. Which means no slicing.
+ * 一次硬盘缓存清理切片的最大时长，以秒为单位。参见`diskCacheEvictionSliceCount`
+ * 默认为0，表示不切片
+ */
+@property (assign, nonatomic) NSTimeInterval diskCacheEvictionSliceDuration;
+
+/**
+ * The byte budget of the decoded disk cache tier. When this is not 0, `SDImageCache` persists the already-decoded pixel buffer of frequently decoded images into a sibling directory (`diskCachePath` + `.decoded`), and on a memory cache miss, maps it back with `mmap` instead of decoding the disk data again.
+ * @note The tier is only used for static images and when the query does not specify custom decoding (such as thumbnail, scale down, custom coder or animated image class).
+ * Defaults to 0. Which means disabled.
+ * 已解码硬盘缓存层的字节预算。当此值不为0时，`SDImageCache`将频繁解码图片的已解码像素缓冲区持久化到兄弟目录(`diskCachePath` + `.decoded`)，在内存缓存未命中时通过`mmap`映射回来，而不再重新解码硬盘数据
+ * @note 仅用于静态图片，并且查询未指定自定义解码(例如缩略图、缩小、自定义解码器或动图类)时
+ * 默认为0，表示禁用
+ */
+@property (assign, nonatomic) NSUInteger decodedDiskCacheLimit;
+
+/**
+ * The decode count of one key from the disk data to populate the decoded disk cache tier. See `decodedDiskCacheLimit`.
+ * Defaults to 2. Which means the image is stored at the second decode.
+ * 将图片写入已解码硬盘缓存层所需的从硬盘数据解码的次数。参见`decodedDiskCacheLimit`
+ * 默认为2，表示第二次解码时存储
+ */
+@property (assign, nonatomic) NSUInteger decodedDiskCachePopulateThreshold;
+
 /**
  * The maximum "total cost" of the in-memory image cache. The cost function is the bytes size held in memory.
  * @note The memory cost is bytes size in memory, but not simple pixels count. For common ARGB8888 image, one pixel is 4 bytes (32 bits).
@@ -145,6 +264,34 @@ typedef NS_ENUM(NSUInteger, SDImageCacheConfigExpireType) {
  */
 @property (assign, nonatomic) NSUInteger maxMemoryCount;
 
+/**
+ * The number of independent shards used by the built-in `SDMemoryCache`. Each shard has its own lock, LRU list and cost accounting, so accesses to keys in different shards do not contend. The value is rounded up to a power of two.
+ * Defaults to 0. Which means automatic, use the active processor count (at most 16).
+ * @note This value does not support dynamic changes. Which means further modification on this value after cache initialized has no effect.
+ * 内置`SDMemoryCache`使用的独立分片数。每个分片拥有自己的锁、LRU链表和开销统计，因此不同分片中key的访问不会相互竞争。该值会向上取整为2的幂
+ * 默认为0，表示自动，使用活跃的处理器数量(最多16)
+ * @note 此值不支持动态更改。这意味着缓存初始化后对这个值的进一步修改没有效果
+ */
+@property (assign, nonatomic) NSUInteger memoryCacheShardCount;
+
+/**
+ * The admission/eviction policy used by the built-in `SDMemoryCache`, it always respect `maxMemoryCost` and `maxMemoryCount`.
+ * Defaults to `SDImageCacheConfigMemoryCachePolicyLRU`.
+ * @note This value does not support dynamic changes. Which means further modification on this value after cache initialized has no effect.
+ * 内置`SDMemoryCache`使用的准入/淘汰策略，总是遵循`maxMemoryCost`和`maxMemoryCount`
+ * 默认为`SDImageCacheConfigMemoryCachePolicyLRU`
+ * @note 此值不支持动态更改。这意味着缓存初始化后对这个值的进一步修改没有效果
+ */
+@property (assign, nonatomic) SDImageCacheConfigMemoryCachePolicy memoryCachePolicy;
+
+/**
+ * The fraction of the memory cache limit to keep when the built-in `SDMemoryCache` receives a memory warning. The first warning trims the cache to `maxMemoryCost * memoryCachePressureTrimRatio` (and the same for count), a repeated warning shortly after trims to the square of the ratio, and the further ones purge all the strong entries. The largest and least recently used entries are evicted first, and the pinned entries are kept.
+ * Defaults to 0, which means purge all the strong entries on the first warning. The value is clamped into [0, 1].
+ * 内置`SDMemoryCache`收到内存警告时保留的内存缓存限制比例。第一次警告将缓存裁剪到`maxMemoryCost * memoryCachePressureTrimRatio`(数量同理)，短时间内重复的警告裁剪到该比例的平方，之后的警告清除所有强引用条目。优先淘汰最大和最久未使用的条目，并保留被固定的条目
+ * 默认为0，表示第一次警告时就清除所有强引用条目。该值会被限制在[0, 1]之间
+ */
+@property (assign, nonatomic) double memoryCachePressureTrimRatio;
+
 /**
  * The attribute which the clear cache will be checked against when clearing the disk cache
  * Default is Modified Date
@@ -153,6 +300,14 @@ typedef NS_ENUM(NSUInteger, SDImageCacheConfigExpireType) {
  */
 @property (assign, nonatomic) SDImageCacheConfigExpireType diskCacheExpireType;
 
+/**
+ * The policy used by the built-in `SDDiskCache` to choose the files to delete in the size-based cleanup, after the expired files are deleted.
+ * Defaults to `SDImageCacheConfigDiskEvictionPolicyDate`.
+ * 内置`SDDiskCache`在删除过期文件之后，基于大小的清理中选择要删除文件所使用的策略
+ * 默认为`SDImageCacheConfigDiskEvictionPolicyDate`
+ */
+@property (assign, nonatomic) SDImageCacheConfigDiskEvictionPolicy diskCacheEvictionPolicy;
+
 /**
  * The custom file manager for disk cache. Pass nil to let disk cache choose the proper file manager.
  * Defaults to nil.
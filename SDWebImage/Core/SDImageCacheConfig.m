@@ -32,9 +32,22 @@ static const NSInteger kDefaultCacheMaxDiskAge = 60 * 60 * 24 * 7; // 1 week
         _shouldRemoveExpiredDataWhenTerminate = YES;
         _diskCacheReadingOptions = 0;
         _diskCacheWritingOptions = NSDataWritingAtomic;
+        _diskCacheMappedReadingThreshold = 0;
+        _maxConcurrentDiskOperationCount = 1;
+        _maxConcurrentDecodeOperationCount = 0;
         _maxDiskAge = kDefaultCacheMaxDiskAge;
         _maxDiskSize = 0;
+        _diskCacheHighWatermark = 1.0;
+        _diskCacheLowWatermark = 0.5;
+        _diskCacheEvictionSliceCount = 0;
+        _diskCacheEvictionSliceDuration = 0;
+        _decodedDiskCacheLimit = 0;
+        _decodedDiskCachePopulateThreshold = 2;
+        _memoryCacheShardCount = 0;
+        _memoryCachePolicy = SDImageCacheConfigMemoryCachePolicyLRU;
+        _memoryCachePressureTrimRatio = 0;
         _diskCacheExpireType = SDImageCacheConfigExpireTypeModificationDate;
+        _diskCacheEvictionPolicy = SDImageCacheConfigDiskEvictionPolicyDate;
         _memoryCacheClass = [SDMemoryCache class];
         _diskCacheClass = [SDDiskCache class];
     }
@@ -50,11 +63,24 @@ static const NSInteger kDefaultCacheMaxDiskAge = 60 * 60 * 24 * 7; // 1 week
     config.shouldRemoveExpiredDataWhenTerminate = self.shouldRemoveExpiredDataWhenTerminate;
     config.diskCacheReadingOptions = self.diskCacheReadingOptions;
     config.diskCacheWritingOptions = self.diskCacheWritingOptions;
+    config.diskCacheMappedReadingThreshold = self.diskCacheMappedReadingThreshold;
+    config.maxConcurrentDiskOperationCount = self.maxConcurrentDiskOperationCount;
+    config.maxConcurrentDecodeOperationCount = self.maxConcurrentDecodeOperationCount;
     config.maxDiskAge = self.maxDiskAge;
     config.maxDiskSize = self.maxDiskSize;
+    config.diskCacheHighWatermark = self.diskCacheHighWatermark;
+    config.diskCacheLowWatermark = self.diskCacheLowWatermark;
+    config.diskCacheEvictionSliceCount = self.diskCacheEvictionSliceCount;
+    config.diskCacheEvictionSliceDuration = self.diskCacheEvictionSliceDuration;
+    config.decodedDiskCacheLimit = self.decodedDiskCacheLimit;
+    config.decodedDiskCachePopulateThreshold = self.decodedDiskCachePopulateThreshold;
     config.maxMemoryCost = self.maxMemoryCost;
     config.maxMemoryCount = self.maxMemoryCount;
+    config.memoryCacheShardCount = self.memoryCacheShardCount;
+    config.memoryCachePolicy = self.memoryCachePolicy;
+    config.memoryCachePressureTrimRatio = self.memoryCachePressureTrimRatio;
     config.diskCacheExpireType = self.diskCacheExpireType;
+    config.diskCacheEvictionPolicy = self.diskCacheEvictionPolicy;
     config.fileManager = self.fileManager; // NSFileManager does not conform to NSCopying, just pass the reference
     config.memoryCacheClass = self.memoryCacheClass;
     config.diskCacheClass = self.diskCacheClass;
@@ -62,4 +88,18 @@ static const NSInteger kDefaultCacheMaxDiskAge = 60 * 60 * 24 * 7; // 1 week
     return config;
 }
 
+- (void)setDiskCacheHighWatermark:(double)diskCacheHighWatermark {
+    if (isnan(diskCacheHighWatermark)) {
+        return;
+    }
+    _diskCacheHighWatermark = MIN(MAX(diskCacheHighWatermark, 0), 1);
+}
+
+- (void)setDiskCacheLowWatermark:(double)diskCacheLowWatermark {
+    if (isnan(diskCacheLowWatermark)) {
+        return;
+    }
+    _diskCacheLowWatermark = MIN(MAX(diskCacheLowWatermark, 0), 1);
+}
+
 @end
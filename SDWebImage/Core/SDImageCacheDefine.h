@@ -55,6 +55,11 @@ typedef NSString * _Nullable (^SDImageCacheAdditionalCachePathBlock)(NSString *
 typedef void(^SDImageCacheQueryCompletionBlock)(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType);
 /// 包含缓存类型
 typedef void(^SDImageCacheContainsCompletionBlock)(SDImageCacheType containsCacheType);
+/// 批量查询中单个key的结果block
+typedef void(^SDImageCacheBatchQueryProgressBlock)(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType, NSString * _Nonnull key);
+/// The batch query completion block, only contains the keys which are found
+/// 批量查询结果block，只包含找到的key
+typedef void(^SDImageCacheBatchQueryCompletionBlock)(NSDictionary<NSString *, UIImage *> * _Nonnull images, NSDictionary<NSString *, NSNumber *> * _Nonnull cacheTypes);
 
 /**
  This is the built-in decoding process for image query from cache. 这是从缓存中查询图像的内置解码过程
@@ -166,4 +171,28 @@ FOUNDATION_EXPORT UIImage * _Nullable SDImageCacheDecodeImageData(NSData * _Nonn
 - (void)clearWithCacheType:(SDImageCacheType)cacheType
                 completion:(nullable SDWebImageNoParamsBlock)completionBlock;
 
+@optional
+/**
+ Query the cached images from image cache for many keys at once. The memory cache is checked for all the keys first, then the disk reads are issued as one batch and decoded in parallel. The operation can be used to cancel the query.
+ If all the images are cached in memory, the blocks are called synchronously, else all the blocks (including the progress of the memory results) are called asynchronously on the main queue.
+ 一次查询多个key的缓存图片。首先检查所有key的内存缓存，然后将硬盘读取作为一批发出并并行解码。operation实例可以用来取消本次查询
+ 如果所有图片都缓存在内存中，同步调用回调，否则所有回调(包括内存结果的进度)都在主队列异步调用
+
+ @param keys The image cache keys
+ @param options A mask to specify options to use for this query
+ @param context A context contains different options to perform specify changes or processes, see `SDWebImageContextOption`. This hold the extra objects which `options` enum can not hold.
+ @param cacheType Specify where to query the cache from. Pass `.none` is invalid and callback with empty result immediately.
+ @param progressBlock The block called for each key once its result is available, including the missing keys (nil image). Pass nil to only receive the coalesced completion
+ 每个key的结果可用时调用的block，包括未找到的key(image为nil)。传nil则只接收合并的结果
+ @param completionBlock The coalesced completion block, called after all the keys are resolved. If the operation is cancelled, it's called with the partial results resolved before cancellation
+ 所有key解析完成后调用的合并结果block。如果操作取消，会使用取消前已解析的部分结果调用
+ @return The operation for this query
+ */
+- (nullable id<SDWebImageOperation>)queryImagesForKeys:(nonnull NSArray<NSString *> *)keys
+                                               options:(SDWebImageOptions)options
+                                               context:(nullable SDWebImageContext *)context
+                                             cacheType:(SDImageCacheType)cacheType
+                                              progress:(nullable SDImageCacheBatchQueryProgressBlock)progressBlock
+                                            completion:(nullable SDImageCacheBatchQueryCompletionBlock)completionBlock;
+
 @end
@@ -0,0 +1,33 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ The operation returned by `SDImageCache` disk query. The query is split into stages: the disk read on the IO scheduler, the decoding on the decode queue, then the memory cache insert and the completion. The cancellation is checked between the stages, and the duration of each stage is recorded here.
+ The operation is not executed by any queue, it only represents the query for cancellation and metrics.
+ `SDImageCache`硬盘查询返回的操作。查询分为几个阶段：在IO调度器上读取硬盘，在解码队列上解码，然后写入内存缓存并回调。在阶段之间检查取消，并在这里记录每个阶段的耗时
+ 该操作不会被任何队列执行，仅代表查询本身，用于取消和统计
+ */
+@interface SDImageCacheQueryOperation : NSOperation
+
+/// The time waiting for the IO scheduler, in seconds
+/// 等待IO调度器的时间，单位秒
+@property (atomic, assign, readonly) NSTimeInterval waitDuration;
+/// The time of the disk read stage, in seconds
+/// 读取硬盘阶段的时间，单位秒
+@property (atomic, assign, readonly) NSTimeInterval ioDuration;
+/// The time of the decoding stage including the waiting for the decode queue, in seconds. 0 when the image is from memory cache or the decoded disk cache
+/// 解码阶段的时间(包括等待解码队列)，单位秒。图片来自内存缓存或已解码硬盘缓存时为0
+@property (atomic, assign, readonly) NSTimeInterval decodeDuration;
+/// The time from the query start to the completion, in seconds
+/// 从查询开始到回调的时间，单位秒
+@property (atomic, assign, readonly) NSTimeInterval totalDuration;
+
+@end
@@ -0,0 +1,34 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDImageCacheQueryOperation.h"
+#import "SDImageCacheQueryOperationInternal.h"
+
+@implementation SDImageCacheQueryOperation
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _startTime = CFAbsoluteTimeGetCurrent();
+    }
+    return self;
+}
+
+- (void)cancel {
+    [super cancel];
+    dispatch_block_t cancellationHandler;
+    @synchronized (self) {
+        cancellationHandler = self.cancellationHandler;
+        self.cancellationHandler = nil;
+    }
+    if (cancellationHandler) {
+        cancellationHandler();
+    }
+}
+
+@end
@@ -307,6 +307,246 @@
     }
 }
 
+/// 批量查找图片
+- (id<SDWebImageOperation>)queryImagesForKeys:(NSArray<NSString *> *)keys options:(SDWebImageOptions)options context:(SDWebImageContext *)context cacheType:(SDImageCacheType)cacheType progress:(SDImageCacheBatchQueryProgressBlock)progressBlock completion:(SDImageCacheBatchQueryCompletionBlock)completionBlock {
+    NSArray<id<SDImageCache>> *caches = self.caches;
+    NSUInteger count = caches.count;
+    if (count == 0 || keys.count == 0) {
+        if (completionBlock) {
+            completionBlock(@{}, @{});
+        }
+        return nil;
+    } else if (count == 1) {
+        return [self batchQueryImagesForKeys:keys options:options context:context cacheType:cacheType progress:progressBlock completion:completionBlock cache:caches.firstObject];
+    }
+    switch (self.queryOperationPolicy) {
+            /// 最高优先级
+        case SDImageCachesManagerOperationPolicyHighestOnly: {
+            id<SDImageCache> cache = caches.lastObject;
+            return [self batchQueryImagesForKeys:keys options:options context:context cacheType:cacheType progress:progressBlock completion:completionBlock cache:cache];
+        }
+            break;
+            /// 最低优先级
+        case SDImageCachesManagerOperationPolicyLowestOnly: {
+            id<SDImageCache> cache = caches.firstObject;
+            return [self batchQueryImagesForKeys:keys options:options context:context cacheType:cacheType progress:progressBlock completion:completionBlock cache:cache];
+        }
+            break;
+            /// 并行处理
+        case SDImageCachesManagerOperationPolicyConcurrent: {
+            SDImageCachesManagerOperation *operation = [SDImageCachesManagerOperation new];
+            [operation beginWithTotalCount:caches.count];
+            [self concurrentQueryImagesForKeys:keys options:options context:context cacheType:cacheType progress:progressBlock completion:completionBlock enumerator:caches.reverseObjectEnumerator operation:operation];
+            return operation;
+        }
+            break;
+            /// 顺序处理
+        case SDImageCachesManagerOperationPolicySerial: {
+            SDImageCachesManagerOperation *operation = [SDImageCachesManagerOperation new];
+            [operation beginWithTotalCount:caches.count];
+            NSMutableDictionary<NSString *, UIImage *> *images = [NSMutableDictionary dictionary];
+            NSMutableDictionary<NSString *, NSNumber *> *cacheTypes = [NSMutableDictionary dictionary];
+            operation.cancelBlock = [self cancelBlockForBatchOperation:operation images:images cacheTypes:cacheTypes completion:completionBlock];
+            [self serialQueryImagesForKeys:[NSOrderedSet orderedSetWithArray:keys].array options:options context:context cacheType:cacheType progress:progressBlock completion:completionBlock images:images cacheTypes:cacheTypes enumerator:caches.reverseObjectEnumerator operation:operation];
+            return operation;
+        }
+            break;
+        default:
+            return nil;
+            break;
+    }
+}
+
+#pragma mark - Batch Operation
+/// Use the batch query of the cache if available, else query each key and coalesce the results
+/// 如果缓存支持则使用其批量查询，否则逐个key查询并合并结果
+- (id<SDWebImageOperation>)batchQueryImagesForKeys:(NSArray<NSString *> *)keys options:(SDWebImageOptions)options context:(SDWebImageContext *)context cacheType:(SDImageCacheType)queryCacheType progress:(SDImageCacheBatchQueryProgressBlock)progressBlock completion:(SDImageCacheBatchQueryCompletionBlock)completionBlock cache:(id<SDImageCache>)cache {
+    if ([cache respondsToSelector:@selector(queryImagesForKeys:options:context:cacheType:progress:completion:)]) {
+        return [cache queryImagesForKeys:keys options:options context:context cacheType:queryCacheType progress:progressBlock completion:completionBlock];
+    }
+    NSOrderedSet<NSString *> *uniqueKeys = [NSOrderedSet orderedSetWithArray:keys];
+    SDImageCachesManagerOperation *operation = [SDImageCachesManagerOperation new];
+    [operation beginWithTotalCount:uniqueKeys.count];
+    NSMutableDictionary<NSString *, UIImage *> *images = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString *, NSNumber *> *cacheTypes = [NSMutableDictionary dictionary];
+    operation.cancelBlock = [self cancelBlockForBatchOperation:operation images:images cacheTypes:cacheTypes completion:completionBlock];
+    for (NSString *key in uniqueKeys) {
+        id<SDWebImageOperation> keyOperation = [cache queryImageForKey:key options:options context:context cacheType:queryCacheType completion:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {
+            if (operation.isCancelled) {
+                // Cancelled
+                return;
+            }
+            // The custom cache may call back on any queue, the batch callbacks are always on the main queue
+            /// 自定义缓存可能在任意队列回调，批量回调总是在主队列
+            if (progressBlock) {
+                dispatch_main_async_safe(^{
+                    progressBlock(image, data, image ? cacheType : SDImageCacheTypeNone, key);
+                });
+            }
+            BOOL finished;
+            NSDictionary<NSString *, UIImage *> *resultImages;
+            NSDictionary<NSString *, NSNumber *> *resultCacheTypes;
+            @synchronized (operation) {
+                if (image) {
+                    images[key] = image;
+                    cacheTypes[key] = @(cacheType);
+                }
+                [operation completeOne];
+                finished = operation.pendingCount == 0 && !operation.isFinished;
+                if (finished) {
+                    [operation done];
+                    resultImages = [images copy];
+                    resultCacheTypes = [cacheTypes copy];
+                }
+            }
+            if (finished && completionBlock) {
+                dispatch_main_async_safe(^{
+                    completionBlock(resultImages, resultCacheTypes);
+                });
+            }
+        }];
+        // Cancel the inner query of each key together
+        /// 一起取消每个key的内部查询
+        [operation addChildOperation:keyOperation];
+    }
+    return operation;
+}
+
+/// The cancel block to call the completion once with the partial results on the main queue, if the batch operation is cancelled before it's done
+/// 如果批量操作在完成前被取消，在主队列使用部分结果调用一次完成回调的block
+- (dispatch_block_t)cancelBlockForBatchOperation:(SDImageCachesManagerOperation *)operation images:(NSMutableDictionary<NSString *, UIImage *> *)images cacheTypes:(NSMutableDictionary<NSString *, NSNumber *> *)cacheTypes completion:(SDImageCacheBatchQueryCompletionBlock)completionBlock {
+    return ^{
+        dispatch_async(dispatch_get_main_queue(), ^{
+            NSDictionary<NSString *, UIImage *> *resultImages;
+            NSDictionary<NSString *, NSNumber *> *resultCacheTypes;
+            @synchronized (operation) {
+                if (operation.isFinished) {
+                    return;
+                }
+                [operation done];
+                resultImages = [images copy];
+                resultCacheTypes = [cacheTypes copy];
+            }
+            if (completionBlock) {
+                completionBlock(resultImages, resultCacheTypes);
+            }
+        });
+    };
+}
+
+/// 并行批量查找图片
+- (void)concurrentQueryImagesForKeys:(NSArray<NSString *> *)keys options:(SDWebImageOptions)options context:(SDWebImageContext *)context cacheType:(SDImageCacheType)queryCacheType progress:(SDImageCacheBatchQueryProgressBlock)progressBlock completion:(SDImageCacheBatchQueryCompletionBlock)completionBlock enumerator:(NSEnumerator<id<SDImageCache>> *)enumerator operation:(SDImageCachesManagerOperation *)operation {
+    NSParameterAssert(enumerator);
+    NSParameterAssert(operation);
+    NSMutableDictionary<NSString *, UIImage *> *images = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString *, NSNumber *> *cacheTypes = [NSMutableDictionary dictionary];
+    operation.cancelBlock = [self cancelBlockForBatchOperation:operation images:images cacheTypes:cacheTypes completion:completionBlock];
+    for (id<SDImageCache> cache in enumerator) {
+        // The first found image of each key wins
+        /// 每个key第一个找到的图片生效
+        SDImageCacheBatchQueryProgressBlock cacheProgressBlock = ^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType, NSString * _Nonnull key) {
+            if (!image || operation.isCancelled) {
+                return;
+            }
+            BOOL isFirst = NO;
+            @synchronized (operation) {
+                if (!images[key]) {
+                    images[key] = image;
+                    cacheTypes[key] = @(cacheType);
+                    isFirst = YES;
+                }
+            }
+            if (isFirst && progressBlock) {
+                progressBlock(image, data, cacheType, key);
+            }
+        };
+        id<SDWebImageOperation> cacheOperation = [self batchQueryImagesForKeys:keys options:options context:context cacheType:queryCacheType progress:cacheProgressBlock completion:^(NSDictionary<NSString *,UIImage *> * _Nonnull cacheImages, NSDictionary<NSString *,NSNumber *> * _Nonnull cacheCacheTypes) {
+            if (operation.isCancelled) {
+                // Cancelled
+                return;
+            }
+            BOOL finished;
+            @synchronized (operation) {
+                [operation completeOne];
+                finished = operation.pendingCount == 0 && !operation.isFinished;
+                if (finished) {
+                    [operation done];
+                }
+            }
+            if (!finished) {
+                return;
+            }
+            // Complete
+            if (progressBlock) {
+                for (NSString *key in [NSOrderedSet orderedSetWithArray:keys]) {
+                    if (!images[key]) {
+                        progressBlock(nil, nil, SDImageCacheTypeNone, key);
+                    }
+                }
+            }
+            if (completionBlock) {
+                completionBlock([images copy], [cacheTypes copy]);
+            }
+        } cache:cache];
+        [operation addChildOperation:cacheOperation];
+    }
+}
+
+/// 顺序批量查找图片，只在下一个缓存中查找未找到的key
+- (void)serialQueryImagesForKeys:(NSArray<NSString *> *)keys options:(SDWebImageOptions)options context:(SDWebImageContext *)context cacheType:(SDImageCacheType)queryCacheType progress:(SDImageCacheBatchQueryProgressBlock)progressBlock completion:(SDImageCacheBatchQueryCompletionBlock)completionBlock images:(NSMutableDictionary<NSString *, UIImage *> *)images cacheTypes:(NSMutableDictionary<NSString *, NSNumber *> *)cacheTypes enumerator:(NSEnumerator<id<SDImageCache>> *)enumerator operation:(SDImageCachesManagerOperation *)operation {
+    NSParameterAssert(enumerator);
+    NSParameterAssert(operation);
+    id<SDImageCache> cache = enumerator.nextObject;
+    if (!cache || keys.count == 0) {
+        // Complete
+        @synchronized (operation) {
+            if (operation.isFinished) {
+                return;
+            }
+            [operation done];
+        }
+        if (progressBlock) {
+            for (NSString *key in keys) {
+                progressBlock(nil, nil, SDImageCacheTypeNone, key);
+            }
+        }
+        if (completionBlock) {
+            completionBlock([images copy], [cacheTypes copy]);
+        }
+        return;
+    }
+    SDImageCacheBatchQueryProgressBlock cacheProgressBlock;
+    if (progressBlock) {
+        cacheProgressBlock = ^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType, NSString * _Nonnull key) {
+            if (image && !operation.isCancelled) {
+                progressBlock(image, data, cacheType, key);
+            }
+        };
+    }
+    @weakify(self);
+    id<SDWebImageOperation> cacheOperation = [self batchQueryImagesForKeys:keys options:options context:context cacheType:queryCacheType progress:cacheProgressBlock completion:^(NSDictionary<NSString *,UIImage *> * _Nonnull cacheImages, NSDictionary<NSString *,NSNumber *> * _Nonnull cacheCacheTypes) {
+        @strongify(self);
+        if (operation.isCancelled) {
+            // Cancelled
+            return;
+        }
+        [operation completeOne];
+        @synchronized (operation) {
+            [images addEntriesFromDictionary:cacheImages];
+            [cacheTypes addEntriesFromDictionary:cacheCacheTypes];
+        }
+        NSMutableArray<NSString *> *missingKeys = [NSMutableArray array];
+        for (NSString *key in keys) {
+            if (!cacheImages[key]) {
+                [missingKeys addObject:key];
+            }
+        }
+        // Next
+        [self serialQueryImagesForKeys:missingKeys options:options context:context cacheType:queryCacheType progress:progressBlock completion:completionBlock images:images cacheTypes:cacheTypes enumerator:enumerator operation:operation];
+    } cache:cache];
+    [operation addChildOperation:cacheOperation];
+}
+
 #pragma mark - Concurrent Operation
 /// 并行查找图片
 - (void)concurrentQueryImageForKey:(NSString *)key options:(SDWebImageOptions)options context:(SDWebImageContext *)context cacheType:(SDImageCacheType)queryCacheType completion:(SDImageCacheQueryCompletionBlock)completionBlock enumerator:(NSEnumerator<id<SDImageCache>> *)enumerator operation:(SDImageCachesManagerOperation *)operation {
@@ -187,6 +187,18 @@ FOUNDATION_EXPORT SDImageCoderOption _Nonnull const SDImageCoderWebImageContext
  */
 - (void)updateIncrementalData:(nullable NSData *)data finished:(BOOL)finished;
 
+@optional
+/**
+ Append the new image data since the last call, instead of passing all the data downloaded so far. The coder keeps the accumulated data and the parser state by itself, so the cost of each call scales with the new bytes. If implemented, the progressive loading use this method instead of `updateIncrementalData:finished:`.
+ 追加自上次调用以来的新图像数据，而不是传递目前为止下载的全部数据。解码器自己保存累积的数据和解析状态，因此每次调用的开销与新字节数成正比。如果实现了该方法，渐进式加载会使用它代替`updateIncrementalData:finished:`
+
+ @param data The new image data since the last call 自上次调用以来的新图像数据
+ @param finished Whether the download has finished 下载是否已完成
+ */
+- (void)appendIncrementalData:(nullable NSData *)data finished:(BOOL)finished;
+
+@required
+
 /**
  Incremental decode the current image data to image.
  @note Due to the performance issue for progressive decoding and the integration for image view. This method may only return the first frame image even if the image data is animated image. If you want progressive animated image decoding, conform to `SDAnimatedImageCoder` protocol as well and use `animatedImageFrameAtIndex:` instead.
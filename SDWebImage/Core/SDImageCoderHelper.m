@@ -15,6 +15,7 @@
 #import "SDAssociatedObject.h"
 #import "UIImage+Metadata.h"
 #import "SDInternalMacros.h"
+#import "SDImageBufferPool.h"
 #import <Accelerate/Accelerate.h>
 
 static inline size_t SDByteAlign(size_t size, size_t alignment) {
@@ -282,17 +283,50 @@ static const CGFloat kDestSeemOverlap = 2.0f;   // the numbers of pixels to over
     // But since our build-in coders use this bitmapInfo, this can have a little performance benefit
     CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host;
     bitmapInfo |= hasAlpha ? kCGImageAlphaPremultipliedFirst : kCGImageAlphaNoneSkipFirst;
-    CGContextRef context = CGBitmapContextCreate(NULL, newWidth, newHeight, 8, 0, [self colorSpaceGetDeviceRGB], bitmapInfo);
+    // Draw into a pooled buffer, which goes back to the pool when the decoded image is released
+    SDImageBufferPool *bufferPool = SDImageBufferPool.sharedPool;
+    BOOL shouldUseBufferPool = bufferPool.maxPooledBytes > 0;
+    size_t bytesPerRow = 0;
+    if (shouldUseBufferPool) {
+        bytesPerRow = [SDImageBufferPool bytesPerRowForWidth:newWidth bytesPerPixel:4];
+        size_t length;
+        if (bytesPerRow == 0 || __builtin_mul_overflow(bytesPerRow, newHeight, &length)) {
+            // The buffer size overflows, fall back to the plain bitmap context
+            shouldUseBufferPool = NO;
+            bytesPerRow = 0;
+        }
+    }
+    void *buffer = NULL;
+    if (shouldUseBufferPool) {
+        buffer = [bufferPool acquireBufferWithWidth:newWidth height:newHeight bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+        if (!buffer) {
+            return NULL;
+        }
+    }
+    CGContextRef context = CGBitmapContextCreate(buffer, newWidth, newHeight, 8, bytesPerRow, [self colorSpaceGetDeviceRGB], bitmapInfo);
     if (!context) {
+        if (buffer) {
+            [bufferPool recycleBuffer:buffer width:newWidth height:newHeight bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+        }
         return NULL;
     }
+    if (buffer && hasAlpha) {
+        // The reused buffer contains the old pixels
+        CGContextClearRect(context, CGRectMake(0, 0, newWidth, newHeight));
+    }
     
     // Apply transform
     CGAffineTransform transform = SDCGContextTransformFromOrientation(orientation, CGSizeMake(newWidth, newHeight));
     CGContextConcatCTM(context, transform);
     CGContextDrawImage(context, CGRectMake(0, 0, width, height), cgImage); // The rect is bounding box of CGImage, don't swap width & height
-    CGImageRef newImageRef = CGBitmapContextCreateImage(context);
-    CGContextRelease(context);
+    CGImageRef newImageRef;
+    if (buffer) {
+        CGContextRelease(context);
+        newImageRef = [bufferPool CGImageCreateWithBuffer:buffer width:newWidth height:newHeight bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo colorSpace:[self colorSpaceGetDeviceRGB]];
+    } else {
+        newImageRef = CGBitmapContextCreateImage(context);
+        CGContextRelease(context);
+    }
     
     return newImageRef;
 }
@@ -0,0 +1,93 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <CoreGraphics/CoreGraphics.h>
+#import "SDWebImageCompat.h"
+#import "NSData+ImageContentType.h"
+
+/// The probe status
+/// 探测状态
+typedef NS_ENUM(NSInteger, SDImageHeaderProbeStatus) {
+    /// The header is not complete yet, append more data
+    /// 头部尚不完整，需要追加更多数据
+    SDImageHeaderProbeStatusNeedMoreData = 0,
+    /// The header is parsed, see `headerInfo`
+    /// 头部已解析，见`headerInfo`
+    SDImageHeaderProbeStatusSucceeded,
+    /// The data is not supported or malformed, or the header is not found within `maxProbeLength`
+    /// 数据不受支持或格式错误，或在`maxProbeLength`内未找到头部
+    SDImageHeaderProbeStatusFailed
+};
+
+/**
+ The image information parsed from the header, before the image is downloaded or decoded.
+ 在图像下载或解码之前，从头部解析出的图像信息
+ */
+@interface SDImageHeaderInfo : NSObject
+
+/// The image format. The AVIF image use the value of `SDImageFormatAVIF` (15) provided by the coder plugin, check `brand` for the exact ISOBMFF brand
+/// 图像格式。AVIF图像使用编码器插件提供的`SDImageFormatAVIF`(15)的值，请检查`brand`获取具体的ISOBMFF品牌
+@property (nonatomic, assign, readonly) SDImageFormat format;
+
+/// The pixel size stored in the header, without applying the EXIF orientation
+/// 头部中存储的像素尺寸，未应用EXIF方向
+@property (nonatomic, assign, readonly) CGSize pixelSize;
+
+/// The frame count when the header tells it (APNG `acTL`, or a still image), 0 means unknown, such as GIF and animated WebP, whose frames are not counted until the whole data is received
+/// 头部给出的帧数(APNG的`acTL`，或静态图像)，0表示未知，例如GIF和动图WebP，它们的帧数在收到全部数据前无法统计
+@property (nonatomic, assign, readonly) NSUInteger frameCount;
+
+/// The major brand of the ISOBMFF container (such as `heic`, `avif`), nil for other formats
+/// ISOBMFF容器的主品牌(例如`heic`、`avif`)，其他格式为nil
+@property (nonatomic, copy, readonly, nullable) NSString *brand;
+
+@end
+
+/**
+ A streaming image header prober, which extend `+[NSData sd_imageFormatForImageData:]` to parse the pixel size and frame count from the first few KB of the data: JPEG SOF, PNG IHDR (and APNG acTL), GIF logical screen descriptor, WebP VP8/VP8L/VP8X, HEIF and AVIF `ispe`.
+ The parser is plain C on the byte buffer and does not call ImageIO, so it's cheap to run on each received chunk. Not thread-safe.
+ 流式图像头部探测器，扩展了`+[NSData sd_imageFormatForImageData:]`，从数据的前几KB中解析像素尺寸和帧数：JPEG SOF、PNG IHDR(和APNG acTL)、GIF逻辑屏幕描述符、WebP VP8/VP8L/VP8X、HEIF和AVIF的`ispe`
+ 解析器是基于字节缓冲区的纯C实现，不调用ImageIO，因此可以低开销地在每次收到数据块时运行。非线程安全
+ */
+@interface SDImageHeaderProber : NSObject
+
+/**
+ Parse the header from the complete or partial data at once.
+ 一次性从完整或部分数据中解析头部
+
+ @param data The image data 图像数据
+ @return The header info, nil if the data is not enough or not supported 头部信息，数据不足或不受支持时为nil
+ */
++ (nullable SDImageHeaderInfo *)headerInfoWithData:(nullable NSData *)data;
+
+/**
+ The maximum bytes kept for probing, the probe fails if the header is not found within it. For example, a large EXIF or ICC profile can push the JPEG SOF away.
+ Defaults to 128KB.
+ 为探测保留的最大字节数，如果在该范围内未找到头部则探测失败。例如，较大的EXIF或ICC配置文件会把JPEG SOF推后
+ 默认为128KB
+ */
+@property (nonatomic, assign) NSUInteger maxProbeLength;
+
+/// The current status
+/// 当前状态
+@property (nonatomic, assign, readonly) SDImageHeaderProbeStatus status;
+
+/// The header info, available when the status is `SDImageHeaderProbeStatusSucceeded`
+/// 头部信息，在状态为`SDImageHeaderProbeStatusSucceeded`时可用
+@property (nonatomic, strong, readonly, nullable) SDImageHeaderInfo *headerInfo;
+
+/**
+ Append the received data and try to parse the header. Once the status is not `SDImageHeaderProbeStatusNeedMoreData`, the data is ignored.
+ 追加接收到的数据并尝试解析头部。一旦状态不是`SDImageHeaderProbeStatusNeedMoreData`，数据将被忽略
+
+ @param data The new data since the last call 自上次调用以来的新数据
+ @return The status after appending 追加后的状态
+ */
+- (SDImageHeaderProbeStatus)appendData:(nullable NSData *)data;
+
+@end
@@ -0,0 +1,501 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDImageHeaderProber.h"
+#import "SDImageIOAnimatedCoderInternal.h"
+
+/// The default bytes kept for probing
+/// 默认为探测保留的字节数
+static const NSUInteger kSDImageHeaderDefaultMaxProbeLength = 128 * 1024;
+
+#define SD_FOURCC(a, b, c, d) (((uint32_t)(a) << 24) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 8) | (uint32_t)(d))
+
+/// The header parsed by the C parser
+/// C解析器解析出的头部
+typedef struct SDImageHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t frameCount; // 0 means unknown
+    uint32_t brand; // ISOBMFF major brand
+} SDImageHeader;
+
+static inline uint16_t SDReadUInt16BE(const uint8_t *bytes) {
+    return (uint16_t)bytes[0] << 8 | bytes[1];
+}
+
+static inline uint16_t SDReadUInt16LE(const uint8_t *bytes) {
+    return (uint16_t)bytes[1] << 8 | bytes[0];
+}
+
+static inline uint32_t SDReadUInt24LE(const uint8_t *bytes) {
+    return (uint32_t)bytes[2] << 16 | (uint32_t)bytes[1] << 8 | bytes[0];
+}
+
+static inline uint32_t SDReadUInt32BE(const uint8_t *bytes) {
+    return (uint32_t)bytes[0] << 24 | (uint32_t)bytes[1] << 16 | (uint32_t)bytes[2] << 8 | bytes[3];
+}
+
+static inline uint32_t SDReadUInt32LE(const uint8_t *bytes) {
+    return (uint32_t)bytes[3] << 24 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[1] << 8 | bytes[0];
+}
+
+static inline uint64_t SDReadUInt64BE(const uint8_t *bytes) {
+    return (uint64_t)SDReadUInt32BE(bytes) << 32 | SDReadUInt32BE(bytes + 4);
+}
+
+// Whether `count` bytes are available at `offset`, written in the form which does not overflow
+static inline BOOL SDImageHeaderHasBytes(size_t length, size_t offset, size_t count) {
+    return offset <= length && length - offset >= count;
+}
+
+#pragma mark - JPEG
+
+// SOF0-SOF15, except DHT(C4), JPG(C8) and DAC(CC)
+static inline BOOL SDJPEGMarkerIsSOF(uint8_t marker) {
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+static SDImageHeaderProbeStatus SDImageHeaderParseJPEG(const uint8_t *bytes, size_t length, size_t *resumeOffset, SDImageHeader *header) {
+    size_t offset = *resumeOffset;
+    if (offset == 0) {
+        if (length < 2) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        if (bytes[0] != 0xFF || bytes[1] != 0xD8) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        offset = 2; // SOI
+    }
+    while (YES) {
+        // Resume from the segment boundary on the next call
+        *resumeOffset = offset;
+        if (!SDImageHeaderHasBytes(length, offset, 1)) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        if (bytes[offset] != 0xFF) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        // Skip the fill bytes
+        while (offset < length && bytes[offset] == 0xFF) {
+            offset++;
+        }
+        if (offset >= length) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        uint8_t marker = bytes[offset++];
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8)) {
+            // Standalone marker
+            continue;
+        }
+        if (marker == 0xD9 || marker == 0xDA) {
+            // No frame header before the scan
+            return SDImageHeaderProbeStatusFailed;
+        }
+        if (!SDImageHeaderHasBytes(length, offset, 2)) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        uint16_t segmentLength = SDReadUInt16BE(bytes + offset);
+        if (segmentLength < 2) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        if (SDJPEGMarkerIsSOF(marker)) {
+            // Length(2), precision(1), height(2), width(2)
+            if (!SDImageHeaderHasBytes(length, offset, 7)) {
+                return SDImageHeaderProbeStatusNeedMoreData;
+            }
+            header->height = SDReadUInt16BE(bytes + offset + 3);
+            header->width = SDReadUInt16BE(bytes + offset + 5);
+            header->frameCount = 1;
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        offset += segmentLength;
+    }
+}
+
+#pragma mark - PNG
+
+static SDImageHeaderProbeStatus SDImageHeaderParsePNG(const uint8_t *bytes, size_t length, size_t *resumeOffset, SDImageHeader *header) {
+    static const uint8_t kPNGSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    size_t offset = *resumeOffset;
+    if (offset == 0) {
+        // Signature(8), IHDR length(4), type(4), width(4), height(4)
+        if (length < 24) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        if (memcmp(bytes, kPNGSignature, sizeof(kPNGSignature)) != 0 || SDReadUInt32BE(bytes + 12) != SD_FOURCC('I', 'H', 'D', 'R')) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        header->width = SDReadUInt32BE(bytes + 16);
+        header->height = SDReadUInt32BE(bytes + 20);
+        uint32_t headerLength = SDReadUInt32BE(bytes + 8);
+        if (headerLength > SIZE_MAX - 20) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        offset = 8 + 12 + (size_t)headerLength;
+    }
+    // The APNG `acTL` must appear before the first `IDAT`
+    while (YES) {
+        // Resume from the chunk boundary on the next call
+        *resumeOffset = offset;
+        if (!SDImageHeaderHasBytes(length, offset, 8)) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        uint32_t chunkLength = SDReadUInt32BE(bytes + offset);
+        uint32_t chunkType = SDReadUInt32BE(bytes + offset + 4);
+        if (chunkType == SD_FOURCC('a', 'c', 'T', 'L')) {
+            if (!SDImageHeaderHasBytes(length, offset, 12)) {
+                return SDImageHeaderProbeStatusNeedMoreData;
+            }
+            header->frameCount = SDReadUInt32BE(bytes + offset + 8);
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        if (chunkType == SD_FOURCC('I', 'D', 'A', 'T')) {
+            header->frameCount = 1;
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        if (chunkLength > SIZE_MAX - 12 - offset) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        offset += 12 + (size_t)chunkLength;
+    }
+}
+
+#pragma mark - GIF
+
+static SDImageHeaderProbeStatus SDImageHeaderParseGIF(const uint8_t *bytes, size_t length, size_t *resumeOffset, SDImageHeader *header) {
+    // Signature(6), logical screen width(2), height(2)
+    if (length < 10) {
+        return SDImageHeaderProbeStatusNeedMoreData;
+    }
+    if (memcmp(bytes, "GIF87a", 6) != 0 && memcmp(bytes, "GIF89a", 6) != 0) {
+        return SDImageHeaderProbeStatusFailed;
+    }
+    header->width = SDReadUInt16LE(bytes + 6);
+    header->height = SDReadUInt16LE(bytes + 8);
+    // The frames are not counted until the whole data is received
+    header->frameCount = 0;
+    return SDImageHeaderProbeStatusSucceeded;
+}
+
+#pragma mark - WebP
+
+static SDImageHeaderProbeStatus SDImageHeaderParseWebP(const uint8_t *bytes, size_t length, size_t *resumeOffset, SDImageHeader *header) {
+    // RIFF(4), file size(4), WEBP(4), chunk type(4), chunk size(4)
+    if (length < 20) {
+        return SDImageHeaderProbeStatusNeedMoreData;
+    }
+    const uint8_t *chunk = bytes + 20;
+    switch (SDReadUInt32BE(bytes + 12)) {
+        case SD_FOURCC('V', 'P', '8', ' '): {
+            // Frame tag(3), start code(3), width(2), height(2), the upper 2 bits are scale
+            if (length < 30) {
+                return SDImageHeaderProbeStatusNeedMoreData;
+            }
+            if (chunk[3] != 0x9D || chunk[4] != 0x01 || chunk[5] != 0x2A) {
+                return SDImageHeaderProbeStatusFailed;
+            }
+            header->width = SDReadUInt16LE(chunk + 6) & 0x3FFF;
+            header->height = SDReadUInt16LE(chunk + 8) & 0x3FFF;
+            header->frameCount = 1;
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        case SD_FOURCC('V', 'P', '8', 'L'): {
+            // Signature(1), then 14 bits width - 1 and 14 bits height - 1
+            if (length < 25) {
+                return SDImageHeaderProbeStatusNeedMoreData;
+            }
+            if (chunk[0] != 0x2F) {
+                return SDImageHeaderProbeStatusFailed;
+            }
+            uint32_t bits = SDReadUInt32LE(chunk + 1);
+            header->width = (bits & 0x3FFF) + 1;
+            header->height = ((bits >> 14) & 0x3FFF) + 1;
+            header->frameCount = 1;
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        case SD_FOURCC('V', 'P', '8', 'X'): {
+            // Flags(1), reserved(3), canvas width - 1(3), canvas height - 1(3)
+            if (length < 30) {
+                return SDImageHeaderProbeStatusNeedMoreData;
+            }
+            BOOL animated = (chunk[0] & 0x02) != 0;
+            header->width = SDReadUInt24LE(chunk + 4) + 1;
+            header->height = SDReadUInt24LE(chunk + 7) + 1;
+            header->frameCount = animated ? 0 : 1;
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        default:
+            return SDImageHeaderProbeStatusFailed;
+    }
+}
+
+#pragma mark - HEIF/AVIF
+
+// Read the box header at offset, the box must end before the parent end. A size of 0 means the box extends to the parent end
+static SDImageHeaderProbeStatus SDImageHeaderReadBox(const uint8_t *bytes, size_t length, size_t offset, size_t parentEnd, uint32_t *type, size_t *payloadOffset, size_t *boxEnd) {
+    if (offset >= parentEnd) {
+        return SDImageHeaderProbeStatusFailed;
+    }
+    if (!SDImageHeaderHasBytes(length, offset, 8)) {
+        return SDImageHeaderProbeStatusNeedMoreData;
+    }
+    uint64_t size = SDReadUInt32BE(bytes + offset);
+    size_t headerSize = 8;
+    *type = SDReadUInt32BE(bytes + offset + 4);
+    if (size == 1) {
+        if (!SDImageHeaderHasBytes(length, offset, 16)) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        size = SDReadUInt64BE(bytes + offset + 8);
+        headerSize = 16;
+    } else if (size == 0) {
+        size = parentEnd - offset;
+    }
+    if (size < headerSize || size > (uint64_t)(parentEnd - offset)) {
+        return SDImageHeaderProbeStatusFailed;
+    }
+    *payloadOffset = offset + headerSize;
+    *boxEnd = offset + (size_t)size;
+    return SDImageHeaderProbeStatusSucceeded;
+}
+
+// Find the first child box with type in [offset, end)
+static SDImageHeaderProbeStatus SDImageHeaderFindBox(const uint8_t *bytes, size_t length, size_t offset, size_t end, uint32_t type, size_t *payloadOffset, size_t *boxEnd) {
+    while (offset < end) {
+        uint32_t boxType;
+        SDImageHeaderProbeStatus status = SDImageHeaderReadBox(bytes, length, offset, end, &boxType, payloadOffset, boxEnd);
+        if (status != SDImageHeaderProbeStatusSucceeded) {
+            return status;
+        }
+        if (boxType == type) {
+            return SDImageHeaderProbeStatusSucceeded;
+        }
+        offset = *boxEnd;
+    }
+    return SDImageHeaderProbeStatusFailed;
+}
+
+// The top level boxes are bounded by `limit`, the bytes which can be probed at most. A box of size 0 extends to the limit, nothing can follow it
+static SDImageHeaderProbeStatus SDImageHeaderParseISOBMFF(const uint8_t *bytes, size_t length, size_t limit, size_t *resumeOffset, SDImageHeader *header) {
+    size_t payloadOffset, boxEnd;
+    uint32_t type;
+    SDImageHeaderProbeStatus status;
+    if (*resumeOffset == 0) {
+        status = SDImageHeaderReadBox(bytes, length, 0, limit, &type, &payloadOffset, &boxEnd);
+        if (status != SDImageHeaderProbeStatusSucceeded) {
+            return status;
+        }
+        if (type != SD_FOURCC('f', 't', 'y', 'p') || boxEnd >= limit || boxEnd - payloadOffset < 4) {
+            return SDImageHeaderProbeStatusFailed;
+        }
+        if (!SDImageHeaderHasBytes(length, payloadOffset, 4)) {
+            return SDImageHeaderProbeStatusNeedMoreData;
+        }
+        header->brand = SDReadUInt32BE(bytes + payloadOffset);
+        *resumeOffset = boxEnd;
+    }
+    // meta -> iprp -> ipco -> ispe, resume from the top level box boundary on the next call
+    while (YES) {
+        status = SDImageHeaderReadBox(bytes, length, *resumeOffset, limit, &type, &payloadOffset, &boxEnd);
+        if (status != SDImageHeaderProbeStatusSucceeded) {
+            return status;
+        }
+        if (type == SD_FOURCC('m', 'e', 't', 'a')) {
+            break;
+        }
+        if (boxEnd >= limit) {
+            // The `meta` can not follow within the limit, stop instead of resuming
+            return SDImageHeaderProbeStatusFailed;
+        }
+        *resumeOffset = boxEnd;
+    }
+    // The `meta` is a full box, skip the version and flags
+    if (boxEnd - payloadOffset < 4) {
+        return SDImageHeaderProbeStatusFailed;
+    }
+    status = SDImageHeaderFindBox(bytes, length, payloadOffset + 4, boxEnd, SD_FOURCC('i', 'p', 'r', 'p'), &payloadOffset, &boxEnd);
+    if (status != SDImageHeaderProbeStatusSucceeded) {
+        return status;
+    }
+    status = SDImageHeaderFindBox(bytes, length, payloadOffset, boxEnd, SD_FOURCC('i', 'p', 'c', 'o'), &payloadOffset, &boxEnd);
+    if (status != SDImageHeaderProbeStatusSucceeded) {
+        return status;
+    }
+    // The grid image and the thumbnails have their own `ispe`, the largest one is the full image
+    if (boxEnd > length) {
+        return SDImageHeaderProbeStatusNeedMoreData;
+    }
+    size_t offset = payloadOffset, end = boxEnd;
+    uint64_t maxArea = 0;
+    while (offset < end) {
+        status = SDImageHeaderReadBox(bytes, length, offset, end, &type, &payloadOffset, &boxEnd);
+        if (status != SDImageHeaderProbeStatusSucceeded) {
+            return status;
+        }
+        // Version and flags(4), width(4), height(4)
+        if (type == SD_FOURCC('i', 's', 'p', 'e') && boxEnd - payloadOffset >= 12) {
+            uint32_t width = SDReadUInt32BE(bytes + payloadOffset + 4);
+            uint32_t height = SDReadUInt32BE(bytes + payloadOffset + 8);
+            if ((uint64_t)width * height > maxArea) {
+                maxArea = (uint64_t)width * height;
+                header->width = width;
+                header->height = height;
+            }
+        }
+        offset = boxEnd;
+    }
+    if (maxArea == 0) {
+        return SDImageHeaderProbeStatusFailed;
+    }
+    uint32_t brand = header->brand;
+    // The image sequence frames are not counted
+    BOOL sequence = brand == SD_FOURCC('m', 's', 'f', '1') || brand == SD_FOURCC('h', 'e', 'v', 'c') || brand == SD_FOURCC('h', 'e', 'v', 's') || brand == SD_FOURCC('a', 'v', 'i', 's');
+    header->frameCount = sequence ? 0 : 1;
+    return SDImageHeaderProbeStatusSucceeded;
+}
+
+#pragma mark - Parse
+
+// The sniffed format of an ISOBMFF file may change with the compatible brands, until the whole `ftyp` box (at most the sniffed prefix) is received
+static inline BOOL SDImageHeaderFileTypeBoxReceived(SDImageFormat format, const uint8_t *bytes, size_t length) {
+    static const size_t kSniffLength = 128;
+    if (format != SDImageFormatHEIC && format != SDImageFormatHEIF && format != kSDImageFormatAVIF) {
+        return YES;
+    }
+    size_t size = length >= 4 ? SDReadUInt32BE(bytes) : 0;
+    if (size < 8) {
+        // Extends to the end, or the 64-bit size
+        size = kSniffLength;
+    }
+    return length >= MIN(size, kSniffLength);
+}
+
+// The parsers keep the progress in `resumeOffset` (0 at the beginning) and `header`, the next call with more bytes continues from there. The header must end within `limit`
+static SDImageHeaderProbeStatus SDImageHeaderParse(SDImageFormat format, const uint8_t *bytes, size_t length, size_t limit, size_t *resumeOffset, SDImageHeader *header) {
+    if (format == SDImageFormatJPEG) {
+        return SDImageHeaderParseJPEG(bytes, length, resumeOffset, header);
+    } else if (format == SDImageFormatPNG) {
+        return SDImageHeaderParsePNG(bytes, length, resumeOffset, header);
+    } else if (format == SDImageFormatGIF) {
+        return SDImageHeaderParseGIF(bytes, length, resumeOffset, header);
+    } else if (format == SDImageFormatWebP) {
+        return SDImageHeaderParseWebP(bytes, length, resumeOffset, header);
+    } else if (format == SDImageFormatHEIC || format == SDImageFormatHEIF || format == kSDImageFormatAVIF) {
+        // AVIF is not a built-in format, but it shares the container with HEIF
+        return SDImageHeaderParseISOBMFF(bytes, length, limit, resumeOffset, header);
+    }
+    return SDImageHeaderProbeStatusFailed;
+}
+
+#pragma mark - SDImageHeaderInfo
+
+@interface SDImageHeaderInfo ()
+
+@property (nonatomic, assign, readwrite) SDImageFormat format;
+@property (nonatomic, assign, readwrite) CGSize pixelSize;
+@property (nonatomic, assign, readwrite) NSUInteger frameCount;
+@property (nonatomic, copy, readwrite, nullable) NSString *brand;
+
+@end
+
+@implementation SDImageHeaderInfo
+
+- (NSString *)description {
+    return [NSString stringWithFormat:@"<%@: %p, format: %ld, pixelSize: %@x%@, frameCount: %lu>", NSStringFromClass(self.class), self, (long)self.format, @(self.pixelSize.width), @(self.pixelSize.height), (unsigned long)self.frameCount];
+}
+
+@end
+
+#pragma mark - SDImageHeaderProber
+
+@interface SDImageHeaderProber ()
+
+@property (nonatomic, assign, readwrite) SDImageHeaderProbeStatus status;
+@property (nonatomic, strong, readwrite, nullable) SDImageHeaderInfo *headerInfo;
+@property (nonatomic, strong, nonnull) NSMutableData *buffer;
+
+@end
+
+@implementation SDImageHeaderProber {
+    BOOL _formatSniffed;
+    SDImageFormat _format;
+    size_t _parseOffset; // the parser resumes from here
+    SDImageHeader _header;
+}
+
++ (SDImageHeaderInfo *)headerInfoWithData:(NSData *)data {
+    SDImageHeaderProber *prober = [[SDImageHeaderProber alloc] init];
+    prober.maxProbeLength = data.length;
+    [prober appendData:data];
+    return prober.headerInfo;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _maxProbeLength = kSDImageHeaderDefaultMaxProbeLength;
+        _buffer = [NSMutableData data];
+    }
+    return self;
+}
+
+- (SDImageHeaderProbeStatus)appendData:(NSData *)data {
+    if (self.status != SDImageHeaderProbeStatusNeedMoreData || data.length == 0) {
+        return self.status;
+    }
+    NSUInteger maxProbeLength = self.maxProbeLength;
+    NSUInteger appendLength = MIN(data.length, maxProbeLength > self.buffer.length ? maxProbeLength - self.buffer.length : 0);
+    if (appendLength > 0) {
+        [self.buffer appendBytes:data.bytes length:appendLength];
+    }
+    NSData *buffer = self.buffer;
+    const uint8_t *bytes = buffer.bytes;
+    SDImageHeaderProbeStatus status = SDImageHeaderProbeStatusNeedMoreData;
+    if (!_formatSniffed) {
+        // Sniff once, then only the parser runs on the following chunks
+        SDImageFormatConfidence confidence;
+        SDImageFormat format = [NSData sd_imageFormatForImageData:buffer confidence:&confidence];
+        if (confidence == SDImageFormatConfidenceHigh && (SDImageHeaderFileTypeBoxReceived(format, bytes, buffer.length) || buffer.length >= maxProbeLength)) {
+            _format = format;
+            _formatSniffed = YES;
+        } else if (confidence == SDImageFormatConfidenceNone && buffer.length >= 12) {
+            // The WebP and HEIF magic bytes need 12 bytes
+            status = SDImageHeaderProbeStatusFailed;
+        }
+    }
+    if (_formatSniffed) {
+        status = SDImageHeaderParse(_format, bytes, buffer.length, maxProbeLength, &_parseOffset, &_header);
+    }
+    SDImageHeader header = _header;
+    SDImageFormat format = _format;
+    if (status == SDImageHeaderProbeStatusSucceeded) {
+        if (header.width == 0 || header.height == 0) {
+            status = SDImageHeaderProbeStatusFailed;
+        } else {
+            SDImageHeaderInfo *headerInfo = [[SDImageHeaderInfo alloc] init];
+            headerInfo.format = format;
+            headerInfo.pixelSize = CGSizeMake(header.width, header.height);
+            headerInfo.frameCount = header.frameCount;
+            if (header.brand != 0) {
+                uint8_t brand[4] = {header.brand >> 24, header.brand >> 16, header.brand >> 8, header.brand};
+                headerInfo.brand = [[NSString alloc] initWithBytes:brand length:sizeof(brand) encoding:NSASCIIStringEncoding];
+            }
+            self.headerInfo = headerInfo;
+        }
+    } else if (status == SDImageHeaderProbeStatusNeedMoreData && buffer.length >= maxProbeLength) {
+        status = SDImageHeaderProbeStatusFailed;
+    }
+    if (status != SDImageHeaderProbeStatusNeedMoreData) {
+        // Free the buffer, the probe is done
+        self.buffer = [NSMutableData data];
+    }
+    self.status = status;
+    return status;
+}
+
+@end
@@ -13,6 +13,7 @@
 #import "SDImageCoderHelper.h"
 #import "SDAnimatedImageRep.h"
 #import "UIImage+ForceDecode.h"
+#import "SDImageIOAnimatedCoderInternal.h"
 
 // Specify DPI for vector format in CGImageSource, like PDF
 // 在CGImageSource中为矢量格式指定DPI，比如PDF
@@ -32,6 +33,42 @@ static NSString * kSDCGImageDestinationRequestedFileSize = @"kCGImageDestination
 @implementation SDImageIOCoderFrame
 @end
 
+@implementation SDImageIOIncrementalData {
+    /// 固定长度的存储空间，写满时才替换，旧的存储空间由引用它的快照持有
+    NSMutableData *_storage; // fixed length storage, replaced only when full, the old one is kept alive by its snapshots
+}
+
+- (NSData *)appendData:(NSData *)data {
+    NSUInteger dataLength = data.length;
+    if (_length + dataLength > _storage.length) {
+        // Grow geometrically, the previous snapshots still reference the old storage
+        /// 按几何级数扩容，之前的快照仍然引用旧的存储空间
+        NSUInteger capacity = MAX(_storage.length * 2, _length + dataLength);
+        NSMutableData *storage = [NSMutableData dataWithLength:capacity];
+        if (_length > 0) {
+            memcpy(storage.mutableBytes, _storage.bytes, _length);
+        }
+        _storage = storage;
+    }
+    if (dataLength > 0) {
+        // Only write behind the snapshot length, so the previous snapshots stay immutable
+        /// 只写入快照长度之后的字节，之前的快照保持不可变
+        memcpy((uint8_t *)_storage.mutableBytes + _length, data.bytes, dataLength);
+        _length += dataLength;
+    }
+    if (_length == 0) {
+        return [NSData data];
+    }
+    NSMutableData *storage = _storage;
+    return [[NSData alloc] initWithBytesNoCopy:storage.mutableBytes length:_length deallocator:^(void * _Nonnull bytes, NSUInteger length) {
+        // Keep the storage alive until the snapshot is released
+        /// 保持存储空间存活，直到快照被释放
+        (void)storage;
+    }];
+}
+
+@end
+
 @implementation SDImageIOAnimatedCoder {
     /// 宽高
     size_t _width, _height;
@@ -39,6 +76,8 @@ static NSString * kSDCGImageDestinationRequestedFileSize = @"kCGImageDestination
     CGImageSourceRef _imageSource;
     /// 图像数据
     NSData *_imageData;
+    /// 追加模式下累积的图像数据
+    SDImageIOIncrementalData *_incrementalData; // the accumulated data for `appendIncrementalData:finished:`
     /// 图像缩放比
     CGFloat _scale;
     /// 图像循环数量
@@ -455,7 +494,26 @@ static NSString * kSDCGImageDestinationRequestedFileSize = @"kCGImageDestination
     // Update the data source, we must pass ALL the data, not just the new bytes
     /// 更新数据源数据
     CGImageSourceUpdateData(_imageSource, (__bridge CFDataRef)data, finished);
-    
+    [self updateIncrementalProperties];
+}
+
+- (void)appendIncrementalData:(NSData *)data finished:(BOOL)finished {
+    if (_finished) {
+        return;
+    }
+    _finished = finished;
+    // Image source may keep the data, pass an immutable snapshot instead of the growing buffer
+    /// 图像源可能持有数据，传入不可变快照而不是正在增长的缓冲区
+    if (!_incrementalData) {
+        _incrementalData = [SDImageIOIncrementalData new];
+    }
+    NSData *imageData = [_incrementalData appendData:data];
+    _imageData = imageData;
+    CGImageSourceUpdateData(_imageSource, (__bridge CFDataRef)imageData, finished);
+    [self updateIncrementalProperties];
+}
+
+- (void)updateIncrementalProperties {
     if (_width + _height == 0) {
         NSDictionary *options = @{
             (__bridge NSString *)kCGImageSourceShouldCacheImmediately : @(YES),
@@ -676,7 +734,7 @@ static NSString * kSDCGImageDestinationRequestedFileSize = @"kCGImageDestination
 }
 /// 动画图像数据
 - (NSData *)animatedImageData {
-    return _imageData;
+    return [_imageData copy];
 }
 /// 动画图像循环次数
 - (NSUInteger)animatedImageLoopCount {
@@ -31,6 +31,8 @@ static NSString * kSDCGImageDestinationRequestedFileSize = @"kCGImageDestination
     BOOL _preserveAspectRatio;
     /// 记录缩略图尺寸
     CGSize _thumbnailSize;
+    /// 追加模式下累积的图像数据
+    SDImageIOIncrementalData *_incrementalData; // the accumulated data for `appendIncrementalData:finished:`
 }
 
 - (void)dealloc {
@@ -165,6 +167,25 @@ static NSString * kSDCGImageDestinationRequestedFileSize = @"kCGImageDestination
     // Update the data source, we must pass ALL the data, not just the new bytes
     /// 更新数据源
     CGImageSourceUpdateData(_imageSource, (__bridge CFDataRef)data, finished);
+    [self updateIncrementalProperties];
+}
+
+- (void)appendIncrementalData:(NSData *)data finished:(BOOL)finished {
+    if (_finished) {
+        return;
+    }
+    _finished = finished;
+    // Image source may keep the data, pass an immutable snapshot instead of the growing buffer
+    /// 图像源可能持有数据，传入不可变快照而不是正在增长的缓冲区
+    if (!_incrementalData) {
+        _incrementalData = [SDImageIOIncrementalData new];
+    }
+    NSData *imageData = [_incrementalData appendData:data];
+    CGImageSourceUpdateData(_imageSource, (__bridge CFDataRef)imageData, finished);
+    [self updateIncrementalProperties];
+}
+
+- (void)updateIncrementalProperties {
     /// 获取到图像的宽高和方向
     if (_width + _height == 0) {
         CFDictionaryRef properties = CGImageSourceCopyPropertiesAtIndex(_imageSource, 0, NULL);
@@ -18,6 +18,7 @@
 SDWebImageContextOption const SDWebImageContextLoaderCachedImage = @"loaderCachedImage";
 
 static void * SDImageLoaderProgressiveCoderKey = &SDImageLoaderProgressiveCoderKey;
+static void * SDImageLoaderProgressiveDataLengthKey = &SDImageLoaderProgressiveDataLengthKey;
 
 id<SDProgressiveImageCoder> SDImageLoaderGetProgressiveCoder(id<SDWebImageOperation> operation) {
     NSCParameterAssert(operation);
@@ -183,7 +184,19 @@ UIImage * _Nullable SDImageLoaderDecodeProgressiveImageData(NSData * _Nonnull im
         return nil;
     }
     
-    [progressiveCoder updateIncrementalData:imageData finished:finished];
+    if ([progressiveCoder respondsToSelector:@selector(appendIncrementalData:finished:)]) {
+        // Only feed the new bytes since the last pass
+        /// 只提供自上次解码以来的新字节
+        NSUInteger fedLength = [objc_getAssociatedObject(operation, SDImageLoaderProgressiveDataLengthKey) unsignedIntegerValue];
+        NSData *appendedData;
+        if (imageData.length > fedLength) {
+            appendedData = [imageData subdataWithRange:NSMakeRange(fedLength, imageData.length - fedLength)];
+            objc_setAssociatedObject(operation, SDImageLoaderProgressiveDataLengthKey, @(imageData.length), OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+        }
+        [progressiveCoder appendIncrementalData:appendedData finished:finished];
+    } else {
+        [progressiveCoder updateIncrementalData:imageData finished:finished];
+    }
     if (!decodeFirstFrame) {
         // check whether we should use `SDAnimatedImage`
         /// 检查是否该使用`SDAnimatedImage`
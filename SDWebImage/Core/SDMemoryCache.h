@@ -74,12 +74,119 @@
 
 @end
 
+/// The memory pressure level for `SDMemoryCache`, a higher level trims harder
+/// `SDMemoryCache`的内存压力等级，等级越高裁剪越多
+typedef NS_ENUM(NSUInteger, SDMemoryCachePressureLevel) {
+    /// No pressure, nothing is trimmed
+    /// 无压力，不裁剪
+    SDMemoryCachePressureLevelNormal = 0,
+    /// Trim to `config.memoryCachePressureTrimRatio` of the limits
+    /// 裁剪到限制的`config.memoryCachePressureTrimRatio`比例
+    SDMemoryCachePressureLevelWarning,
+    /// Trim to the square of `config.memoryCachePressureTrimRatio` of the limits
+    /// 裁剪到限制的`config.memoryCachePressureTrimRatio`平方比例
+    SDMemoryCachePressureLevelUrgent,
+    /// Remove all the strong entries except the pinned ones
+    /// 删除除固定条目外的所有强引用条目
+    SDMemoryCachePressureLevelCritical,
+};
+
 /**
  A memory cache which auto purge the cache on memory warning and support weak cache.
  一种内存缓存，在内存警告时自动清除缓存，并支持弱缓存
+ @note The storage is split into independent shards (key hash -> shard), each shard has its own lock, LRU list, cost accounting and weak cache. So concurrent accesses to different keys do not contend on one global lock. The cost and count limit apply to the whole cache, when exceeded the least recently used entries of the largest shard are evicted first.
+ @note 存储被拆分为多个独立的分片(key哈希 -> 分片)，每个分片拥有自己的锁、LRU链表、开销统计和弱缓存。因此对不同key的并发访问不会竞争同一把全局锁。开销和数量限制作用于整个缓存，超出时优先淘汰最大分片中最久未使用的条目
  */
-@interface SDMemoryCache <KeyType, ObjectType> : NSCache <KeyType, ObjectType> <SDMemoryCache>
+@interface SDMemoryCache <KeyType, ObjectType> : NSObject <SDMemoryCache>
 
 @property (nonatomic, strong, nonnull, readonly) SDImageCacheConfig *config;
 
+/**
+ The name of the cache, the same as `NSCache.name`.
+ 缓存的名称，与`NSCache.name`相同
+ */
+@property (nonatomic, copy, nonnull) NSString *name;
+
+/**
+ The delegate notified when an object is about to be evicted or removed, the same as `NSCache.delegate`. The `cache` argument is this `SDMemoryCache` instance, which is not a `NSCache` subclass anymore.
+ 对象即将被淘汰或删除时收到通知的代理，与`NSCache.delegate`相同。`cache`参数为该`SDMemoryCache`实例，它已不再是`NSCache`的子类
+ */
+@property (nonatomic, weak, nullable) id<NSCacheDelegate> delegate;
+
+/**
+ Whether the objects conforming to `NSDiscardableContent` are removed when their content is discarded, the same as `NSCache.evictsObjectsWithDiscardableContent`.
+ Defaults to YES.
+ 当遵循`NSDiscardableContent`的对象内容被丢弃时是否删除它们，与`NSCache.evictsObjectsWithDiscardableContent`相同
+ 默认为YES
+ */
+@property (nonatomic, assign) BOOL evictsObjectsWithDiscardableContent;
+
+/**
+ The maximum total cost that the cache can hold before it starts evicting objects. Defaults to `config.maxMemoryCost`, 0 means no limit.
+ 缓存开始淘汰对象之前可以保存的最大总开销。默认为`config.maxMemoryCost`，0表示无限制
+ */
+@property (nonatomic, assign) NSUInteger totalCostLimit;
+
+/**
+ The maximum number of objects the cache should hold. Defaults to `config.maxMemoryCount`, 0 means no limit.
+ 缓存应保存的最大对象数。默认为`config.maxMemoryCount`，0表示无限制
+ */
+@property (nonatomic, assign) NSUInteger countLimit;
+
+/**
+ The current total cost of objects in the cache.
+ 缓存中对象的当前总开销
+ */
+@property (nonatomic, assign, readonly) NSUInteger totalCost;
+
+/**
+ The current number of objects in the cache.
+ 缓存中对象的当前数量
+ */
+@property (nonatomic, assign, readonly) NSUInteger totalCount;
+
+/**
+ The number of independent shards, which is decided by `config.memoryCacheShardCount` during initialization.
+ 独立分片的数量，由初始化时的`config.memoryCacheShardCount`决定
+ */
+@property (nonatomic, assign, readonly) NSUInteger shardCount;
+
+/**
+ The pressure level applied by the last memory warning. Each memory warning raises the level by one (up to `SDMemoryCachePressureLevelCritical`), and it falls back to `SDMemoryCachePressureLevelWarning` when the previous warning is long enough ago.
+ 上一次内存警告应用的压力等级。每次内存警告将等级提高一级(最高到`SDMemoryCachePressureLevelCritical`)，当距上一次警告足够久时回落到`SDMemoryCachePressureLevelWarning`
+ */
+@property (nonatomic, assign, readonly) SDMemoryCachePressureLevel pressureLevel;
+
+/**
+ Trim the strong entries for the pressure level, the weak cache is kept. The target is a fraction of the limits (or the current total when there is no limit), the largest and least recently used entries are evicted first, and the pinned entries are kept. This is what the memory warning calls, you can call it directly to respond to your own pressure source.
+ 按压力等级裁剪强引用条目，保留弱缓存。目标值为限制的一定比例(没有限制时为当前总量)，优先淘汰最大和最久未使用的条目，并保留被固定的条目。内存警告时调用的就是这个方法，你也可以直接调用以响应你自己的压力来源
+
+ @param level The pressure level 压力等级
+ */
+- (void)trimForPressureLevel:(SDMemoryCachePressureLevel)level;
+
+/**
+ Pin the key so the pressure trimming keeps its entry, such as an image currently on screen. The pin is counted, each pin should be balanced by one unpin. The limits and the explicit removal still apply to the pinned entries.
+ The view category pins the image it sets, and unpins it when the load is cancelled, the image is replaced or the view is released.
+ 固定key，使压力裁剪保留其条目，例如当前显示在屏幕上的图片。固定是计数的，每次固定都应对应一次取消固定。限制和显式删除仍然适用于被固定的条目
+ 视图分类会固定其设置的图片，并在加载取消、图片被替换或视图被释放时取消固定
+
+ @param key The key to pin 要固定的key
+ */
+- (void)pinObjectForKey:(nonnull KeyType)key;
+
+/**
+ Balance one previous `pinObjectForKey:` call.
+ 抵消之前的一次`pinObjectForKey:`调用
+
+ @param key The key to unpin 要取消固定的key
+ */
+- (void)unpinObjectForKey:(nonnull KeyType)key;
+
+- (nullable ObjectType)objectForKey:(nonnull KeyType)key;
+- (void)setObject:(nullable ObjectType)object forKey:(nonnull KeyType)key;
+- (void)setObject:(nullable ObjectType)object forKey:(nonnull KeyType)key cost:(NSUInteger)cost;
+- (void)removeObjectForKey:(nonnull KeyType)key;
+- (void)removeAllObjects;
+
 @end
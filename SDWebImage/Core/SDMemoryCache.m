@@ -10,33 +10,60 @@
 #import "SDImageCacheConfig.h"
 #import "UIImage+MemoryCacheCost.h"
 #import "SDInternalMacros.h"
+#import "SDMemoryCacheShard.h"
 
 /// 内存缓存上下文
 static void * SDMemoryCacheContext = &SDMemoryCacheContext;
+/// 自动分片时的最大分片数
+static const NSUInteger kSDMemoryCacheMaxAutomaticShardCount = 16;
+/// The memory warnings within this interval are treated as repeated, which escalate the pressure level
+/// 在此间隔内的内存警告被视为重复警告，会提升压力等级
+static const CFTimeInterval kSDMemoryCachePressureEscalationInterval = 30;
 
-@interface SDMemoryCache <KeyType, ObjectType> () {
-#if SD_UIKIT
-    /// 若缓存锁
-    SD_LOCK_DECLARE(_weakCacheLock); // a lock to keep the access to `weakCache` thread-safe
-#endif
+// Mix the bits of `-hash`, because many `NSString` hashes only differ in the high bits
+// 混合`-hash`的位，因为很多`NSString`的哈希只在高位不同
+static inline NSUInteger SDMemoryCacheMixHash(NSUInteger hash) {
+    uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return (NSUInteger)h;
+}
+
+// Split `limit` into `count` parts to size the shard segments, each part is at least 1 when `limit` is not 0 (0 means no limit)
+// 将`limit`分成`count`份用于确定分片各分段的大小，当`limit`不为0时(0表示无限制)每份至少为1
+static inline NSUInteger SDMemoryCacheShardLimit(NSUInteger limit, NSUInteger count, NSUInteger index) {
+    if (limit == 0) {
+        return 0;
+    }
+    NSUInteger shardLimit = limit / count + (index < limit % count ? 1 : 0);
+    return MAX(shardLimit, 1);
 }
+
+@interface SDMemoryCache <KeyType, ObjectType> ()
 /// 缓存配置
 @property (nonatomic, strong, nullable) SDImageCacheConfig *config;
-#if SD_UIKIT
-/// 弱缓存
-@property (nonatomic, strong, nonnull) NSMapTable<KeyType, ObjectType> *weakCache; // strong-weak cache
-#endif
+/// 分片
+@property (nonatomic, copy, nonnull) NSArray<SDMemoryCacheShard *> *shards;
+
 @end
 
-@implementation SDMemoryCache
+@implementation SDMemoryCache {
+    NSUInteger _shardMask;
+    SDMemoryCacheUsage _usage; // the usage and limits shared by the shards
+    SD_LOCK_DECLARE(_pressureLock); // a lock to keep the escalation of memory warnings thread-safe
+    CFAbsoluteTime _lastPressureTime;
+}
 
 - (void)dealloc {
     [_config removeObserver:self forKeyPath:NSStringFromSelector(@selector(maxMemoryCost)) context:SDMemoryCacheContext];
     [_config removeObserver:self forKeyPath:NSStringFromSelector(@selector(maxMemoryCount)) context:SDMemoryCacheContext];
+    [_config removeObserver:self forKeyPath:NSStringFromSelector(@selector(shouldUseWeakMemoryCache)) context:SDMemoryCacheContext];
 #if SD_UIKIT
     [[NSNotificationCenter defaultCenter] removeObserver:self name:UIApplicationDidReceiveMemoryWarningNotification object:nil];
 #endif
-    self.delegate = nil;
 }
 
 - (instancetype)init {
@@ -59,16 +86,52 @@ static void * SDMemoryCacheContext = &SDMemoryCacheContext;
 
 - (void)commonInit {
     SDImageCacheConfig *config = self.config;
+    SD_LOCK_INIT(_pressureLock);
+    atomic_init(&_usage.cost, 0);
+    atomic_init(&_usage.count, 0);
+    atomic_init(&_usage.costLimit, 0);
+    atomic_init(&_usage.countLimit, 0);
+    _name = @"";
+    _evictsObjectsWithDiscardableContent = YES;
+
+    // Shard count is always a power of two, so the shard index is just a mask
+    /// 分片数总是2的幂，因此分片索引只需要掩码运算
+    NSUInteger shardCount = config.memoryCacheShardCount;
+    if (shardCount == 0) {
+        shardCount = MIN(NSProcessInfo.processInfo.activeProcessorCount, kSDMemoryCacheMaxAutomaticShardCount);
+    }
+    NSUInteger powerOfTwo = 1;
+    while (powerOfTwo < shardCount) {
+        powerOfTwo <<= 1;
+    }
+    shardCount = powerOfTwo;
+    _shardMask = shardCount - 1;
+
+    NSMutableArray<SDMemoryCacheShard *> *shards = [NSMutableArray arrayWithCapacity:shardCount];
+    @weakify(self);
+    void (^evictionBlock)(id, id) = ^(id key, id object) {
+        @strongify(self);
+        id<NSCacheDelegate> delegate = self.delegate;
+        if ([delegate respondsToSelector:@selector(cache:willEvictObject:)]) {
+            [delegate cache:(NSCache *)self willEvictObject:object];
+        }
+    };
+    for (NSUInteger i = 0; i < shardCount; i++) {
+        SDMemoryCacheShard *shard = [[SDMemoryCacheShard alloc] initWithPolicy:config.memoryCachePolicy usage:&_usage];
+        shard.evictionBlock = evictionBlock;
+        [shards addObject:shard];
+    }
+    self.shards = shards;
+
     self.totalCostLimit = config.maxMemoryCost;
     self.countLimit = config.maxMemoryCount;
+    [self updateWeakCache];
 
     [config addObserver:self forKeyPath:NSStringFromSelector(@selector(maxMemoryCost)) options:0 context:SDMemoryCacheContext];
     [config addObserver:self forKeyPath:NSStringFromSelector(@selector(maxMemoryCount)) options:0 context:SDMemoryCacheContext];
+    [config addObserver:self forKeyPath:NSStringFromSelector(@selector(shouldUseWeakMemoryCache)) options:0 context:SDMemoryCacheContext];
 
 #if SD_UIKIT
-    self.weakCache = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory valueOptions:NSPointerFunctionsWeakMemory capacity:0];
-    SD_LOCK_INIT(_weakCacheLock);
-
     [[NSNotificationCenter defaultCenter] addObserver:self
                                              selector:@selector(didReceiveMemoryWarning:)
                                                  name:UIApplicationDidReceiveMemoryWarningNotification
@@ -76,74 +139,235 @@ static void * SDMemoryCacheContext = &SDMemoryCacheContext;
 #endif
 }
 
+- (SDMemoryCacheShard *)shardForKey:(id)key {
+    NSUInteger index = SDMemoryCacheMixHash([key hash]) & _shardMask;
+    return self.shards[index];
+}
+
+- (void)updateWeakCache {
+    // Current the weak cache only works on iOS/tvOS platform, because only it will purge the cache on memory warning
+    // 目前弱缓存只在iOS/tvOS平台上生效，因为只有它会在内存警告时清除缓存
+#if SD_UIKIT
+    BOOL shouldUseWeakCache = self.config.shouldUseWeakMemoryCache;
+#else
+    BOOL shouldUseWeakCache = NO;
+#endif
+    for (SDMemoryCacheShard *shard in self.shards) {
+        shard.shouldUseWeakCache = shouldUseWeakCache;
+    }
+}
+
+#pragma mark - Limits
+
+- (NSUInteger)shardCount {
+    return self.shards.count;
+}
+
+- (void)setTotalCostLimit:(NSUInteger)totalCostLimit {
+    _totalCostLimit = totalCostLimit;
+    atomic_store_explicit(&_usage.costLimit, totalCostLimit, memory_order_relaxed);
+    NSArray<SDMemoryCacheShard *> *shards = self.shards;
+    [shards enumerateObjectsUsingBlock:^(SDMemoryCacheShard * _Nonnull shard, NSUInteger idx, BOOL * _Nonnull stop) {
+        shard.costShare = SDMemoryCacheShardLimit(totalCostLimit, shards.count, idx);
+    }];
+    [self evictToLimitsExcludingKey:nil];
+}
+
+- (void)setCountLimit:(NSUInteger)countLimit {
+    _countLimit = countLimit;
+    atomic_store_explicit(&_usage.countLimit, countLimit, memory_order_relaxed);
+    NSArray<SDMemoryCacheShard *> *shards = self.shards;
+    [shards enumerateObjectsUsingBlock:^(SDMemoryCacheShard * _Nonnull shard, NSUInteger idx, BOOL * _Nonnull stop) {
+        shard.countShare = SDMemoryCacheShardLimit(countLimit, shards.count, idx);
+    }];
+    [self evictToLimitsExcludingKey:nil];
+}
+
+- (NSUInteger)totalCost {
+    return atomic_load_explicit(&_usage.cost, memory_order_relaxed);
+}
+
+- (NSUInteger)totalCount {
+    return atomic_load_explicit(&_usage.count, memory_order_relaxed);
+}
+
+// The limits apply to the whole cache, so a large object is not evicted just because its shard is over an even split. Evict from the largest shard until the cache is within the limits, the object just stored for `key` goes last
+// 限制作用于整个缓存，因此大对象不会仅仅因为所在分片超过平均分配的额度而被淘汰。从最大的分片开始淘汰，直到缓存回到限制之内，刚刚为`key`存储的对象最后淘汰
+- (void)evictToLimitsExcludingKey:(nullable id)key {
+    NSArray<SDMemoryCacheShard *> *shards = self.shards;
+    NSUInteger shardCount = shards.count;
+    BOOL exhausted[shardCount];
+    memset(exhausted, 0, sizeof(exhausted));
+    while (YES) {
+        NSUInteger costLimit = atomic_load_explicit(&_usage.costLimit, memory_order_relaxed);
+        NSUInteger countLimit = atomic_load_explicit(&_usage.countLimit, memory_order_relaxed);
+        BOOL exceedCost = costLimit > 0 && self.totalCost > costLimit;
+        BOOL exceedCount = countLimit > 0 && self.totalCount > countLimit;
+        if (!exceedCost && !exceedCount) {
+            return;
+        }
+        NSUInteger largestIndex = NSNotFound;
+        NSUInteger largestSize = 0;
+        for (NSUInteger i = 0; i < shardCount; i++) {
+            if (exhausted[i]) {
+                continue;
+            }
+            NSUInteger size = exceedCost ? shards[i].totalCost : shards[i].totalCount;
+            if (largestIndex == NSNotFound || size > largestSize) {
+                largestIndex = i;
+                largestSize = size;
+            }
+        }
+        if (largestIndex == NSNotFound) {
+            break;
+        }
+        if (![shards[largestIndex] evictObjectExcludingKey:key]) {
+            exhausted[largestIndex] = YES;
+        }
+    }
+    if (key) {
+        // The object for `key` alone exceed the limits
+        [self evictToLimitsExcludingKey:nil];
+    }
+}
+
+#pragma mark - SDMemoryCache
+
 // Current this seems no use on macOS (macOS use virtual memory and do not clear cache when memory warning). So we only override on iOS/tvOS platform.
 /// 仅支持 iOS/tvOS
 #if SD_UIKIT
 - (void)didReceiveMemoryWarning:(NSNotification *)notification {
+    // Escalate on repeated warnings, start over when the last one is long ago
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    SD_LOCK(_pressureLock);
+    SDMemoryCachePressureLevel level = _pressureLevel;
+    if (level == SDMemoryCachePressureLevelNormal || now - _lastPressureTime > kSDMemoryCachePressureEscalationInterval) {
+        level = SDMemoryCachePressureLevelWarning;
+    } else if (level < SDMemoryCachePressureLevelCritical) {
+        level++;
+    }
+    _pressureLevel = level;
+    _lastPressureTime = now;
+    SD_UNLOCK(_pressureLock);
     // Only remove cache, but keep weak cache
-    [super removeAllObjects];
+    [self trimForPressureLevel:level];
 }
+#endif
 
-// `setObject:forKey:` just call this with 0 cost. Override this is enough
-- (void)setObject:(id)obj forKey:(id)key cost:(NSUInteger)g {
-    [super setObject:obj forKey:key cost:g];
-    if (!self.config.shouldUseWeakMemoryCache) {
+- (void)trimForPressureLevel:(SDMemoryCachePressureLevel)level {
+    if (level == SDMemoryCachePressureLevelNormal) {
+        return;
+    }
+    double ratio = MIN(MAX(self.config.memoryCachePressureTrimRatio, 0), 1);
+    double fraction;
+    switch (level) {
+        case SDMemoryCachePressureLevelWarning:
+            fraction = ratio;
+            break;
+        case SDMemoryCachePressureLevelUrgent:
+            fraction = ratio * ratio;
+            break;
+        default:
+            fraction = 0;
+            break;
+    }
+    NSUInteger totalCost = self.totalCost;
+    NSUInteger totalCount = self.totalCount;
+    NSUInteger costLimit = self.totalCostLimit;
+    NSUInteger countLimit = self.countLimit;
+    // The target is for the whole cache, each shard keeps its proportion of the target
+    // 目标值针对整个缓存，每个分片按比例保留目标值
+    double costRatio = 1;
+    double countRatio = 1;
+    if (costLimit == 0 && countLimit == 0) {
+        // No limit, trim the current total instead
+        // 没有限制时，按当前总量裁剪
+        costRatio = fraction;
+        countRatio = fraction;
+    } else {
+        if (costLimit > 0 && totalCost > costLimit * fraction) {
+            costRatio = costLimit * fraction / totalCost;
+        }
+        if (countLimit > 0 && totalCount > countLimit * fraction) {
+            countRatio = countLimit * fraction / totalCount;
+        }
+    }
+    for (SDMemoryCacheShard *shard in self.shards) {
+        if (fraction <= 0) {
+            [shard trimStrongObjectsToCost:0 count:0];
+            continue;
+        }
+        [shard trimStrongObjectsToCost:(NSUInteger)(shard.totalCost * costRatio) count:(NSUInteger)(shard.totalCount * countRatio)];
+    }
+}
+
+- (void)pinObjectForKey:(id)key {
+    if (!key) {
         return;
     }
-    if (key && obj) {
-        // Store weak cache
-        SD_LOCK(_weakCacheLock);
-        [self.weakCache setObject:obj forKey:key];
-        SD_UNLOCK(_weakCacheLock);
+    [[self shardForKey:key] pinKey:key];
+}
+
+- (void)unpinObjectForKey:(id)key {
+    if (!key) {
+        return;
     }
+    [[self shardForKey:key] unpinKey:key];
 }
 
 - (id)objectForKey:(id)key {
-    id obj = [super objectForKey:key];
-    if (!self.config.shouldUseWeakMemoryCache) {
-        return obj;
-    }
-    if (key && !obj) {
-        // Check weak cache
-        SD_LOCK(_weakCacheLock);
-        obj = [self.weakCache objectForKey:key];
-        SD_UNLOCK(_weakCacheLock);
-        if (obj) {
-            // Sync cache
-            NSUInteger cost = 0;
-            if ([obj isKindOfClass:[UIImage class]]) {
-                cost = [(UIImage *)obj sd_memoryCost];
-            }
-            [super setObject:obj forKey:key cost:cost];
+    if (!key) {
+        return nil;
+    }
+    SDMemoryCacheShard *shard = [self shardForKey:key];
+    BOOL resurrected = NO;
+    id obj = [shard objectForKey:key resurrected:&resurrected];
+    if (obj && self.evictsObjectsWithDiscardableContent && [obj conformsToProtocol:@protocol(NSDiscardableContent)] && [(id<NSDiscardableContent>)obj isContentDiscarded]) {
+        // The same as `NSCache`, the discarded content is useless
+        [shard removeObjectForKey:key];
+        return nil;
+    }
+    if (resurrected) {
+        // Sync cache, the cost is calculated outside of the shard lock
+        NSUInteger cost = 0;
+        if ([obj isKindOfClass:[UIImage class]]) {
+            cost = [(UIImage *)obj sd_memoryCost];
         }
+        [shard setObject:obj forKey:key cost:cost];
+        [self evictToLimitsExcludingKey:key];
     }
     return obj;
 }
 
-- (void)removeObjectForKey:(id)key {
-    [super removeObjectForKey:key];
-    if (!self.config.shouldUseWeakMemoryCache) {
+- (void)setObject:(id)obj forKey:(id)key {
+    [self setObject:obj forKey:key cost:0];
+}
+
+- (void)setObject:(id)obj forKey:(id)key cost:(NSUInteger)g {
+    if (!key) {
         return;
     }
-    if (key) {
-        // Remove weak cache
-        SD_LOCK(_weakCacheLock);
-        [self.weakCache removeObjectForKey:key];
-        SD_UNLOCK(_weakCacheLock);
+    if (!obj) {
+        [self removeObjectForKey:key];
+        return;
     }
+    [[self shardForKey:key] setObject:obj forKey:key cost:g];
+    [self evictToLimitsExcludingKey:key];
 }
 
-- (void)removeAllObjects {
-    [super removeAllObjects];
-    if (!self.config.shouldUseWeakMemoryCache) {
+- (void)removeObjectForKey:(id)key {
+    if (!key) {
         return;
     }
+    [[self shardForKey:key] removeObjectForKey:key];
+}
+
+- (void)removeAllObjects {
     // Manually remove should also remove weak cache
-    SD_LOCK(_weakCacheLock);
-    [self.weakCache removeAllObjects];
-    SD_UNLOCK(_weakCacheLock);
+    for (SDMemoryCacheShard *shard in self.shards) {
+        [shard removeAllObjects];
+    }
 }
-#endif
 
 #pragma mark - KVO
 
@@ -153,6 +377,8 @@ static void * SDMemoryCacheContext = &SDMemoryCacheContext;
             self.totalCostLimit = self.config.maxMemoryCost;
         } else if ([keyPath isEqualToString:NSStringFromSelector(@selector(maxMemoryCount))]) {
             self.countLimit = self.config.maxMemoryCount;
+        } else if ([keyPath isEqualToString:NSStringFromSelector(@selector(shouldUseWeakMemoryCache))]) {
+            [self updateWeakCache];
         }
     } else {
         [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
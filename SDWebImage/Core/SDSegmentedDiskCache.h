@@ -0,0 +1,60 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageCompat.h"
+#import "SDDiskCache.h"
+
+/**
+ A log-structured disk cache, which can be used as an alternative of the built-in `SDDiskCache` via `SDImageCacheConfig.diskCacheClass`.
+ 一种日志结构的硬盘缓存，可以通过`SDImageCacheConfig.diskCacheClass`替代内置的`SDDiskCache`使用
+
+ @discussion Instead of one file per key, the entries (image data and extended data) are appended into a few large segment files, and an in-memory hash index maps the key to (segment, offset, length, extended data offset). The index is rebuilt by scanning the record headers of segments during initialization. Removal appends a small tombstone record. Segments with too many dead bytes are compacted in the background, live records are copied to the active segment and the old segment file is deleted.
+ This avoid huge flat directories and one inode per image. A hit is only one `pread` on an already opened file.
+ 每个key不再对应一个文件，条目(图像数据和扩展数据)被追加写入少量大的分段文件，内存中的哈希索引将key映射到(分段, 偏移, 长度, 扩展数据偏移)。初始化时通过扫描分段的记录头重建索引。删除操作追加一个小的墓碑记录。失效字节过多的分段会在后台被压缩，存活的记录被复制到活跃分段，旧的分段文件被删除。
+ 这避免了巨大的扁平目录和每张图片占用一个inode。一次命中只需要对已打开的文件进行一次`pread`
+
+ @note Since there is no file for each key, `cachePathForKey:` always returns nil.
+ @note 由于每个key没有对应的文件，`cachePathForKey:`总是返回nil
+ @note A read does not write the segments, so the access date is not recorded. `SDImageCacheConfigExpireTypeAccessDate` is not supported, the expiration and the size limit always use the modification date.
+ @note 读取不会写入分段，因此不记录访问日期。不支持`SDImageCacheConfigExpireTypeAccessDate`，过期清理和大小限制总是使用修改日期
+ */
+@interface SDSegmentedDiskCache : NSObject <SDDiskCache>
+
+/**
+ Cache Config object - storing all kind of settings.
+ 配置对象
+ */
+@property (nonatomic, strong, readonly, nonnull) SDImageCacheConfig *config;
+
+/**
+ The size limit of one segment file, when the active segment exceeds this size, a new segment is created. Defaults to 16MB.
+ 单个分段文件的大小限制，当活跃分段超过此大小时，会创建一个新的分段。默认为16MB
+ */
+@property (nonatomic, assign) NSUInteger maxSegmentSize;
+
+/**
+ The ratio of dead bytes in a segment to trigger the background compaction. Defaults to 0.5.
+ 触发后台压缩的分段中失效字节的比例。默认为0.5
+ */
+@property (nonatomic, assign) double compactionRatio;
+
+/**
+ The number of segment files currently in use.
+ 当前使用中的分段文件数量
+ */
+@property (nonatomic, assign, readonly) NSUInteger segmentCount;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/**
+ Wait until all the scheduled background compaction finished. Useful for test or benchmark.
+ 等待所有已计划的后台压缩完成，可用于测试和性能测试
+ */
+- (void)waitUntilCompactionFinished;
+
+@end
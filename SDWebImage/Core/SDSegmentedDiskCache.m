@@ -0,0 +1,769 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDSegmentedDiskCache.h"
+#import "SDImageCacheConfig.h"
+#import "SDInternalMacros.h"
+#import <fcntl.h>
+#import <unistd.h>
+
+/// 分段文件扩展名
+static NSString * const SDSegmentedDiskCacheSegmentExtension = @"segment";
+/// 记录魔数 'SDLS'
+static const uint32_t kSDSegmentRecordMagic = 0x53444C53;
+/// key的最大长度，用于校验损坏的记录
+static const uint32_t kSDSegmentRecordMaxKeyLength = 64 * 1024;
+/// 默认分段大小 16MB
+static const NSUInteger kSDSegmentedDiskCacheDefaultSegmentSize = 16 * 1024 * 1024;
+
+/// 记录类型
+typedef NS_ENUM(uint8_t, SDSegmentRecordType) {
+    SDSegmentRecordTypeData = 1,
+    SDSegmentRecordTypeExtendedData = 2, // empty payload means remove the extended data
+    SDSegmentRecordTypeTombstone = 3,
+};
+
+/// The fixed-size header of each record, followed by the UTF-8 key bytes and the payload bytes
+/// 每条记录的固定长度头部，后面跟随UTF-8编码的key和负载数据
+typedef struct __attribute__((packed)) SDSegmentRecordHeader {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t reserved[3];
+    uint32_t keyLength;
+    uint32_t reserved2;
+    uint64_t payloadLength;
+    double timestamp; // since 1970
+} SDSegmentRecordHeader;
+
+/// 一个分段文件
+@interface SDSegmentedDiskCacheSegment : NSObject {
+    @package
+    uint32_t _identifier;
+    int _fd;
+    NSString *_path;
+    uint64_t _size; // the append offset, including the reserved but not yet written bytes
+    uint64_t _deadBytes;
+    NSUInteger _pendingWrites; // the reserved records not yet written, the segment is compacted only when there is none
+    BOOL _compacting;
+}
+@end
+
+@implementation SDSegmentedDiskCacheSegment
+
+- (void)dealloc {
+    // The file descriptor is closed only when no reader holds this segment, so an in-flight read on a compacted segment still works
+    // 只有在没有读取方持有该分段时才关闭文件描述符，因此对已压缩分段的读取仍然有效
+    if (_fd >= 0) {
+        close(_fd);
+    }
+}
+
+@end
+
+/// A location of record inside the segments
+/// 记录在分段中的位置
+typedef struct SDSegmentLocation {
+    uint32_t segment;
+    uint64_t recordOffset;
+    uint64_t recordLength;
+    uint64_t payloadOffset;
+    uint64_t payloadLength;
+} SDSegmentLocation;
+
+static inline BOOL SDSegmentLocationEqual(SDSegmentLocation a, SDSegmentLocation b) {
+    return a.segment == b.segment && a.recordOffset == b.recordOffset;
+}
+
+// Whether `a` is appended after `b`, which matches the replay order
+static inline BOOL SDSegmentLocationAfter(SDSegmentLocation a, SDSegmentLocation b) {
+    return a.segment > b.segment || (a.segment == b.segment && a.recordOffset > b.recordOffset);
+}
+
+/// 索引条目
+@interface SDSegmentedDiskCacheEntry : NSObject {
+    @package
+    SDSegmentLocation _data;
+    BOOL _hasExtendedData;
+    SDSegmentLocation _extendedData;
+    NSTimeInterval _modificationDate;
+}
+@end
+
+@implementation SDSegmentedDiskCacheEntry
+@end
+
+@interface SDSegmentedDiskCache () {
+    SD_LOCK_DECLARE(_lock); // a lock to keep the access to index and segments thread-safe, no file IO inside
+    NSMutableDictionary<NSString *, SDSegmentedDiskCacheEntry *> *_index;
+    NSMutableDictionary<NSNumber *, SDSegmentedDiskCacheSegment *> *_segments;
+    SDSegmentedDiskCacheSegment *_activeSegment;
+    NSUInteger _totalSize;
+}
+/// 硬盘缓存路径
+@property (nonatomic, copy) NSString *diskCachePath;
+/// 文件管理器
+@property (nonatomic, strong, nonnull) NSFileManager *fileManager;
+/// 压缩队列
+@property (nonatomic, strong, nonnull) dispatch_queue_t compactionQueue;
+
+@end
+
+@implementation SDSegmentedDiskCache
+
+- (instancetype)init {
+    NSAssert(NO, @"Use `initWithCachePath:` with the disk cache path");
+    return nil;
+}
+
+#pragma mark - SDDiskCache Protocol
+
+- (instancetype)initWithCachePath:(NSString *)cachePath config:(SDImageCacheConfig *)config {
+    if (self = [super init]) {
+        _diskCachePath = cachePath;
+        _config = config;
+        _maxSegmentSize = kSDSegmentedDiskCacheDefaultSegmentSize;
+        _compactionRatio = 0.5;
+        NSAssert(config.diskCacheExpireType != SDImageCacheConfigExpireTypeAccessDate, @"`SDSegmentedDiskCache` does not persist the access date, use `SDImageCacheConfigExpireTypeModificationDate` instead");
+        _index = [NSMutableDictionary dictionary];
+        _segments = [NSMutableDictionary dictionary];
+        _compactionQueue = dispatch_queue_create("com.hackemist.SDSegmentedDiskCache.compaction", dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_SERIAL, QOS_CLASS_UTILITY, 0));
+        SD_LOCK_INIT(_lock);
+        [self commonInit];
+    }
+    return self;
+}
+
+- (void)commonInit {
+    if (self.config.fileManager) {
+        self.fileManager = self.config.fileManager;
+    } else {
+        self.fileManager = [NSFileManager new];
+    }
+    [self createDirectoryIfNeeded];
+    [self loadSegments];
+}
+
+- (void)createDirectoryIfNeeded {
+    if ([self.fileManager fileExistsAtPath:self.diskCachePath]) {
+        return;
+    }
+    [self.fileManager createDirectoryAtPath:self.diskCachePath withIntermediateDirectories:YES attributes:nil error:NULL];
+    // disable iCloud backup
+    if (self.config.shouldDisableiCloud) {
+        // ignore iCloud backup resource value error
+        [[NSURL fileURLWithPath:self.diskCachePath isDirectory:YES] setResourceValue:@YES forKey:NSURLIsExcludedFromBackupKey error:nil];
+    }
+}
+
+- (BOOL)containsDataForKey:(NSString *)key {
+    NSParameterAssert(key);
+    SD_LOCK(_lock);
+    BOOL exists = _index[key] != nil;
+    SD_UNLOCK(_lock);
+    return exists;
+}
+
+- (NSData *)dataForKey:(NSString *)key {
+    NSParameterAssert(key);
+    SD_LOCK(_lock);
+    SDSegmentedDiskCacheEntry *entry = _index[key];
+    SDSegmentLocation location = {0};
+    SDSegmentedDiskCacheSegment *segment;
+    if (entry) {
+        location = entry->_data;
+        segment = _segments[@(location.segment)];
+    }
+    SD_UNLOCK(_lock);
+    if (!segment) {
+        return nil;
+    }
+    return [self readSegment:segment offset:location.payloadOffset length:location.payloadLength];
+}
+
+- (void)setData:(NSData *)data forKey:(NSString *)key {
+    NSParameterAssert(data);
+    NSParameterAssert(key);
+    NSTimeInterval timestamp = [NSDate date].timeIntervalSince1970;
+    SDSegmentLocation location;
+    if (![self appendRecordWithType:SDSegmentRecordTypeData key:key payload:data timestamp:timestamp location:&location]) {
+        return;
+    }
+    SD_LOCK(_lock);
+    SDSegmentedDiskCacheEntry *entry = _index[key];
+    if (!_segments[@(location.segment)]) {
+        // All data removed during writing
+    } else if (entry && SDSegmentLocationAfter(entry->_data, location)) {
+        // A concurrent write already appended a newer record
+        [self _markDeadLocation:location];
+    } else {
+        if (entry) {
+            [self _markDeadEntry:entry];
+        }
+        entry = [SDSegmentedDiskCacheEntry new];
+        entry->_data = location;
+        entry->_modificationDate = timestamp;
+        _index[key] = entry;
+        _totalSize += location.payloadLength;
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (NSData *)extendedDataForKey:(NSString *)key {
+    NSParameterAssert(key);
+    SD_LOCK(_lock);
+    SDSegmentedDiskCacheEntry *entry = _index[key];
+    SDSegmentLocation location = {0};
+    SDSegmentedDiskCacheSegment *segment;
+    if (entry && entry->_hasExtendedData) {
+        location = entry->_extendedData;
+        segment = _segments[@(location.segment)];
+    }
+    SD_UNLOCK(_lock);
+    if (!segment) {
+        return nil;
+    }
+    return [self readSegment:segment offset:location.payloadOffset length:location.payloadLength];
+}
+
+- (void)setExtendedData:(NSData *)extendedData forKey:(NSString *)key {
+    NSParameterAssert(key);
+    SD_LOCK(_lock);
+    SDSegmentedDiskCacheEntry *entry = _index[key];
+    BOOL shouldWrite = entry && (extendedData.length > 0 || entry->_hasExtendedData);
+    SD_UNLOCK(_lock);
+    if (!shouldWrite) {
+        return;
+    }
+    // Empty payload means remove
+    SDSegmentLocation location;
+    if (![self appendRecordWithType:SDSegmentRecordTypeExtendedData key:key payload:extendedData timestamp:[NSDate date].timeIntervalSince1970 location:&location]) {
+        return;
+    }
+    SD_LOCK(_lock);
+    entry = _index[key];
+    if (!entry || SDSegmentLocationAfter(entry->_data, location) || (entry->_hasExtendedData && SDSegmentLocationAfter(entry->_extendedData, location))) {
+        [self _markDeadLocation:location];
+    } else {
+        if (entry->_hasExtendedData) {
+            [self _markDeadLocation:entry->_extendedData];
+        }
+        if (extendedData.length > 0) {
+            entry->_hasExtendedData = YES;
+            entry->_extendedData = location;
+        } else {
+            entry->_hasExtendedData = NO;
+            [self _markDeadLocation:location];
+        }
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (void)removeDataForKey:(NSString *)key {
+    NSParameterAssert(key);
+    [self appendTombstoneForKey:key onlyIfAbsent:NO];
+}
+
+- (void)removeAllData {
+    SD_LOCK(_lock);
+    // Swap the segments out, the files are deleted outside of the lock. The new active segment continue the identifier, so it never reuse a file being deleted
+    NSArray<SDSegmentedDiskCacheSegment *> *segments = _segments.allValues;
+    uint32_t identifier = _activeSegment ? _activeSegment->_identifier + 1 : 1;
+    [_index removeAllObjects];
+    [_segments removeAllObjects];
+    _activeSegment = nil;
+    _totalSize = 0;
+    SD_UNLOCK(_lock);
+    for (SDSegmentedDiskCacheSegment *segment in segments) {
+        unlink(segment->_path.fileSystemRepresentation);
+    }
+    [self createDirectoryIfNeeded];
+    SD_LOCK(_lock);
+    if (!_activeSegment) {
+        [self _openActiveSegmentWithIdentifier:identifier];
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (void)removeExpiredData {
+    // Only the modification date is recorded, a read never writes the segments
+    NSTimeInterval expirationDate = (self.config.maxDiskAge < 0) ? 0 : [NSDate date].timeIntervalSince1970 - self.config.maxDiskAge;
+    NSMutableArray<NSString *> *keysToDelete = [NSMutableArray array];
+    NSMutableArray<NSString *> *remainingKeys = [NSMutableArray array];
+    NSMutableDictionary<NSString *, NSNumber *> *remainingDates = [NSMutableDictionary dictionary];
+    NSMutableDictionary<NSString *, NSNumber *> *remainingSizes = [NSMutableDictionary dictionary];
+    NSUInteger currentCacheSize = 0;
+
+    SD_LOCK(_lock);
+    [_index enumerateKeysAndObjectsUsingBlock:^(NSString * _Nonnull key, SDSegmentedDiskCacheEntry * _Nonnull entry, BOOL * _Nonnull stop) {
+        NSTimeInterval date = entry->_modificationDate;
+        if (self.config.maxDiskAge >= 0 && date <= expirationDate) {
+            [keysToDelete addObject:key];
+            return;
+        }
+        [remainingKeys addObject:key];
+        remainingDates[key] = @(date);
+        remainingSizes[key] = @(entry->_data.payloadLength);
+    }];
+    currentCacheSize = _totalSize;
+    SD_UNLOCK(_lock);
+
+    for (NSString *key in keysToDelete) {
+        [self removeDataForKey:key];
+    }
+    SD_LOCK(_lock);
+    currentCacheSize = _totalSize;
+    SD_UNLOCK(_lock);
+
+    // If our remaining disk cache exceeds the high watermark, delete the oldest entries until the low watermark
+    // 如果剩余的磁盘缓存超过了高水位，删除最老的条目直到低水位
+    NSUInteger maxDiskSize = self.config.maxDiskSize;
+    double highWatermark = self.config.diskCacheHighWatermark;
+    if (maxDiskSize > 0 && currentCacheSize > maxDiskSize * highWatermark) {
+        // The low watermark never exceeds the high watermark
+        const NSUInteger desiredCacheSize = (NSUInteger)(maxDiskSize * MIN(self.config.diskCacheLowWatermark, highWatermark));
+        [remainingKeys sortUsingComparator:^NSComparisonResult(NSString * _Nonnull key1, NSString * _Nonnull key2) {
+            return [remainingDates[key1] compare:remainingDates[key2]];
+        }];
+        for (NSString *key in remainingKeys) {
+            [self removeDataForKey:key];
+            NSUInteger size = remainingSizes[key].unsignedIntegerValue;
+            currentCacheSize = currentCacheSize > size ? currentCacheSize - size : 0;
+            if (currentCacheSize < desiredCacheSize) {
+                break;
+            }
+        }
+    }
+}
+
+- (NSString *)cachePathForKey:(NSString *)key {
+    // No file for each key
+    return nil;
+}
+
+- (NSUInteger)totalCount {
+    SD_LOCK(_lock);
+    NSUInteger count = _index.count;
+    SD_UNLOCK(_lock);
+    return count;
+}
+
+- (NSUInteger)totalSize {
+    SD_LOCK(_lock);
+    NSUInteger size = _totalSize;
+    SD_UNLOCK(_lock);
+    return size;
+}
+
+- (NSUInteger)segmentCount {
+    SD_LOCK(_lock);
+    NSUInteger count = _segments.count;
+    SD_UNLOCK(_lock);
+    return count;
+}
+
+- (void)waitUntilCompactionFinished {
+    dispatch_sync(self.compactionQueue, ^{});
+}
+
+#pragma mark - Segment IO
+
+- (NSString *)pathForSegmentIdentifier:(uint32_t)identifier {
+    NSString *fileName = [[NSString stringWithFormat:@"%08u", identifier] stringByAppendingPathExtension:SDSegmentedDiskCacheSegmentExtension];
+    return [self.diskCachePath stringByAppendingPathComponent:fileName];
+}
+
+- (SDSegmentedDiskCacheSegment *)openSegmentWithIdentifier:(uint32_t)identifier {
+    NSString *path = [self pathForSegmentIdentifier:identifier];
+    int fd = open(path.fileSystemRepresentation, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return nil;
+    }
+    SDSegmentedDiskCacheSegment *segment = [SDSegmentedDiskCacheSegment new];
+    segment->_identifier = identifier;
+    segment->_fd = fd;
+    segment->_path = path;
+    segment->_size = (uint64_t)MAX(lseek(fd, 0, SEEK_END), 0);
+    return segment;
+}
+
+// Make sure to call with lock held by caller
+- (void)_openActiveSegmentWithIdentifier:(uint32_t)identifier {
+    SDSegmentedDiskCacheSegment *segment = [self openSegmentWithIdentifier:identifier];
+    if (segment) {
+        _segments[@(identifier)] = segment;
+        _activeSegment = segment;
+    }
+}
+
+- (NSData *)readSegment:(SDSegmentedDiskCacheSegment *)segment offset:(uint64_t)offset length:(uint64_t)length {
+    void *bytes = malloc((size_t)MAX(length, 1));
+    if (!bytes) {
+        return nil;
+    }
+    ssize_t result = pread(segment->_fd, bytes, (size_t)length, (off_t)offset);
+    if (result < 0 || (uint64_t)result != length) {
+        free(bytes);
+        return nil;
+    }
+    return [NSData dataWithBytesNoCopy:bytes length:(NSUInteger)length freeWhenDone:YES];
+}
+
+// Reserve the space in active segment, the bytes are written outside of the lock
+// Make sure to call with lock held by caller
+- (SDSegmentedDiskCacheSegment *)_reserveRecordLength:(uint64_t)length offset:(uint64_t *)offset {
+    SDSegmentedDiskCacheSegment *segment = _activeSegment;
+    if (!segment || (segment->_size > 0 && segment->_size + length > self.maxSegmentSize)) {
+        [self _openActiveSegmentWithIdentifier:segment ? segment->_identifier + 1 : 1];
+        segment = _activeSegment;
+    }
+    if (!segment) {
+        return nil;
+    }
+    *offset = segment->_size;
+    segment->_size += length;
+    segment->_pendingWrites++;
+    return segment;
+}
+
+// Make sure to call with lock held by caller
+- (void)_finishWriteInSegment:(SDSegmentedDiskCacheSegment *)segment {
+    segment->_pendingWrites--;
+    if (segment->_pendingWrites == 0 && _segments[@(segment->_identifier)] == segment) {
+        // The compaction was deferred by this write
+        [self _scheduleCompactionIfNeeded:segment];
+    }
+}
+
+- (BOOL)writeRecordWithType:(SDSegmentRecordType)type keyBytes:(NSData *)keyBytes payload:(NSData *)payload timestamp:(NSTimeInterval)timestamp segment:(SDSegmentedDiskCacheSegment *)segment offset:(uint64_t)offset {
+    SDSegmentRecordHeader header = {0};
+    header.magic = kSDSegmentRecordMagic;
+    header.type = type;
+    header.keyLength = (uint32_t)keyBytes.length;
+    header.payloadLength = payload.length;
+    header.timestamp = timestamp;
+    size_t length = sizeof(header) + keyBytes.length + payload.length;
+    uint8_t *buffer = malloc(length);
+    if (!buffer) {
+        return NO;
+    }
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), keyBytes.bytes, keyBytes.length);
+    if (payload.length > 0) {
+        memcpy(buffer + sizeof(header) + keyBytes.length, payload.bytes, payload.length);
+    }
+    ssize_t result = pwrite(segment->_fd, buffer, length, (off_t)offset);
+    free(buffer);
+    return result >= 0 && (size_t)result == length;
+}
+
+- (BOOL)appendRecordWithType:(SDSegmentRecordType)type key:(NSString *)key payload:(NSData *)payload timestamp:(NSTimeInterval)timestamp location:(SDSegmentLocation *)location {
+    NSData *keyBytes = [key dataUsingEncoding:NSUTF8StringEncoding];
+    if (!keyBytes || keyBytes.length > kSDSegmentRecordMaxKeyLength) {
+        return NO;
+    }
+    uint64_t recordLength = sizeof(SDSegmentRecordHeader) + keyBytes.length + payload.length;
+    uint64_t offset = 0;
+    SD_LOCK(_lock);
+    SDSegmentedDiskCacheSegment *segment = [self _reserveRecordLength:recordLength offset:&offset];
+    SD_UNLOCK(_lock);
+    if (!segment) {
+        return NO;
+    }
+    SDSegmentLocation recordLocation = {segment->_identifier, offset, recordLength, offset + sizeof(SDSegmentRecordHeader) + keyBytes.length, payload.length};
+    BOOL written = [self writeRecordWithType:type keyBytes:keyBytes payload:payload timestamp:timestamp segment:segment offset:offset];
+    SD_LOCK(_lock);
+    if (!written) {
+        [self _markDeadLocation:recordLocation];
+    }
+    [self _finishWriteInSegment:segment];
+    SD_UNLOCK(_lock);
+    if (!written) {
+        return NO;
+    }
+    if (location) {
+        *location = recordLocation;
+    }
+    return YES;
+}
+
+- (void)appendTombstoneForKey:(NSString *)key onlyIfAbsent:(BOOL)onlyIfAbsent {
+    NSData *keyBytes = [key dataUsingEncoding:NSUTF8StringEncoding];
+    if (!keyBytes || keyBytes.length > kSDSegmentRecordMaxKeyLength) {
+        return;
+    }
+    uint64_t recordLength = sizeof(SDSegmentRecordHeader) + keyBytes.length;
+    uint64_t offset = 0;
+    SDSegmentedDiskCacheSegment *segment;
+    SD_LOCK(_lock);
+    SDSegmentedDiskCacheEntry *entry = _index[key];
+    if ((onlyIfAbsent && !entry) || (!onlyIfAbsent && entry)) {
+        // The check and reservation are in the same critical section, so the tombstone is always ordered correctly with a concurrent write
+        segment = [self _reserveRecordLength:recordLength offset:&offset];
+    }
+    if (segment) {
+        if (entry) {
+            [self _markDeadEntry:entry];
+            [_index removeObjectForKey:key];
+        }
+        // Tombstone is dead at the beginning, it's only used for replay
+        SDSegmentLocation location = {segment->_identifier, offset, recordLength, offset + recordLength, 0};
+        [self _markDeadLocation:location];
+    }
+    SD_UNLOCK(_lock);
+    if (segment) {
+        [self writeRecordWithType:SDSegmentRecordTypeTombstone keyBytes:keyBytes payload:nil timestamp:[NSDate date].timeIntervalSince1970 segment:segment offset:offset];
+        SD_LOCK(_lock);
+        [self _finishWriteInSegment:segment];
+        SD_UNLOCK(_lock);
+    }
+}
+
+#pragma mark - Dead Bytes
+
+// Make sure to call with lock held by caller
+- (void)_markDeadEntry:(SDSegmentedDiskCacheEntry *)entry {
+    _totalSize -= MIN(_totalSize, entry->_data.payloadLength);
+    [self _markDeadLocation:entry->_data];
+    if (entry->_hasExtendedData) {
+        [self _markDeadLocation:entry->_extendedData];
+    }
+}
+
+// Make sure to call with lock held by caller
+- (void)_markDeadLocation:(SDSegmentLocation)location {
+    SDSegmentedDiskCacheSegment *segment = _segments[@(location.segment)];
+    if (!segment) {
+        return;
+    }
+    segment->_deadBytes += location.recordLength;
+    [self _scheduleCompactionIfNeeded:segment];
+}
+
+// Make sure to call with lock held by caller
+- (void)_scheduleCompactionIfNeeded:(SDSegmentedDiskCacheSegment *)segment {
+    if (segment == _activeSegment || segment->_compacting || segment->_pendingWrites > 0 || segment->_size == 0) {
+        return;
+    }
+    if ((double)segment->_deadBytes / segment->_size < self.compactionRatio) {
+        return;
+    }
+    segment->_compacting = YES;
+    dispatch_async(self.compactionQueue, ^{
+        @autoreleasepool {
+            [self compactSegment:segment];
+        }
+    });
+}
+
+#pragma mark - Load & Compaction
+
+// Read the header and key of record at offset, return NO if the record is invalid
+- (BOOL)readRecordHeader:(SDSegmentRecordHeader *)header key:(NSString **)key segment:(SDSegmentedDiskCacheSegment *)segment offset:(uint64_t)offset fileSize:(uint64_t)fileSize {
+    if (offset + sizeof(SDSegmentRecordHeader) > fileSize) {
+        return NO;
+    }
+    if (pread(segment->_fd, header, sizeof(SDSegmentRecordHeader), (off_t)offset) != sizeof(SDSegmentRecordHeader)) {
+        return NO;
+    }
+    if (header->magic != kSDSegmentRecordMagic || header->type < SDSegmentRecordTypeData || header->type > SDSegmentRecordTypeTombstone || header->keyLength > kSDSegmentRecordMaxKeyLength) {
+        return NO;
+    }
+    if (offset + sizeof(SDSegmentRecordHeader) + header->keyLength + header->payloadLength > fileSize) {
+        return NO;
+    }
+    NSData *keyBytes = [self readSegment:segment offset:offset + sizeof(SDSegmentRecordHeader) length:header->keyLength];
+    if (!keyBytes) {
+        return NO;
+    }
+    *key = [[NSString alloc] initWithData:keyBytes encoding:NSUTF8StringEncoding];
+    return *key != nil;
+}
+
+// Rebuild the index by replaying all the segments, called during initialization
+- (void)loadSegments {
+    NSArray<NSString *> *fileNames = [self.fileManager contentsOfDirectoryAtPath:self.diskCachePath error:nil];
+    NSMutableArray<NSNumber *> *identifiers = [NSMutableArray array];
+    for (NSString *fileName in fileNames) {
+        if ([fileName.pathExtension isEqualToString:SDSegmentedDiskCacheSegmentExtension]) {
+            [identifiers addObject:@((uint32_t)fileName.stringByDeletingPathExtension.longLongValue)];
+        }
+    }
+    [identifiers sortUsingSelector:@selector(compare:)];
+
+    SD_LOCK(_lock);
+    for (NSNumber *identifier in identifiers) {
+        SDSegmentedDiskCacheSegment *segment = [self openSegmentWithIdentifier:identifier.unsignedIntValue];
+        if (!segment) {
+            continue;
+        }
+        _segments[identifier] = segment;
+        _activeSegment = segment;
+        uint64_t fileSize = segment->_size;
+        uint64_t offset = 0;
+        while (offset < fileSize) {
+            SDSegmentRecordHeader header;
+            NSString *key;
+            if (![self readRecordHeader:&header key:&key segment:segment offset:offset fileSize:fileSize]) {
+                // Partial or corrupted tail, which is caused by crash during writing. Drop it
+                ftruncate(segment->_fd, (off_t)offset);
+                segment->_size = offset;
+                break;
+            }
+            uint64_t recordLength = sizeof(SDSegmentRecordHeader) + header.keyLength + header.payloadLength;
+            SDSegmentLocation location = {segment->_identifier, offset, recordLength, offset + sizeof(SDSegmentRecordHeader) + header.keyLength, header.payloadLength};
+            [self _replayRecordWithType:header.type key:key location:location timestamp:header.timestamp];
+            offset += recordLength;
+        }
+    }
+    if (!_activeSegment) {
+        [self _openActiveSegmentWithIdentifier:1];
+    }
+    for (SDSegmentedDiskCacheSegment *segment in _segments.allValues) {
+        [self _scheduleCompactionIfNeeded:segment];
+    }
+    SD_UNLOCK(_lock);
+}
+
+// Make sure to call with lock held by caller
+- (void)_replayRecordWithType:(SDSegmentRecordType)type key:(NSString *)key location:(SDSegmentLocation)location timestamp:(NSTimeInterval)timestamp {
+    SDSegmentedDiskCacheEntry *entry = _index[key];
+    switch (type) {
+        case SDSegmentRecordTypeData: {
+            if (entry) {
+                [self _markDeadEntry:entry];
+            }
+            entry = [SDSegmentedDiskCacheEntry new];
+            entry->_data = location;
+            entry->_modificationDate = timestamp;
+            _index[key] = entry;
+            _totalSize += location.payloadLength;
+        }
+            break;
+        case SDSegmentRecordTypeExtendedData: {
+            if (!entry || location.payloadLength == 0) {
+                [self _markDeadLocation:location];
+            }
+            if (!entry) {
+                break;
+            }
+            if (entry->_hasExtendedData) {
+                [self _markDeadLocation:entry->_extendedData];
+            }
+            entry->_hasExtendedData = location.payloadLength > 0;
+            entry->_extendedData = location;
+        }
+            break;
+        case SDSegmentRecordTypeTombstone: {
+            if (entry) {
+                [self _markDeadEntry:entry];
+                [_index removeObjectForKey:key];
+            }
+            [self _markDeadLocation:location];
+        }
+            break;
+    }
+}
+
+// Copy the live records of segment into the active segment, then delete the segment file
+- (void)compactSegment:(SDSegmentedDiskCacheSegment *)segment {
+    // The segment is not active and has no pending write, so the size is final and every record is written
+    SD_LOCK(_lock);
+    uint64_t fileSize = segment->_size;
+    SD_UNLOCK(_lock);
+    uint64_t offset = 0;
+    while (offset < fileSize) {
+        SDSegmentRecordHeader header;
+        NSString *key;
+        if (![self readRecordHeader:&header key:&key segment:segment offset:offset fileSize:fileSize]) {
+            // A failed write left a hole, the records after it can not be walked. Keep the segment, the live records are still readable by the index. It stays marked as compacting so it's not retried
+            // 写入失败留下了空洞，之后的记录无法遍历。保留该分段，索引仍然可以读取其中的有效记录。它保持压缩中的标记，因此不会重试
+            return;
+        }
+        uint64_t recordLength = sizeof(SDSegmentRecordHeader) + header.keyLength + header.payloadLength;
+        SDSegmentLocation location = {segment->_identifier, offset, recordLength, offset + sizeof(SDSegmentRecordHeader) + header.keyLength, header.payloadLength};
+        offset += recordLength;
+
+        if (header.type == SDSegmentRecordTypeTombstone) {
+            // The key may still have an older data record in previous segments, keep the tombstone unless this is the oldest segment
+            SD_LOCK(_lock);
+            BOOL isOldest = YES;
+            for (NSNumber *identifier in _segments) {
+                if (identifier.unsignedIntValue < segment->_identifier) {
+                    isOldest = NO;
+                    break;
+                }
+            }
+            SD_UNLOCK(_lock);
+            if (!isOldest) {
+                [self appendTombstoneForKey:key onlyIfAbsent:YES];
+            }
+            continue;
+        }
+
+        SD_LOCK(_lock);
+        SDSegmentedDiskCacheEntry *entry = _index[key];
+        BOOL moveData = entry && header.type == SDSegmentRecordTypeData && SDSegmentLocationEqual(entry->_data, location);
+        BOOL moveExtendedData = entry && entry->_hasExtendedData && (moveData || (header.type == SDSegmentRecordTypeExtendedData && SDSegmentLocationEqual(entry->_extendedData, location)));
+        SDSegmentLocation dataLocation = entry ? entry->_data : location;
+        SDSegmentLocation extendedDataLocation = entry ? entry->_extendedData : location;
+        NSTimeInterval modificationDate = entry ? entry->_modificationDate : 0;
+        SDSegmentedDiskCacheSegment *extendedDataSegment = moveExtendedData ? _segments[@(extendedDataLocation.segment)] : nil;
+        SD_UNLOCK(_lock);
+
+        // The extended data must be appended after the data, because a data record reset the extended data during replay
+        NSData *data = moveData ? [self readSegment:segment offset:dataLocation.payloadOffset length:dataLocation.payloadLength] : nil;
+        NSData *extendedData = extendedDataSegment ? [self readSegment:extendedDataSegment offset:extendedDataLocation.payloadOffset length:extendedDataLocation.payloadLength] : nil;
+        SDSegmentLocation newDataLocation, newExtendedDataLocation;
+        BOOL dataMoved = data && [self appendRecordWithType:SDSegmentRecordTypeData key:key payload:data timestamp:modificationDate location:&newDataLocation];
+        BOOL extendedDataMoved = extendedData && (!moveData || dataMoved) && [self appendRecordWithType:SDSegmentRecordTypeExtendedData key:key payload:extendedData timestamp:modificationDate location:&newExtendedDataLocation];
+        if (dataMoved != moveData || extendedDataMoved != moveExtendedData) {
+            // A live record failed to read or append, deleting the segment would lose it. Abort and keep the segment, the copies are useless. It stays marked as compacting so it's not retried
+            // 存活的记录读取或追加失败，删除分段会丢失它。中止并保留分段，副本无用。它保持压缩中的标记，因此不会重试
+            SD_LOCK(_lock);
+            if (dataMoved) [self _markDeadLocation:newDataLocation];
+            if (extendedDataMoved) [self _markDeadLocation:newExtendedDataLocation];
+            SD_UNLOCK(_lock);
+            return;
+        }
+        if (!dataMoved && !extendedDataMoved) {
+            continue;
+        }
+
+        SD_LOCK(_lock);
+        SDSegmentedDiskCacheEntry *currentEntry = _index[key];
+        BOOL unchanged = currentEntry == entry && SDSegmentLocationEqual(currentEntry->_data, dataLocation) && (!extendedDataMoved || (currentEntry->_hasExtendedData && SDSegmentLocationEqual(currentEntry->_extendedData, extendedDataLocation)));
+        if (unchanged) {
+            if (dataMoved) {
+                [self _markDeadLocation:currentEntry->_data];
+                currentEntry->_data = newDataLocation;
+            }
+            if (extendedDataMoved) {
+                [self _markDeadLocation:currentEntry->_extendedData];
+                currentEntry->_extendedData = newExtendedDataLocation;
+            }
+        } else {
+            // Modified during compaction, the copies are useless
+            if (dataMoved) [self _markDeadLocation:newDataLocation];
+            if (extendedDataMoved) [self _markDeadLocation:newExtendedDataLocation];
+        }
+        SD_UNLOCK(_lock);
+    }
+
+    SD_LOCK(_lock);
+    BOOL removed = NO;
+    if (_segments[@(segment->_identifier)] == segment && segment != _activeSegment) {
+        [_segments removeObjectForKey:@(segment->_identifier)];
+        removed = YES;
+    }
+    SD_UNLOCK(_lock);
+    if (removed) {
+        unlink(segment->_path.fileSystemRepresentation);
+    }
+}
+
+@end
@@ -273,7 +273,18 @@ typedef NS_OPTIONS(NSUInteger, SDWebImageOptions) {
      * 我们通常不会在矢量图像上应用transform，因为矢量图像支持动态改变到任何大小，栅格化到固定大小会丢失细节。要修改矢量图像，可以在运行时处理矢量数据(例如修改PDF标记/ SVG元素)。
      * 无论如何，使用这个标志来转换它们
      */
-    SDWebImageTransformVectorImage = 1 << 23
+    SDWebImageTransformVectorImage = 1 << 23,
+    
+    /**
+     * By default, the downloaded data is kept in memory until the download finished, then written to the disk cache. For a large image (such as a 20-50 MB panorama), the data is kept by the downloader, the manager and the cache writing at the same time.
+     * Use this flag to write the bytes incrementally into a temporary file inside the disk cache directory, the decoder use a mapped view of the file, and the file is moved into the disk cache by an atomic rename on success. So the peak memory does not depend on the file size.
+     * @note This only works when the original image cache is `SDImageCache` and the data is stored to disk without a cache serializer. Otherwise it falls back to the in-memory download. The progressive loading and the data decryptor are not supported with this flag.
+     *
+     * 默认情况下，下载的数据在下载完成前一直保存在内存中，然后写入硬盘缓存。对于大图片(例如20-50 MB的全景图)，下载器、管理器和缓存写入会同时持有这些数据
+     * 使用此标志将字节增量写入硬盘缓存目录中的临时文件，解码器使用该文件的映射视图，成功后通过原子重命名将文件移入硬盘缓存。因此峰值内存与文件大小无关
+     * @note 只有在原始图像缓存为`SDImageCache`且数据不经过缓存序列化器存储到硬盘时才生效，否则回退到内存下载。使用此标志时不支持渐进式加载和数据解密器
+     */
+    SDWebImageStreamToDiskCache = 1 << 24
 };
 
 
@@ -436,6 +447,27 @@ FOUNDATION_EXPORT SDWebImageContextOption _Nonnull const SDWebImageContextDownlo
  */
 FOUNDATION_EXPORT SDWebImageContextOption _Nonnull const SDWebImageContextDownloadDecryptor;
 
+/**
+ A file path which the downloader writes the response body into incrementally, instead of keeping it in memory. The image data in the completion is read from the file (see `SDWebImageContextDownloadFileMappable`), and the file belongs to the caller after the download succeed (it's removed by the downloader when failed). The manager set this for `SDWebImageStreamToDiskCache`, you don't need to set it manually. (NSString *)
+ 
+ 下载器增量写入响应体的文件路径，而不是将其保存在内存中。完成回调中的图像数据从该文件读取(参见`SDWebImageContextDownloadFileMappable`)，下载成功后文件归调用方所有(失败时由下载器删除)。管理器会为`SDWebImageStreamToDiskCache`设置该值，你不需要手动设置。(NSString *)
+ */
+FOUNDATION_EXPORT SDWebImageContextOption _Nonnull const SDWebImageContextDownloadFilePath;
+
+/**
+ Whether the image data of `SDWebImageContextDownloadFilePath` can be a mapped view of the file. Only set it when the file is never overwritten in place, because the mapped pages of a truncated file crash on access. The manager set this when the disk cache writes atomically (`diskCacheWritingOptions` contains `NSDataWritingAtomic`). Defaults to NO, the file is read into memory. (NSNumber *)
+ 
+ `SDWebImageContextDownloadFilePath`的图像数据是否可以是该文件的映射视图。仅当该文件不会被原地覆盖时设置，因为被截断文件的映射页面在访问时会崩溃。管理器会在硬盘缓存使用原子写入(`diskCacheWritingOptions`包含`NSDataWritingAtomic`)时设置。默认为NO，文件会被读取到内存中。(NSNumber *)
+ */
+FOUNDATION_EXPORT SDWebImageContextOption _Nonnull const SDWebImageContextDownloadFileMappable;
+
+/**
+ The deadline of the download, used by `SDWebImageDownloaderDeadlineExecutionOrder`, the download with the earliest deadline starts first. The value can be a NSDate, or a NSNumber of seconds from now, such as @(0.2) for a cell which becomes visible in 200 ms. The deadline of a queued download can be updated by `-[SDWebImageDownloader setDeadline:forDownloadToken:]` when the viewport moves. If not provided, the download has no deadline and starts after all the downloads with deadline. (NSDate * or NSNumber *)
+ 
+ 下载的截止时间，由`SDWebImageDownloaderDeadlineExecutionOrder`使用，截止时间最早的下载最先开始。值可以是NSDate，也可以是从现在起的秒数NSNumber，例如对于200毫秒后可见的cell使用@(0.2)。视口移动时可以通过`-[SDWebImageDownloader setDeadline:forDownloadToken:]`更新排队中的下载的截止时间。如果不提供，下载没有截止时间，在所有有截止时间的下载之后开始。(NSDate *或NSNumber *)
+ */
+FOUNDATION_EXPORT SDWebImageContextOption _Nonnull const SDWebImageContextDownloadDeadline;
+
 /**
  A id<SDWebImageCacheKeyFilter> instance to convert an URL into a cache key. It's used when manager need cache key to use image cache. If you provide one, it will ignore the `cacheKeyFilter` in manager and use provided one instead. (id<SDWebImageCacheKeyFilter>)
  
@@ -140,5 +140,8 @@ SDWebImageContextOption const SDWebImageContextAnimatedImageClass = @"animatedIm
 SDWebImageContextOption const SDWebImageContextDownloadRequestModifier = @"downloadRequestModifier";
 SDWebImageContextOption const SDWebImageContextDownloadResponseModifier = @"downloadResponseModifier";
 SDWebImageContextOption const SDWebImageContextDownloadDecryptor = @"downloadDecryptor";
+SDWebImageContextOption const SDWebImageContextDownloadFilePath = @"downloadFilePath";
+SDWebImageContextOption const SDWebImageContextDownloadFileMappable = @"downloadFileMappable";
+SDWebImageContextOption const SDWebImageContextDownloadDeadline = @"downloadDeadline";
 SDWebImageContextOption const SDWebImageContextCacheKeyFilter = @"cacheKeyFilter";
 SDWebImageContextOption const SDWebImageContextCacheSerializer = @"cacheSerializer";
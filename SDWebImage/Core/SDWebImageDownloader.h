@@ -11,10 +11,12 @@
 #import "SDWebImageDefine.h"
 #import "SDWebImageOperation.h"
 #import "SDWebImageDownloaderConfig.h"
+#import "SDWebImageDownloaderConcurrencyController.h"
 #import "SDWebImageDownloaderRequestModifier.h"
 #import "SDWebImageDownloaderResponseModifier.h"
 #import "SDWebImageDownloaderDecryptor.h"
 #import "SDImageLoader.h"
+#import "SDImageHeaderProber.h"
 
 /// Downloader options
 /// 下载选项
@@ -118,6 +120,8 @@ typedef NS_OPTIONS(NSUInteger, SDWebImageDownloaderOptions) {
 FOUNDATION_EXPORT NSNotificationName _Nonnull const SDWebImageDownloadStartNotification;
 /// 收到响应通知
 FOUNDATION_EXPORT NSNotificationName _Nonnull const SDWebImageDownloadReceiveResponseNotification;
+/// 解析出图像头部通知，在主队列发送，object为下载操作，可通过其`imageHeaderInfo`获取头部信息
+FOUNDATION_EXPORT NSNotificationName _Nonnull const SDWebImageDownloadReceiveImageHeaderNotification; // posted on the main queue once the image header is parsed, before the whole data is received. The object is the download operation, see its `imageHeaderInfo`
 /// 下载停止通知
 FOUNDATION_EXPORT NSNotificationName _Nonnull const SDWebImageDownloadStopNotification;
 /// 下载完成通知
@@ -164,6 +168,12 @@ typedef SDImageLoaderCompletedBlock SDWebImageDownloaderCompletedBlock;
  */
 @property (nonatomic, strong, nullable, readonly) NSURLSessionTaskMetrics *metrics API_AVAILABLE(macosx(10.12), ios(10.0), watchos(3.0), tvos(10.0));
 
+/**
+ The image header info parsed from the first received bytes, such as the pixel size and format. This will be nil until `SDWebImageDownloadReceiveImageHeaderNotification` is posted, or if download operation does not support header probing.
+ 从最先接收到的字节中解析出的图像头部信息，例如像素尺寸和格式。在`SDWebImageDownloadReceiveImageHeaderNotification`发送之前，或下载操作不支持头部探测时为nil
+ */
+@property (nonatomic, strong, nullable, readonly) SDImageHeaderInfo *imageHeaderInfo;
+
 @end
 
 
@@ -239,6 +249,12 @@ typedef SDImageLoaderCompletedBlock SDWebImageDownloaderCompletedBlock;
  */
 @property (nonatomic, assign, readonly) NSUInteger currentDownloadCount;
 
+/**
+ * The controller which adjusts the concurrent downloads, its properties expose the decisions as metrics. Nil unless `SDWebImageDownloaderConfig.adaptiveConcurrentDownloads` is enabled.
+ * 调整并行下载数的控制器，其属性将决策作为指标公开。除非启用`SDWebImageDownloaderConfig.adaptiveConcurrentDownloads`，否则为nil
+ */
+@property (nonatomic, strong, readonly, nullable) SDWebImageDownloaderConcurrencyController *concurrencyController;
+
 /**
  *  Returns the global shared downloader instance. Which use the `SDWebImageDownloaderConfig.defaultDownloaderConfig` config.
  *  返回全局共享下载器实例。使用“SDWebImageDownloaderConfig.defaultDownloaderConfig”配置
@@ -357,6 +373,15 @@ typedef SDImageLoaderCompletedBlock SDWebImageDownloaderCompletedBlock;
  */
 - (void)cancelAllDownloads;
 
+/**
+ * Update the deadline of a waiting download, only used for `SDWebImageDownloaderDeadlineExecutionOrder`. You can call it for the visible cells each time the viewport moves. The download which already started is not affected. The deadline is stored for each token, and a download shared by several tokens waits until the earliest deadline of the tokens which are not cancelled, so it can move both earlier and later.
+ * 更新等待中的下载的截止时间，仅用于`SDWebImageDownloaderDeadlineExecutionOrder`。可以在每次视口移动时为可见的cell调用。已经开始的下载不受影响。截止时间按token保存，被多个token共享的下载使用未取消的token中最早的截止时间，因此可以提前也可以推后
+ *
+ * @param deadline The new deadline of this token, nil removes the deadline of this token 此token新的截止时间，nil删除此token的截止时间
+ * @param token The token received from `-downloadImageWithURL:options:context:progress:completed:` 从下载方法获得的token
+ */
+- (void)setDeadline:(nullable NSDate *)deadline forDownloadToken:(nonnull SDWebImageDownloadToken *)token;
+
 /**
  * Invalidates the managed session, optionally canceling pending operations.
  * 使管理会话失效，可选地取消挂起的操作。
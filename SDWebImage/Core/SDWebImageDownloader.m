@@ -11,15 +11,29 @@
 #import "SDWebImageDownloaderOperation.h"
 #import "SDWebImageError.h"
 #import "SDInternalMacros.h"
+#import "SDWebImageDownloaderDeadlineQueue.h"
 
 /// 通知名常量
 NSNotificationName const SDWebImageDownloadStartNotification = @"SDWebImageDownloadStartNotification";
 NSNotificationName const SDWebImageDownloadReceiveResponseNotification = @"SDWebImageDownloadReceiveResponseNotification";
+NSNotificationName const SDWebImageDownloadReceiveImageHeaderNotification = @"SDWebImageDownloadReceiveImageHeaderNotification";
 NSNotificationName const SDWebImageDownloadStopNotification = @"SDWebImageDownloadStopNotification";
 NSNotificationName const SDWebImageDownloadFinishNotification = @"SDWebImageDownloadFinishNotification";
 
 static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 
+// The absolute deadline from `SDWebImageContextDownloadDeadline`, INFINITY means no deadline
+// 从`SDWebImageContextDownloadDeadline`获取绝对截止时间，INFINITY表示没有截止时间
+static CFAbsoluteTime SDWebImageDownloaderDeadlineFromContext(SDWebImageContext *context) {
+    id deadline = context[SDWebImageContextDownloadDeadline];
+    if ([deadline isKindOfClass:[NSDate class]]) {
+        return ((NSDate *)deadline).timeIntervalSinceReferenceDate;
+    } else if ([deadline isKindOfClass:[NSNumber class]]) {
+        return CFAbsoluteTimeGetCurrent() + ((NSNumber *)deadline).doubleValue;
+    }
+    return INFINITY;
+}
+
 @interface SDWebImageDownloadToken ()
 /// 图片url
 @property (nonatomic, strong, nullable, readwrite) NSURL *url;
@@ -29,10 +43,14 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 @property (nonatomic, strong, nullable, readwrite) NSURLResponse *response;
 /// 会话任务度量
 @property (nonatomic, strong, nullable, readwrite) NSURLSessionTaskMetrics *metrics API_AVAILABLE(macosx(10.12), ios(10.0), watchos(3.0), tvos(10.0));
+/// 图像头部信息
+@property (nonatomic, strong, nullable, readwrite) SDImageHeaderInfo *imageHeaderInfo;
 /// 下载操作取消标志
 @property (nonatomic, weak, nullable, readwrite) id downloadOperationCancelToken;
 /// 下载操作
 @property (nonatomic, weak, nullable) NSOperation<SDWebImageDownloaderOperation> *downloadOperation;
+/// 下载器，用于取消时移除等待中的下载
+@property (nonatomic, weak, nullable) SDWebImageDownloader *downloader; // the downloader, to remove the waiting download when cancelled
 /// 取消标识
 @property (nonatomic, assign, getter=isCancelled) BOOL cancelled;
 
@@ -49,11 +67,28 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 @property (strong, nonatomic, nonnull) NSMutableDictionary<NSURL *, NSOperation<SDWebImageDownloaderOperation> *> *URLOperations;
 /// HTTP请求头
 @property (strong, nonatomic, nullable) NSMutableDictionary<NSString *, NSString *> *HTTPHeaders;
+/// 任务标识 -> 下载操作的索引
+@property (strong, nonatomic, nonnull) NSMapTable<NSNumber *, NSOperation<SDWebImageDownloaderOperation> *> *taskOperations;
+/// 主机 -> 持有该主机下载名额的操作，按添加顺序排列
+@property (strong, nonatomic, nonnull) NSMutableDictionary<NSString *, NSMutableArray<NSOperation *> *> *hostOperations; // host -> the operations holding the download slots of that host, in the adding order
+/// 主机 -> 等待该主机下载名额的操作，先进先出
+@property (strong, nonatomic, nonnull) NSMutableDictionary<NSString *, NSMutableArray<NSOperation *> *> *hostWaitingOperations; // host -> the operations waiting for a download slot of that host, in FIFO order
+/// 等待中的操作，按截止时间排序
+@property (strong, nonatomic, nonnull) SDWebImageDownloaderDeadlineQueue *deadlineQueue; // the waiting operations for `SDWebImageDownloaderDeadlineExecutionOrder`
+/// 已从截止时间队列进入下载队列且尚未完成的操作
+@property (strong, nonatomic, nonnull) NSMutableSet<NSOperation *> *deadlineAdmittedOperations; // the operations moved from `deadlineQueue` into `downloadQueue` and not finished yet
+/// 等待中的操作 -> 每个token的截止时间
+@property (strong, nonatomic, nonnull) NSMapTable<NSOperation *, NSMapTable<id, NSNumber *> *> *tokenDeadlines; // the waiting operation -> the deadline of each live token, keyed by the cancel token of the operation
 
 // The session in which data tasks will run
 // 将要执行的数据任务会话
 @property (strong, nonatomic) NSURLSession *session;
 
+/// 等待中的下载被取消
+- (void)waitingOperationDidCancel:(nonnull NSOperation *)operation url:(nullable NSURL *)url;
+/// 共享下载的一个token被取消
+- (void)waitingOperation:(nonnull NSOperation *)operation didCancelToken:(nonnull id)cancelToken;
+
 @end
 
 @implementation SDWebImageDownloader {
@@ -61,6 +96,12 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
     SD_LOCK_DECLARE(_HTTPHeadersLock); // A lock to keep the access to `HTTPHeaders` thread-safe
     /// URLOperations 线程安全锁
     SD_LOCK_DECLARE(_operationsLock); // A lock to keep the access to `URLOperations` thread-safe
+    /// taskOperations 线程安全锁
+    SD_LOCK_DECLARE(_taskOperationsLock); // A lock to keep the access to `taskOperations` thread-safe
+    /// hostOperations 线程安全锁
+    SD_LOCK_DECLARE(_hostOperationsLock); // A lock to keep the access to `hostOperations` and `hostWaitingOperations` thread-safe
+    /// deadlineQueue 线程安全锁
+    SD_LOCK_DECLARE(_deadlineLock); // A lock to keep the access to `deadlineQueue`, `deadlineAdmittedOperations` and `tokenDeadlines` thread-safe
 }
 
 /// 初始化
@@ -110,8 +151,18 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         [_config addObserver:self forKeyPath:NSStringFromSelector(@selector(maxConcurrentDownloads)) options:0 context:SDWebImageDownloaderContext];
         _downloadQueue = [NSOperationQueue new];
         _downloadQueue.maxConcurrentOperationCount = _config.maxConcurrentDownloads;
+        if (_config.adaptiveConcurrentDownloads) {
+            _concurrencyController = [[SDWebImageDownloaderConcurrencyController alloc] initWithMinimumConcurrency:_config.minConcurrentDownloads maximumConcurrency:_config.maxConcurrentDownloads initialConcurrency:_config.minConcurrentDownloads];
+            _downloadQueue.maxConcurrentOperationCount = _concurrencyController.concurrency;
+        }
         _downloadQueue.name = @"com.hackemist.SDWebImageDownloader";
         _URLOperations = [NSMutableDictionary new];
+        _taskOperations = [NSMapTable strongToWeakObjectsMapTable];
+        _hostOperations = [NSMutableDictionary new];
+        _hostWaitingOperations = [NSMutableDictionary new];
+        _deadlineQueue = [SDWebImageDownloaderDeadlineQueue new];
+        _deadlineAdmittedOperations = [NSMutableSet new];
+        _tokenDeadlines = [NSMapTable strongToStrongObjectsMapTable];
         NSMutableDictionary<NSString *, NSString *> *headerDictionary = [NSMutableDictionary dictionary];
         NSString *userAgent = nil;
 #if SD_UIKIT
@@ -136,6 +187,9 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         _HTTPHeaders = headerDictionary;
         SD_LOCK_INIT(_HTTPHeadersLock);
         SD_LOCK_INIT(_operationsLock);
+        SD_LOCK_INIT(_taskOperationsLock);
+        SD_LOCK_INIT(_hostOperationsLock);
+        SD_LOCK_INIT(_deadlineLock);
         NSURLSessionConfiguration *sessionConfiguration = _config.sessionConfiguration;
         if (!sessionConfiguration) {
             sessionConfiguration = [NSURLSessionConfiguration defaultSessionConfiguration];
@@ -239,14 +293,20 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
             return nil;
         }
         @weakify(self);
+        @weakify(operation);
         operation.completionBlock = ^{
             @strongify(self);
+            @strongify(operation);
             if (!self) {
                 return;
             }
             SD_LOCK(self->_operationsLock);
             [self.URLOperations removeObjectForKey:url];
             SD_UNLOCK(self->_operationsLock);
+            if (operation) {
+                [self releaseHostSlotForOperation:operation url:url];
+                [self deadlineOperationDidFinish:operation];
+            }
         };
         self.URLOperations[url] = operation;
         // Add the handlers before submitting to operation queue, avoid the race condition that operation finished before setting handlers.
@@ -256,7 +316,16 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         // `addOperation:` does not synchronously execute the `operation.completionBlock` so this will not cause deadlock.
         /// 根据苹果文档完成所有配置后，才能将操作添加到操作队列中。
         /// ' addOperation: '不会同步执行' operation.completionBlock '，所以不会导致死锁
-        [self.downloadQueue addOperation:operation];
+        if (self.config.executionOrder == SDWebImageDownloaderDeadlineExecutionOrder) {
+            // Wait in deadline queue, it's moved into the download queue outside the lock
+            SD_LOCK(_deadlineLock);
+            [self.deadlineQueue addOperation:operation deadline:INFINITY];
+            [self setDeadline:SDWebImageDownloaderDeadlineFromContext(context) forOperation:operation cancelToken:downloadOperationCancelToken];
+            SD_UNLOCK(_deadlineLock);
+        } else if ([self acquireHostSlotForOperation:operation url:url]) {
+            // Else wait for a download slot of the host, it's moved into the download queue when any slot of that host is released
+            [self.downloadQueue addOperation:operation];
+        }
     } else {
         // When we reuse the download operation to attach more callbacks, there may be thread safe issue because the getter of callbacks may in another queue (decoding queue or delegate queue)
         // So we lock the operation here, and in `SDWebImageDownloaderOperation`, we use `@synchonzied (self)`, to ensure the thread safe between these two classes.
@@ -265,6 +334,12 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         @synchronized (operation) {
             downloadOperationCancelToken = [operation addHandlersForProgress:progressBlock completed:completedBlock];
         }
+        if (self.config.executionOrder == SDWebImageDownloaderDeadlineExecutionOrder && context[SDWebImageContextDownloadDeadline]) {
+            // The shared download use the earliest deadline of its tokens
+            SD_LOCK(_deadlineLock);
+            [self setDeadline:SDWebImageDownloaderDeadlineFromContext(context) forOperation:operation cancelToken:downloadOperationCancelToken];
+            SD_UNLOCK(_deadlineLock);
+        }
         if (!operation.isExecuting) {
             if (options & SDWebImageDownloaderHighPriority) {
                 operation.queuePriority = NSOperationQueuePriorityHigh;
@@ -276,11 +351,13 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         }
     }
     SD_UNLOCK(_operationsLock);
+    [self admitDeadlineOperations];
     /// 实例化token
     SDWebImageDownloadToken *token = [[SDWebImageDownloadToken alloc] initWithDownloadOperation:operation];
     token.url = url;
     token.request = operation.request;
     token.downloadOperationCancelToken = downloadOperationCancelToken;
+    token.downloader = self;
     
     return token;
 }
@@ -384,6 +461,10 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         operation.minimumProgressInterval = MIN(MAX(self.config.minimumProgressInterval, 0), 1);
     }
     
+    if ([operation respondsToSelector:@selector(setProgressiveFrameBudget:)]) {
+        operation.progressiveFrameBudget = self.config.progressiveFrameBudget;
+    }
+    
     if ([operation respondsToSelector:@selector(setAcceptableStatusCodes:)]) {
         operation.acceptableStatusCodes = self.config.acceptableStatusCodes;
     }
@@ -392,6 +473,14 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
         operation.acceptableContentTypes = self.config.acceptableContentTypes;
     }
     
+    if ([operation respondsToSelector:@selector(setAbortsUndecodableDownloads:)]) {
+        operation.abortsUndecodableDownloads = self.config.abortsUndecodableDownloads;
+    }
+    
+    if ([operation respondsToSelector:@selector(setMaxDownloadPixelCount:)]) {
+        operation.maxDownloadPixelCount = self.config.maxDownloadPixelCount;
+    }
+    
     if (options & SDWebImageDownloaderHighPriority) {
         operation.queuePriority = NSOperationQueuePriorityHigh;
     } else if (options & SDWebImageDownloaderLowPriority) {
@@ -417,6 +506,91 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 - (void)cancelAllDownloads {
     /// 取消所有下载
     [self.downloadQueue cancelAllOperations];
+    SD_LOCK(_deadlineLock);
+    NSArray<NSOperation *> *waitingOperations = [self.deadlineQueue removeAllOperations];
+    [self.tokenDeadlines removeAllObjects];
+    SD_UNLOCK(_deadlineLock);
+    [self cancelWaitingOperations:waitingOperations];
+    NSMutableArray<NSOperation *> *hostWaitingOperations = [NSMutableArray array];
+    SD_LOCK(_hostOperationsLock);
+    for (NSMutableArray<NSOperation *> *operations in self.hostWaitingOperations.allValues) {
+        [hostWaitingOperations addObjectsFromArray:operations];
+    }
+    [self.hostWaitingOperations removeAllObjects];
+    SD_UNLOCK(_hostOperationsLock);
+    [self cancelWaitingOperations:hostWaitingOperations];
+}
+
+- (void)setDeadline:(NSDate *)deadline forDownloadToken:(SDWebImageDownloadToken *)token {
+    NSOperation<SDWebImageDownloaderOperation> *operation = token.downloadOperation;
+    id cancelToken = token.downloadOperationCancelToken;
+    if (!operation || !cancelToken) {
+        return;
+    }
+    CFAbsoluteTime absoluteDeadline = deadline ? deadline.timeIntervalSinceReferenceDate : INFINITY;
+    SD_LOCK(_deadlineLock);
+    [self setDeadline:absoluteDeadline forOperation:operation cancelToken:cancelToken];
+    SD_UNLOCK(_deadlineLock);
+}
+
+// Store the deadline of one token, and move the waiting operation to the earliest deadline of its live tokens. INFINITY removes the entry of that token. Call with `_deadlineLock` held
+/// 保存一个token的截止时间，并将等待中的操作移到其存活token中最早的截止时间。INFINITY删除该token的条目。调用时需持有`_deadlineLock`
+- (void)setDeadline:(CFAbsoluteTime)deadline forOperation:(NSOperation *)operation cancelToken:(nullable id)cancelToken {
+    if (isnan([self.deadlineQueue deadlineForOperation:operation])) {
+        // Already started, the deadline does not matter any more
+        [self.tokenDeadlines removeObjectForKey:operation];
+        return;
+    }
+    NSMapTable<id, NSNumber *> *deadlines = [self.tokenDeadlines objectForKey:operation];
+    if (!deadlines) {
+        deadlines = [NSMapTable mapTableWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory];
+        [self.tokenDeadlines setObject:deadlines forKey:operation];
+    }
+    // The custom operation may not return a cancel token
+    id key = cancelToken ?: operation;
+    if (isinf(deadline)) {
+        [deadlines removeObjectForKey:key];
+    } else {
+        [deadlines setObject:@(deadline) forKey:key];
+    }
+    CFAbsoluteTime earliestDeadline = INFINITY;
+    for (NSNumber *tokenDeadline in deadlines.objectEnumerator) {
+        earliestDeadline = MIN(earliestDeadline, tokenDeadline.doubleValue);
+    }
+    [self.deadlineQueue updateDeadline:earliestDeadline forOperation:operation];
+}
+
+- (void)waitingOperation:(NSOperation *)operation didCancelToken:(id)cancelToken {
+    SD_LOCK(_deadlineLock);
+    if ([self.tokenDeadlines objectForKey:operation]) {
+        [self setDeadline:INFINITY forOperation:operation cancelToken:cancelToken];
+    }
+    SD_UNLOCK(_deadlineLock);
+}
+
+// The cancelled download which is still waiting never start by itself, remove it from the waiting queues and move it into download queue to finish
+/// 仍在等待中的已取消下载永远不会自行开始，将其从等待队列中移除并移入下载队列以完成
+- (void)waitingOperationDidCancel:(NSOperation *)operation url:(NSURL *)url {
+    SD_LOCK(_deadlineLock);
+    BOOL removed = [self.deadlineQueue removeOperation:operation];
+    [self.tokenDeadlines removeObjectForKey:operation];
+    SD_UNLOCK(_deadlineLock);
+    if (!removed) {
+        NSString *host = url.host.lowercaseString;
+        if (host) {
+            SD_LOCK(_hostOperationsLock);
+            NSMutableArray<NSOperation *> *waitingOperations = self.hostWaitingOperations[host];
+            removed = [waitingOperations indexOfObjectIdenticalTo:operation] != NSNotFound;
+            [waitingOperations removeObjectIdenticalTo:operation];
+            if (waitingOperations && waitingOperations.count == 0) {
+                [self.hostWaitingOperations removeObjectForKey:host];
+            }
+            SD_UNLOCK(_hostOperationsLock);
+        }
+    }
+    if (removed) {
+        [self.downloadQueue addOperation:operation];
+    }
 }
 
 #pragma mark - Properties
@@ -430,7 +604,15 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 }
 
 - (NSUInteger)currentDownloadCount {
-    return self.downloadQueue.operationCount;
+    SD_LOCK(_deadlineLock);
+    NSUInteger waitingCount = self.deadlineQueue.count;
+    SD_UNLOCK(_deadlineLock);
+    SD_LOCK(_hostOperationsLock);
+    for (NSMutableArray<NSOperation *> *operations in self.hostWaitingOperations.allValues) {
+        waitingCount += operations.count;
+    }
+    SD_UNLOCK(_hostOperationsLock);
+    return self.downloadQueue.operationCount + waitingCount;
 }
 
 - (NSURLSessionConfiguration *)sessionConfiguration {
@@ -442,7 +624,14 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 - (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)object change:(NSDictionary<NSKeyValueChangeKey,id> *)change context:(void *)context {
     if (context == SDWebImageDownloaderContext) {
         if ([keyPath isEqualToString:NSStringFromSelector(@selector(maxConcurrentDownloads))]) {
-            self.downloadQueue.maxConcurrentOperationCount = self.config.maxConcurrentDownloads;
+            if (self.concurrencyController) {
+                // The upper bound of the adaptive concurrency
+                self.concurrencyController.maximumConcurrency = self.config.maxConcurrentDownloads;
+                self.downloadQueue.maxConcurrentOperationCount = self.concurrencyController.concurrency;
+            } else {
+                self.downloadQueue.maxConcurrentOperationCount = self.config.maxConcurrentDownloads;
+            }
+            [self admitDeadlineOperations];
         }
     } else {
         [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
@@ -451,8 +640,186 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
 
 #pragma mark Helper methods
 
+// Move the waiting operations with the earliest deadline into download queue, until the download queue is full. So the download queue never queues, and the deadline of the waiting operations can be updated until they start.
+/// 将截止时间最早的等待中的操作移入下载队列，直到下载队列已满。因此下载队列本身从不排队，等待中的操作在开始前都可以更新截止时间
+- (void)admitDeadlineOperations {
+    if (self.config.executionOrder != SDWebImageDownloaderDeadlineExecutionOrder) {
+        return;
+    }
+    NSMutableArray<NSOperation *> *admittedOperations = [NSMutableArray array];
+    NSMutableArray<NSOperation *> *expiredOperations = [NSMutableArray array];
+    NSInteger maxConcurrentOperationCount = self.downloadQueue.maxConcurrentOperationCount;
+    BOOL shouldDropExpiredDownloads = self.config.shouldDropExpiredDownloads;
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    SD_LOCK(_deadlineLock);
+    while (self.deadlineQueue.count > 0 && (maxConcurrentOperationCount < 0 || self.deadlineAdmittedOperations.count < (NSUInteger)maxConcurrentOperationCount)) {
+        CFAbsoluteTime deadline;
+        NSOperation *operation = [self.deadlineQueue popOperationWithDeadline:&deadline];
+        [self.tokenDeadlines removeObjectForKey:operation];
+        if (shouldDropExpiredDownloads && deadline < now) {
+            [expiredOperations addObject:operation];
+            continue;
+        }
+        [self.deadlineAdmittedOperations addObject:operation];
+        [admittedOperations addObject:operation];
+    }
+    SD_UNLOCK(_deadlineLock);
+    [self cancelWaitingOperations:expiredOperations];
+    for (NSOperation *operation in admittedOperations) {
+        [self.downloadQueue addOperation:operation];
+    }
+}
+
+- (void)deadlineOperationDidFinish:(NSOperation *)operation {
+    if (self.config.executionOrder != SDWebImageDownloaderDeadlineExecutionOrder) {
+        return;
+    }
+    SD_LOCK(_deadlineLock);
+    [self.deadlineAdmittedOperations removeObject:operation];
+    SD_UNLOCK(_deadlineLock);
+    [self admitDeadlineOperations];
+}
+
+// The cancelled operation still need to be started by download queue, which mark it finished and clean up
+/// 取消的操作仍需要由下载队列启动，以将其标记为完成并清理
+- (void)cancelWaitingOperations:(NSArray<NSOperation *> *)operations {
+    for (NSOperation *operation in operations) {
+        [operation cancel];
+        [self.downloadQueue addOperation:operation];
+    }
+}
+
+- (NSInteger)maxConcurrentDownloadsForHost:(NSString *)host {
+    NSNumber *hostLimit = self.config.maxConcurrentDownloadsForHosts[host];
+    if (hostLimit) {
+        return hostLimit.integerValue;
+    }
+    return self.config.maxConcurrentDownloadsPerHost;
+}
+
+// Each operation of the host holds one slot. When the host is full, the new operation waits in the FIFO of the host outside the download queue, and the first waiting one is moved into the download queue when any slot of that host is released. So at most `limit` operations of the host are in the download queue at the same time, the waiting ones do not take the download queue slots from the other hosts, and one slow download does not block the others behind it. Only for `SDWebImageDownloaderFIFOExecutionOrder`.
+/// 主机的每个操作持有一个名额。主机已满时，新操作在下载队列之外的该主机先进先出队列中等待，当该主机的任一名额释放时，第一个等待的操作被移入下载队列。因此该主机同时最多只有`limit`个操作在下载队列中，等待中的操作不会占用其他主机在下载队列中的名额，一个慢的下载也不会阻塞排在它后面的下载。仅用于`SDWebImageDownloaderFIFOExecutionOrder`
+- (BOOL)acquireHostSlotForOperation:(NSOperation *)operation url:(NSURL *)url {
+    if (self.config.executionOrder != SDWebImageDownloaderFIFOExecutionOrder) {
+        return YES;
+    }
+    NSString *host = url.host.lowercaseString;
+    if (!host) {
+        return YES;
+    }
+    NSInteger limit = [self maxConcurrentDownloadsForHost:host];
+    if (limit <= 0) {
+        return YES;
+    }
+    SD_LOCK(_hostOperationsLock);
+    NSMutableArray<NSOperation *> *operations = self.hostOperations[host];
+    if (!operations) {
+        operations = [NSMutableArray array];
+        self.hostOperations[host] = operations;
+    }
+    BOOL acquired = operations.count < (NSUInteger)limit;
+    if (acquired) {
+        [operations addObject:operation];
+    } else {
+        NSMutableArray<NSOperation *> *waitingOperations = self.hostWaitingOperations[host];
+        if (!waitingOperations) {
+            waitingOperations = [NSMutableArray array];
+            self.hostWaitingOperations[host] = waitingOperations;
+        }
+        [waitingOperations addObject:operation];
+    }
+    SD_UNLOCK(_hostOperationsLock);
+    return acquired;
+}
+
+- (void)releaseHostSlotForOperation:(NSOperation *)operation url:(NSURL *)url {
+    NSString *host = url.host.lowercaseString;
+    if (!host) {
+        return;
+    }
+    NSInteger limit = [self maxConcurrentDownloadsForHost:host];
+    NSMutableArray<NSOperation *> *admittedOperations = [NSMutableArray array];
+    SD_LOCK(_hostOperationsLock);
+    NSMutableArray<NSOperation *> *operations = self.hostOperations[host];
+    NSMutableArray<NSOperation *> *waitingOperations = self.hostWaitingOperations[host];
+    [operations removeObjectIdenticalTo:operation];
+    [waitingOperations removeObjectIdenticalTo:operation];
+    // Hand the free slots to the waiting operations in FIFO order, the cancelled ones only need to be started to finish, and do not take a slot
+    while (waitingOperations.count > 0 && (limit <= 0 || operations.count < (NSUInteger)limit)) {
+        NSOperation *waitingOperation = waitingOperations.firstObject;
+        [waitingOperations removeObjectAtIndex:0];
+        if (!waitingOperation.isCancelled) {
+            if (!operations) {
+                operations = [NSMutableArray array];
+                self.hostOperations[host] = operations;
+            }
+            [operations addObject:waitingOperation];
+        }
+        [admittedOperations addObject:waitingOperation];
+    }
+    if (operations && operations.count == 0) {
+        [self.hostOperations removeObjectForKey:host];
+    }
+    if (waitingOperations && waitingOperations.count == 0) {
+        [self.hostWaitingOperations removeObjectForKey:host];
+    }
+    SD_UNLOCK(_hostOperationsLock);
+    for (NSOperation *admittedOperation in admittedOperations) {
+        [self.downloadQueue addOperation:admittedOperation];
+    }
+}
+
+// Feed the finished task into the concurrency controller, and apply the new concurrency
+/// 将完成的任务提供给并发控制器，并应用新的并发数
+- (void)recordConcurrencySampleWithTask:(NSURLSessionTask *)task operation:(NSOperation<SDWebImageDownloaderOperation> *)operation error:(NSError *)error {
+    SDWebImageDownloaderConcurrencyController *concurrencyController = self.concurrencyController;
+    if (!concurrencyController) {
+        return;
+    }
+    if (@available(iOS 10.0, tvOS 10.0, macOS 10.12, watchOS 3.0, *)) {
+        // The metrics is delivered before the completion
+        if (![operation respondsToSelector:@selector(metrics)]) {
+            return;
+        }
+        NSURLSessionTaskMetrics *metrics = operation.metrics;
+        NSDate *startDate = metrics.taskInterval.startDate;
+        if (!startDate) {
+            return;
+        }
+        NSInteger statusCode = [task.response isKindOfClass:NSHTTPURLResponse.class] ? ((NSHTTPURLResponse *)task.response).statusCode : 0;
+        // The server is overloaded, the operation cancel the task for these status codes
+        BOOL failed = statusCode >= 500 || statusCode == 429;
+        if (!failed && error) {
+            if ([error.domain isEqualToString:NSURLErrorDomain] && error.code == NSURLErrorCancelled) {
+                // Cancelled by user or by the response validation, say nothing about the link
+                return;
+            }
+            failed = YES;
+        }
+        NSDate *firstByteDate = metrics.transactionMetrics.lastObject.responseStartDate;
+        NSDate *endDate = metrics.taskInterval.endDate ?: [NSDate date];
+        NSInteger concurrency = [concurrencyController recordDownloadWithReceivedBytes:task.countOfBytesReceived
+                                                                             startTime:startDate.timeIntervalSinceReferenceDate
+                                                                         firstByteTime:firstByteDate.timeIntervalSinceReferenceDate
+                                                                               endTime:endDate.timeIntervalSinceReferenceDate
+                                                                                failed:failed];
+        if (self.downloadQueue.maxConcurrentOperationCount != concurrency) {
+            self.downloadQueue.maxConcurrentOperationCount = concurrency;
+            [self admitDeadlineOperations];
+        }
+    }
+}
+
 - (NSOperation<SDWebImageDownloaderOperation> *)operationWithTask:(NSURLSessionTask *)task {
-    NSOperation<SDWebImageDownloaderOperation> *returnOperation = nil;
+    // Every delegate callback (each received chunk) comes here, so look up the index first, only the first callback of a task scan the queue
+    /// 每个代理回调(每个收到的数据块)都会调用这里，因此先查找索引，只有任务的第一个回调才会扫描队列
+    NSNumber *taskIdentifier = @(task.taskIdentifier);
+    SD_LOCK(_taskOperationsLock);
+    NSOperation<SDWebImageDownloaderOperation> *returnOperation = [self.taskOperations objectForKey:taskIdentifier];
+    SD_UNLOCK(_taskOperationsLock);
+    if (returnOperation) {
+        return returnOperation;
+    }
     for (NSOperation<SDWebImageDownloaderOperation> *operation in self.downloadQueue.operations) {
         if ([operation respondsToSelector:@selector(dataTask)]) {
             // So we lock the operation here, and in `SDWebImageDownloaderOperation`, we use `@synchonzied (self)`, to ensure the thread safe between these two classes.
@@ -467,9 +834,20 @@ static void * SDWebImageDownloaderContext = &SDWebImageDownloaderContext;
             }
         }
     }
+    if (returnOperation) {
+        SD_LOCK(_taskOperationsLock);
+        [self.taskOperations setObject:returnOperation forKey:taskIdentifier];
+        SD_UNLOCK(_taskOperationsLock);
+    }
     return returnOperation;
 }
 
+- (void)removeOperationForTask:(NSURLSessionTask *)task {
+    SD_LOCK(_taskOperationsLock);
+    [self.taskOperations removeObjectForKey:@(task.taskIdentifier)];
+    SD_UNLOCK(_taskOperationsLock);
+}
+
 #pragma mark NSURLSessionDataDelegate
 
 - (void)URLSession:(NSURLSession *)session
@@ -520,6 +898,10 @@ didReceiveResponse:(NSURLResponse *)response
     
     // Identify the operation that runs this task and pass it the delegate method
     NSOperation<SDWebImageDownloaderOperation> *dataOperation = [self operationWithTask:task];
+    // This is the last callback of the task
+    /// 这是任务的最后一个回调
+    [self removeOperationForTask:task];
+    [self recordConcurrencySampleWithTask:task operation:dataOperation error:error];
     if ([dataOperation respondsToSelector:@selector(URLSession:task:didCompleteWithError:)]) {
         [dataOperation URLSession:session task:task didCompleteWithError:error];
     }
@@ -567,6 +949,7 @@ didReceiveResponse:(NSURLResponse *)response
 /// 删除通知
 - (void)dealloc {
     [[NSNotificationCenter defaultCenter] removeObserver:self name:SDWebImageDownloadReceiveResponseNotification object:nil];
+    [[NSNotificationCenter defaultCenter] removeObserver:self name:SDWebImageDownloadReceiveImageHeaderNotification object:nil];
     [[NSNotificationCenter defaultCenter] removeObserver:self name:SDWebImageDownloadStopNotification object:nil];
 }
 /// 初始化
@@ -575,7 +958,12 @@ didReceiveResponse:(NSURLResponse *)response
     if (self) {
         _downloadOperation = downloadOperation;
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(downloadDidReceiveResponse:) name:SDWebImageDownloadReceiveResponseNotification object:downloadOperation];
+        [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(downloadDidReceiveImageHeader:) name:SDWebImageDownloadReceiveImageHeaderNotification object:downloadOperation];
         [[NSNotificationCenter defaultCenter] addObserver:self selector:@selector(downloadDidStop:) name:SDWebImageDownloadStopNotification object:downloadOperation];
+        // The shared download operation may already parse the header
+        if ([downloadOperation respondsToSelector:@selector(imageHeaderInfo)]) {
+            _imageHeaderInfo = downloadOperation.imageHeaderInfo;
+        }
     }
     return self;
 }
@@ -586,6 +974,15 @@ didReceiveResponse:(NSURLResponse *)response
         self.response = downloadOperation.response;
     }
 }
+/// 解析出图像头部
+- (void)downloadDidReceiveImageHeader:(NSNotification *)notification {
+    NSOperation<SDWebImageDownloaderOperation> *downloadOperation = notification.object;
+    if (downloadOperation && downloadOperation == self.downloadOperation) {
+        if ([downloadOperation respondsToSelector:@selector(imageHeaderInfo)]) {
+            self.imageHeaderInfo = downloadOperation.imageHeaderInfo;
+        }
+    }
+}
 /// 下载停止
 - (void)downloadDidStop:(NSNotification *)notification {
     NSOperation<SDWebImageDownloaderOperation> *downloadOperation = notification.object;
@@ -599,14 +996,25 @@ didReceiveResponse:(NSURLResponse *)response
 }
 /// 取消
 - (void)cancel {
+    NSOperation<SDWebImageDownloaderOperation> *downloadOperation;
+    id cancelToken;
     @synchronized (self) {
         if (self.isCancelled) {
             return;
         }
         self.cancelled = YES;
-        [self.downloadOperation cancel:self.downloadOperationCancelToken];
+        downloadOperation = self.downloadOperation;
+        cancelToken = self.downloadOperationCancelToken;
+        [downloadOperation cancel:cancelToken];
         self.downloadOperationCancelToken = nil;
     }
+    if (downloadOperation.isCancelled) {
+        // The last token of the download is cancelled, don't leave it in the waiting queue
+        [self.downloader waitingOperationDidCancel:downloadOperation url:self.url];
+    } else if (downloadOperation && cancelToken) {
+        // The other tokens keep the download, which no longer follows the deadline of this one
+        [self.downloader waitingOperation:downloadOperation didCancelToken:cancelToken];
+    }
 }
 
 @end
@@ -661,7 +1069,8 @@ didReceiveResponse:(NSURLResponse *)response
     // Filter the error domain and check error codes
     if ([error.domain isEqualToString:SDWebImageErrorDomain]) {
         shouldBlockFailedURL = (   error.code == SDWebImageErrorInvalidURL
-                                || error.code == SDWebImageErrorBadImageData);
+                                || error.code == SDWebImageErrorBadImageData
+                                || error.code == SDWebImageErrorUndecodableDownloadData);
     } else if ([error.domain isEqualToString:NSURLErrorDomain]) {
         shouldBlockFailedURL = (   error.code != NSURLErrorNotConnectedToInternet
                                 && error.code != NSURLErrorCancelled
@@ -0,0 +1,129 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/// The decision made by the concurrency controller at the end of a sample window
+/// 并发控制器在采样窗口结束时做出的决策
+typedef NS_ENUM(NSInteger, SDWebImageDownloaderConcurrencyDecision) {
+    /// No window finished yet
+    /// 尚未完成任何采样窗口
+    SDWebImageDownloaderConcurrencyDecisionNone = 0,
+    /// The throughput did not drop, increase the concurrency by 1
+    /// 吞吐量没有下降，并发数加1
+    SDWebImageDownloaderConcurrencyDecisionIncrease,
+    /// The error rate or the time to first byte is too high, decrease the concurrency multiplicatively
+    /// 错误率或首字节时间过高，按比例降低并发数
+    SDWebImageDownloaderConcurrencyDecisionDecrease,
+    /// The throughput dropped after the last increase, keep the concurrency
+    /// 上次增加后吞吐量下降，保持并发数
+    SDWebImageDownloaderConcurrencyDecisionHold
+};
+
+/**
+ An AIMD (additive increase, multiplicative decrease) controller for the download concurrency. The completed downloads are grouped into sample windows of `concurrency` downloads. At the end of each window, the concurrency is decreased multiplicatively when the error rate exceeds `errorRateThreshold` or the mean time to first byte exceeds `latencyTolerance` times the lowest one observed (the requests are queued by the server or the link). Otherwise it's increased by 1 as long as the window throughput does not drop compared with the previous window, so it stops growing once the link is saturated.
+ The controller is driven by `SDWebImageDownloader` when `SDWebImageDownloaderConfig.adaptiveConcurrentDownloads` is enabled, and the properties below expose its decisions as metrics. It's thread-safe.
+ 下载并发数的AIMD(加性增、乘性减)控制器。已完成的下载被分组为包含`concurrency`个下载的采样窗口。每个窗口结束时，如果错误率超过`errorRateThreshold`，或平均首字节时间超过观察到的最低值的`latencyTolerance`倍(请求被服务器或链路排队)，并发数按比例降低。否则只要窗口吞吐量相比上一个窗口没有下降，并发数就加1，因此链路饱和后就停止增长
+ 当启用`SDWebImageDownloaderConfig.adaptiveConcurrentDownloads`时，该控制器由`SDWebImageDownloader`驱动，下面的属性将其决策作为指标公开。它是线程安全的
+ */
+@interface SDWebImageDownloaderConcurrencyController : NSObject
+
+/**
+ Create a controller. The bounds are clamped to at least 1, and the initial concurrency is clamped into the bounds.
+ 创建控制器。边界值至少为1，初始并发数会被限制在边界之内
+ */
+- (nonnull instancetype)initWithMinimumConcurrency:(NSInteger)minimumConcurrency
+                                maximumConcurrency:(NSInteger)maximumConcurrency
+                                initialConcurrency:(NSInteger)initialConcurrency NS_DESIGNATED_INITIALIZER;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
++ (nonnull instancetype)new NS_UNAVAILABLE;
+
+/// The lower bound of the concurrency
+/// 并发数下限
+@property (atomic, assign, readonly) NSInteger minimumConcurrency;
+
+/**
+ The upper bound of the concurrency. Lowering it below the current concurrency takes effect immediately.
+ 并发数上限。将其降低到当前并发数以下会立即生效
+ */
+@property (atomic, assign) NSInteger maximumConcurrency;
+
+/**
+ The error rate in a window above which the concurrency is decreased.
+ Defaults to 0.1.
+ 窗口内错误率超过该值时降低并发数
+ 默认为0.1
+ */
+@property (atomic, assign) double errorRateThreshold;
+
+/**
+ The ratio of the window mean time to first byte to the lowest one, above which the concurrency is decreased.
+ Defaults to 2.0.
+ 窗口平均首字节时间与最低值之比超过该值时降低并发数
+ 默认为2.0
+ */
+@property (atomic, assign) double latencyTolerance;
+
+/// The current concurrency, it's always within the bounds
+/// 当前并发数，总是在边界之内
+@property (atomic, assign, readonly) NSInteger concurrency;
+
+/// The decision made at the end of the last window
+/// 上一个窗口结束时做出的决策
+@property (atomic, assign, readonly) SDWebImageDownloaderConcurrencyDecision lastDecision;
+
+/// The throughput of the last window in bytes per second
+/// 上一个窗口的吞吐量，单位为字节每秒
+@property (atomic, assign, readonly) double throughput;
+
+/// The mean time to first byte of the last window in seconds, 0 if there is no successful download in the window
+/// 上一个窗口的平均首字节时间，单位为秒，窗口内没有成功的下载时为0
+@property (atomic, assign, readonly) NSTimeInterval timeToFirstByte;
+
+/// The lowest window mean time to first byte observed, which is used as the uncongested baseline. It decays toward the recent windows run at the minimum concurrency, so a slower link is accepted as the new baseline. 0 if not observed yet
+/// 观察到的最低窗口平均首字节时间，用作未拥塞时的基准。它会向以最小并发数运行的最近窗口衰减，因此更慢的链路会被接受为新的基准。尚未观察到时为0
+@property (atomic, assign, readonly) NSTimeInterval baselineTimeToFirstByte;
+
+/// The error rate of the last window
+/// 上一个窗口的错误率
+@property (atomic, assign, readonly) double errorRate;
+
+/// The number of the recorded downloads
+/// 已记录的下载数量
+@property (atomic, assign, readonly) NSUInteger sampleCount;
+
+/// The number of the increase decisions
+/// 增加决策的次数
+@property (atomic, assign, readonly) NSUInteger increaseCount;
+
+/// The number of the decrease decisions
+/// 降低决策的次数
+@property (atomic, assign, readonly) NSUInteger decreaseCount;
+
+/**
+ Record a finished download. The times are in seconds on the same clock, such as `CFAbsoluteTimeGetCurrent()`. For a failed download, the first byte time can be 0.
+ The cancelled downloads should not be recorded, they say nothing about the link.
+ 记录一个已完成的下载。时间使用同一时钟的秒数，例如`CFAbsoluteTimeGetCurrent()`。对于失败的下载，首字节时间可以为0
+ 取消的下载不应被记录，它们与链路状况无关
+
+ @param receivedBytes The received bytes of the response body 接收到的响应体字节数
+ @param startTime The time when the request started 请求开始的时间
+ @param firstByteTime The time when the first byte of the response received 收到响应第一个字节的时间
+ @param endTime The time when the download finished 下载完成的时间
+ @param failed Whether the download failed 下载是否失败
+ @return The concurrency after recording 记录后的并发数
+ */
+- (NSInteger)recordDownloadWithReceivedBytes:(int64_t)receivedBytes
+                                   startTime:(NSTimeInterval)startTime
+                               firstByteTime:(NSTimeInterval)firstByteTime
+                                     endTime:(NSTimeInterval)endTime
+                                      failed:(BOOL)failed;
+
+@end
@@ -0,0 +1,166 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageDownloaderConcurrencyController.h"
+#import "SDInternalMacros.h"
+
+/// The factor used by the multiplicative decrease
+/// 乘性减使用的系数
+static const double kSDConcurrencyDecreaseFactor = 0.75;
+/// The throughput drop allowed for the additive increase, which absorb the measurement noise
+/// 加性增允许的吞吐量下降，用于吸收测量噪声
+static const double kSDConcurrencyThroughputTolerance = 0.05;
+/// The weight of the new time to first byte when the baseline decays toward it
+/// 基准向新的首字节时间衰减时，新值所占的权重
+static const double kSDConcurrencyBaselineDecayFactor = 0.5;
+
+@interface SDWebImageDownloaderConcurrencyController ()
+
+@property (atomic, assign, readwrite) NSInteger minimumConcurrency;
+@property (atomic, assign, readwrite) NSInteger concurrency;
+@property (atomic, assign, readwrite) SDWebImageDownloaderConcurrencyDecision lastDecision;
+@property (atomic, assign, readwrite) double throughput;
+@property (atomic, assign, readwrite) NSTimeInterval timeToFirstByte;
+@property (atomic, assign, readwrite) NSTimeInterval baselineTimeToFirstByte;
+@property (atomic, assign, readwrite) double errorRate;
+@property (atomic, assign, readwrite) NSUInteger sampleCount;
+@property (atomic, assign, readwrite) NSUInteger increaseCount;
+@property (atomic, assign, readwrite) NSUInteger decreaseCount;
+
+@end
+
+@implementation SDWebImageDownloaderConcurrencyController {
+    SD_LOCK_DECLARE(_lock); // a lock to keep the window thread-safe
+    // The current sample window
+    NSUInteger _windowSampleCount;
+    NSUInteger _windowFailureCount;
+    NSUInteger _windowFirstByteCount;
+    int64_t _windowReceivedBytes;
+    NSTimeInterval _windowStartTime;
+    NSTimeInterval _windowEndTime;
+    NSTimeInterval _windowTimeToFirstByte; // the sum
+    double _previousThroughput;
+}
+
+@synthesize maximumConcurrency = _maximumConcurrency;
+
+- (instancetype)initWithMinimumConcurrency:(NSInteger)minimumConcurrency maximumConcurrency:(NSInteger)maximumConcurrency initialConcurrency:(NSInteger)initialConcurrency {
+    self = [super init];
+    if (self) {
+        SD_LOCK_INIT(_lock);
+        minimumConcurrency = MAX(minimumConcurrency, 1);
+        maximumConcurrency = MAX(maximumConcurrency, minimumConcurrency);
+        _minimumConcurrency = minimumConcurrency;
+        _maximumConcurrency = maximumConcurrency;
+        _concurrency = MIN(MAX(initialConcurrency, minimumConcurrency), maximumConcurrency);
+        _errorRateThreshold = 0.1;
+        _latencyTolerance = 2.0;
+        [self resetWindow];
+    }
+    return self;
+}
+
+- (void)setMaximumConcurrency:(NSInteger)maximumConcurrency {
+    SD_LOCK(_lock);
+    maximumConcurrency = MAX(maximumConcurrency, self.minimumConcurrency);
+    _maximumConcurrency = maximumConcurrency;
+    if (self.concurrency > maximumConcurrency) {
+        self.concurrency = maximumConcurrency;
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (NSInteger)maximumConcurrency {
+    SD_LOCK(_lock);
+    NSInteger maximumConcurrency = _maximumConcurrency;
+    SD_UNLOCK(_lock);
+    return maximumConcurrency;
+}
+
+// Make sure to call with lock held by caller
+- (void)resetWindow {
+    _windowSampleCount = 0;
+    _windowFailureCount = 0;
+    _windowFirstByteCount = 0;
+    _windowReceivedBytes = 0;
+    _windowStartTime = DBL_MAX;
+    _windowEndTime = 0;
+    _windowTimeToFirstByte = 0;
+}
+
+- (NSInteger)recordDownloadWithReceivedBytes:(int64_t)receivedBytes startTime:(NSTimeInterval)startTime firstByteTime:(NSTimeInterval)firstByteTime endTime:(NSTimeInterval)endTime failed:(BOOL)failed {
+    SD_LOCK(_lock);
+    self.sampleCount++;
+    _windowSampleCount++;
+    _windowReceivedBytes += MAX(receivedBytes, 0);
+    _windowStartTime = MIN(_windowStartTime, startTime);
+    _windowEndTime = MAX(_windowEndTime, endTime);
+    if (failed) {
+        _windowFailureCount++;
+    } else if (firstByteTime >= startTime) {
+        _windowFirstByteCount++;
+        _windowTimeToFirstByte += firstByteTime - startTime;
+    }
+    NSInteger concurrency = self.concurrency;
+    // A window contains one download per concurrent slot, so each decision see the effect of the previous one
+    if (_windowSampleCount >= (NSUInteger)concurrency) {
+        concurrency = [self finishWindow];
+    }
+    SD_UNLOCK(_lock);
+    return concurrency;
+}
+
+// Make sure to call with lock held by caller
+- (NSInteger)finishWindow {
+    NSTimeInterval duration = MAX(_windowEndTime - _windowStartTime, 0.001);
+    double throughput = _windowReceivedBytes / duration;
+    double errorRate = (double)_windowFailureCount / _windowSampleCount;
+    NSTimeInterval timeToFirstByte = _windowFirstByteCount > 0 ? _windowTimeToFirstByte / _windowFirstByteCount : 0;
+    NSInteger concurrency = self.concurrency;
+    NSInteger minimumConcurrency = self.minimumConcurrency;
+    NSTimeInterval baselineTimeToFirstByte = self.baselineTimeToFirstByte;
+    if (timeToFirstByte > 0 && (baselineTimeToFirstByte == 0 || timeToFirstByte < baselineTimeToFirstByte)) {
+        baselineTimeToFirstByte = timeToFirstByte;
+    } else if (timeToFirstByte > 0 && concurrency <= minimumConcurrency) {
+        // At the lower bound our own load can not explain the latency, the link changed (e.g. Wi-Fi to cellular), so decay the baseline toward the recent samples instead of pinning the concurrency at the lower bound forever
+        // Only decay here, or the baseline would follow the queueing delay caused by ourselves
+        baselineTimeToFirstByte += (timeToFirstByte - baselineTimeToFirstByte) * kSDConcurrencyBaselineDecayFactor;
+    }
+
+    NSInteger maximumConcurrency = _maximumConcurrency;
+    BOOL congested = errorRate > self.errorRateThreshold;
+    congested |= (timeToFirstByte > 0 && timeToFirstByte > baselineTimeToFirstByte * self.latencyTolerance);
+    SDWebImageDownloaderConcurrencyDecision decision;
+    if (congested) {
+        // Multiplicative decrease, at least 1 unless reach the lower bound
+        NSInteger decreasedConcurrency = MIN((NSInteger)floor(concurrency * kSDConcurrencyDecreaseFactor), concurrency - 1);
+        concurrency = MAX(decreasedConcurrency, minimumConcurrency);
+        decision = SDWebImageDownloaderConcurrencyDecisionDecrease;
+        self.decreaseCount++;
+    } else if (_previousThroughput == 0 || throughput >= _previousThroughput * (1 - kSDConcurrencyThroughputTolerance)) {
+        // Additive increase, the more concurrency still pays off
+        concurrency = MIN(concurrency + 1, maximumConcurrency);
+        decision = SDWebImageDownloaderConcurrencyDecisionIncrease;
+        self.increaseCount++;
+    } else {
+        // The throughput dropped, the link is saturated
+        decision = SDWebImageDownloaderConcurrencyDecisionHold;
+    }
+
+    _previousThroughput = throughput;
+    self.throughput = throughput;
+    self.errorRate = errorRate;
+    self.timeToFirstByte = timeToFirstByte;
+    self.baselineTimeToFirstByte = baselineTimeToFirstByte;
+    self.lastDecision = decision;
+    self.concurrency = concurrency;
+    [self resetWindow];
+    return concurrency;
+}
+
+@end
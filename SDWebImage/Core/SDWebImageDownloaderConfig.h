@@ -22,7 +22,13 @@ typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
      * All download operations will execute in stack style (last-in-first-out).
      * 所有的下载操作会按照 后入先出 的顺序执行 LIFO
      */
-    SDWebImageDownloaderLIFOExecutionOrder
+    SDWebImageDownloaderLIFOExecutionOrder,
+    
+    /**
+     * All download operations will execute in earliest-deadline-first order, see `SDWebImageContextDownloadDeadline`. The downloads wait in the downloader and only start when the download queue has free slots, so the later deadline update still takes effect.
+     * 所有下载操作会按照截止时间最早优先的顺序执行，参见`SDWebImageContextDownloadDeadline`。下载在下载器中等待，只有当下载队列有空闲名额时才开始，因此之后的截止时间更新仍然生效
+     */
+    SDWebImageDownloaderDeadlineExecutionOrder
 };
 
 /**
@@ -48,6 +54,44 @@ typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
  */
 @property (nonatomic, assign) NSInteger maxConcurrentDownloads;
 
+/**
+ * Whether to adjust the concurrent downloads from the observed throughput, time to first byte and error rate. When enabled, the downloader starts from `minConcurrentDownloads`, and `maxConcurrentDownloads` becomes the upper bound, so you may raise it for the fast links. See `SDWebImageDownloaderConcurrencyController`.
+ * Defaults to NO.
+ * @note This property does not support dynamic changes, means it's immutable after the downloader instance initialized.
+ * 是否根据观察到的吞吐量、首字节时间和错误率调整并行下载数。启用后，下载器从`minConcurrentDownloads`开始，`maxConcurrentDownloads`成为上限，因此对于快速链路可以调高它。参见`SDWebImageDownloaderConcurrencyController`
+ * 默认为NO
+ * @note 该属性不支持动态修改，意味着在下载器实例初始化之后，它是不可变的
+ */
+@property (nonatomic, assign) BOOL adaptiveConcurrentDownloads;
+
+/**
+ * The minimum number of concurrent downloads, only used when `adaptiveConcurrentDownloads` is enabled.
+ * Defaults to 2.
+ * @note This property does not support dynamic changes, means it's immutable after the downloader instance initialized.
+ * 最小并行下载数，仅在启用`adaptiveConcurrentDownloads`时使用
+ * 默认为2
+ * @note 该属性不支持动态修改，意味着在下载器实例初始化之后，它是不可变的
+ */
+@property (nonatomic, assign) NSInteger minConcurrentDownloads;
+
+/**
+ * The maximum number of concurrent downloads to the same host, the host name is compared case-insensitively. The extra downloads wait for the previous downloads to that host, without taking the slots from the downloads to other hosts. So a burst of requests to a slow host does not block the other hosts.
+ * Defaults to 0, which means no limit.
+ * @note This is ignored for `SDWebImageDownloaderLIFOExecutionOrder` and `SDWebImageDownloaderDeadlineExecutionOrder`.
+ * 对同一主机的最大并行下载数，主机名不区分大小写。多余的下载会等待该主机之前的下载，而不会占用其他主机下载的名额。因此对慢速主机的突发请求不会阻塞其他主机
+ * 默认为0，表示没有限制
+ * @note 对于`SDWebImageDownloaderLIFOExecutionOrder`和`SDWebImageDownloaderDeadlineExecutionOrder`会被忽略
+ */
+@property (nonatomic, assign) NSInteger maxConcurrentDownloadsPerHost;
+
+/**
+ * The maximum number of concurrent downloads for the specified hosts, which override `maxConcurrentDownloadsPerHost`. The key is the lowercase host name, and the value is a positive integer. Use this to weight the hosts, such as a larger budget for the primary host than the third-party CDN.
+ * Defaults to nil.
+ * 指定主机的最大并行下载数，会覆盖`maxConcurrentDownloadsPerHost`。key是小写的主机名，value是正整数。使用它来为主机分配权重，例如为主域名分配比第三方CDN更大的预算
+ * 默认为nil
+ */
+@property (nonatomic, copy, nullable) NSDictionary<NSString *, NSNumber *> *maxConcurrentDownloadsForHosts;
+
 /**
  * The timeout value (in seconds) for each download operation.
  * Defaults to 15.0.
@@ -69,6 +113,18 @@ typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
  */
 @property (nonatomic, assign) double minimumProgressInterval;
 
+/**
+ * The maximum number of the progressive frames decoded for each download, the final image is not counted. A progressive frame is decoded only when it's worth the cost: a JPEG scan completed, or enough new bytes arrived to spread the remaining frames evenly, and the idle time since the last frame is at least its measured decoding time.
+ * 0 means no limit, the frames are still throttled by the bytes gained and the decoding cost.
+ * @note This only takes effect when `SDWebImageDownloaderProgressiveLoad` is used. See `SDWebImageDownloaderOperation.producedProgressiveFrameCount` and `skippedProgressiveFrameCount` for the result.
+ * Defaults to 10.
+ * 每个下载解码的渐进式帧的最大数量，最终图像不计算在内。仅当渐进式帧值得解码时才会解码：一个JPEG扫描已完成，或接收到的新字节足以使剩余帧平均分布，并且距上一帧的空闲时间不少于其测得的解码时间
+ * 0表示不限制，帧仍会根据新增字节和解码开销进行节流
+ * @note 仅在使用`SDWebImageDownloaderProgressiveLoad`时生效。结果见`SDWebImageDownloaderOperation.producedProgressiveFrameCount`和`skippedProgressiveFrameCount`
+ * 默认为10
+ */
+@property (nonatomic, assign) NSUInteger progressiveFrameBudget;
+
 /**
  * The custom session configuration in use by NSURLSession. If you don't provide one, we will use `defaultSessionConfiguration` instead.
  * Defatuls to nil.
@@ -100,6 +156,14 @@ typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
  */
 @property (nonatomic, assign) SDWebImageDownloaderExecutionOrder executionOrder;
 
+/**
+ * Whether to cancel the waiting downloads which already passed their deadline instead of starting them, only used for `SDWebImageDownloaderDeadlineExecutionOrder`. The completion block is called with `SDWebImageErrorCancelled`.
+ * Defaults to NO.
+ * 是否取消已超过截止时间的等待中的下载而不是启动它们，仅用于`SDWebImageDownloaderDeadlineExecutionOrder`。完成回调会收到`SDWebImageErrorCancelled`错误
+ * 默认为NO
+ */
+@property (nonatomic, assign) BOOL shouldDropExpiredDownloads;
+
 /**
  * Set the default URL credential to be set for request operations.
  * Defaults to nil.
@@ -146,4 +210,24 @@ typedef NS_ENUM(NSInteger, SDWebImageDownloaderExecutionOrder) {
  */
 @property (nonatomic, copy, nullable) NSSet<NSString *> *acceptableContentTypes;
 
+/**
+ * Whether to sniff the first received bytes and cancel the download immediately when they are not any decodable image format, such as a HTML error page or JSON sent with `image/*` content type. The download fails with error code `SDWebImageErrorUndecodableDownloadData`.
+ * The data is decodable when its magic bytes are recognized, or any registered coder (except the ImageIO fallback coder, which accept any data) can decode it. The XML data is always kept, since SVG can only be detected at the end.
+ * @note If you use a custom coder whose `canDecodeFromData:` need the whole data, keep this disabled.
+ * Defaults to NO.
+ * 是否嗅探最先接收到的字节，当它们不是任何可解码的图像格式时立即取消下载，例如以`image/*`内容类型发送的HTML错误页面或JSON。下载将失败，错误码为`SDWebImageErrorUndecodableDownloadData`
+ * 当数据的魔术字节可以识别，或任何已注册的解码器(除了接受任意数据的ImageIO兜底解码器)可以解码时，数据是可解码的。XML数据总是保留，因为SVG只能在末尾检测
+ * @note 如果你使用的自定义解码器的`canDecodeFromData:`需要完整数据，请保持禁用
+ * 默认为NO
+ */
+@property (nonatomic, assign) BOOL abortsUndecodableDownloads;
+
+/**
+ * The maximum pixel count (width * height) of the downloaded image. When the image header probed from the first received bytes exceeds it, the download is cancelled immediately and fails with error code `SDWebImageErrorDownloadPixelCountExceedLimit`. The size is the pixel size stored in the header, before any thumbnail or scale down decoding.
+ * Defaults to 0, which means no limit.
+ * 下载图像的最大像素数(宽 * 高)。当从最先接收到的字节中探测出的图像头部超过该值时，下载会被立即取消，并以错误码`SDWebImageErrorDownloadPixelCountExceedLimit`失败。该尺寸是头部中存储的像素尺寸，在任何缩略图或缩小解码之前
+ * 默认为0，表示不限制
+ */
+@property (nonatomic, assign) NSUInteger maxDownloadPixelCount;
+
 @end
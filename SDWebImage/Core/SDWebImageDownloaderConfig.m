@@ -24,7 +24,9 @@ static SDWebImageDownloaderConfig * _defaultDownloaderConfig;
     self = [super init];
     if (self) {
         _maxConcurrentDownloads = 6;
+        _minConcurrentDownloads = 2;
         _downloadTimeout = 15.0;
+        _progressiveFrameBudget = 10;
         _executionOrder = SDWebImageDownloaderFIFOExecutionOrder;
         _acceptableStatusCodes = [NSIndexSet indexSetWithIndexesInRange:NSMakeRange(200, 100)];
     }
@@ -34,16 +36,24 @@ static SDWebImageDownloaderConfig * _defaultDownloaderConfig;
 - (id)copyWithZone:(NSZone *)zone {
     SDWebImageDownloaderConfig *config = [[[self class] allocWithZone:zone] init];
     config.maxConcurrentDownloads = self.maxConcurrentDownloads;
+    config.adaptiveConcurrentDownloads = self.adaptiveConcurrentDownloads;
+    config.minConcurrentDownloads = self.minConcurrentDownloads;
+    config.maxConcurrentDownloadsPerHost = self.maxConcurrentDownloadsPerHost;
+    config.maxConcurrentDownloadsForHosts = self.maxConcurrentDownloadsForHosts;
     config.downloadTimeout = self.downloadTimeout;
     config.minimumProgressInterval = self.minimumProgressInterval;
+    config.progressiveFrameBudget = self.progressiveFrameBudget;
     config.sessionConfiguration = [self.sessionConfiguration copyWithZone:zone];
     config.operationClass = self.operationClass;
     config.executionOrder = self.executionOrder;
+    config.shouldDropExpiredDownloads = self.shouldDropExpiredDownloads;
     config.urlCredential = self.urlCredential;
     config.username = self.username;
     config.password = self.password;
     config.acceptableStatusCodes = self.acceptableStatusCodes;
     config.acceptableContentTypes = self.acceptableContentTypes;
+    config.abortsUndecodableDownloads = self.abortsUndecodableDownloads;
+    config.maxDownloadPixelCount = self.maxDownloadPixelCount;
     
     return config;
 }
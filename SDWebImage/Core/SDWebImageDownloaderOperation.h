@@ -43,13 +43,18 @@
 @property (strong, nonatomic, readonly, nullable) NSURLSessionTask *dataTask;
 /// 封装会话任务度量的对象
 @property (strong, nonatomic, readonly, nullable) NSURLSessionTaskMetrics *metrics API_AVAILABLE(macosx(10.12), ios(10.0), watchos(3.0), tvos(10.0));
+/// 图像头部信息
+@property (strong, nonatomic, readonly, nullable) SDImageHeaderInfo *imageHeaderInfo;
 
 // These operation-level config was inherited from downloader. See `SDWebImageDownloaderConfig` for documentation.
 /// 这些操作级配置是从下载器继承的。请参阅“SDWebImageDownloaderConfig”文档
 @property (strong, nonatomic, nullable) NSURLCredential *credential;
 @property (assign, nonatomic) double minimumProgressInterval;
+@property (assign, nonatomic) NSUInteger progressiveFrameBudget;
 @property (copy, nonatomic, nullable) NSIndexSet *acceptableStatusCodes;
 @property (copy, nonatomic, nullable) NSSet<NSString *> *acceptableContentTypes;
+@property (assign, nonatomic) BOOL abortsUndecodableDownloads;
+@property (assign, nonatomic) NSUInteger maxDownloadPixelCount;
 
 @end
 
@@ -87,6 +92,14 @@
  */
 @property (strong, nonatomic, readonly, nullable) NSURLSessionTaskMetrics *metrics API_AVAILABLE(macosx(10.12), ios(10.0), watchos(3.0), tvos(10.0));
 
+/**
+ * The image header info probed from the first received bytes, such as the pixel size, format and frame count. It's available before the whole data is received, so the layout or memory budget does not need to wait for the decoding. `SDWebImageDownloadReceiveImageHeaderNotification` is posted once it's set.
+ * This will be nil if the header is not parsed, or the data decryptor is used.
+ * 从最先接收到的字节中探测出的图像头部信息，例如像素尺寸、格式和帧数。它在接收到全部数据之前就可用，因此布局或内存预算无需等待解码。设置后会发送`SDWebImageDownloadReceiveImageHeaderNotification`
+ * 如果头部未解析，或使用了数据解密器，则为nil
+ */
+@property (strong, nonatomic, readonly, nullable) SDImageHeaderInfo *imageHeaderInfo;
+
 /**
  * The credential used for authentication challenges in `-URLSession:task:didReceiveChallenge:completionHandler:`.
  * 在' -URLSession:task: didreceivecchallenge: completionHandler: '中用于认证挑战的凭据
@@ -111,6 +124,26 @@
  */
 @property (assign, nonatomic) double minimumProgressInterval;
 
+/**
+ * The maximum number of the progressive frames decoded during download, 0 means no limit. See `SDWebImageDownloaderConfig.progressiveFrameBudget`.
+ * Defaults to 10.
+ * 下载过程中解码的渐进式帧的最大数量，0表示不限制。见`SDWebImageDownloaderConfig.progressiveFrameBudget`
+ * 默认为10
+ */
+@property (assign, nonatomic) NSUInteger progressiveFrameBudget;
+
+/**
+ * The number of the progressive frames decoded so far.
+ * 目前为止已解码的渐进式帧数
+ */
+@property (assign, nonatomic, readonly) NSUInteger producedProgressiveFrameCount;
+
+/**
+ * The number of the progressive frame chances skipped by the throttle so far, because the decoding was busy, the budget was used up, or the new data was not worth the cost.
+ * 目前为止被节流跳过的渐进式帧次数，原因是解码繁忙、预算用完，或新数据不值得解码开销
+ */
+@property (assign, nonatomic, readonly) NSUInteger skippedProgressiveFrameCount;
+
 /**
  * Set the acceptable HTTP Response status code. The status code which beyond the range will mark the download operation failed.
  * For example, if we config [200, 400) but server response is 503, the download will fail with error code `SDWebImageErrorInvalidDownloadStatusCode`.
@@ -134,6 +167,22 @@
  */
 @property (copy, nonatomic, nullable) NSSet<NSString *> *acceptableContentTypes;
 
+/**
+ * Whether to cancel the download when the first received bytes are not any decodable image format. See `SDWebImageDownloaderConfig.abortsUndecodableDownloads`.
+ * Defaults to NO.
+ * 当最先接收到的字节不是任何可解码的图像格式时是否取消下载。见`SDWebImageDownloaderConfig.abortsUndecodableDownloads`
+ * 默认为NO
+ */
+@property (assign, nonatomic) BOOL abortsUndecodableDownloads;
+
+/**
+ * The maximum pixel count of the probed image header, the download is cancelled when exceeded. See `SDWebImageDownloaderConfig.maxDownloadPixelCount`.
+ * Defaults to 0, which means no limit.
+ * 探测出的图像头部的最大像素数，超过时取消下载。见`SDWebImageDownloaderConfig.maxDownloadPixelCount`
+ * 默认为0，表示不限制
+ */
+@property (assign, nonatomic) NSUInteger maxDownloadPixelCount;
+
 /**
  * The options for the receiver.
  * 接收方的选项
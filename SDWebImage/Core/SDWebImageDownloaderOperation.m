@@ -11,11 +11,18 @@
 #import "SDInternalMacros.h"
 #import "SDWebImageDownloaderResponseModifier.h"
 #import "SDWebImageDownloaderDecryptor.h"
+#import "SDWebImageDownloaderProgressiveThrottle.h"
+#import "SDImageHeaderProber.h"
+#import "SDImageCodersManager.h"
+#import "SDImageIOCoder.h"
+#import "SDImageIOAnimatedCoderInternal.h"
 
 /// 进度回调key
 static NSString *const kProgressCallbackKey = @"progress";
 /// 完成回调key
 static NSString *const kCompletedCallbackKey = @"completed";
+/// 判断数据是否可解码所需嗅探的字节数
+static const NSUInteger kSDDownloadSniffLength = 256; // the bytes sniffed to tell whether the data is decodable
 
 /// 回调字典
 typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
@@ -31,8 +38,12 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 @property (assign, nonatomic, getter = isExecuting) BOOL executing;
 /// 执行完成
 @property (assign, nonatomic, getter = isFinished) BOOL finished;
-/// 图像数据
-@property (strong, nonatomic, nullable) NSMutableData *imageData;
+/// 已接收的数据块链，只在需要时拼接为一个不拷贝的`dispatch_data_t`
+@property (strong, nonatomic, nullable) NSMutableArray<dispatch_data_t> *receivedChunks; // the received chunks, concatenated into one `dispatch_data_t` only when needed, without copying bytes
+/// 流式写入的文件路径，设置后接收的数据直接写入该文件而不在内存中累积
+@property (copy, nonatomic, nullable) NSString *downloadFilePath; // from `SDWebImageContextDownloadFilePath`, the received data is written into this file instead of accumulated in memory
+/// 流式写入的文件句柄
+@property (strong, nonatomic, nullable) NSFileHandle *downloadFileHandle;
 /// 缓存数据
 @property (copy, nonatomic, nullable) NSData *cachedData; // for `SDWebImageDownloaderIgnoreCachedResponse`
 /// 预期数据大小
@@ -64,6 +75,16 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 @property (strong, nonatomic, readwrite, nullable) NSURLSessionTaskMetrics *metrics API_AVAILABLE(macosx(10.12), ios(10.0), watchos(3.0), tvos(10.0));
 /// 编码器队列
 @property (strong, nonatomic, nonnull) NSOperationQueue *coderQueue; // the serial operation queue to do image decoding
+/// 图像头部信息
+@property (strong, nonatomic, readwrite, nullable) SDImageHeaderInfo *imageHeaderInfo;
+/// 图像头部探测器
+@property (strong, nonatomic, nullable) SDImageHeaderProber *imageHeaderProber; // parse the header from the first received bytes
+/// 是否已嗅探数据
+@property (assign, nonatomic) BOOL dataSniffed; // for `abortsUndecodableDownloads`
+/// 待嗅探的最初字节
+@property (strong, nonatomic, nullable) NSMutableData *sniffData; // the first received bytes kept in memory for sniffing, the received data may be streamed into file
+/// 渐进式帧节流器
+@property (strong, nonatomic, nullable) SDWebImageDownloaderProgressiveThrottle *progressiveThrottle; // decide when a progressive frame is worth decoding
 #if SD_UIKIT
 /// 后台任务Id
 @property (assign, nonatomic) UIBackgroundTaskIdentifier backgroundTaskId;
@@ -71,6 +92,38 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
 
 @end
 
+// Wrap the received chunk as dispatch data without copying, the chunk is retained by the regions
+// 不拷贝地将接收到的数据块包装为dispatch data，数据块由区域持有
+static dispatch_data_t SDDispatchDataCreateWithData(NSData *data) {
+    if ([data conformsToProtocol:@protocol(OS_dispatch_data)]) {
+        return (dispatch_data_t)data;
+    }
+    if ([data isKindOfClass:[NSMutableData class]]) {
+        data = [data copy];
+    }
+    __block dispatch_data_t result = dispatch_data_empty;
+    [data enumerateByteRangesUsingBlock:^(const void * _Nonnull bytes, NSRange byteRange, BOOL * _Nonnull stop) {
+        dispatch_data_t region = dispatch_data_create(bytes, byteRange.length, NULL, ^{
+            (void)data;
+        });
+        result = dispatch_data_create_concat(result, region);
+    }];
+    return result;
+}
+
+// Concatenate the chunks pairwise, so each region record is copied O(log n) times instead of O(n) by appending one by one
+// 成对拼接数据块，使每个区域记录只被拷贝O(log n)次，而不是逐个追加时的O(n)次
+static dispatch_data_t SDDispatchDataCreateConcat(NSArray<dispatch_data_t> *chunks, NSUInteger location, NSUInteger length) {
+    if (length == 0) {
+        return dispatch_data_empty;
+    }
+    if (length == 1) {
+        return chunks[location];
+    }
+    NSUInteger half = length / 2;
+    return dispatch_data_create_concat(SDDispatchDataCreateConcat(chunks, location, half), SDDispatchDataCreateConcat(chunks, location + half, length - half));
+}
+
 @implementation SDWebImageDownloaderOperation
 /// 生成getter && setter
 @synthesize executing = _executing;
@@ -95,9 +148,15 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
         _callbackBlocks = [NSMutableArray new];
         _responseModifier = context[SDWebImageContextDownloadResponseModifier];
         _decryptor = context[SDWebImageContextDownloadDecryptor];
+        NSString *downloadFilePath = context[SDWebImageContextDownloadFilePath];
+        // The decryptor need the whole encrypted data in memory, so streaming is disabled
+        if ([downloadFilePath isKindOfClass:[NSString class]] && downloadFilePath.length > 0 && !_decryptor) {
+            _downloadFilePath = [downloadFilePath copy];
+        }
         _executing = NO;
         _finished = NO;
         _expectedSize = 0;
+        _progressiveFrameBudget = 10;
         _unownedSession = session;
         _coderQueue = [NSOperationQueue new];
         _coderQueue.maxConcurrentOperationCount = 1;
@@ -281,6 +340,8 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
     // Operation cancelled by user during sending the request
     [self callCompletionBlocksWithError:[NSError errorWithDomain:SDWebImageErrorDomain code:SDWebImageErrorCancelled userInfo:@{NSLocalizedDescriptionKey : @"Operation cancelled by user during sending the request"}]];
 
+    [self closeDownloadFile];
+    [self removeDownloadFile];
     [self reset];
 }
 
@@ -294,6 +355,7 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
     @synchronized (self) {
         [self.callbackBlocks removeAllObjects];
         self.dataTask = nil;
+        [self closeDownloadFile];
         
         if (self.ownedSession) {
             [self.ownedSession invalidateAndCancel];
@@ -327,6 +389,14 @@ typedef NSMutableDictionary<NSString *, id> SDCallbacksDictionary;
     return YES;
 }
 
+- (NSUInteger)producedProgressiveFrameCount {
+    return self.progressiveThrottle.producedFrameCount;
+}
+
+- (NSUInteger)skippedProgressiveFrameCount {
+    return self.progressiveThrottle.skippedFrameCount;
+}
+
 #pragma mark NSURLSessionDataDelegate
 
 - (void)URLSession:(NSURLSession *)session
@@ -408,13 +478,188 @@ didReceiveResponse:(NSURLResponse *)response
     }
 }
 
+// The snapshot of received data. It's a `dispatch_data_t` which is a `NSData` subclass, the regions are the received chunks without copying, and the later chunks do not mutate the snapshot. The getter has no side effect, the chunk list is left as is
+// 已接收数据的快照。它是`dispatch_data_t`，同时也是`NSData`子类，其区域就是不经拷贝的已接收数据块，之后的数据块不会改变该快照。该getter没有副作用，不会修改数据块列表
+- (nullable NSData *)imageData {
+    if (self.downloadFilePath) {
+        // Streamed into file, call this after the file handle closed. Map the file only when it's never overwritten in place, a truncated mapped file crashes on access
+        if (self.receivedSize == 0) {
+            return nil;
+        }
+        NSDataReadingOptions readingOptions = [self.context[SDWebImageContextDownloadFileMappable] boolValue] ? NSDataReadingMappedAlways : 0;
+        return [NSData dataWithContentsOfFile:self.downloadFilePath options:readingOptions error:nil];
+    }
+    NSArray<dispatch_data_t> *receivedChunks = [self.receivedChunks copy];
+    if (receivedChunks.count == 0) {
+        return nil;
+    }
+    return (NSData *)SDDispatchDataCreateConcat(receivedChunks, 0, receivedChunks.count);
+}
+
+// Write the received chunk into the download file, the file is created at the first chunk
+// 将接收到的数据块写入下载文件，文件在第一个数据块时创建
+- (BOOL)writeDownloadFileWithData:(NSData *)data {
+    if (!self.downloadFileHandle) {
+        NSFileManager *fileManager = [NSFileManager new];
+        NSString *directory = [self.downloadFilePath stringByDeletingLastPathComponent];
+        [fileManager createDirectoryAtPath:directory withIntermediateDirectories:YES attributes:nil error:nil];
+        if (![fileManager createFileAtPath:self.downloadFilePath contents:nil attributes:nil]) {
+            return NO;
+        }
+        self.downloadFileHandle = [NSFileHandle fileHandleForWritingAtPath:self.downloadFilePath];
+        if (!self.downloadFileHandle) {
+            return NO;
+        }
+    }
+    // `writeData:` raise exception when the disk is full
+    @try {
+        [self.downloadFileHandle writeData:data];
+    } @catch (NSException *exception) {
+        return NO;
+    }
+    return YES;
+}
+
+- (void)closeDownloadFile {
+    NSFileHandle *downloadFileHandle = self.downloadFileHandle;
+    if (!downloadFileHandle) {
+        return;
+    }
+    self.downloadFileHandle = nil;
+    @try {
+        [downloadFileHandle closeFile];
+    } @catch (NSException *exception) {
+        // Ignore, the data is checked when reading the file
+    }
+}
+
+- (void)removeDownloadFile {
+    if (self.downloadFilePath) {
+        [[NSFileManager new] removeItemAtPath:self.downloadFilePath error:nil];
+    }
+}
+
+// Probe the image header and sniff the first bytes, return the error if the download should be aborted
+- (nullable NSError *)sniffDownloadWithData:(NSData *)data {
+    if (!self.imageHeaderProber) {
+        self.imageHeaderProber = [[SDImageHeaderProber alloc] init];
+    }
+    // Once succeeded or failed, the prober ignore the data and keep the status
+    SDImageHeaderProbeStatus previousStatus = self.imageHeaderProber.status;
+    if (previousStatus != SDImageHeaderProbeStatusNeedMoreData) {
+        return nil;
+    }
+    SDImageHeaderProbeStatus status = [self.imageHeaderProber appendData:data];
+    if (status == SDImageHeaderProbeStatusSucceeded) {
+        SDImageHeaderInfo *imageHeaderInfo = self.imageHeaderProber.headerInfo;
+        self.imageHeaderInfo = imageHeaderInfo;
+        @weakify(self);
+        dispatch_async(dispatch_get_main_queue(), ^{
+            @strongify(self);
+            if (!self) {
+                return;
+            }
+            [[NSNotificationCenter defaultCenter] postNotificationName:SDWebImageDownloadReceiveImageHeaderNotification object:self];
+        });
+        NSUInteger maxDownloadPixelCount = self.maxDownloadPixelCount;
+        double pixelCount = imageHeaderInfo.pixelSize.width * imageHeaderInfo.pixelSize.height;
+        if (maxDownloadPixelCount > 0 && pixelCount > maxDownloadPixelCount) {
+            return [NSError errorWithDomain:SDWebImageErrorDomain
+                                       code:SDWebImageErrorDownloadPixelCountExceedLimit
+                                   userInfo:@{NSLocalizedDescriptionKey : [NSString stringWithFormat:@"Download marked as failed because the image pixel count %.0f exceeds the limit %lu", pixelCount, (unsigned long)maxDownloadPixelCount],
+                                              SDWebImageErrorDownloadImageHeaderKey : imageHeaderInfo}];
+        }
+        return nil;
+    }
+    if (!self.abortsUndecodableDownloads || self.dataSniffed) {
+        return nil;
+    }
+    if (!self.sniffData) {
+        self.sniffData = [NSMutableData dataWithCapacity:kSDDownloadSniffLength];
+    }
+    NSUInteger sniffLength = MIN(data.length, kSDDownloadSniffLength - MIN(self.sniffData.length, kSDDownloadSniffLength));
+    if (sniffLength > 0) {
+        [self.sniffData appendBytes:data.bytes length:sniffLength];
+    }
+    // Wait for enough bytes, unless the header is already known to be malformed
+    if (status == SDImageHeaderProbeStatusNeedMoreData && self.sniffData.length < kSDDownloadSniffLength) {
+        return nil;
+    }
+    self.dataSniffed = YES;
+    NSData *sniffData = self.sniffData;
+    self.sniffData = nil;
+    if ([self isDecodableSniffedData:sniffData]) {
+        return nil;
+    }
+    return [NSError errorWithDomain:SDWebImageErrorDomain
+                               code:SDWebImageErrorUndecodableDownloadData
+                           userInfo:@{NSLocalizedDescriptionKey : @"Download marked as failed because the data is not any decodable image format"}];
+}
+
+- (BOOL)isDecodableSniffedData:(NSData *)data {
+    // The magic bytes are recognized, keep downloading even if the header probe failed, the decoder may still handle the data which the prober does not understand
+    if ([NSData sd_imageFormatForImageData:data] != SDImageFormatUndefined) {
+        return YES;
+    }
+    // The XML may be a SVG, which can only be detected at the end
+    NSUInteger location = (data.length >= 3 && memcmp(data.bytes, "\xEF\xBB\xBF", 3) == 0) ? 3 : 0; // UTF-8 BOM
+    NSString *prefix = [[NSString alloc] initWithData:[data subdataWithRange:NSMakeRange(location, MIN(data.length - location, kSDDownloadSniffLength))] encoding:NSISOLatin1StringEncoding];
+    prefix = [prefix stringByTrimmingCharactersInSet:NSCharacterSet.whitespaceAndNewlineCharacterSet].lowercaseString;
+    if ([prefix hasPrefix:@"<?xml"] || [prefix hasPrefix:@"<svg"] || [prefix hasPrefix:@"<!doctype svg"]) {
+        return YES;
+    }
+    // Ask the custom coders, the ImageIO coder is the fallback which accept any data
+    id<SDImageCoder> imageCoder = self.context[SDWebImageContextImageCoder];
+    NSArray<id<SDImageCoder>> *coders = imageCoder ? @[imageCoder] : SDImageCodersManager.sharedManager.coders;
+    for (id<SDImageCoder> coder in coders) {
+        if ([coder isKindOfClass:SDImageIOCoder.class]) {
+            continue;
+        }
+        if ([coder canDecodeFromData:data]) {
+            return YES;
+        }
+    }
+    return NO;
+}
+
 - (void)URLSession:(NSURLSession *)session dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
-    if (!self.imageData) {
-        self.imageData = [[NSMutableData alloc] initWithCapacity:self.expectedSize];
+    if (self.downloadFilePath) {
+        if (![self writeDownloadFileWithData:data]) {
+            // Failed to write the file, such as disk full, mark as failed and cancel the download
+            self.responseError = [NSError errorWithDomain:SDWebImageErrorDomain
+                                                     code:SDWebImageErrorBadImageData
+                                                 userInfo:@{NSLocalizedDescriptionKey : @"Download marked as failed because the data can not be written to file"}];
+            [dataTask cancel];
+            return;
+        }
+    } else {
+        if (!self.receivedChunks) {
+            self.receivedChunks = [NSMutableArray array];
+        }
+        [self.receivedChunks addObject:SDDispatchDataCreateWithData(data)];
     }
-    [self.imageData appendData:data];
     
-    self.receivedSize = self.imageData.length;
+    self.receivedSize += data.length;
+    // The encrypted data can not be probed
+    if (!self.decryptor) {
+        NSError *sniffError = [self sniffDownloadWithData:data];
+        if (sniffError) {
+            // Not worth downloading, cancel immediately to save the bandwidth and memory
+            self.responseError = sniffError;
+            [dataTask cancel];
+            return;
+        }
+    }
+    // Using data decryptor will disable the progressive decoding, since there are no support for progressive decrypt
+    // Streaming into file will disable the progressive decoding as well, since the data is not kept in memory
+    BOOL supportProgressive = (self.options & SDWebImageDownloaderProgressiveLoad) && !self.decryptor && !self.downloadFilePath;
+    if (supportProgressive) {
+        if (!self.progressiveThrottle) {
+            self.progressiveThrottle = [[SDWebImageDownloaderProgressiveThrottle alloc] initWithFrameBudget:self.progressiveFrameBudget];
+        }
+        // Parse every chunk, the scan boundaries can not be missed even when the progress callback is skipped
+        [self.progressiveThrottle appendData:data];
+    }
     if (self.expectedSize == 0) {
         // Unknown expectedSize, immediately call progressBlock and return
         for (SDWebImageDownloaderProgressBlock progressBlock in [self callbacksForKey:kProgressCallbackKey]) {
@@ -435,15 +680,13 @@ didReceiveResponse:(NSURLResponse *)response
     }
     self.previousProgress = currentProgress;
     
-    // Using data decryptor will disable the progressive decoding, since there are no support for progressive decrypt
-    BOOL supportProgressive = (self.options & SDWebImageDownloaderProgressiveLoad) && !self.decryptor;
     // Progressive decoding Only decode partial image, full image in `URLSession:task:didCompleteWithError:`
     if (supportProgressive && !finished) {
-        // Get the image data
-        NSData *imageData = self.imageData;
-        
-        // keep maximum one progressive decode process during download
-        if (self.coderQueue.operationCount == 0) {
+        // keep maximum one progressive decode process during download, and only decode the frame worth the cost
+        SDWebImageDownloaderProgressiveThrottle *progressiveThrottle = self.progressiveThrottle;
+        if ([progressiveThrottle shouldRenderFrameWithReceivedSize:self.receivedSize expectedSize:self.expectedSize decoding:self.coderQueue.operationCount > 0]) {
+            // Get the image data
+            NSData *imageData = self.imageData;
             // NSOperation have autoreleasepool, don't need to create extra one
             @weakify(self);
             [self.coderQueue addOperationWithBlock:^{
@@ -451,7 +694,9 @@ didReceiveResponse:(NSURLResponse *)response
                 if (!self) {
                     return;
                 }
+                CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
                 UIImage *image = SDImageLoaderDecodeProgressiveImageData(imageData, self.request.URL, NO, self, [[self class] imageOptionsFromDownloaderOptions:self.options], self.context);
+                [progressiveThrottle didRenderFrameWithDuration:CFAbsoluteTimeGetCurrent() - startTime];
                 if (image) {
                     // We do not keep the progressive decoding image even when `finished`=YES. Because they are for view rendering but not take full function from downloader options. And some coders implementation may not keep consistent between progressive decoding and normal decoding.
                     
@@ -499,18 +744,21 @@ didReceiveResponse:(NSURLResponse *)response
         });
     }
     
+    [self closeDownloadFile];
+    
     // make sure to call `[self done]` to mark operation as finished
     if (error) {
         // custom error instead of URLSession error
         if (self.responseError) {
             error = self.responseError;
         }
+        [self removeDownloadFile];
         [self callCompletionBlocksWithError:error];
         [self done];
     } else {
         if ([self callbacksForKey:kCompletedCallbackKey].count > 0) {
             NSData *imageData = self.imageData;
-            self.imageData = nil;
+            self.receivedChunks = nil;
             // data decryptor
             if (imageData && self.decryptor) {
                 imageData = [self.decryptor decryptedDataWithData:imageData response:self.response];
@@ -525,6 +773,7 @@ didReceiveResponse:(NSURLResponse *)response
                                                          userInfo:@{NSLocalizedDescriptionKey : @"Downloaded image is not modified and ignored",
                                                                     SDWebImageErrorDownloadResponseKey : self.response}];
                     // call completion block with not modified error
+                    [self removeDownloadFile];
                     [self callCompletionBlocksWithError:self.responseError];
                     [self done];
                 } else {
@@ -547,6 +796,7 @@ didReceiveResponse:(NSURLResponse *)response
                         CGSize imageSize = image.size;
                         if (imageSize.width == 0 || imageSize.height == 0) {
                             NSString *description = image == nil ? @"Downloaded image decode failed" : @"Downloaded image has 0 pixels";
+                            [self removeDownloadFile];
                             [self callCompletionBlocksWithError:[NSError errorWithDomain:SDWebImageErrorDomain code:SDWebImageErrorBadImageData userInfo:@{NSLocalizedDescriptionKey : description}]];
                         } else {
                             [self callCompletionBlocksWithImage:image imageData:imageData error:nil finished:YES];
@@ -555,10 +805,12 @@ didReceiveResponse:(NSURLResponse *)response
                     }];
                 }
             } else {
+                [self removeDownloadFile];
                 [self callCompletionBlocksWithError:[NSError errorWithDomain:SDWebImageErrorDomain code:SDWebImageErrorBadImageData userInfo:@{NSLocalizedDescriptionKey : @"Image data is nil"}]];
                 [self done];
             }
         } else {
+            [self removeDownloadFile];
             [self done];
         }
     }
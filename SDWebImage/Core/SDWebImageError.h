@@ -20,6 +20,9 @@ FOUNDATION_EXPORT NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadStatu
 /// The HTTP MIME content type for invalid download response (NSString *)
 /// 非法下载响应的HTTP MIME 内容类型
 FOUNDATION_EXPORT NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadContentTypeKey;
+/// The image header probed from the aborted download (SDImageHeaderInfo *)
+/// 被中止下载中探测出的图像头部信息
+FOUNDATION_EXPORT NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadImageHeaderKey;
 
 /// SDWebImage error domain and codes
 /// SDWebImage错误域和代码
@@ -33,4 +36,6 @@ typedef NS_ERROR_ENUM(SDWebImageErrorDomain, SDWebImageError) {
     SDWebImageErrorCancelled = 2002, // The image loading operation is cancelled before finished, during either async disk cache query, or waiting before actual network request. For actual network request error, check `NSURLErrorDomain` error domain and code. - 在异步磁盘缓存查询或等待实际网络请求期间，图像加载操作在完成之前被取消。对于实际的网络请求错误，检查' NSURLErrorDomain '错误域和代码
     SDWebImageErrorInvalidDownloadResponse = 2003, // When using response modifier, the modified download response is nil and marked as failed. - 当使用响应修饰符时，修改后的下载响应为nil，并标记为失败
     SDWebImageErrorInvalidDownloadContentType = 2004, // The image download response a invalid content type. You can check the MIME content type in error's userInfo under `SDWebImageErrorDownloadContentTypeKey` - 映像下载响应的内容类型无效。你可以在错误的userInfo下' SDWebImageErrorDownloadContentTypeKey '检查MIME内容类型
+    SDWebImageErrorUndecodableDownloadData = 2005, // The first bytes of the download are not any decodable image format, such as a HTML error page, the download is cancelled early. See `SDWebImageDownloaderConfig.abortsUndecodableDownloads` - 下载的最初字节不是任何可解码的图像格式，例如HTML错误页面，下载被提前取消。见`SDWebImageDownloaderConfig.abortsUndecodableDownloads`
+    SDWebImageErrorDownloadPixelCountExceedLimit = 2006, // The probed image pixel count exceeds the limit, the download is cancelled early. You can check the header in error's userInfo under `SDWebImageErrorDownloadImageHeaderKey`. See `SDWebImageDownloaderConfig.maxDownloadPixelCount` - 探测出的图像像素数超过限制，下载被提前取消。你可以在错误的userInfo下`SDWebImageErrorDownloadImageHeaderKey`检查头部信息。见`SDWebImageDownloaderConfig.maxDownloadPixelCount`
 };
@@ -14,3 +14,4 @@ NSErrorDomain const _Nonnull SDWebImageErrorDomain = @"SDWebImageErrorDomain";
 NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadResponseKey = @"SDWebImageErrorDownloadResponseKey";
 NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadStatusCodeKey = @"SDWebImageErrorDownloadStatusCodeKey";
 NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadContentTypeKey = @"SDWebImageErrorDownloadContentTypeKey";
+NSErrorUserInfoKey const _Nonnull SDWebImageErrorDownloadImageHeaderKey = @"SDWebImageErrorDownloadImageHeaderKey";
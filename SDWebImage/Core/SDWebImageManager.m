@@ -409,12 +409,26 @@ static id<SDImageLoader> _defaultImageLoader;
             mutableContext[SDWebImageContextLoaderCachedImage] = cachedImage;
             context = [mutableContext copy];
         }
+        // Stream the download into a file inside the disk cache directory, which is moved into the cache later
+        /// 将下载流式写入硬盘缓存目录中的文件，之后移入缓存
+        SDImageCache *streamImageCache = [self streamImageCacheForOptions:options context:context];
+        if (streamImageCache) {
+            SDWebImageMutableContext *mutableContext = [context mutableCopy] ?: [NSMutableDictionary dictionary];
+            mutableContext[SDWebImageContextDownloadFilePath] = [streamImageCache uniqueTemporaryFilePath];
+            // The file is moved into the cache, map it only if the cache never overwrite it in place
+            mutableContext[SDWebImageContextDownloadFileMappable] = @((streamImageCache.config.diskCacheWritingOptions & NSDataWritingAtomic) != 0);
+            context = [mutableContext copy];
+        }
         
         @weakify(operation);
         operation.loaderOperation = [imageLoader requestImageWithURL:url options:options context:context progress:progressBlock completed:^(UIImage *downloadedImage, NSData *downloadedData, NSError *error, BOOL finished) {
             @strongify(operation);
             if (!operation || operation.isCancelled) {
                 // Image combined operation cancelled by user - 图像组合操作被用户取消
+                if (!error && finished) {
+                    // The streamed file is not moved into cache
+                    [self removeDownloadFileWithContext:context];
+                }
                 [self callCompletionBlockForOperation:operation completion:completedBlock error:[NSError errorWithDomain:SDWebImageErrorDomain code:SDWebImageErrorCancelled userInfo:@{NSLocalizedDescriptionKey : @"Operation cancelled by user during sending the request"}] url:url];
             } else if (cachedImage && options & SDWebImageRefreshCached && [error.domain isEqualToString:SDWebImageErrorDomain] && error.code == SDWebImageErrorCacheNotModified) {
                 // Image refresh hit the NSURLCache cache, do not call the completion block - 图像刷新命中NSURLCache缓存，不调用完成块
@@ -464,6 +478,9 @@ static id<SDImageLoader> _defaultImageLoader;
                                  finished:(BOOL)finished
                                  progress:(nullable SDImageLoaderProgressBlock)progressBlock
                                 completed:(nullable SDInternalCompletionBlock)completedBlock {
+    if (!downloadedImage || !finished) {
+        [self removeDownloadFileWithContext:context];
+    }
     // Grab the image cache to use, choose standalone original cache firstly
     /// 获取图像缓存，首先选择独立的原始缓存
     id<SDImageCache> imageCache;
@@ -518,11 +535,20 @@ static id<SDImageLoader> _defaultImageLoader;
                     }];
                 }
             });
+        } else if ([self canMoveDownloadFileWithContext:context imageCache:imageCache cacheType:targetStoreCacheType]) {
+            // The data is streamed into file, move the file into disk cache instead of writing the data again
+            /// 数据已流式写入文件，将文件移入硬盘缓存而不是再次写入数据
+            [self storeImage:downloadedImage imageFileAtPath:context[SDWebImageContextDownloadFilePath] forKey:key imageCache:(SDImageCache *)imageCache cacheType:targetStoreCacheType options:options completion:^{
+                // Continue transform process - 继续变换操作
+                [self callTransformProcessForOperation:operation url:url options:options context:context originalImage:downloadedImage originalData:downloadedData finished:finished progress:progressBlock completed:completedBlock];
+            }];
         } else {
             [self storeImage:downloadedImage imageData:downloadedData forKey:key imageCache:imageCache cacheType:targetStoreCacheType options:options context:context completion:^{
                 // Continue transform process - 继续变换操作
                 [self callTransformProcessForOperation:operation url:url options:options context:context originalImage:downloadedImage originalData:downloadedData finished:finished progress:progressBlock completed:completedBlock];
             }];
+            // The data is already mapped, the file is not needed any more
+            [self removeDownloadFileWithContext:context];
         }
     } else {
         // Continue transform process - 继续变换操作
@@ -627,6 +653,87 @@ static id<SDImageLoader> _defaultImageLoader;
     }
 }
 
+- (void)storeImage:(nullable UIImage *)image
+   imageFileAtPath:(nonnull NSString *)path
+            forKey:(nullable NSString *)key
+        imageCache:(nonnull SDImageCache *)imageCache
+         cacheType:(SDImageCacheType)cacheType
+           options:(SDWebImageOptions)options
+        completion:(nullable SDWebImageNoParamsBlock)completion {
+    BOOL waitStoreCache = SD_OPTIONS_CONTAINS(options, SDWebImageWaitStoreCache);
+    // Check whether we should wait the store cache finished. If not, callback immediately
+    /// 检查我们是否应该等待存储缓存完成。如果没有，立即回调
+    [imageCache storeImage:image imageFileAtPath:path forKey:key toMemory:(cacheType == SDImageCacheTypeAll) completion:^{
+        if (waitStoreCache) {
+            if (completion) {
+                completion();
+            }
+        }
+    }];
+    if (!waitStoreCache) {
+        if (completion) {
+            completion();
+        }
+    }
+}
+
+// The original image cache to stream the download into, nil if streaming is not available
+/// 流式下载使用的原始图像缓存，不可用时为nil
+- (nullable SDImageCache *)streamImageCacheForOptions:(SDWebImageOptions)options context:(nullable SDWebImageContext *)context {
+    if (!SD_OPTIONS_CONTAINS(options, SDWebImageStreamToDiskCache) || context[SDWebImageContextDownloadFilePath]) {
+        return nil;
+    }
+    // The cache serializer and the decryptor need the data in memory
+    if (context[SDWebImageContextCacheSerializer] || context[SDWebImageContextDownloadDecryptor]) {
+        return nil;
+    }
+    // Same as the store cache process
+    id<SDImageCache> imageCache;
+    if ([context[SDWebImageContextOriginalImageCache] conformsToProtocol:@protocol(SDImageCache)]) {
+        imageCache = context[SDWebImageContextOriginalImageCache];
+    } else if ([context[SDWebImageContextImageCache] conformsToProtocol:@protocol(SDImageCache)]) {
+        imageCache = context[SDWebImageContextImageCache];
+    } else {
+        imageCache = self.imageCache;
+    }
+    if (![imageCache isKindOfClass:[SDImageCache class]]) {
+        return nil;
+    }
+    SDImageCacheType storeCacheType = SDImageCacheTypeAll;
+    if (context[SDWebImageContextStoreCacheType]) {
+        storeCacheType = [context[SDWebImageContextStoreCacheType] integerValue];
+    }
+    SDImageCacheType originalStoreCacheType = SDImageCacheTypeDisk;
+    if (context[SDWebImageContextOriginalStoreCacheType]) {
+        originalStoreCacheType = [context[SDWebImageContextOriginalStoreCacheType] integerValue];
+    }
+    // If the image is transformed, the original image use the original store cache type
+    SDImageCacheType targetStoreCacheType = context[SDWebImageContextImageTransformer] ? originalStoreCacheType : storeCacheType;
+    if (targetStoreCacheType != SDImageCacheTypeDisk && targetStoreCacheType != SDImageCacheTypeAll) {
+        return nil;
+    }
+    return (SDImageCache *)imageCache;
+}
+
+- (BOOL)canMoveDownloadFileWithContext:(nullable SDWebImageContext *)context imageCache:(nonnull id<SDImageCache>)imageCache cacheType:(SDImageCacheType)cacheType {
+    NSString *path = context[SDWebImageContextDownloadFilePath];
+    if (!path || ![imageCache isKindOfClass:[SDImageCache class]]) {
+        return NO;
+    }
+    if (cacheType != SDImageCacheTypeDisk && cacheType != SDImageCacheTypeAll) {
+        return NO;
+    }
+    // A shared download operation only writes the file from the context of the first request
+    return [[NSFileManager defaultManager] fileExistsAtPath:path];
+}
+
+- (void)removeDownloadFileWithContext:(nullable SDWebImageContext *)context {
+    NSString *path = context[SDWebImageContextDownloadFilePath];
+    if (path) {
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    }
+}
+
 - (void)callCompletionBlockForOperation:(nullable SDWebImageCombinedOperation*)operation
                              completion:(nullable SDInternalCompletionBlock)completionBlock
                                   error:(nullable NSError *)error
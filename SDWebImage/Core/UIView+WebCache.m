@@ -13,9 +13,39 @@
 #import "SDInternalMacros.h"
 #import "SDWebImageTransitionInternal.h"
 #import "SDImageCache.h"
+#import "SDMemoryCache.h"
 
 const int64_t SDWebImageProgressUnitCountUnknown = 1LL;
 
+/// Keep the memory cache entry of the image on screen pinned, the pin is released when this object is released (cancel, replacement or the view released)
+/// 保持屏幕上图片的内存缓存条目被固定，当此对象被释放时(取消、替换或视图被释放)取消固定
+@interface SDWebImageMemoryCachePin : NSObject
+
+@property (nonatomic, strong, readonly, nonnull) SDMemoryCache *memoryCache;
+@property (nonatomic, copy, readonly, nonnull) NSString *key;
+
+- (nonnull instancetype)initWithMemoryCache:(nonnull SDMemoryCache *)memoryCache key:(nonnull NSString *)key;
+
+@end
+
+@implementation SDWebImageMemoryCachePin
+
+- (instancetype)initWithMemoryCache:(SDMemoryCache *)memoryCache key:(NSString *)key {
+    self = [super init];
+    if (self) {
+        _memoryCache = memoryCache;
+        _key = [key copy];
+        [_memoryCache pinObjectForKey:_key];
+    }
+    return self;
+}
+
+- (void)dealloc {
+    [_memoryCache unpinObjectForKey:_key];
+}
+
+@end
+
 @implementation UIView (WebCache)
 
 - (nullable NSURL *)sd_imageURL {
@@ -34,6 +64,14 @@ const int64_t SDWebImageProgressUnitCountUnknown = 1LL;
     objc_setAssociatedObject(self, @selector(sd_latestOperationKey), sd_latestOperationKey, OBJC_ASSOCIATION_COPY_NONATOMIC);
 }
 
+- (nullable SDWebImageMemoryCachePin *)sd_memoryCachePin {
+    return objc_getAssociatedObject(self, @selector(sd_memoryCachePin));
+}
+
+- (void)setSd_memoryCachePin:(SDWebImageMemoryCachePin * _Nullable)sd_memoryCachePin {
+    objc_setAssociatedObject(self, @selector(sd_memoryCachePin), sd_memoryCachePin, OBJC_ASSOCIATION_RETAIN_NONATOMIC);
+}
+
 - (NSProgress *)sd_imageProgress {
     NSProgress *progress = objc_getAssociatedObject(self, @selector(sd_imageProgress));
     if (!progress) {
@@ -70,6 +108,8 @@ const int64_t SDWebImageProgressUnitCountUnknown = 1LL;
     }
     self.sd_latestOperationKey = validOperationKey;
     [self sd_cancelImageLoadOperationWithKey:validOperationKey];
+    // The previous image is being replaced, release its pin
+    self.sd_memoryCachePin = nil;
     self.sd_imageURL = url;
     
     SDWebImageManager *manager = context[SDWebImageContextCustomManager];
@@ -83,8 +123,16 @@ const int64_t SDWebImageProgressUnitCountUnknown = 1LL;
     }
     
     BOOL shouldUseWeakCache = NO;
+    SDMemoryCache *pinnableMemoryCache;
+    NSString *pinKey;
     if ([manager.imageCache isKindOfClass:SDImageCache.class]) {
         shouldUseWeakCache = ((SDImageCache *)manager.imageCache).config.shouldUseWeakMemoryCache;
+        id<SDMemoryCache> memoryCache = ((SDImageCache *)manager.imageCache).memoryCache;
+        if (url && [memoryCache isKindOfClass:SDMemoryCache.class]) {
+            // Don't capture the manager in the completion block, see above
+            pinnableMemoryCache = (SDMemoryCache *)memoryCache;
+            pinKey = [manager cacheKeyForURL:url context:context];
+        }
     }
     if (!(options & SDWebImageDelayPlaceholder)) {
         if (shouldUseWeakCache) {
@@ -219,6 +267,10 @@ const int64_t SDWebImageProgressUnitCountUnknown = 1LL;
 #else
                 [self sd_setImage:targetImage imageData:targetData basedOnClassOrViaCustomSetImageBlock:setImageBlock cacheType:cacheType imageURL:imageURL];
 #endif
+                if (pinnableMemoryCache && pinKey && image && finished) {
+                    // Keep the image on screen in the memory cache under pressure trimming
+                    self.sd_memoryCachePin = [[SDWebImageMemoryCachePin alloc] initWithMemoryCache:pinnableMemoryCache key:pinKey];
+                }
                 callCompletedBlockClosure();
             });
         }];
@@ -239,6 +291,7 @@ const int64_t SDWebImageProgressUnitCountUnknown = 1LL;
 - (void)sd_cancelCurrentImageLoad {
     [self sd_cancelImageLoadOperationWithKey:self.sd_latestOperationKey];
     self.sd_latestOperationKey = nil;
+    self.sd_memoryCachePin = nil;
 }
 
 - (void)sd_setImage:(UIImage *)image imageData:(NSData *)imageData basedOnClassOrViaCustomSetImageBlock:(SDSetImageBlock)setImageBlock cacheType:(SDImageCacheType)cacheType imageURL:(NSURL *)imageURL {
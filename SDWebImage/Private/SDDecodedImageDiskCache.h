@@ -0,0 +1,47 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+@class SDImageCacheConfig;
+
+/**
+ The optional third cache tier of `SDImageCache`, which persists the already-decoded pixel buffer (with a width/height/stride/format header) and maps it back without decoding.
+ It's backed by a private `SDDiskCache` in a sibling directory, which has its own byte budget (`decodedDiskCacheLimit`) and always use the zero-copy mapped reading. The image is populated only when its key has been decoded from the disk data for `decodedDiskCachePopulateThreshold` times, because a raw bitmap is much larger than the encoded data.
+ `SDImageCache`的可选第三级缓存，持久化已解码的像素缓冲区(带有宽/高/行字节数/格式头部)，并且无需解码即可映射回来
+ 它由兄弟目录中的私有`SDDiskCache`支持，拥有自己的字节预算(`decodedDiskCacheLimit`)，并且总是使用零拷贝映射读取。只有当key被从硬盘数据解码达到`decodedDiskCachePopulateThreshold`次时才会写入，因为原始位图比编码数据大得多
+ */
+@interface SDDecodedImageDiskCache : NSObject
+
+- (nonnull instancetype)initWithCachePath:(nonnull NSString *)cachePath config:(nonnull SDImageCacheConfig *)config NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/// 缓存路径
+@property (nonatomic, copy, readonly, nonnull) NSString *cachePath;
+/// 总大小
+@property (nonatomic, assign, readonly) NSUInteger totalSize;
+
+/// Map the decoded image for key, returns nil if not exist or the file is invalid
+/// 映射key对应的已解码图片，不存在或文件无效时返回nil
+- (nullable UIImage *)imageForKey:(nonnull NSString *)key;
+/// Record one decode of key, and returns whether the decoded image should be stored
+/// 记录key的一次解码，返回是否应该存储已解码图片
+- (BOOL)shouldStoreImage:(nonnull UIImage *)image forKey:(nonnull NSString *)key;
+/// Store the decoded pixel buffer of image, then trim to the byte budget if needed
+/// 存储图片的已解码像素缓冲区，如需要则裁剪到字节预算
+- (void)storeImage:(nonnull UIImage *)image forKey:(nonnull NSString *)key;
+/// 删除key对应的已解码图片
+- (void)removeImageForKey:(nonnull NSString *)key;
+/// 删除所有已解码图片
+- (void)removeAllImages;
+/// Remove the expired images, and trim to the byte budget
+/// 删除过期的图片，并裁剪到字节预算
+- (void)removeExpiredImages;
+
+@end
@@ -0,0 +1,259 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDDecodedImageDiskCache.h"
+#import "SDDiskCache.h"
+#import "SDImageCacheConfig.h"
+#import "SDImageCoderHelper.h"
+#import "NSImage+Compatibility.h"
+#import "UIImage+Metadata.h"
+#import "UIImage+ForceDecode.h"
+
+/// 文件魔数 'SDRB'
+static const uint32_t kSDDecodedImageMagic = 0x53445242;
+/// 文件格式版本
+static const uint32_t kSDDecodedImageVersion = 2;
+/// The alignment of the pixels offset
+/// 像素偏移的对齐
+static const size_t kSDDecodedImagePixelAlignment = 64;
+/// The low watermark of byte budget, keep some room to avoid trimming on every store
+/// 字节预算的低水位，保留一些空间以避免每次存储都进行裁剪
+static const double kSDDecodedImageLowWatermark = 0.8;
+/// 解码次数统计的最大key数
+static const NSUInteger kSDDecodedImageMaxCountedKeys = 1024;
+
+/// The header of the raw bitmap file, padded to 64 bytes. It's followed by the ICC profile of the color space (empty means device RGB), then the pixels at an aligned offset
+/// 原始位图文件的头部，填充到64字节。其后是色彩空间的ICC配置文件(为空表示设备RGB)，然后是位于对齐偏移处的像素
+typedef struct __attribute__((packed)) SDDecodedImageHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t bytesPerRow;
+    uint32_t bitsPerComponent;
+    uint32_t bitsPerPixel;
+    uint32_t bitmapInfo;
+    double scale;
+    uint32_t orientation; // EXIF orientation
+    uint32_t format; // SDImageFormat
+    uint32_t colorSpaceLength; // the ICC profile length
+    uint32_t pixelOffset;
+    uint8_t reserved[8];
+} SDDecodedImageHeader;
+
+static void SDDecodedImageReleaseData(void *info, const void *data, size_t size) {
+    // Release the mapped NSData, which unmaps the file
+    CFRelease(info);
+}
+
+// Return the ICC profile to store, nil for device RGB. Return NO if the color space can not be stored
+static BOOL SDDecodedImageCopyICCData(CGColorSpaceRef colorSpace, CFDataRef *iccData) {
+    *iccData = NULL;
+    if (CFEqual(colorSpace, [SDImageCoderHelper colorSpaceGetDeviceRGB])) {
+        return YES;
+    }
+    if (@available(iOS 10, tvOS 10, macOS 10.12, watchOS 3, *)) {
+        *iccData = CGColorSpaceCopyICCData(colorSpace);
+    }
+    return *iccData != NULL;
+}
+
+// Create the color space from the ICC profile after header, or device RGB when empty
+static CGColorSpaceRef SDDecodedImageCreateColorSpace(NSData *data, uint32_t colorSpaceLength) {
+    if (colorSpaceLength == 0) {
+        return CGColorSpaceRetain([SDImageCoderHelper colorSpaceGetDeviceRGB]);
+    }
+    CGColorSpaceRef colorSpace = NULL;
+    if (@available(iOS 10, tvOS 10, macOS 10.12, watchOS 3, *)) {
+        NSData *iccData = [data subdataWithRange:NSMakeRange(sizeof(SDDecodedImageHeader), colorSpaceLength)];
+        colorSpace = CGColorSpaceCreateWithICCData((__bridge CFDataRef)iccData);
+    }
+    return colorSpace;
+}
+
+@interface SDDecodedImageDiskCache ()
+/// 存储原始位图的硬盘缓存
+@property (nonatomic, strong, nonnull) SDDiskCache *diskCache;
+/// 解码次数统计
+@property (nonatomic, strong, nonnull) NSCache<NSString *, NSNumber *> *decodeCounts;
+/// 写入阈值
+@property (nonatomic, assign) NSUInteger populateThreshold;
+
+@end
+
+@implementation SDDecodedImageDiskCache
+
+- (instancetype)initWithCachePath:(NSString *)cachePath config:(SDImageCacheConfig *)config {
+    self = [super init];
+    if (self) {
+        _cachePath = [cachePath copy];
+        // Own byte budget, and always map the raw bitmap
+        /// 独立的字节预算，并且总是映射原始位图
+        SDImageCacheConfig *diskConfig = [config copy];
+        diskConfig.maxDiskSize = config.decodedDiskCacheLimit;
+        diskConfig.diskCacheHighWatermark = 1.0;
+        diskConfig.diskCacheLowWatermark = kSDDecodedImageLowWatermark;
+        diskConfig.diskCacheWritingOptions |= NSDataWritingAtomic;
+        diskConfig.diskCacheMappedReadingThreshold = 1;
+        _diskCache = [[SDDiskCache alloc] initWithCachePath:_cachePath config:diskConfig];
+        _decodeCounts = [[NSCache alloc] init];
+        _decodeCounts.countLimit = kSDDecodedImageMaxCountedKeys;
+        _populateThreshold = config.decodedDiskCachePopulateThreshold;
+    }
+    return self;
+}
+
+- (NSUInteger)totalSize {
+    return self.diskCache.totalSize;
+}
+
+- (UIImage *)imageForKey:(NSString *)key {
+    NSData *data = [self.diskCache dataForKey:key];
+    if (data.length < sizeof(SDDecodedImageHeader)) {
+        return nil;
+    }
+    SDDecodedImageHeader header;
+    memcpy(&header, data.bytes, sizeof(header));
+    if (header.magic != kSDDecodedImageMagic || header.version != kSDDecodedImageVersion) {
+        return nil;
+    }
+    size_t pixelLength = (size_t)header.bytesPerRow * header.height;
+    if (header.width == 0 || header.height == 0 || header.bytesPerRow < (size_t)header.width * header.bitsPerPixel / 8
+        || header.pixelOffset < sizeof(header) + (size_t)header.colorSpaceLength || data.length < (size_t)header.pixelOffset + pixelLength) {
+        return nil;
+    }
+    CGColorSpaceRef colorSpace = SDDecodedImageCreateColorSpace(data, header.colorSpaceLength);
+    if (!colorSpace) {
+        return nil;
+    }
+    // The data provider retains the mapped data, no copy and no decode
+    /// 数据提供者持有映射的数据，没有拷贝也没有解码
+    CGDataProviderRef provider = CGDataProviderCreateWithData((__bridge_retained void *)data, (const uint8_t *)data.bytes + header.pixelOffset, pixelLength, SDDecodedImageReleaseData);
+    if (!provider) {
+        CGColorSpaceRelease(colorSpace);
+        return nil;
+    }
+    CGImageRef imageRef = CGImageCreate(header.width, header.height, header.bitsPerComponent, header.bitsPerPixel, header.bytesPerRow, colorSpace, header.bitmapInfo, provider, NULL, false, kCGRenderingIntentDefault);
+    CGDataProviderRelease(provider);
+    CGColorSpaceRelease(colorSpace);
+    if (!imageRef) {
+        return nil;
+    }
+    CGFloat scale = header.scale >= 1 ? header.scale : 1;
+#if SD_UIKIT || SD_WATCH
+    UIImageOrientation imageOrientation = [SDImageCoderHelper imageOrientationFromEXIFOrientation:header.orientation];
+    UIImage *image = [[UIImage alloc] initWithCGImage:imageRef scale:scale orientation:imageOrientation];
+#else
+    UIImage *image = [[UIImage alloc] initWithCGImage:imageRef scale:scale orientation:header.orientation];
+#endif
+    CGImageRelease(imageRef);
+    image.sd_isDecoded = YES;
+    image.sd_imageFormat = header.format;
+    return image;
+}
+
+- (BOOL)shouldStoreImage:(UIImage *)image forKey:(NSString *)key {
+    // Only the static bitmap image can be mapped back
+    /// 只有静态位图可以被映射回来
+    if (image.sd_isAnimated || image.class != UIImage.class || !image.sd_isDecoded) {
+        return NO;
+    }
+    NSUInteger count = [self.decodeCounts objectForKey:key].unsignedIntegerValue + 1;
+    [self.decodeCounts setObject:@(count) forKey:key];
+    return count >= self.populateThreshold;
+}
+
+- (void)storeImage:(UIImage *)image forKey:(NSString *)key {
+    CGImageRef imageRef = image.CGImage;
+    if (!imageRef) {
+        return;
+    }
+    size_t bitsPerComponent = CGImageGetBitsPerComponent(imageRef);
+    size_t bitsPerPixel = CGImageGetBitsPerPixel(imageRef);
+    CGColorSpaceRef colorSpace = CGImageGetColorSpace(imageRef);
+    if (bitsPerComponent != 8 || bitsPerPixel != 32 || !colorSpace || CGColorSpaceGetModel(colorSpace) != kCGColorSpaceModelRGB) {
+        return;
+    }
+    size_t width = CGImageGetWidth(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    size_t bytesPerRow = CGImageGetBytesPerRow(imageRef);
+    size_t pixelLength = bytesPerRow * height;
+    if (width > UINT32_MAX || height > UINT32_MAX || bytesPerRow > UINT32_MAX || pixelLength + sizeof(SDDecodedImageHeader) > self.diskCache.config.maxDiskSize || bytesPerRow * 8 < width * bitsPerPixel) {
+        return;
+    }
+    // Keep the color space, so the wide gamut image is not shifted to sRGB
+    /// 保留色彩空间，使广色域图片不会被偏移到sRGB
+    CFDataRef iccData;
+    if (!SDDecodedImageCopyICCData(colorSpace, &iccData)) {
+        return;
+    }
+    size_t colorSpaceLength = iccData ? (size_t)CFDataGetLength(iccData) : 0;
+    size_t pixelOffset = (sizeof(SDDecodedImageHeader) + colorSpaceLength + kSDDecodedImagePixelAlignment - 1) / kSDDecodedImagePixelAlignment * kSDDecodedImagePixelAlignment;
+    uint8_t *buffer = calloc(1, pixelOffset + pixelLength);
+    if (!buffer) {
+        if (iccData) CFRelease(iccData);
+        return;
+    }
+    // Draw into the file buffer directly, which is the only pixel copy. The context has the same layout as the image, so it's a plain blit
+    /// 直接绘制到文件缓冲区中，这是唯一的一次像素拷贝。上下文与图片布局相同，因此只是普通的位块传输
+    CGContextRef context = CGBitmapContextCreate(buffer + pixelOffset, width, height, bitsPerComponent, bytesPerRow, colorSpace, CGImageGetBitmapInfo(imageRef));
+    if (!context) {
+        free(buffer);
+        if (iccData) CFRelease(iccData);
+        return;
+    }
+    CGContextSetBlendMode(context, kCGBlendModeCopy);
+    CGContextDrawImage(context, CGRectMake(0, 0, width, height), imageRef);
+    CGContextRelease(context);
+    SDDecodedImageHeader header = {0};
+    header.magic = kSDDecodedImageMagic;
+    header.version = kSDDecodedImageVersion;
+    header.width = (uint32_t)width;
+    header.height = (uint32_t)height;
+    header.bytesPerRow = (uint32_t)bytesPerRow;
+    header.bitsPerComponent = (uint32_t)bitsPerComponent;
+    header.bitsPerPixel = (uint32_t)bitsPerPixel;
+    header.bitmapInfo = CGImageGetBitmapInfo(imageRef);
+    header.scale = image.scale;
+#if SD_UIKIT || SD_WATCH
+    header.orientation = [SDImageCoderHelper exifOrientationFromImageOrientation:image.imageOrientation];
+#else
+    header.orientation = kCGImagePropertyOrientationUp;
+#endif
+    header.format = (uint32_t)image.sd_imageFormat;
+    header.colorSpaceLength = (uint32_t)colorSpaceLength;
+    header.pixelOffset = (uint32_t)pixelOffset;
+    memcpy(buffer, &header, sizeof(header));
+    if (iccData) {
+        memcpy(buffer + sizeof(header), CFDataGetBytePtr(iccData), colorSpaceLength);
+        CFRelease(iccData);
+    }
+    NSData *data = [NSData dataWithBytesNoCopy:buffer length:pixelOffset + pixelLength freeWhenDone:YES];
+
+    [self.diskCache setData:data forKey:key];
+    [self.decodeCounts removeObjectForKey:key];
+    if (self.diskCache.totalSize > self.diskCache.config.maxDiskSize) {
+        [self.diskCache removeExpiredData];
+    }
+}
+
+- (void)removeImageForKey:(NSString *)key {
+    [self.decodeCounts removeObjectForKey:key];
+    [self.diskCache removeDataForKey:key];
+}
+
+- (void)removeAllImages {
+    [self.decodeCounts removeAllObjects];
+    [self.diskCache removeAllData];
+}
+
+- (void)removeExpiredImages {
+    [self.diskCache removeExpiredData];
+}
+
+@end
@@ -0,0 +1,95 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/// The metadata of one cache file, the date is the time interval since 1970
+/// 一个缓存文件的元数据，日期为1970年以来的时间间隔
+@interface SDDiskCacheIndexEntry : NSObject <NSCopying>
+
+/// 文件名
+@property (nonatomic, copy, nonnull) NSString *fileName;
+/// 文件大小
+@property (nonatomic, assign) NSUInteger size;
+/// 创建日期
+@property (nonatomic, assign) NSTimeInterval creationDate;
+/// 修改日期
+@property (nonatomic, assign) NSTimeInterval modificationDate;
+/// 访问日期
+@property (nonatomic, assign) NSTimeInterval accessDate;
+/// 属性修改日期(包括扩展数据)
+@property (nonatomic, assign) NSTimeInterval changeDate;
+/// 访问次数
+@property (nonatomic, assign) NSUInteger accessCount;
+/// The GDSF inflation value `L` when the file was last written or accessed
+/// 文件上次写入或访问时GDSF的膨胀值`L`
+@property (nonatomic, assign) double inflation;
+/// The Greedy-Dual-Size-Frequency priority `H = L + frequency * cost / size`, computed from `inflation` with the cost of the index when the entry is returned
+/// GDSF优先级`H = L + 频率 * 代价 / 大小`，在返回条目时根据`inflation`和索引的代价计算
+@property (nonatomic, assign) double priority;
+
+@end
+
+/**
+ A persistent metadata index of the files inside the disk cache directory, which is updated incrementally on set/get/remove. So that the size query and expiration never walk the directory.
+ The index is stored as a snapshot file with an append-only journal inside the cache directory (hidden files). The journal is folded into the snapshot when it grows too large. When the index files are missing (first launch or upgrade), the index is rebuilt by scanning the directory once.
+ 硬盘缓存目录中文件的持久化元数据索引，在写入/读取/删除时增量更新。因此大小查询和过期清理不再需要遍历目录
+ 索引以快照文件加只追加日志的形式存储在缓存目录中(隐藏文件)。日志过大时会合并到快照中。当索引文件缺失时(首次启动或升级)，会扫描一次目录重建索引
+ The access records are coalesced in memory and written in batch, after a short interval, when the app enters background or terminates, or with `flushAccessRecords`. A crash may lose the recent access dates and counts, but never the sizes.
+ The index assumes that it is the only owner of the directory: only one instance (in one process) for each path. Multiple instances on the same path write the same journal and get out of sync.
+ 访问记录在内存中合并后批量写入，时机为短暂间隔后、app进入后台或终止时、或调用`flushAccessRecords`。崩溃可能丢失最近的访问日期和次数，但不会丢失大小
+ 索引假定它是目录的唯一所有者：每个路径只有一个实例(在一个进程中)。同一路径上的多个实例会写入同一个日志并导致不一致
+ */
+@interface SDDiskCacheIndex : NSObject
+
+- (nonnull instancetype)initWithDirectory:(nonnull NSString *)directory fileManager:(nonnull NSFileManager *)fileManager NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/// 所有文件的总大小
+@property (nonatomic, assign, readonly) NSUInteger totalSize;
+/// 文件总数
+@property (nonatomic, assign, readonly) NSUInteger totalCount;
+/// The GDSF inflation value `L`, which is the priority of the last evicted file. It's persisted and only increases
+/// GDSF的膨胀值`L`，即上一个被淘汰文件的优先级。会被持久化且只增不减
+@property (nonatomic, assign) double inflation;
+/// Whether the GDSF cost is the file size (maximizes the byte hit ratio), otherwise the cost is 1 (maximizes the hit ratio). Defaults to NO
+/// GDSF的代价是否为文件大小(最大化字节命中率)，否则代价为1(最大化命中率)。默认为NO
+@property (atomic, assign) BOOL byteOrientedCost;
+
+/// Returns a copy of the entry, or nil if the file is not indexed
+/// 返回条目的拷贝，如果文件未被索引则返回nil
+- (nullable SDDiskCacheIndexEntry *)entryForFileName:(nonnull NSString *)fileName;
+/// Returns a copy of all the entries
+/// 返回所有条目的拷贝
+- (nonnull NSArray<SDDiskCacheIndexEntry *> *)allEntries;
+
+/// 记录文件写入
+- (void)recordWriteForFileName:(nonnull NSString *)fileName size:(NSUInteger)size;
+/// Record the file read, add the entry if the file is not indexed (written by others)
+/// 记录文件读取，如果文件未被索引(由其他方写入)则添加条目
+- (void)recordAccessForFileName:(nonnull NSString *)fileName size:(NSUInteger)size;
+/// 记录文件属性修改
+- (void)recordChangeForFileName:(nonnull NSString *)fileName;
+/// 删除条目
+- (void)removeEntryForFileName:(nonnull NSString *)fileName;
+/// Remove all the entries and the index files
+/// 删除所有条目和索引文件
+- (void)removeAllEntries;
+
+/// Drop the current index and rebuild it by scanning the directory
+/// 丢弃当前索引并扫描目录重建
+- (void)rebuild;
+/// Fold the journal into the snapshot
+/// 将日志合并到快照
+- (void)synchronize;
+/// Write the coalesced access records into the journal
+/// 将合并的访问记录写入日志
+- (void)flushAccessRecords;
+
+@end
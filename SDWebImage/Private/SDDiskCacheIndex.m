@@ -0,0 +1,606 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDDiskCacheIndex.h"
+#import "SDInternalMacros.h"
+#import <errno.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+/// 索引快照文件名
+static NSString * const SDDiskCacheIndexSnapshotName = @".SDDiskCacheIndex";
+/// 索引日志文件名
+static NSString * const SDDiskCacheIndexJournalName = @".SDDiskCacheIndex.journal";
+/// 文件魔数 'SDDI'
+static const uint32_t kSDDiskCacheIndexMagic = 0x53444449;
+/// 文件格式版本
+static const uint32_t kSDDiskCacheIndexVersion = 3;
+/// The minimum journal record count to fold the journal into snapshot
+/// 将日志合并到快照的最小日志记录数
+static const NSUInteger kSDDiskCacheIndexMinJournalCount = 1024;
+/// The coalesced access records are written when reaching this count, or after the flush interval
+/// 合并的访问记录达到该数量，或经过刷新间隔后写入
+static const NSUInteger kSDDiskCacheIndexAccessBatchCount = 256;
+/// 访问记录的刷新间隔(秒)
+static const NSTimeInterval kSDDiskCacheIndexAccessFlushInterval = 5;
+
+/// 记录操作类型
+typedef NS_ENUM(uint8_t, SDDiskCacheIndexOperation) {
+    SDDiskCacheIndexOperationUpsert = 1,
+    SDDiskCacheIndexOperationRemove = 2,
+    SDDiskCacheIndexOperationInflation = 3, // the file name is empty, followed by a double value
+};
+
+/// The file header of both snapshot and journal
+/// 快照和日志共用的文件头
+typedef struct __attribute__((packed)) SDDiskCacheIndexHeader {
+    uint32_t magic;
+    uint32_t version;
+} SDDiskCacheIndexHeader;
+
+/// The fixed part of upsert record, which follows the operation and file name
+/// 写入记录的固定部分，跟在操作类型和文件名之后
+typedef struct __attribute__((packed)) SDDiskCacheIndexRecord {
+    uint64_t size;
+    double creationDate;
+    double modificationDate;
+    double accessDate;
+    double changeDate;
+    uint32_t accessCount;
+    double inflation;
+} SDDiskCacheIndexRecord;
+
+@implementation SDDiskCacheIndexEntry
+
+- (id)copyWithZone:(NSZone *)zone {
+    SDDiskCacheIndexEntry *entry = [[[self class] allocWithZone:zone] init];
+    entry.fileName = self.fileName;
+    entry.size = self.size;
+    entry.creationDate = self.creationDate;
+    entry.modificationDate = self.modificationDate;
+    entry.accessDate = self.accessDate;
+    entry.changeDate = self.changeDate;
+    entry.accessCount = self.accessCount;
+    entry.inflation = self.inflation;
+    entry.priority = self.priority;
+    return entry;
+}
+
+@end
+
+// GDSF priority `H = L + frequency * cost / size`, the cost is the size (byte hit ratio) or 1 (hit ratio)
+static inline double SDDiskCacheIndexPriority(SDDiskCacheIndexEntry *entry, BOOL byteOrientedCost) {
+    double frequency = (double)entry.accessCount + 1;
+    if (byteOrientedCost) {
+        return entry.inflation + frequency;
+    }
+    return entry.inflation + frequency / (double)MAX(entry.size, 1);
+}
+
+// Append one record into buffer, `entry` is ignored for remove operation
+static void SDDiskCacheIndexEncodeRecord(NSMutableData *buffer, SDDiskCacheIndexOperation operation, NSString *fileName, SDDiskCacheIndexEntry *entry) {
+    NSData *nameData = [fileName dataUsingEncoding:NSUTF8StringEncoding];
+    if (nameData.length > UINT16_MAX) {
+        return;
+    }
+    uint8_t op = operation;
+    uint16_t nameLength = (uint16_t)nameData.length;
+    [buffer appendBytes:&op length:sizeof(op)];
+    [buffer appendBytes:&nameLength length:sizeof(nameLength)];
+    [buffer appendData:nameData];
+    if (operation == SDDiskCacheIndexOperationUpsert) {
+        SDDiskCacheIndexRecord record = {entry.size, entry.creationDate, entry.modificationDate, entry.accessDate, entry.changeDate, (uint32_t)MIN(entry.accessCount, UINT32_MAX), entry.inflation};
+        [buffer appendBytes:&record length:sizeof(record)];
+    }
+}
+
+// Write the whole buffer, returns NO on any error or short write
+static BOOL SDDiskCacheIndexWrite(int fd, const void *bytes, size_t length) {
+    const uint8_t *cursor = bytes;
+    while (length > 0) {
+        ssize_t written = write(fd, cursor, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return NO;
+        }
+        cursor += written;
+        length -= (size_t)written;
+    }
+    return YES;
+}
+
+static void SDDiskCacheIndexEncodeInflation(NSMutableData *buffer, double inflation) {
+    uint8_t op = SDDiskCacheIndexOperationInflation;
+    uint16_t nameLength = 0;
+    [buffer appendBytes:&op length:sizeof(op)];
+    [buffer appendBytes:&nameLength length:sizeof(nameLength)];
+    [buffer appendBytes:&inflation length:sizeof(inflation)];
+}
+
+// Replay all the records in data into entries, returns NO if the data is invalid or has a truncated tail
+static BOOL SDDiskCacheIndexDecodeRecords(NSData *data, NSMutableDictionary<NSString *, SDDiskCacheIndexEntry *> *entries, double *inflation) {
+    const uint8_t *bytes = data.bytes;
+    NSUInteger length = data.length;
+    if (length < sizeof(SDDiskCacheIndexHeader)) {
+        return NO;
+    }
+    SDDiskCacheIndexHeader header;
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != kSDDiskCacheIndexMagic || header.version != kSDDiskCacheIndexVersion) {
+        return NO;
+    }
+    NSUInteger offset = sizeof(header);
+    while (offset < length) {
+        if (offset + sizeof(uint8_t) + sizeof(uint16_t) > length) {
+            return NO;
+        }
+        uint8_t op = bytes[offset];
+        uint16_t nameLength;
+        memcpy(&nameLength, bytes + offset + sizeof(uint8_t), sizeof(nameLength));
+        offset += sizeof(uint8_t) + sizeof(uint16_t);
+        if (offset + nameLength > length) {
+            return NO;
+        }
+        NSString *fileName = [[NSString alloc] initWithBytes:bytes + offset length:nameLength encoding:NSUTF8StringEncoding];
+        offset += nameLength;
+        if (!fileName) {
+            return NO;
+        }
+        if (op == SDDiskCacheIndexOperationUpsert) {
+            if (offset + sizeof(SDDiskCacheIndexRecord) > length) {
+                return NO;
+            }
+            SDDiskCacheIndexRecord record;
+            memcpy(&record, bytes + offset, sizeof(record));
+            offset += sizeof(record);
+            SDDiskCacheIndexEntry *entry = [SDDiskCacheIndexEntry new];
+            entry.fileName = fileName;
+            entry.size = (NSUInteger)record.size;
+            entry.creationDate = record.creationDate;
+            entry.modificationDate = record.modificationDate;
+            entry.accessDate = record.accessDate;
+            entry.changeDate = record.changeDate;
+            entry.accessCount = record.accessCount;
+            entry.inflation = record.inflation;
+            entries[fileName] = entry;
+        } else if (op == SDDiskCacheIndexOperationRemove) {
+            [entries removeObjectForKey:fileName];
+        } else if (op == SDDiskCacheIndexOperationInflation) {
+            if (offset + sizeof(double) > length) {
+                return NO;
+            }
+            memcpy(inflation, bytes + offset, sizeof(double));
+            offset += sizeof(double);
+        } else {
+            return NO;
+        }
+    }
+    return YES;
+}
+
+@interface SDDiskCacheIndex () {
+    SD_LOCK_DECLARE(_lock); // a lock to keep the access to entries thread-safe
+    NSMutableDictionary<NSString *, SDDiskCacheIndexEntry *> *_entries;
+    NSUInteger _totalSize;
+    double _inflation;
+    NSMutableSet<NSString *> *_pendingAccessNames; // the accessed files whose records are not written yet
+    BOOL _flushScheduled;
+    SD_LOCK_DECLARE(_journalLock); // a lock to keep the journal file thread-safe, always acquired after `_lock`
+    int _journalFD;
+    NSUInteger _journalCount;
+    BOOL _journalFailed; // the index files can not be written, keep in memory only until the next snapshot succeeds
+}
+/// 缓存目录
+@property (nonatomic, copy, nonnull) NSString *directory;
+/// 文件管理器
+@property (nonatomic, strong, nonnull) NSFileManager *fileManager;
+
+@end
+
+@implementation SDDiskCacheIndex
+
+- (void)dealloc {
+    [[NSNotificationCenter defaultCenter] removeObserver:self];
+    [self flushAccessRecords];
+    if (_journalFD >= 0) {
+        close(_journalFD);
+    }
+}
+
+- (instancetype)initWithDirectory:(NSString *)directory fileManager:(NSFileManager *)fileManager {
+    self = [super init];
+    if (self) {
+        _directory = [directory copy];
+        _fileManager = fileManager;
+        _entries = [NSMutableDictionary dictionary];
+        _pendingAccessNames = [NSMutableSet set];
+        _journalFD = -1;
+        SD_LOCK_INIT(_lock);
+        SD_LOCK_INIT(_journalLock);
+        SD_LOCK(_lock);
+        [self _load];
+        SD_UNLOCK(_lock);
+        
+#if SD_UIKIT
+        // Write the coalesced access records before the app may be suspended or killed
+        /// 在app可能被挂起或杀死之前写入合并的访问记录
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationWillTerminate:)
+                                                     name:UIApplicationWillTerminateNotification
+                                                   object:nil];
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationWillTerminate:)
+                                                     name:UIApplicationDidEnterBackgroundNotification
+                                                   object:nil];
+#endif
+#if SD_MAC
+        [[NSNotificationCenter defaultCenter] addObserver:self
+                                                 selector:@selector(applicationWillTerminate:)
+                                                     name:NSApplicationWillTerminateNotification
+                                                   object:nil];
+#endif
+    }
+    return self;
+}
+
+#if SD_UIKIT || SD_MAC
+- (void)applicationWillTerminate:(NSNotification *)notification {
+    [self flushAccessRecords];
+}
+#endif
+
+#pragma mark - Query
+
+- (NSUInteger)totalSize {
+    SD_LOCK(_lock);
+    NSUInteger totalSize = _totalSize;
+    SD_UNLOCK(_lock);
+    return totalSize;
+}
+
+- (NSUInteger)totalCount {
+    SD_LOCK(_lock);
+    NSUInteger totalCount = _entries.count;
+    SD_UNLOCK(_lock);
+    return totalCount;
+}
+
+- (SDDiskCacheIndexEntry *)entryForFileName:(NSString *)fileName {
+    BOOL byteOrientedCost = self.byteOrientedCost;
+    SD_LOCK(_lock);
+    SDDiskCacheIndexEntry *entry = [_entries[fileName] copy];
+    SD_UNLOCK(_lock);
+    if (entry) {
+        entry.priority = SDDiskCacheIndexPriority(entry, byteOrientedCost);
+    }
+    return entry;
+}
+
+- (NSArray<SDDiskCacheIndexEntry *> *)allEntries {
+    BOOL byteOrientedCost = self.byteOrientedCost;
+    SD_LOCK(_lock);
+    NSArray<SDDiskCacheIndexEntry *> *entries = [[NSArray alloc] initWithArray:_entries.allValues copyItems:YES];
+    SD_UNLOCK(_lock);
+    for (SDDiskCacheIndexEntry *entry in entries) {
+        entry.priority = SDDiskCacheIndexPriority(entry, byteOrientedCost);
+    }
+    return entries;
+}
+
+- (double)inflation {
+    SD_LOCK(_lock);
+    double inflation = _inflation;
+    SD_UNLOCK(_lock);
+    return inflation;
+}
+
+#pragma mark - Update
+
+- (void)setInflation:(double)inflation {
+    SD_LOCK(_lock);
+    if (inflation > _inflation) {
+        _inflation = inflation;
+        NSMutableData *buffer = [NSMutableData data];
+        SDDiskCacheIndexEncodeInflation(buffer, inflation);
+        [self _appendRecordData:buffer];
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (void)recordWriteForFileName:(NSString *)fileName size:(NSUInteger)size {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    SD_LOCK(_lock);
+    SDDiskCacheIndexEntry *entry = _entries[fileName];
+    if (entry) {
+        _totalSize -= MIN(_totalSize, entry.size);
+    } else {
+        entry = [SDDiskCacheIndexEntry new];
+        entry.fileName = fileName;
+        entry.creationDate = now;
+        _entries[fileName] = entry;
+    }
+    entry.size = size;
+    entry.modificationDate = now;
+    entry.accessDate = now;
+    entry.changeDate = now;
+    entry.inflation = _inflation;
+    _totalSize += size;
+    [self _appendOperation:SDDiskCacheIndexOperationUpsert fileName:fileName entry:entry];
+    SD_UNLOCK(_lock);
+}
+
+- (void)recordAccessForFileName:(NSString *)fileName size:(NSUInteger)size {
+    NSTimeInterval now = [NSDate date].timeIntervalSince1970;
+    SD_LOCK(_lock);
+    SDDiskCacheIndexEntry *entry = _entries[fileName];
+    if (!entry) {
+        entry = [SDDiskCacheIndexEntry new];
+        entry.fileName = fileName;
+        entry.size = size;
+        entry.creationDate = now;
+        entry.modificationDate = now;
+        entry.changeDate = now;
+        _entries[fileName] = entry;
+        _totalSize += size;
+    }
+    entry.accessDate = now;
+    entry.accessCount += 1;
+    entry.inflation = _inflation;
+    // Only update in memory, the records are coalesced and written in batch outside of the lock, so a read hit never waits for the disk
+    /// 只在内存中更新，记录会被合并并在锁外批量写入，因此读取命中不会等待磁盘
+    [_pendingAccessNames addObject:fileName];
+    BOOL flushNow = _pendingAccessNames.count == kSDDiskCacheIndexAccessBatchCount;
+    BOOL scheduleFlush = !_flushScheduled;
+    _flushScheduled = YES;
+    SD_UNLOCK(_lock);
+    
+    if (flushNow || scheduleFlush) {
+        @weakify(self);
+        dispatch_time_t when = flushNow ? DISPATCH_TIME_NOW : dispatch_time(DISPATCH_TIME_NOW, (int64_t)(kSDDiskCacheIndexAccessFlushInterval * NSEC_PER_SEC));
+        dispatch_after(when, dispatch_get_global_queue(QOS_CLASS_UTILITY, 0), ^{
+            @strongify(self);
+            [self flushAccessRecords];
+        });
+    }
+}
+
+- (void)recordChangeForFileName:(NSString *)fileName {
+    SD_LOCK(_lock);
+    SDDiskCacheIndexEntry *entry = _entries[fileName];
+    if (entry) {
+        entry.changeDate = [NSDate date].timeIntervalSince1970;
+        [self _appendOperation:SDDiskCacheIndexOperationUpsert fileName:fileName entry:entry];
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (void)removeEntryForFileName:(NSString *)fileName {
+    SD_LOCK(_lock);
+    SDDiskCacheIndexEntry *entry = _entries[fileName];
+    if (entry) {
+        _totalSize -= MIN(_totalSize, entry.size);
+        [_entries removeObjectForKey:fileName];
+        [self _appendOperation:SDDiskCacheIndexOperationRemove fileName:fileName entry:nil];
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (void)removeAllEntries {
+    SD_LOCK(_lock);
+    [self _reset];
+    SD_UNLOCK(_lock);
+}
+
+- (void)rebuild {
+    SD_LOCK(_lock);
+    [self _reset];
+    [self _rebuildFromDirectory];
+    SD_UNLOCK(_lock);
+}
+
+- (void)synchronize {
+    SD_LOCK(_lock);
+    [self _synchronize];
+    SD_UNLOCK(_lock);
+}
+
+- (void)flushAccessRecords {
+    SD_LOCK(_lock);
+    _flushScheduled = NO;
+    if (_pendingAccessNames.count == 0) {
+        SD_UNLOCK(_lock);
+        return;
+    }
+    NSMutableData *buffer = [NSMutableData data];
+    NSUInteger recordCount = 0;
+    for (NSString *fileName in _pendingAccessNames) {
+        // The removed files are already journaled
+        SDDiskCacheIndexEntry *entry = _entries[fileName];
+        if (entry) {
+            SDDiskCacheIndexEncodeRecord(buffer, SDDiskCacheIndexOperationUpsert, fileName, entry);
+            recordCount++;
+        }
+    }
+    [_pendingAccessNames removeAllObjects];
+    NSUInteger entryCount = _entries.count;
+    // Hand over to the journal lock before releasing the entries lock, so the batch keeps its order with the following records
+    SD_LOCK(_journalLock);
+    SD_UNLOCK(_lock);
+    BOOL success = [self _writeJournalData:buffer recordCount:recordCount];
+    BOOL needsSynchronize = !success || _journalCount > MAX(kSDDiskCacheIndexMinJournalCount, entryCount);
+    SD_UNLOCK(_journalLock);
+    
+    if (needsSynchronize) {
+        // Replace the journal with a snapshot of the memory entries, which drops any torn record
+        [self synchronize];
+    }
+}
+
+#pragma mark - Private, make sure to call with lock held by caller
+
+- (NSString *)snapshotPath {
+    return [self.directory stringByAppendingPathComponent:SDDiskCacheIndexSnapshotName];
+}
+
+- (NSString *)journalPath {
+    return [self.directory stringByAppendingPathComponent:SDDiskCacheIndexJournalName];
+}
+
+// Call with the journal lock held
+- (void)_closeJournal {
+    if (_journalFD >= 0) {
+        close(_journalFD);
+        _journalFD = -1;
+    }
+    _journalCount = 0;
+}
+
+- (void)_reset {
+    [_entries removeAllObjects];
+    [_pendingAccessNames removeAllObjects];
+    _totalSize = 0;
+    _inflation = 0;
+    SD_LOCK(_journalLock);
+    [self _closeJournal];
+    _journalFailed = NO;
+    [self.fileManager removeItemAtPath:[self snapshotPath] error:nil];
+    [self.fileManager removeItemAtPath:[self journalPath] error:nil];
+    SD_UNLOCK(_journalLock);
+}
+
+- (void)_load {
+    NSData *snapshot = [NSData dataWithContentsOfFile:[self snapshotPath]];
+    NSData *journal = [NSData dataWithContentsOfFile:[self journalPath]];
+    if (!snapshot && !journal) {
+        // First launch or upgrade from the version without index
+        [self _rebuildFromDirectory];
+        return;
+    }
+    if (snapshot && !SDDiskCacheIndexDecodeRecords(snapshot, _entries, &_inflation)) {
+        [self _reset];
+        [self _rebuildFromDirectory];
+        return;
+    }
+    BOOL journalValid = !journal || SDDiskCacheIndexDecodeRecords(journal, _entries, &_inflation);
+    for (SDDiskCacheIndexEntry *entry in _entries.allValues) {
+        _totalSize += entry.size;
+    }
+    if (!journalValid) {
+        // The journal tail is truncated by crash, write a clean snapshot so the following records are not appended after garbage
+        [self _synchronize];
+    }
+}
+
+- (void)_rebuildFromDirectory {
+    BOOL isDirectory = NO;
+    if (![self.fileManager fileExistsAtPath:self.directory isDirectory:&isDirectory] || !isDirectory) {
+        return;
+    }
+    NSArray<NSURLResourceKey> *resourceKeys = @[NSURLIsDirectoryKey, NSURLFileSizeKey, NSURLCreationDateKey, NSURLContentModificationDateKey, NSURLContentAccessDateKey, NSURLAttributeModificationDateKey];
+    NSDirectoryEnumerator *fileEnumerator = [self.fileManager enumeratorAtURL:[NSURL fileURLWithPath:self.directory isDirectory:YES]
+                                                   includingPropertiesForKeys:resourceKeys
+                                                                      options:NSDirectoryEnumerationSkipsHiddenFiles
+                                                                 errorHandler:NULL];
+    for (NSURL *fileURL in fileEnumerator) {
+        NSDictionary<NSURLResourceKey, id> *resourceValues = [fileURL resourceValuesForKeys:resourceKeys error:nil];
+        if (!resourceValues || [resourceValues[NSURLIsDirectoryKey] boolValue]) {
+            continue;
+        }
+        SDDiskCacheIndexEntry *entry = [SDDiskCacheIndexEntry new];
+        entry.fileName = fileURL.lastPathComponent;
+        entry.size = [resourceValues[NSURLFileSizeKey] unsignedIntegerValue];
+        entry.creationDate = [resourceValues[NSURLCreationDateKey] timeIntervalSince1970];
+        entry.modificationDate = [resourceValues[NSURLContentModificationDateKey] timeIntervalSince1970];
+        entry.accessDate = [resourceValues[NSURLContentAccessDateKey] timeIntervalSince1970];
+        entry.changeDate = [resourceValues[NSURLAttributeModificationDateKey] timeIntervalSince1970];
+        _entries[entry.fileName] = entry;
+        _totalSize += entry.size;
+    }
+    [self _synchronize];
+}
+
+- (void)_synchronize {
+    // The snapshot contains the pending access records
+    [_pendingAccessNames removeAllObjects];
+    SD_LOCK(_journalLock);
+    [self _closeJournal];
+    BOOL isDirectory = NO;
+    if (![self.fileManager fileExistsAtPath:self.directory isDirectory:&isDirectory] || !isDirectory) {
+        SD_UNLOCK(_journalLock);
+        return;
+    }
+    NSMutableData *buffer = [NSMutableData data];
+    SDDiskCacheIndexHeader header = {kSDDiskCacheIndexMagic, kSDDiskCacheIndexVersion};
+    [buffer appendBytes:&header length:sizeof(header)];
+    SDDiskCacheIndexEncodeInflation(buffer, _inflation);
+    [_entries enumerateKeysAndObjectsUsingBlock:^(NSString * _Nonnull fileName, SDDiskCacheIndexEntry * _Nonnull entry, BOOL * _Nonnull stop) {
+        SDDiskCacheIndexEncodeRecord(buffer, SDDiskCacheIndexOperationUpsert, fileName, entry);
+    }];
+    if ([buffer writeToFile:[self snapshotPath] atomically:YES]) {
+        // The journal records are idempotent, replay them on a newer snapshot after crash here is harmless
+        [self.fileManager removeItemAtPath:[self journalPath] error:nil];
+        _journalFailed = NO;
+    } else {
+        // Drop the index files so the next launch rebuilds from the directory, and stop journaling on an incomplete snapshot
+        [self.fileManager removeItemAtPath:[self snapshotPath] error:nil];
+        [self.fileManager removeItemAtPath:[self journalPath] error:nil];
+        _journalFailed = YES;
+    }
+    SD_UNLOCK(_journalLock);
+}
+
+- (void)_appendOperation:(SDDiskCacheIndexOperation)operation fileName:(NSString *)fileName entry:(SDDiskCacheIndexEntry *)entry {
+    // This record carries the latest state, the pending access record is no longer needed
+    [_pendingAccessNames removeObject:fileName];
+    NSMutableData *buffer = [NSMutableData data];
+    SDDiskCacheIndexEncodeRecord(buffer, operation, fileName, entry);
+    [self _appendRecordData:buffer];
+}
+
+- (void)_appendRecordData:(NSData *)buffer {
+    SD_LOCK(_journalLock);
+    BOOL success = [self _writeJournalData:buffer recordCount:1];
+    BOOL needsSynchronize = !success || _journalCount > MAX(kSDDiskCacheIndexMinJournalCount, _entries.count);
+    SD_UNLOCK(_journalLock);
+    if (needsSynchronize) {
+        [self _synchronize];
+    }
+}
+
+// Call with the journal lock held, returns NO if the journal may contain a torn record
+- (BOOL)_writeJournalData:(NSData *)buffer recordCount:(NSUInteger)recordCount {
+    if (_journalFailed) {
+        // Keep counting, so the snapshot is retried when the journal would be folded
+        _journalCount += recordCount;
+        return YES;
+    }
+    if (_journalFD < 0) {
+        _journalFD = open([self journalPath].fileSystemRepresentation, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+        if (_journalFD < 0) {
+            // The directory does not exist, keep in memory only
+            return YES;
+        }
+        if (lseek(_journalFD, 0, SEEK_END) == 0) {
+            SDDiskCacheIndexHeader header = {kSDDiskCacheIndexMagic, kSDDiskCacheIndexVersion};
+            if (!SDDiskCacheIndexWrite(_journalFD, &header, sizeof(header))) {
+                [self _closeJournal];
+                return NO;
+            }
+        }
+    }
+    if (!SDDiskCacheIndexWrite(_journalFD, buffer.bytes, buffer.length)) {
+        [self _closeJournal];
+        return NO;
+    }
+    _journalCount += recordCount;
+    return YES;
+}
+
+@end
@@ -0,0 +1,40 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/**
+ The IO scheduler of `SDImageCache`, which replaces the single serial IO queue. Each key is hashed into one of the serial lanes, so the operations for different keys run concurrently (bounded by the lane count), while the operations for the same key keep the submission order.
+ The barrier operation (clear, expiration, size query) waits for all the operations submitted before it, and blocks all the operations submitted after it, just like one block on the serial queue. The lanes are suspended instead of parking threads, and the sync operations inside a barrier run inline.
+ `SDImageCache`的IO调度器，替代单一的串行IO队列。每个key被散列到一个串行通道中，因此不同key的操作可以并发执行(受通道数限制)，而同一key的操作保持提交顺序
+ 屏障操作(清理、过期、大小查询)会等待之前提交的所有操作，并阻塞之后提交的所有操作，就像串行队列中的一个block。通道会被挂起而不是占用线程等待，屏障内的同步操作会直接执行
+ */
+@interface SDDiskIOScheduler : NSObject
+
+/// Create a scheduler with the lane count, 0 is treated as 1. With 1 lane it's the same as one serial queue
+/// 使用通道数创建调度器，0视为1。1个通道时等同于一个串行队列
+- (nonnull instancetype)initWithLabel:(nonnull NSString *)label laneCount:(NSUInteger)laneCount NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/// 通道数
+@property (nonatomic, assign, readonly) NSUInteger laneCount;
+
+/// 异步执行key的操作
+- (void)dispatchAsyncForKey:(nullable NSString *)key block:(nonnull dispatch_block_t)block;
+/// 同步执行key的操作
+- (void)dispatchSyncForKey:(nullable NSString *)key block:(nonnull dispatch_block_t)block;
+/// Group the keys by lane, and asynchronously execute the block once per lane with the keys of that lane
+/// 按通道对key分组，每个通道异步执行一次block，参数为该通道的key
+- (void)dispatchAsyncForKeys:(nonnull NSArray<NSString *> *)keys block:(nonnull void(^)(NSArray<NSString *> * _Nonnull laneKeys))block;
+/// 异步执行屏障操作
+- (void)dispatchBarrierAsync:(nonnull dispatch_block_t)block;
+/// 同步执行屏障操作
+- (void)dispatchBarrierSync:(nonnull dispatch_block_t)block;
+
+@end
@@ -0,0 +1,123 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDDiskIOScheduler.h"
+#import "SDInternalMacros.h"
+
+static void * SDDiskIOSchedulerBarrierKey = &SDDiskIOSchedulerBarrierKey;
+
+@implementation SDDiskIOScheduler {
+    NSArray<dispatch_queue_t> *_lanes;
+    // the serial queue to run the barrier blocks, while all the lanes are suspended
+    dispatch_queue_t _barrierQueue;
+    // a lock to keep all the lanes receive the barriers in the same order, or two barriers may wait for each other
+    SD_LOCK_DECLARE(_barrierLock);
+}
+
+- (instancetype)initWithLabel:(NSString *)label laneCount:(NSUInteger)laneCount {
+    self = [super init];
+    if (self) {
+        _laneCount = MAX(laneCount, 1);
+        NSMutableArray<dispatch_queue_t> *lanes = [NSMutableArray arrayWithCapacity:_laneCount];
+        for (NSUInteger i = 0; i < _laneCount; i++) {
+            NSString *laneLabel = _laneCount > 1 ? [NSString stringWithFormat:@"%@.%lu", label, (unsigned long)i] : label;
+            [lanes addObject:dispatch_queue_create(laneLabel.UTF8String, DISPATCH_QUEUE_SERIAL)];
+        }
+        _lanes = [lanes copy];
+        _barrierQueue = dispatch_queue_create([NSString stringWithFormat:@"%@.barrier", label].UTF8String, DISPATCH_QUEUE_SERIAL);
+        dispatch_queue_set_specific(_barrierQueue, SDDiskIOSchedulerBarrierKey, (__bridge void *)self, NULL);
+        SD_LOCK_INIT(_barrierLock);
+    }
+    return self;
+}
+
+- (BOOL)isInBarrier {
+    return dispatch_get_specific(SDDiskIOSchedulerBarrierKey) == (__bridge void *)self;
+}
+
+- (dispatch_queue_t)laneForKey:(NSString *)key {
+    if (_laneCount == 1 || !key) {
+        return _lanes.firstObject;
+    }
+    return _lanes[key.hash % _laneCount];
+}
+
+- (void)dispatchAsyncForKey:(NSString *)key block:(dispatch_block_t)block {
+    dispatch_async([self laneForKey:key], block);
+}
+
+- (void)dispatchSyncForKey:(NSString *)key block:(dispatch_block_t)block {
+    // All the lanes are suspended during the barrier, which already owns the disk exclusively
+    if ([self isInBarrier]) {
+        block();
+        return;
+    }
+    dispatch_sync([self laneForKey:key], block);
+}
+
+- (void)dispatchAsyncForKeys:(NSArray<NSString *> *)keys block:(void (^)(NSArray<NSString *> * _Nonnull))block {
+    if (_laneCount == 1) {
+        dispatch_async(_lanes.firstObject, ^{
+            block(keys);
+        });
+        return;
+    }
+    NSMutableDictionary<NSNumber *, NSMutableArray<NSString *> *> *laneKeys = [NSMutableDictionary dictionary];
+    for (NSString *key in keys) {
+        NSNumber *laneIndex = @(key.hash % _laneCount);
+        NSMutableArray<NSString *> *keysInLane = laneKeys[laneIndex];
+        if (!keysInLane) {
+            keysInLane = [NSMutableArray array];
+            laneKeys[laneIndex] = keysInLane;
+        }
+        [keysInLane addObject:key];
+    }
+    [laneKeys enumerateKeysAndObjectsUsingBlock:^(NSNumber * _Nonnull laneIndex, NSMutableArray<NSString *> * _Nonnull keysInLane, BOOL * _Nonnull stop) {
+        dispatch_async(self->_lanes[laneIndex.unsignedIntegerValue], ^{
+            block([keysInLane copy]);
+        });
+    }];
+}
+
+- (void)dispatchBarrierAsync:(dispatch_block_t)block {
+    // Each lane suspends itself when it reaches the barrier, so no thread is blocked while waiting. After all the lanes arrive, run the block on the barrier queue and resume them
+    /// 每个通道到达屏障时挂起自身，因此等待时不会阻塞任何线程。所有通道到达后，在屏障队列执行block并恢复它们
+    NSArray<dispatch_queue_t> *lanes = _lanes;
+    dispatch_group_t arrivedGroup = dispatch_group_create();
+    SD_LOCK(_barrierLock);
+    for (dispatch_queue_t lane in lanes) {
+        dispatch_group_enter(arrivedGroup);
+        dispatch_async(lane, ^{
+            // Take effect after this block returns
+            dispatch_suspend(lane);
+            dispatch_group_leave(arrivedGroup);
+        });
+    }
+    SD_UNLOCK(_barrierLock);
+    dispatch_group_notify(arrivedGroup, _barrierQueue, ^{
+        block();
+        for (dispatch_queue_t lane in lanes) {
+            dispatch_resume(lane);
+        }
+    });
+}
+
+- (void)dispatchBarrierSync:(dispatch_block_t)block {
+    if ([self isInBarrier]) {
+        block();
+        return;
+    }
+    dispatch_semaphore_t finishSemaphore = dispatch_semaphore_create(0);
+    [self dispatchBarrierAsync:^{
+        block();
+        dispatch_semaphore_signal(finishSemaphore);
+    }];
+    dispatch_semaphore_wait(finishSemaphore, DISPATCH_TIME_FOREVER);
+}
+
+@end
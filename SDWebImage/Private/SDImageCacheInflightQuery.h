@@ -0,0 +1,38 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+#import "SDImageCacheDefine.h"
+
+@class SDImageCacheQueryOperation;
+
+/**
+ One in-flight disk query of `SDImageCache`, shared by all the concurrent queries for the same cache key and decode options. Each query subscribes with its own operation, and the shared read/decode is cancelled only when all the subscribers are cancelled.
+ This class is not thread-safe, it's protected by the lock of `SDImageCache`.
+ `SDImageCache`的一个进行中的硬盘查询，由相同缓存key和解码选项的所有并发查询共享。每个查询使用自己的操作订阅，只有所有订阅者都取消时才取消共享的读取/解码
+ 该类不是线程安全的，由`SDImageCache`的锁保护
+ */
+@interface SDImageCacheInflightQuery : NSObject
+
+/// The operation which runs the shared read/decode
+/// 执行共享读取/解码的操作
+@property (nonatomic, strong, readonly, nonnull) SDImageCacheQueryOperation *operation;
+/// 订阅者数
+@property (nonatomic, assign, readonly) NSUInteger subscriberCount;
+
+/// 添加订阅者
+- (void)addSubscriber:(nonnull SDImageCacheQueryOperation *)subscriber doneBlock:(nullable SDImageCacheQueryCompletionBlock)doneBlock;
+/// Remove the subscriber, returns its done block, or nil if it's not subscribed
+/// 删除订阅者，返回它的完成回调，如果未订阅则返回nil
+- (nullable SDImageCacheQueryCompletionBlock)removeSubscriber:(nonnull SDImageCacheQueryOperation *)subscriber;
+/// Remove all the subscribers and returns them with their done blocks
+/// 删除所有订阅者并返回它们及其完成回调
+- (nonnull NSMapTable<SDImageCacheQueryOperation *, SDImageCacheQueryCompletionBlock> *)removeAllSubscribers;
+
+@end
@@ -0,0 +1,47 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDImageCacheInflightQuery.h"
+#import "SDImageCacheQueryOperation.h"
+
+@implementation SDImageCacheInflightQuery {
+    NSMapTable<SDImageCacheQueryOperation *, SDImageCacheQueryCompletionBlock> *_subscribers;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _operation = [SDImageCacheQueryOperation new];
+        _subscribers = [NSMapTable strongToStrongObjectsMapTable];
+    }
+    return self;
+}
+
+- (NSUInteger)subscriberCount {
+    return _subscribers.count;
+}
+
+- (void)addSubscriber:(SDImageCacheQueryOperation *)subscriber doneBlock:(SDImageCacheQueryCompletionBlock)doneBlock {
+    // Use an empty block, the map table can not contain nil
+    /// 使用空block，映射表不能包含nil
+    [_subscribers setObject:doneBlock ?: ^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {} forKey:subscriber];
+}
+
+- (SDImageCacheQueryCompletionBlock)removeSubscriber:(SDImageCacheQueryOperation *)subscriber {
+    SDImageCacheQueryCompletionBlock doneBlock = [_subscribers objectForKey:subscriber];
+    [_subscribers removeObjectForKey:subscriber];
+    return doneBlock;
+}
+
+- (NSMapTable<SDImageCacheQueryOperation *,SDImageCacheQueryCompletionBlock> *)removeAllSubscribers {
+    NSMapTable<SDImageCacheQueryOperation *, SDImageCacheQueryCompletionBlock> *subscribers = _subscribers;
+    _subscribers = [NSMapTable strongToStrongObjectsMapTable];
+    return subscribers;
+}
+
+@end
@@ -0,0 +1,23 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDImageCacheQueryOperation.h"
+
+@interface SDImageCacheQueryOperation ()
+
+/// 查询开始时间
+@property (atomic, assign) CFAbsoluteTime startTime;
+@property (atomic, assign, readwrite) NSTimeInterval waitDuration;
+@property (atomic, assign, readwrite) NSTimeInterval ioDuration;
+@property (atomic, assign, readwrite) NSTimeInterval decodeDuration;
+@property (atomic, assign, readwrite) NSTimeInterval totalDuration;
+/// Called once when the operation is cancelled
+/// 操作取消时调用一次
+@property (atomic, copy, nullable) dispatch_block_t cancellationHandler;
+
+@end
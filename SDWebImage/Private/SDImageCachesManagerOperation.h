@@ -8,6 +8,7 @@
 
 #import <Foundation/Foundation.h>
 #import "SDWebImageCompat.h"
+#import "SDWebImageOperation.h"
 
 /// This is used for operation management, but not for operation queue execute
 /// 这用于操作管理，但不用于操作队列执行
@@ -20,5 +21,11 @@
 - (void)completeOne;
 /// 完成
 - (void)done;
+/// Add an inner operation, which is cancelled together with this operation. If this operation is already cancelled, the inner operation is cancelled immediately
+/// 添加内部操作，会随此操作一起取消。如果此操作已经取消，内部操作会被立即取消
+- (void)addChildOperation:(nullable id<SDWebImageOperation>)operation;
+/// The block called once when the operation is cancelled before it's done, it's released after the operation is cancelled or done
+/// 操作在完成前被取消时调用一次的block，在操作取消或完成后释放
+@property (nonatomic, copy, nullable) dispatch_block_t cancelBlock;
 
 @end
@@ -11,6 +11,8 @@
 
 @implementation SDImageCachesManagerOperation {
     SD_LOCK_DECLARE(_pendingCountLock);
+    NSMutableArray<id<SDWebImageOperation>> *_childOperations;
+    BOOL _cancelRequested;
 }
 
 @synthesize executing = _executing;
@@ -22,6 +24,7 @@
     if (self = [super init]) {
         SD_LOCK_INIT(_pendingCountLock);
         _pendingCount = 0;
+        _childOperations = [NSMutableArray array];
     }
     return self;
 }
@@ -45,14 +48,50 @@
     SD_UNLOCK(_pendingCountLock);
 }
 
+- (void)addChildOperation:(id<SDWebImageOperation>)operation {
+    if (!operation) {
+        return;
+    }
+    SD_LOCK(_pendingCountLock);
+    BOOL cancelled = _cancelRequested;
+    if (!cancelled) {
+        [_childOperations addObject:operation];
+    }
+    SD_UNLOCK(_pendingCountLock);
+    if (cancelled) {
+        [operation cancel];
+    }
+}
+
 - (void)cancel {
+    SD_LOCK(_pendingCountLock);
+    if (_cancelRequested || _finished) {
+        SD_UNLOCK(_pendingCountLock);
+        return;
+    }
+    _cancelRequested = YES;
+    NSArray<id<SDWebImageOperation>> *childOperations = [_childOperations copy];
+    [_childOperations removeAllObjects];
+    dispatch_block_t cancelBlock = _cancelBlock;
+    _cancelBlock = nil;
+    SD_UNLOCK(_pendingCountLock);
     self.cancelled = YES;
     [self reset];
+    for (id<SDWebImageOperation> operation in childOperations) {
+        [operation cancel];
+    }
+    if (cancelBlock) {
+        cancelBlock();
+    }
 }
 
 - (void)done {
     self.finished = YES;
     self.executing = NO;
+    SD_LOCK(_pendingCountLock);
+    [_childOperations removeAllObjects];
+    _cancelBlock = nil;
+    SD_UNLOCK(_pendingCountLock);
     [self reset];
 }
 
@@ -27,6 +27,25 @@
 #define kSDUTTypeSVG   ((__bridge CFStringRef)@"public.svg-image")
 #define kSDUTTypeGIF   ((__bridge CFStringRef)@"com.compuserve.gif")
 #define kSDUTTypePDF   ((__bridge CFStringRef)@"com.adobe.pdf")
+#define kSDUTTypeBMP   ((__bridge CFStringRef)@"com.microsoft.bmp")
+#define kSDUTTypeICO   ((__bridge CFStringRef)@"com.microsoft.ico")
+#define kSDUTTypeAVIF  ((__bridge CFStringRef)@"public.avif")
+#define kSDUTTypeJPEGXL ((__bridge CFStringRef)@"public.jpeg-xl")
+
+// The format values registered by the AVIF and JPEG XL coder plugins, they declare the public constants themselves
+/// AVIF和JPEG XL编码器插件注册的格式值，公开常量由插件自己声明
+static const SDImageFormat kSDImageFormatAVIF   = 15;
+static const SDImageFormat kSDImageFormatJPEGXL = 17;
+
+// The accumulated data for `appendIncrementalData:finished:`. Each append returns an immutable snapshot for `CGImageSourceUpdateData`, the bytes visible to a previous snapshot are never changed, and only the new bytes are copied unless the storage grows
+/// 追加模式下累积的图像数据。每次追加都返回一个不可变快照给`CGImageSourceUpdateData`，之前快照可见的字节不会被修改，除非存储空间扩容，否则只拷贝新的字节
+@interface SDImageIOIncrementalData : NSObject
+/// 已累积的字节数
+@property (nonatomic, assign, readonly) NSUInteger length;
+/// 追加新的字节，返回包含全部已累积字节的不可变快照
+- (nonnull NSData *)appendData:(nullable NSData *)data;
+
+@end
 
 @interface SDImageIOAnimatedCoder ()
 /// 指定图像源 在指定位置 的帧时长
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import <stdatomic.h>
+#import "SDWebImageCompat.h"
+#import "SDImageCacheConfig.h"
+
+/// The usage and limits shared by all the shards of one `SDMemoryCache`. The limits apply to the whole cache, a single shard can grow up to them, 0 means no limit
+/// 同一个`SDMemoryCache`的所有分片共享的用量和限制。限制作用于整个缓存，单个分片最多可以增长到该限制，0表示无限制
+typedef struct SDMemoryCacheUsage {
+    atomic_ulong cost;
+    atomic_ulong count;
+    atomic_ulong costLimit;
+    atomic_ulong countLimit;
+} SDMemoryCacheUsage;
+
+/// One independent partition of `SDMemoryCache`. Each shard owns its own lock, LRU list, cost accounting and weak side-table, so that accesses to keys which hash into different shards never contend.
+/// `SDMemoryCache` 的一个独立分片。每个分片拥有自己的锁、LRU链表、开销统计和弱引用表，因此散列到不同分片的key的访问不会互相竞争
+@interface SDMemoryCacheShard : NSObject
+
+/// Create a shard with the admission/eviction policy, the policy can not be changed later. The usage is updated by the shard and must outlive it
+/// 使用准入/淘汰策略创建分片，之后不能更改。用量由分片更新，其生命周期必须长于分片
+- (nonnull instancetype)initWithPolicy:(SDImageCacheConfigMemoryCachePolicy)policy usage:(nonnull SDMemoryCacheUsage *)usage NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/// 准入/淘汰策略
+@property (nonatomic, assign, readonly) SDImageCacheConfigMemoryCachePolicy policy;
+
+/// The share of the cost limit for this shard, which only size the W-TinyLFU segments. The eviction follows the shared limits
+/// 该分片分得的开销限制，仅用于确定W-TinyLFU各分段的大小。淘汰遵循共享的限制
+@property (nonatomic, assign) NSUInteger costShare;
+/// The share of the count limit for this shard, which size the W-TinyLFU segments and the frequency sketch
+/// 该分片分得的数量限制，用于确定W-TinyLFU各分段和频率草图的大小
+@property (nonatomic, assign) NSUInteger countShare;
+/// Called outside the lock for each entry removed from the strong storage, by eviction or by removal
+/// 每个条目从强引用存储中被淘汰或删除时，在锁外调用
+@property (nonatomic, copy, nullable) void (^evictionBlock)(id _Nonnull key, id _Nonnull object);
+/// Whether to keep a weak reference to every stored object, which can be resurrected after the strong reference get purged
+/// 是否为每个存储的对象保留一个弱引用，以便强引用被清除后可以恢复
+@property (nonatomic, assign) BOOL shouldUseWeakCache;
+/// 当前总开销
+@property (nonatomic, assign, readonly) NSUInteger totalCost;
+/// 当前对象数
+@property (nonatomic, assign, readonly) NSUInteger totalCount;
+
+/**
+ Returns the value associated with a given key. When the strong entry is missing but the weak side-table still contains a live object, the object is returned and `resurrected` is set to YES. The caller is responsible for syncing it back with the proper cost, which avoid computing the cost inside the shard lock.
+ 返回与key绑定的值。当强引用条目缺失但弱引用表中对象仍存活时，返回该对象并将`resurrected`设为YES。调用方负责使用正确的开销将其同步回缓存，从而避免在分片锁中计算开销
+ */
+- (nullable id)objectForKey:(nonnull id)key resurrected:(nullable BOOL *)resurrected;
+/// 设置值和开销
+- (void)setObject:(nonnull id)object forKey:(nonnull id)key cost:(NSUInteger)cost;
+/// Evict the least valuable entry except the one for `key`, return NO if there is nothing to evict
+/// 淘汰除`key`对应条目之外价值最低的条目，没有可淘汰的条目时返回NO
+- (BOOL)evictObjectExcludingKey:(nullable id)key;
+/// 删除值（包括弱引用）
+- (void)removeObjectForKey:(nonnull id)key;
+/// 清空（包括弱引用）
+- (void)removeAllObjects;
+/// Remove all strong entries, but keep the weak side-table
+/// 删除所有强引用条目，但保留弱引用表
+- (void)removeAllStrongObjects;
+/**
+ Remove the strong entries until both the total cost and count are not greater than the target, the weak side-table is kept. The pinned keys are never removed. The entries are ranked by cost multiplied by the age in the recency order, so the large and cold entries go first.
+ 删除强引用条目直到总开销和数量都不大于目标值，保留弱引用表。被固定的key不会被删除。条目按开销乘以在最近使用顺序中的年龄排序，因此大且冷的条目优先被删除
+ */
+- (void)trimStrongObjectsToCost:(NSUInteger)cost count:(NSUInteger)count;
+/// Pin the key so that `trimStrongObjectsToCost:count:` skip it, the pin is counted. The limits and the explicit removal still apply.
+/// 固定key，使`trimStrongObjectsToCost:count:`跳过它，固定是计数的。限制和显式删除仍然生效
+- (void)pinKey:(nonnull id)key;
+/// 取消固定key
+- (void)unpinKey:(nonnull id)key;
+
+@end
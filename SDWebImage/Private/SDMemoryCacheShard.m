@@ -0,0 +1,605 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDMemoryCacheShard.h"
+#import "SDInternalMacros.h"
+
+/// The segment which a node belongs to. LRU policy only use the window segment.
+/// 节点所属的分段。LRU策略只使用窗口分段
+typedef NS_ENUM(NSUInteger, SDMemoryCacheSegment) {
+    SDMemoryCacheSegmentWindow,
+    SDMemoryCacheSegmentProbation,
+    SDMemoryCacheSegmentProtected,
+};
+
+/// A node in the LRU doubly linked list. The links are unretained, the strong reference is held by the shard's hash table.
+/// LRU双向链表的节点。链接不持有对象，强引用由分片的哈希表持有
+@interface SDMemoryCacheNode : NSObject {
+    @package
+    __unsafe_unretained SDMemoryCacheNode *_prev;
+    __unsafe_unretained SDMemoryCacheNode *_next;
+    id _key;
+    id _value;
+    NSUInteger _cost;
+    NSUInteger _hash;
+    SDMemoryCacheSegment _segment;
+}
+@end
+
+@implementation SDMemoryCacheNode
+@end
+
+/// A doubly linked list with its own cost accounting, head is the most recently used
+/// 带有开销统计的双向链表，头部为最近使用的节点
+typedef struct SDMemoryCacheList {
+    __unsafe_unretained SDMemoryCacheNode *head;
+    __unsafe_unretained SDMemoryCacheNode *tail;
+    NSUInteger cost;
+    NSUInteger count;
+} SDMemoryCacheList;
+
+static inline void SDMemoryCacheListInsertHead(SDMemoryCacheList *list, SDMemoryCacheNode *node) {
+    node->_prev = nil;
+    node->_next = list->head;
+    if (list->head) {
+        list->head->_prev = node;
+    } else {
+        list->tail = node;
+    }
+    list->head = node;
+    list->cost += node->_cost;
+    list->count++;
+}
+
+static inline void SDMemoryCacheListRemove(SDMemoryCacheList *list, SDMemoryCacheNode *node) {
+    if (node->_next) node->_next->_prev = node->_prev;
+    if (node->_prev) node->_prev->_next = node->_next;
+    if (list->head == node) list->head = node->_next;
+    if (list->tail == node) list->tail = node->_prev;
+    node->_prev = nil;
+    node->_next = nil;
+    list->cost -= node->_cost;
+    list->count--;
+}
+
+static inline void SDMemoryCacheListBringToHead(SDMemoryCacheList *list, SDMemoryCacheNode *node) {
+    if (list->head == node) {
+        return;
+    }
+    SDMemoryCacheListRemove(list, node);
+    SDMemoryCacheListInsertHead(list, node);
+}
+
+#pragma mark - Frequency Sketch
+
+/// Count-Min sketch depth
+/// Count-Min 草图深度
+#define SD_SKETCH_DEPTH 4
+/// 4-bit counter
+/// 4位计数器上限
+#define SD_SKETCH_MAX_FREQUENCY 15
+
+/// A Count-Min sketch with 4-bit saturating counters, all the counters are halved after `sampleSize` increments so that the old popularity fade out.
+/// 使用4位饱和计数器的Count-Min草图，每增加`sampleSize`次后所有计数器减半，使旧的热度逐渐消退
+typedef struct SDMemoryCacheSketch {
+    uint8_t *table;
+    NSUInteger width; // power of two, for each row
+    NSUInteger additions;
+    NSUInteger sampleSize;
+} SDMemoryCacheSketch;
+
+static const uint64_t SDMemoryCacheSketchSeeds[SD_SKETCH_DEPTH] = {0xc3a5c85c97cb3127ULL, 0xb492b66fbe98f273ULL, 0x9ae16a3b2f90404fULL, 0xcbf29ce484222325ULL};
+
+static inline NSUInteger SDMemoryCacheSketchIndex(const SDMemoryCacheSketch *sketch, NSUInteger hash, NSUInteger row) {
+    uint64_t h = ((uint64_t)hash + SDMemoryCacheSketchSeeds[row]) * SDMemoryCacheSketchSeeds[row];
+    h += h >> 32;
+    return row * sketch->width + (NSUInteger)(h & (sketch->width - 1));
+}
+
+static void SDMemoryCacheSketchResize(SDMemoryCacheSketch *sketch, NSUInteger capacity) {
+    // 4 counters per entry for each row, keep the collision low
+    // 每行为每个条目预留4个计数器，保持较低的碰撞率
+    NSUInteger width = 16;
+    while (width < capacity * 4) {
+        width <<= 1;
+    }
+    if (sketch->table && sketch->width == width) {
+        return;
+    }
+    free(sketch->table);
+    sketch->table = calloc(width * SD_SKETCH_DEPTH, sizeof(uint8_t));
+    sketch->width = sketch->table ? width : 0;
+    sketch->additions = 0;
+    sketch->sampleSize = capacity * 10;
+}
+
+static inline NSUInteger SDMemoryCacheSketchFrequency(const SDMemoryCacheSketch *sketch, NSUInteger hash) {
+    if (!sketch->table) {
+        return 0;
+    }
+    NSUInteger frequency = SD_SKETCH_MAX_FREQUENCY;
+    for (NSUInteger row = 0; row < SD_SKETCH_DEPTH; row++) {
+        frequency = MIN(frequency, sketch->table[SDMemoryCacheSketchIndex(sketch, hash, row)]);
+    }
+    return frequency;
+}
+
+static inline void SDMemoryCacheSketchIncrement(SDMemoryCacheSketch *sketch, NSUInteger hash) {
+    if (!sketch->table) {
+        return;
+    }
+    BOOL added = NO;
+    for (NSUInteger row = 0; row < SD_SKETCH_DEPTH; row++) {
+        uint8_t *counter = &sketch->table[SDMemoryCacheSketchIndex(sketch, hash, row)];
+        if (*counter < SD_SKETCH_MAX_FREQUENCY) {
+            (*counter)++;
+            added = YES;
+        }
+    }
+    if (added && ++sketch->additions >= sketch->sampleSize) {
+        // Aging, halve all the counters
+        // 老化，所有计数器减半
+        NSUInteger length = sketch->width * SD_SKETCH_DEPTH;
+        for (NSUInteger i = 0; i < length; i++) {
+            sketch->table[i] >>= 1;
+        }
+        sketch->additions /= 2;
+    }
+}
+
+#pragma mark - Shard
+
+/// The percent of limits for the admission window, the rest is the main space
+/// 准入窗口占限制的百分比，其余为主空间
+static const NSUInteger kSDMemoryCacheWindowPercent = 1;
+/// The percent of main space for the protected segment, the rest is the probation segment
+/// 保护段占主空间的百分比，其余为试用段
+static const NSUInteger kSDMemoryCacheProtectedPercent = 80;
+/// The default sketch capacity when only cost limit is provided
+/// 只提供开销限制时草图的默认容量
+static const NSUInteger kSDMemoryCacheDefaultSketchCapacity = 512;
+
+@interface SDMemoryCacheShard () {
+    SD_LOCK_DECLARE(_lock); // a lock to keep the access to all the storage below thread-safe
+    CFMutableDictionaryRef _map; // key -> node
+    SDMemoryCacheList _window; // LRU policy use this as the only list
+    SDMemoryCacheList _probation;
+    SDMemoryCacheList _protected;
+    SDMemoryCacheSketch _sketch;
+    atomic_ulong _totalCost; // written with lock held, read without lock
+    atomic_ulong _totalCount;
+    SDMemoryCacheUsage *_usage;
+    NSCountedSet *_pinnedKeys;
+}
+/// 弱缓存
+@property (nonatomic, strong, nonnull) NSMapTable *weakCache; // strong-weak cache
+
+@end
+
+@implementation SDMemoryCacheShard
+
+- (void)dealloc {
+    if (_map) {
+        CFRelease(_map);
+        _map = NULL;
+    }
+    free(_sketch.table);
+    _sketch.table = NULL;
+}
+
+- (instancetype)initWithPolicy:(SDImageCacheConfigMemoryCachePolicy)policy usage:(SDMemoryCacheUsage *)usage {
+    self = [super init];
+    if (self) {
+        _policy = policy;
+        _usage = usage;
+        atomic_init(&_totalCost, 0);
+        atomic_init(&_totalCount, 0);
+        SD_LOCK_INIT(_lock);
+        _map = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+        _weakCache = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory valueOptions:NSPointerFunctionsWeakMemory capacity:0];
+        _pinnedKeys = [NSCountedSet set];
+        if (_policy == SDImageCacheConfigMemoryCachePolicyTinyLFU) {
+            SDMemoryCacheSketchResize(&_sketch, kSDMemoryCacheDefaultSketchCapacity);
+        }
+    }
+    return self;
+}
+
+#pragma mark - Segments
+
+// Make sure to call with lock held by caller
+- (SDMemoryCacheList *)_listForSegment:(SDMemoryCacheSegment)segment {
+    switch (segment) {
+        case SDMemoryCacheSegmentProbation:
+            return &_probation;
+        case SDMemoryCacheSegmentProtected:
+            return &_protected;
+        default:
+            return &_window;
+    }
+}
+
+// Whether the `cost` and `count` exceed the `percent` of limits
+static inline BOOL SDMemoryCacheExceedLimit(NSUInteger cost, NSUInteger count, NSUInteger costLimit, NSUInteger countLimit, NSUInteger percent) {
+    if (costLimit > 0 && cost > costLimit / 100 * percent + costLimit % 100 * percent / 100) {
+        return YES;
+    }
+    if (countLimit > 0 && count > MAX(countLimit * percent / 100, 1)) {
+        return YES;
+    }
+    return NO;
+}
+
+// Whether the whole cache exceed the shared limits
+- (BOOL)_exceedLimit {
+    return SDMemoryCacheExceedLimit(atomic_load_explicit(&_usage->cost, memory_order_relaxed),
+                                    atomic_load_explicit(&_usage->count, memory_order_relaxed),
+                                    atomic_load_explicit(&_usage->costLimit, memory_order_relaxed),
+                                    atomic_load_explicit(&_usage->countLimit, memory_order_relaxed),
+                                    100);
+}
+
+// Make sure to call with lock held by caller
+- (void)_addCost:(NSUInteger)cost count:(NSUInteger)count {
+    atomic_fetch_add_explicit(&_totalCost, cost, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_totalCount, count, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_usage->cost, cost, memory_order_relaxed);
+    atomic_fetch_add_explicit(&_usage->count, count, memory_order_relaxed);
+}
+
+// Make sure to call with lock held by caller
+- (void)_subtractCost:(NSUInteger)cost count:(NSUInteger)count {
+    atomic_fetch_sub_explicit(&_totalCost, cost, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&_totalCount, count, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&_usage->cost, cost, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&_usage->count, count, memory_order_relaxed);
+}
+
+// Make sure to call with lock held by caller
+// The removed node is appended into `holder`, so that the value can be released after the lock is dropped
+- (void)_removeNode:(SDMemoryCacheNode *)node holder:(NSMutableArray<SDMemoryCacheNode *> *)holder {
+    [holder addObject:node];
+    SDMemoryCacheListRemove([self _listForSegment:node->_segment], node);
+    CFDictionaryRemoveValue(_map, (__bridge const void *)node->_key);
+    [self _subtractCost:node->_cost count:1];
+}
+
+// Make sure to call with lock held by caller
+// The victim of main space: probation first, then protected, then window
+- (SDMemoryCacheNode *)_victimExcludingNode:(SDMemoryCacheNode *)excludedNode {
+    SDMemoryCacheList *lists[] = {&_probation, &_protected, &_window};
+    for (NSUInteger i = 0; i < sizeof(lists) / sizeof(lists[0]); i++) {
+        SDMemoryCacheNode *node = lists[i]->tail;
+        if (node == excludedNode) {
+            node = node->_prev;
+        }
+        if (node) {
+            return node;
+        }
+    }
+    return nil;
+}
+
+// Notify the removed nodes, call without lock
+- (void)_didRemoveNodes:(NSArray<SDMemoryCacheNode *> *)nodes {
+    void (^evictionBlock)(id, id) = self.evictionBlock;
+    if (!evictionBlock) {
+        return;
+    }
+    for (SDMemoryCacheNode *node in nodes) {
+        evictionBlock(node->_key, node->_value);
+    }
+}
+
+// Make sure to call with lock held by caller
+// Only the W-TinyLFU admission evicts here, the shared limits are enforced by `SDMemoryCache` from the largest shard
+- (void)_admitWithHolder:(NSMutableArray<SDMemoryCacheNode *> *)holder {
+    if (_policy == SDImageCacheConfigMemoryCachePolicyTinyLFU) {
+        // Move the overflow of window into main space, each candidate must win the frequency comparison against the main victim to be admitted
+        // 将窗口溢出的节点移入主空间，每个候选者必须在频率比较中胜过主空间的淘汰者才能被接纳
+        while (_window.count > 1 && SDMemoryCacheExceedLimit(_window.cost, _window.count, _costShare, _countShare, kSDMemoryCacheWindowPercent)) {
+            SDMemoryCacheNode *candidate = _window.tail;
+            SDMemoryCacheListRemove(&_window, candidate);
+            NSUInteger candidateFrequency = SDMemoryCacheSketchFrequency(&_sketch, candidate->_hash);
+            BOOL admitted = YES;
+            while ([self _exceedLimit]) {
+                SDMemoryCacheNode *victim = _probation.tail ?: _protected.tail;
+                if (!victim) {
+                    break;
+                }
+                if (candidateFrequency > SDMemoryCacheSketchFrequency(&_sketch, victim->_hash)) {
+                    [self _removeNode:victim holder:holder];
+                } else {
+                    admitted = NO;
+                    break;
+                }
+            }
+            if (admitted) {
+                candidate->_segment = SDMemoryCacheSegmentProbation;
+                SDMemoryCacheListInsertHead(&_probation, candidate);
+            } else {
+                // Put back and evict the candidate
+                candidate->_segment = SDMemoryCacheSegmentWindow;
+                SDMemoryCacheListInsertHead(&_window, candidate);
+                [self _removeNode:candidate holder:holder];
+            }
+        }
+    }
+}
+
+// Make sure to call with lock held by caller
+- (void)_accessNode:(SDMemoryCacheNode *)node {
+    switch (node->_segment) {
+        case SDMemoryCacheSegmentProbation: {
+            // Promote to protected, demote the protected overflow back to probation
+            // 晋升到保护段，保护段溢出的节点降级回试用段
+            SDMemoryCacheListRemove(&_probation, node);
+            node->_segment = SDMemoryCacheSegmentProtected;
+            SDMemoryCacheListInsertHead(&_protected, node);
+            NSUInteger percent = (100 - kSDMemoryCacheWindowPercent) * kSDMemoryCacheProtectedPercent / 100;
+            while (_protected.count > 1 && SDMemoryCacheExceedLimit(_protected.cost, _protected.count, _costShare, _countShare, percent)) {
+                SDMemoryCacheNode *demoted = _protected.tail;
+                SDMemoryCacheListRemove(&_protected, demoted);
+                demoted->_segment = SDMemoryCacheSegmentProbation;
+                SDMemoryCacheListInsertHead(&_probation, demoted);
+            }
+        }
+            break;
+        default:
+            SDMemoryCacheListBringToHead([self _listForSegment:node->_segment], node);
+            break;
+    }
+}
+
+#pragma mark - Cache
+
+- (NSUInteger)totalCost {
+    return atomic_load_explicit(&_totalCost, memory_order_relaxed);
+}
+
+- (NSUInteger)totalCount {
+    return atomic_load_explicit(&_totalCount, memory_order_relaxed);
+}
+
+- (void)setCostShare:(NSUInteger)costShare {
+    SD_LOCK(_lock);
+    _costShare = costShare;
+    SD_UNLOCK(_lock);
+}
+
+- (void)setCountShare:(NSUInteger)countShare {
+    SD_LOCK(_lock);
+    _countShare = countShare;
+    if (_policy == SDImageCacheConfigMemoryCachePolicyTinyLFU) {
+        SDMemoryCacheSketchResize(&_sketch, countShare > 0 ? countShare : kSDMemoryCacheDefaultSketchCapacity);
+    }
+    SD_UNLOCK(_lock);
+}
+
+- (id)objectForKey:(id)key resurrected:(BOOL *)resurrected {
+    if (!key) {
+        return nil;
+    }
+    id object;
+    BOOL isResurrected = NO;
+    NSUInteger hash = [key hash];
+    SD_LOCK(_lock);
+    SDMemoryCacheSketchIncrement(&_sketch, hash);
+    SDMemoryCacheNode *node = CFDictionaryGetValue(_map, (__bridge const void *)key);
+    if (node) {
+        [self _accessNode:node];
+        object = node->_value;
+    } else if (_shouldUseWeakCache) {
+        // Check weak cache
+        object = [self.weakCache objectForKey:key];
+        isResurrected = object != nil;
+    }
+    SD_UNLOCK(_lock);
+    if (resurrected) {
+        *resurrected = isResurrected;
+    }
+    return object;
+}
+
+- (void)setObject:(id)object forKey:(id)key cost:(NSUInteger)cost {
+    if (!key || !object) {
+        return;
+    }
+    NSUInteger hash = [key hash];
+    NSMutableArray<SDMemoryCacheNode *> *holder = [NSMutableArray array];
+    id oldObject; // keep the old value alive until unlock
+    SD_LOCK(_lock);
+    SDMemoryCacheSketchIncrement(&_sketch, hash);
+    SDMemoryCacheNode *node = CFDictionaryGetValue(_map, (__bridge const void *)key);
+    if (node) {
+        oldObject = node->_value;
+        SDMemoryCacheList *list = [self _listForSegment:node->_segment];
+        list->cost = list->cost - node->_cost + cost;
+        [self _addCost:cost count:0];
+        [self _subtractCost:node->_cost count:0];
+        node->_cost = cost;
+        node->_value = object;
+        [self _accessNode:node];
+    } else {
+        node = [SDMemoryCacheNode new];
+        node->_key = key;
+        node->_value = object;
+        node->_cost = cost;
+        node->_hash = hash;
+        node->_segment = SDMemoryCacheSegmentWindow;
+        CFDictionarySetValue(_map, (__bridge const void *)key, (__bridge const void *)node);
+        SDMemoryCacheListInsertHead(&_window, node);
+        [self _addCost:cost count:1];
+    }
+    if (_shouldUseWeakCache) {
+        // Store weak cache
+        [self.weakCache setObject:object forKey:key];
+    }
+    [self _admitWithHolder:holder];
+    SD_UNLOCK(_lock);
+    [self _didRemoveNodes:holder];
+}
+
+- (BOOL)evictObjectExcludingKey:(id)key {
+    NSMutableArray<SDMemoryCacheNode *> *holder = [NSMutableArray array];
+    SD_LOCK(_lock);
+    SDMemoryCacheNode *excludedNode = key ? CFDictionaryGetValue(_map, (__bridge const void *)key) : nil;
+    SDMemoryCacheNode *victim = [self _victimExcludingNode:excludedNode];
+    if (victim) {
+        [self _removeNode:victim holder:holder];
+    }
+    SD_UNLOCK(_lock);
+    [self _didRemoveNodes:holder];
+    return victim != nil;
+}
+
+- (void)removeObjectForKey:(id)key {
+    if (!key) {
+        return;
+    }
+    NSMutableArray<SDMemoryCacheNode *> *holder = [NSMutableArray array];
+    SD_LOCK(_lock);
+    SDMemoryCacheNode *node = CFDictionaryGetValue(_map, (__bridge const void *)key);
+    if (node) {
+        [self _removeNode:node holder:holder];
+    }
+    // Remove weak cache
+    [self.weakCache removeObjectForKey:key];
+    SD_UNLOCK(_lock);
+    [self _didRemoveNodes:holder];
+}
+
+- (void)removeAllObjects {
+    [self removeAllObjectsKeepingWeakCache:NO];
+}
+
+- (void)removeAllStrongObjects {
+    [self removeAllObjectsKeepingWeakCache:YES];
+}
+
+/// A trim candidate, `rank` is the position from the least recently used end
+/// 裁剪候选，`rank`为从最久未使用端开始的位置
+typedef struct SDMemoryCacheTrimCandidate {
+    __unsafe_unretained SDMemoryCacheNode *node;
+    NSUInteger rank;
+    double score;
+} SDMemoryCacheTrimCandidate;
+
+static int SDMemoryCacheTrimCandidateCompare(const void *a, const void *b) {
+    const SDMemoryCacheTrimCandidate *lhs = a;
+    const SDMemoryCacheTrimCandidate *rhs = b;
+    if (lhs->score != rhs->score) {
+        return lhs->score > rhs->score ? -1 : 1;
+    }
+    // Same score, the older one first
+    return lhs->rank < rhs->rank ? -1 : (lhs->rank > rhs->rank ? 1 : 0);
+}
+
+// Make sure to call with lock held by caller
+// Walk from the list tail (least recently used) to head, the same order as `_victimExcludingNode:`
+- (NSUInteger)_collectTrimCandidates:(SDMemoryCacheTrimCandidate *)candidates fromList:(SDMemoryCacheList *)list rank:(NSUInteger *)rank {
+    NSUInteger count = 0;
+    for (SDMemoryCacheNode *node = list->tail; node; node = node->_prev) {
+        NSUInteger currentRank = (*rank)++;
+        if (_pinnedKeys.count > 0 && [_pinnedKeys countForObject:node->_key] > 0) {
+            continue;
+        }
+        candidates[count++] = (SDMemoryCacheTrimCandidate){node, currentRank, 0};
+    }
+    return count;
+}
+
+- (void)trimStrongObjectsToCost:(NSUInteger)cost count:(NSUInteger)count {
+    SD_LOCK(_lock);
+    if (self.totalCost <= cost && self.totalCount <= count) {
+        SD_UNLOCK(_lock);
+        return;
+    }
+    if (cost == 0 && count == 0 && _pinnedKeys.count == 0) {
+        // Check the pins and remove in the same lock hold, a key pinned in between is never dropped
+        CFMutableDictionaryRef map = [self _swapOutAllNodesKeepingWeakCache:YES];
+        SD_UNLOCK(_lock);
+        [self _didSwapOutAllNodes:map];
+        return;
+    }
+    NSUInteger totalCount = self.totalCount;
+    SDMemoryCacheTrimCandidate *candidates = malloc(totalCount * sizeof(SDMemoryCacheTrimCandidate));
+    if (!candidates) {
+        SD_UNLOCK(_lock);
+        return;
+    }
+    NSUInteger rank = 0;
+    NSUInteger candidateCount = 0;
+    candidateCount += [self _collectTrimCandidates:candidates + candidateCount fromList:&_probation rank:&rank];
+    candidateCount += [self _collectTrimCandidates:candidates + candidateCount fromList:&_protected rank:&rank];
+    candidateCount += [self _collectTrimCandidates:candidates + candidateCount fromList:&_window rank:&rank];
+    for (NSUInteger i = 0; i < candidateCount; i++) {
+        // Cost 0 entries still follow the recency order
+        // 开销为0的条目仍然遵循最近使用顺序
+        candidates[i].score = ((double)candidates[i].node->_cost + 1) * (double)(totalCount - candidates[i].rank);
+    }
+    qsort(candidates, candidateCount, sizeof(SDMemoryCacheTrimCandidate), SDMemoryCacheTrimCandidateCompare);
+    NSMutableArray<SDMemoryCacheNode *> *holder = [NSMutableArray array];
+    for (NSUInteger i = 0; i < candidateCount && (self.totalCost > cost || self.totalCount > count); i++) {
+        [self _removeNode:candidates[i].node holder:holder];
+    }
+    free(candidates);
+    SD_UNLOCK(_lock);
+    [self _didRemoveNodes:holder];
+}
+
+- (void)pinKey:(id)key {
+    if (!key) {
+        return;
+    }
+    SD_LOCK(_lock);
+    [_pinnedKeys addObject:key];
+    SD_UNLOCK(_lock);
+}
+
+- (void)unpinKey:(id)key {
+    if (!key) {
+        return;
+    }
+    SD_LOCK(_lock);
+    [_pinnedKeys removeObject:key];
+    SD_UNLOCK(_lock);
+}
+
+- (void)removeAllObjectsKeepingWeakCache:(BOOL)keepWeakCache {
+    SD_LOCK(_lock);
+    CFMutableDictionaryRef map = [self _swapOutAllNodesKeepingWeakCache:keepWeakCache];
+    SD_UNLOCK(_lock);
+    [self _didSwapOutAllNodes:map];
+}
+
+// Make sure to call with lock held by caller
+// Swap the storage out, returns the old one to release after unlock
+- (CFMutableDictionaryRef)_swapOutAllNodesKeepingWeakCache:(BOOL)keepWeakCache {
+    CFMutableDictionaryRef map = _map;
+    _map = CFDictionaryCreateMutable(kCFAllocatorDefault, 0, &kCFTypeDictionaryKeyCallBacks, &kCFTypeDictionaryValueCallBacks);
+    _window = (SDMemoryCacheList){0};
+    _probation = (SDMemoryCacheList){0};
+    _protected = (SDMemoryCacheList){0};
+    [self _subtractCost:self.totalCost count:self.totalCount];
+    if (!keepWeakCache) {
+        [self.weakCache removeAllObjects];
+    }
+    return map;
+}
+
+// Call after unlock
+- (void)_didSwapOutAllNodes:(CFMutableDictionaryRef)map {
+    if (self.evictionBlock) {
+        NSArray<SDMemoryCacheNode *> *nodes = [(__bridge NSDictionary *)map allValues];
+        [self _didRemoveNodes:nodes];
+    }
+    CFRelease(map);
+}
+
+@end
@@ -0,0 +1,38 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/// A binary min-heap of the pending download operations ordered by deadline, the operations with the same deadline are in FIFO order. The deadline is the absolute time of `CFAbsoluteTimeGetCurrent()`, `INFINITY` means no deadline. Not thread-safe, the caller should lock.
+/// 按截止时间排序的待执行下载操作的二叉最小堆，截止时间相同的操作按FIFO顺序排列。截止时间是`CFAbsoluteTimeGetCurrent()`的绝对时间，`INFINITY`表示没有截止时间。非线程安全，调用方需要加锁
+@interface SDWebImageDownloaderDeadlineQueue : NSObject
+
+/// 待执行操作数
+@property (nonatomic, assign, readonly) NSUInteger count;
+
+/// Add the operation, O(log n). Adding an operation already in queue update its deadline
+/// 添加操作，O(log n)。添加已在队列中的操作会更新其截止时间
+- (void)addOperation:(nonnull NSOperation *)operation deadline:(CFAbsoluteTime)deadline;
+/// Update the deadline of a pending operation, O(log n). Return NO if the operation is not in queue
+/// 更新待执行操作的截止时间，O(log n)。如果操作不在队列中则返回NO
+- (BOOL)updateDeadline:(CFAbsoluteTime)deadline forOperation:(nonnull NSOperation *)operation;
+/// The deadline of a pending operation, NAN if the operation is not in queue
+/// 待执行操作的截止时间，如果操作不在队列中则为NAN
+- (CFAbsoluteTime)deadlineForOperation:(nonnull NSOperation *)operation;
+/// Remove and return the operation with the earliest deadline, O(log n)
+/// 删除并返回截止时间最早的操作，O(log n)
+- (nullable NSOperation *)popOperationWithDeadline:(nullable CFAbsoluteTime *)deadline;
+/// Remove a pending operation, O(log n). Return NO if the operation is not in queue
+/// 删除待执行操作，O(log n)。如果操作不在队列中则返回NO
+- (BOOL)removeOperation:(nonnull NSOperation *)operation;
+/// Remove and return all the operations
+/// 删除并返回所有操作
+- (nonnull NSArray<NSOperation *> *)removeAllOperations;
+
+@end
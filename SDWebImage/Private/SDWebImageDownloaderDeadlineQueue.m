@@ -0,0 +1,182 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageDownloaderDeadlineQueue.h"
+
+/// A heap node, which remember its index so the deadline can be updated without searching
+/// 堆节点，记录自己的下标以便无需查找即可更新截止时间
+@interface SDWebImageDownloaderDeadlineEntry : NSObject {
+    @package
+    NSOperation *_operation;
+    CFAbsoluteTime _deadline;
+    NSUInteger _sequence;
+    NSUInteger _index;
+}
+@end
+
+@implementation SDWebImageDownloaderDeadlineEntry
+@end
+
+static inline BOOL SDDeadlineEntryLess(SDWebImageDownloaderDeadlineEntry *entry1, SDWebImageDownloaderDeadlineEntry *entry2) {
+    if (entry1->_deadline != entry2->_deadline) {
+        return entry1->_deadline < entry2->_deadline;
+    }
+    return entry1->_sequence < entry2->_sequence;
+}
+
+@implementation SDWebImageDownloaderDeadlineQueue {
+    NSMutableArray<SDWebImageDownloaderDeadlineEntry *> *_heap;
+    NSMapTable<NSOperation *, SDWebImageDownloaderDeadlineEntry *> *_entries;
+    NSUInteger _sequence;
+}
+
+- (instancetype)init {
+    self = [super init];
+    if (self) {
+        _heap = [NSMutableArray array];
+        _entries = [[NSMapTable alloc] initWithKeyOptions:NSPointerFunctionsStrongMemory | NSPointerFunctionsObjectPointerPersonality valueOptions:NSPointerFunctionsStrongMemory capacity:0];
+    }
+    return self;
+}
+
+- (NSUInteger)count {
+    return _heap.count;
+}
+
+#pragma mark - Heap
+
+- (void)swapAtIndex:(NSUInteger)index1 withIndex:(NSUInteger)index2 {
+    [_heap exchangeObjectAtIndex:index1 withObjectAtIndex:index2];
+    _heap[index1]->_index = index1;
+    _heap[index2]->_index = index2;
+}
+
+- (void)siftUpFromIndex:(NSUInteger)index {
+    while (index > 0) {
+        NSUInteger parent = (index - 1) / 2;
+        if (!SDDeadlineEntryLess(_heap[index], _heap[parent])) {
+            break;
+        }
+        [self swapAtIndex:index withIndex:parent];
+        index = parent;
+    }
+}
+
+- (void)siftDownFromIndex:(NSUInteger)index {
+    NSUInteger count = _heap.count;
+    while (YES) {
+        NSUInteger smallest = index;
+        NSUInteger left = index * 2 + 1;
+        NSUInteger right = left + 1;
+        if (left < count && SDDeadlineEntryLess(_heap[left], _heap[smallest])) {
+            smallest = left;
+        }
+        if (right < count && SDDeadlineEntryLess(_heap[right], _heap[smallest])) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        [self swapAtIndex:index withIndex:smallest];
+        index = smallest;
+    }
+}
+
+#pragma mark - Operations
+
+- (void)addOperation:(NSOperation *)operation deadline:(CFAbsoluteTime)deadline {
+    if ([self updateDeadline:deadline forOperation:operation]) {
+        return;
+    }
+    SDWebImageDownloaderDeadlineEntry *entry = [SDWebImageDownloaderDeadlineEntry new];
+    entry->_operation = operation;
+    entry->_deadline = deadline;
+    entry->_sequence = _sequence++;
+    entry->_index = _heap.count;
+    [_heap addObject:entry];
+    [_entries setObject:entry forKey:operation];
+    [self siftUpFromIndex:entry->_index];
+}
+
+- (BOOL)updateDeadline:(CFAbsoluteTime)deadline forOperation:(NSOperation *)operation {
+    SDWebImageDownloaderDeadlineEntry *entry = [_entries objectForKey:operation];
+    if (!entry) {
+        return NO;
+    }
+    CFAbsoluteTime oldDeadline = entry->_deadline;
+    entry->_deadline = deadline;
+    if (deadline < oldDeadline) {
+        [self siftUpFromIndex:entry->_index];
+    } else if (deadline > oldDeadline) {
+        [self siftDownFromIndex:entry->_index];
+    }
+    return YES;
+}
+
+- (CFAbsoluteTime)deadlineForOperation:(NSOperation *)operation {
+    SDWebImageDownloaderDeadlineEntry *entry = [_entries objectForKey:operation];
+    if (!entry) {
+        return NAN;
+    }
+    return entry->_deadline;
+}
+
+- (NSOperation *)popOperationWithDeadline:(CFAbsoluteTime *)deadline {
+    SDWebImageDownloaderDeadlineEntry *entry = _heap.firstObject;
+    if (!entry) {
+        return nil;
+    }
+    NSUInteger lastIndex = _heap.count - 1;
+    if (lastIndex > 0) {
+        [self swapAtIndex:0 withIndex:lastIndex];
+    }
+    [_heap removeLastObject];
+    if (_heap.count > 0) {
+        [self siftDownFromIndex:0];
+    }
+    [_entries removeObjectForKey:entry->_operation];
+    if (deadline) {
+        *deadline = entry->_deadline;
+    }
+    return entry->_operation;
+}
+
+- (BOOL)removeOperation:(NSOperation *)operation {
+    SDWebImageDownloaderDeadlineEntry *entry = [_entries objectForKey:operation];
+    if (!entry) {
+        return NO;
+    }
+    NSUInteger index = entry->_index;
+    NSUInteger lastIndex = _heap.count - 1;
+    if (index != lastIndex) {
+        [self swapAtIndex:index withIndex:lastIndex];
+    }
+    [_heap removeLastObject];
+    [_entries removeObjectForKey:operation];
+    if (index < _heap.count) {
+        // The moved last entry may need to go either up or down
+        SDWebImageDownloaderDeadlineEntry *movedEntry = _heap[index];
+        [self siftUpFromIndex:index];
+        if (movedEntry->_index == index) {
+            [self siftDownFromIndex:index];
+        }
+    }
+    return YES;
+}
+
+- (NSArray<NSOperation *> *)removeAllOperations {
+    NSMutableArray<NSOperation *> *operations = [NSMutableArray arrayWithCapacity:_heap.count];
+    for (SDWebImageDownloaderDeadlineEntry *entry in _heap) {
+        [operations addObject:entry->_operation];
+    }
+    [_heap removeAllObjects];
+    [_entries removeAllObjects];
+    return [operations copy];
+}
+
+@end
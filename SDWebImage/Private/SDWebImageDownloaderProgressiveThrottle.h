@@ -0,0 +1,41 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import <Foundation/Foundation.h>
+#import "SDWebImageCompat.h"
+
+/// Decide whether a progressive frame is worth decoding during download. A frame is rendered only when the decoding is idle, the frame budget is not used up, the idle time since the last frame is at least the measured cost of the last frame, and the data gained something visible: a completed JPEG scan, or enough new bytes to spread the remaining budget evenly over the remaining data. Thread-safe.
+/// 决定下载过程中是否值得解码一个渐进式帧。仅当解码空闲、帧预算未用完、距上一帧的空闲时间不少于上一帧测得的开销，并且数据带来了可见的变化时才渲染：一个完整的JPEG扫描，或足够多的新字节使剩余预算平均分布在剩余数据上。线程安全
+@interface SDWebImageDownloaderProgressiveThrottle : NSObject
+
+/// Create a throttle, 0 budget means no limit on the frame count
+/// 创建节流器，预算为0表示不限制帧数
+- (nonnull instancetype)initWithFrameBudget:(NSUInteger)frameBudget NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/// 帧预算
+@property (nonatomic, assign, readonly) NSUInteger frameBudget;
+/// 已渲染的帧数
+@property (nonatomic, assign, readonly) NSUInteger producedFrameCount;
+/// 被跳过的帧数
+@property (nonatomic, assign, readonly) NSUInteger skippedFrameCount;
+/// The number of the completed JPEG scans, each one refines the whole image. Always 0 for other formats
+/// 已完成的JPEG扫描数，每个扫描都会细化整张图像。其他格式始终为0
+@property (nonatomic, assign, readonly) NSUInteger completedScanCount;
+
+/// Append the received data, the JPEG markers are parsed incrementally
+/// 追加接收到的数据，增量解析JPEG标记
+- (void)appendData:(nonnull NSData *)data;
+/// Whether to render a frame now, which counts the frame as produced or skipped. The `decoding` means the previous frame is still decoding
+/// 现在是否渲染一帧，该帧会被计为已渲染或已跳过。`decoding`表示上一帧仍在解码
+- (BOOL)shouldRenderFrameWithReceivedSize:(NSUInteger)receivedSize expectedSize:(NSUInteger)expectedSize decoding:(BOOL)decoding;
+/// Record the cost of the rendered frame
+/// 记录已渲染帧的开销
+- (void)didRenderFrameWithDuration:(NSTimeInterval)duration;
+
+@end
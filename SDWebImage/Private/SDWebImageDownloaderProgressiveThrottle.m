@@ -0,0 +1,240 @@
+/*
+ * This file is part of the SDWebImage package.
+ * (c) Olivier Poitrey <rs@dailymotion.com>
+ *
+ * For the full copyright and license information, please view the LICENSE
+ * file that was distributed with this source code.
+ */
+
+#import "SDWebImageDownloaderProgressiveThrottle.h"
+#import "SDInternalMacros.h"
+
+/// The byte gain ratio of the expected size to render a frame when there is no frame budget
+/// 没有帧预算时，渲染一帧所需的新字节占预期大小的比例
+static const double kSDProgressiveByteGainRatio = 0.05;
+/// The ratio of the idle time to the last frame decoding cost, 1 means the decoding takes at most half of the time
+/// 空闲时间与上一帧解码开销之比，1表示解码最多占用一半的时间
+static const double kSDProgressiveCostFactor = 1.0;
+
+/// The incremental JPEG marker parser state
+/// 增量JPEG标记解析器的状态
+typedef NS_ENUM(NSUInteger, SDJPEGParseState) {
+    SDJPEGParseStateSOIPrefix = 0,
+    SDJPEGParseStateSOI,
+    SDJPEGParseStateMarkerPrefix,
+    SDJPEGParseStateMarker,
+    SDJPEGParseStateLengthHigh,
+    SDJPEGParseStateLengthLow,
+    SDJPEGParseStateSegment,
+    SDJPEGParseStateEntropy,
+    SDJPEGParseStateEntropyMarker,
+    SDJPEGParseStateNotJPEG
+};
+
+// The markers without the length field: TEM, RSTn, SOI, EOI
+static inline BOOL SDJPEGMarkerIsStandalone(uint8_t marker) {
+    return marker == 0x01 || (marker >= 0xD0 && marker <= 0xD9);
+}
+
+@implementation SDWebImageDownloaderProgressiveThrottle {
+    SD_LOCK_DECLARE(_lock); // a lock to keep the parser and counters thread-safe
+    SDJPEGParseState _state;
+    uint8_t _segmentMarker;
+    NSUInteger _segmentLength; // the remaining bytes to skip when in segment state
+    NSUInteger _lastRenderedSize;
+    NSUInteger _lastRenderedScanCount;
+    NSTimeInterval _lastRenderDuration;
+    CFAbsoluteTime _lastRenderEndTime;
+}
+
+- (instancetype)initWithFrameBudget:(NSUInteger)frameBudget {
+    self = [super init];
+    if (self) {
+        SD_LOCK_INIT(_lock);
+        _frameBudget = frameBudget;
+        _state = SDJPEGParseStateSOIPrefix;
+    }
+    return self;
+}
+
+#pragma mark - JPEG Scan
+
+// Make sure to call with lock held by caller
+- (void)handleMarker:(uint8_t)marker {
+    if (marker == 0xFF) {
+        // Fill byte
+        _state = SDJPEGParseStateMarker;
+    } else if (SDJPEGMarkerIsStandalone(marker) || marker == 0x00) {
+        _state = SDJPEGParseStateMarkerPrefix;
+    } else {
+        _segmentMarker = marker;
+        _state = SDJPEGParseStateLengthHigh;
+    }
+}
+
+// Make sure to call with lock held by caller
+- (void)finishSegment {
+    // The entropy-coded data follows the SOS header
+    _state = _segmentMarker == 0xDA ? SDJPEGParseStateEntropy : SDJPEGParseStateMarkerPrefix;
+}
+
+// Make sure to call with lock held by caller
+- (void)parseBytes:(const uint8_t *)bytes length:(NSUInteger)length {
+    NSUInteger index = 0;
+    while (index < length && _state != SDJPEGParseStateNotJPEG) {
+        switch (_state) {
+            case SDJPEGParseStateSOIPrefix:
+                _state = bytes[index++] == 0xFF ? SDJPEGParseStateSOI : SDJPEGParseStateNotJPEG;
+                break;
+            case SDJPEGParseStateSOI:
+                _state = bytes[index++] == 0xD8 ? SDJPEGParseStateMarkerPrefix : SDJPEGParseStateNotJPEG;
+                break;
+            case SDJPEGParseStateMarkerPrefix:
+                if (bytes[index++] == 0xFF) {
+                    _state = SDJPEGParseStateMarker;
+                }
+                break;
+            case SDJPEGParseStateMarker:
+                [self handleMarker:bytes[index++]];
+                break;
+            case SDJPEGParseStateLengthHigh:
+                _segmentLength = (NSUInteger)bytes[index++] << 8;
+                _state = SDJPEGParseStateLengthLow;
+                break;
+            case SDJPEGParseStateLengthLow:
+                _segmentLength |= bytes[index++];
+                // The length includes itself
+                _segmentLength = _segmentLength > 2 ? _segmentLength - 2 : 0;
+                if (_segmentLength > 0) {
+                    _state = SDJPEGParseStateSegment;
+                } else {
+                    [self finishSegment];
+                }
+                break;
+            case SDJPEGParseStateSegment: {
+                NSUInteger skipLength = MIN(_segmentLength, length - index);
+                index += skipLength;
+                _segmentLength -= skipLength;
+                if (_segmentLength == 0) {
+                    [self finishSegment];
+                }
+                break;
+            }
+            case SDJPEGParseStateEntropy: {
+                // The entropy-coded data is the most of the file, search the marker prefix with memchr
+                const uint8_t *found = memchr(bytes + index, 0xFF, length - index);
+                if (!found) {
+                    index = length;
+                } else {
+                    index = found - bytes + 1;
+                    _state = SDJPEGParseStateEntropyMarker;
+                }
+                break;
+            }
+            case SDJPEGParseStateEntropyMarker: {
+                uint8_t marker = bytes[index++];
+                if (marker == 0x00 || (marker >= 0xD0 && marker <= 0xD7)) {
+                    // Stuffed byte or restart marker, still in the scan
+                    _state = SDJPEGParseStateEntropy;
+                } else if (marker != 0xFF) {
+                    // Any other marker ends the scan
+                    _completedScanCount++;
+                    [self handleMarker:marker];
+                }
+                break;
+            }
+            default:
+                index = length;
+                break;
+        }
+    }
+}
+
+- (void)appendData:(NSData *)data {
+    SD_LOCK(_lock);
+    if (_state != SDJPEGParseStateNotJPEG) {
+        [data enumerateByteRangesUsingBlock:^(const void * _Nonnull bytes, NSRange byteRange, BOOL * _Nonnull stop) {
+            [self parseBytes:bytes length:byteRange.length];
+        }];
+    }
+    SD_UNLOCK(_lock);
+}
+
+#pragma mark - Throttle
+
+// Make sure to call with lock held by caller
+- (BOOL)canRenderFrameWithReceivedSize:(NSUInteger)receivedSize expectedSize:(NSUInteger)expectedSize decoding:(BOOL)decoding {
+    if (decoding) {
+        return NO;
+    }
+    if (_frameBudget > 0 && _producedFrameCount >= _frameBudget) {
+        return NO;
+    }
+    // Measured cost, keep the decoding from occupying the coder queue all the time
+    if (_producedFrameCount > 0 && CFAbsoluteTimeGetCurrent() - _lastRenderEndTime < _lastRenderDuration * kSDProgressiveCostFactor) {
+        return NO;
+    }
+    // A completed scan refines the whole image, which is the most visible change
+    if (_completedScanCount > _lastRenderedScanCount) {
+        return YES;
+    }
+    if (receivedSize <= _lastRenderedSize) {
+        return NO;
+    }
+    NSUInteger gainedSize = receivedSize - _lastRenderedSize;
+    double requiredSize;
+    if (_frameBudget > 0) {
+        // Spread the remaining frames evenly, the full image at the end takes one more step
+        NSUInteger remainingSize = expectedSize > _lastRenderedSize ? expectedSize - _lastRenderedSize : 0;
+        requiredSize = (double)remainingSize / (_frameBudget - _producedFrameCount + 1);
+    } else {
+        requiredSize = expectedSize * kSDProgressiveByteGainRatio;
+    }
+    return gainedSize >= requiredSize;
+}
+
+- (BOOL)shouldRenderFrameWithReceivedSize:(NSUInteger)receivedSize expectedSize:(NSUInteger)expectedSize decoding:(BOOL)decoding {
+    SD_LOCK(_lock);
+    BOOL shouldRender = [self canRenderFrameWithReceivedSize:receivedSize expectedSize:expectedSize decoding:decoding];
+    if (shouldRender) {
+        _producedFrameCount++;
+        _lastRenderedSize = receivedSize;
+        _lastRenderedScanCount = _completedScanCount;
+    } else {
+        _skippedFrameCount++;
+    }
+    SD_UNLOCK(_lock);
+    return shouldRender;
+}
+
+- (void)didRenderFrameWithDuration:(NSTimeInterval)duration {
+    SD_LOCK(_lock);
+    _lastRenderDuration = MAX(duration, 0);
+    _lastRenderEndTime = CFAbsoluteTimeGetCurrent();
+    SD_UNLOCK(_lock);
+}
+
+#pragma mark - Counters
+
+- (NSUInteger)producedFrameCount {
+    SD_LOCK(_lock);
+    NSUInteger producedFrameCount = _producedFrameCount;
+    SD_UNLOCK(_lock);
+    return producedFrameCount;
+}
+
+- (NSUInteger)skippedFrameCount {
+    SD_LOCK(_lock);
+    NSUInteger skippedFrameCount = _skippedFrameCount;
+    SD_UNLOCK(_lock);
+    return skippedFrameCount;
+}
+
+- (NSUInteger)completedScanCount {
+    SD_LOCK(_lock);
+    NSUInteger completedScanCount = _completedScanCount;
+    SD_UNLOCK(_lock);
+    return completedScanCount;
+}
+
+@end
@@ -629,6 +629,860 @@ static NSString *kTestImageKeyPNG = @"TestImageKey.png";
     [self waitForExpectationsWithCommonTimeout];
 }
 
+- (void)test59MemoryCacheShardedConcurrentAccess {
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.memoryCacheShardCount = 8;
+    config.maxMemoryCount = 1000;
+    SDMemoryCache *memoryCache = [[SDMemoryCache alloc] initWithConfig:config];
+    expect(memoryCache.shardCount).equal(8);
+    expect(memoryCache.countLimit).equal(1000);
+    NSUInteger keyCount = 2000;
+    NSMutableArray<NSString *> *keys = [NSMutableArray arrayWithCapacity:keyCount];
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        [keys addObject:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+    }
+    // Mixed get/set from 8 threads, each thread counts its mismatched reads, which are checked on the test thread
+    const NSUInteger threadCount = 8;
+    const NSUInteger operationCount = 20000;
+    NSUInteger (^access)(void) = ^NSUInteger {
+        NSUInteger *mismatchCounts = calloc(threadCount, sizeof(NSUInteger));
+        dispatch_apply(threadCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t thread) {
+            NSUInteger count = operationCount / threadCount;
+            for (NSUInteger i = 0; i < count; i++) {
+                NSString *key = keys[(thread * count + i * 7) % keyCount];
+                if (i % 4 == 0) {
+                    [memoryCache setObject:key forKey:key cost:1];
+                } else {
+                    id object = [memoryCache objectForKey:key];
+                    if (object && ![object isEqual:key]) {
+                        mismatchCounts[thread]++;
+                    }
+                }
+            }
+        });
+        NSUInteger mismatchCount = 0;
+        for (NSUInteger thread = 0; thread < threadCount; thread++) {
+            mismatchCount += mismatchCounts[thread];
+        }
+        free(mismatchCounts);
+        return mismatchCount;
+    };
+    expect(access()).equal(0);
+    expect(memoryCache.totalCount).beLessThanOrEqualTo(1000);
+    expect(memoryCache.totalCost).equal(memoryCache.totalCount);
+    
+    __block NSUInteger measuredMismatchCount = 0;
+    [self measureBlock:^{
+        [memoryCache removeAllObjects];
+        measuredMismatchCount += access();
+    }];
+    expect(measuredMismatchCount).equal(0);
+    expect(memoryCache.totalCount).beLessThanOrEqualTo(1000);
+}
+
+- (void)test60MemoryCacheShardedLimitsApplyToWholeCache {
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.memoryCacheShardCount = 8;
+    config.maxMemoryCost = 100;
+    SDMemoryCache *memoryCache = [[SDMemoryCache alloc] initWithConfig:config];
+    // An object larger than the even split is still cached
+    [memoryCache setObject:@"large" forKey:@"large" cost:60];
+    expect([memoryCache objectForKey:@"large"]).equal(@"large");
+    for (NSUInteger i = 0; i < 100; i++) {
+        NSString *key = [NSString stringWithFormat:@"small-%lu", (unsigned long)i];
+        [memoryCache setObject:key forKey:key cost:1];
+        expect(memoryCache.totalCost).beLessThanOrEqualTo(100);
+    }
+    // The count limit smaller than the shard count is not exceeded
+    config.maxMemoryCost = 0;
+    config.maxMemoryCount = 3;
+    for (NSUInteger i = 0; i < 20; i++) {
+        NSString *key = [NSString stringWithFormat:@"count-%lu", (unsigned long)i];
+        [memoryCache setObject:key forKey:key];
+        expect(memoryCache.totalCount).beLessThanOrEqualTo(3);
+        expect([memoryCache objectForKey:key]).equal(key);
+    }
+    expect(memoryCache.name).equal(@"");
+    expect(memoryCache.evictsObjectsWithDiscardableContent).beTruthy();
+}
+
+- (void)test61MemoryCacheTinyLFUScanResistance {
+    // Replay a recorded trace (one key per line) when provided, otherwise a synthetic trace: a hot set interleaved with one-time scans
+    NSArray<NSString *> *trace;
+    NSString *tracePath = NSProcessInfo.processInfo.environment[@"SD_MEMORY_CACHE_TRACE"];
+    if (tracePath) {
+        NSString *content = [NSString stringWithContentsOfFile:tracePath encoding:NSUTF8StringEncoding error:nil];
+        trace = [content componentsSeparatedByCharactersInSet:NSCharacterSet.newlineCharacterSet];
+    } else {
+        NSMutableArray<NSString *> *keys = [NSMutableArray array];
+        NSUInteger scanIndex = 0;
+        for (NSUInteger round = 0; round < 50; round++) {
+            for (NSUInteger i = 0; i < 80; i++) {
+                [keys addObject:[NSString stringWithFormat:@"hot-%lu", (unsigned long)(i % 40)]];
+            }
+            for (NSUInteger i = 0; i < 200; i++) {
+                [keys addObject:[NSString stringWithFormat:@"scan-%lu", (unsigned long)scanIndex++]];
+            }
+        }
+        trace = [keys copy];
+    }
+    __block NSUInteger maxTotalCount = 0;
+    double (^hitRatio)(SDImageCacheConfigMemoryCachePolicy) = ^double(SDImageCacheConfigMemoryCachePolicy policy) {
+        SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+        config.memoryCacheShardCount = 1;
+        config.memoryCachePolicy = policy;
+        config.maxMemoryCount = 100;
+        SDMemoryCache *memoryCache = [[SDMemoryCache alloc] initWithConfig:config];
+        NSUInteger hitCount = 0;
+        NSUInteger requestCount = 0;
+        for (NSString *key in trace) {
+            if (key.length == 0) {
+                continue;
+            }
+            requestCount++;
+            if ([memoryCache objectForKey:key]) {
+                hitCount++;
+            } else {
+                [memoryCache setObject:key forKey:key];
+            }
+            maxTotalCount = MAX(maxTotalCount, memoryCache.totalCount);
+        }
+        return requestCount > 0 ? (double)hitCount / requestCount : 0;
+    };
+    double lruHitRatio = hitRatio(SDImageCacheConfigMemoryCachePolicyLRU);
+    double tinyLFUHitRatio = hitRatio(SDImageCacheConfigMemoryCachePolicyTinyLFU);
+    expect(maxTotalCount).beLessThanOrEqualTo(100);
+    if (!tracePath) {
+        expect(tinyLFUHitRatio).beGreaterThan(lruHitRatio);
+    }
+}
+
+- (void)test62SegmentedDiskCacheReadWrite {
+    NSString *basePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SDSegmentedDiskCacheTests"];
+    [[NSFileManager defaultManager] removeItemAtPath:basePath error:nil];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    NSData *data = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    NSData *extendedData = [@"Extended" dataUsingEncoding:NSUTF8StringEncoding];
+    NSUInteger keyCount = 500;
+
+    // Both caches read back the same data, the segmented one keeps far fewer files
+    NSMutableDictionary<NSString *, NSNumber *> *fileCounts = [NSMutableDictionary dictionary];
+    NSArray<Class> *classes = @[[SDDiskCache class], [SDSegmentedDiskCache class]];
+    for (Class cls in classes) {
+        NSString *cachePath = [basePath stringByAppendingPathComponent:NSStringFromClass(cls)];
+        id<SDDiskCache> diskCache = [[cls alloc] initWithCachePath:cachePath config:config];
+        for (NSUInteger i = 0; i < keyCount; i++) {
+            [diskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+        }
+        NSUInteger mismatchCount = 0;
+        for (NSUInteger i = 0; i < keyCount; i++) {
+            if (![[diskCache dataForKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]] isEqualToData:data]) {
+                mismatchCount++;
+            }
+        }
+        expect(mismatchCount).equal(0);
+        expect(diskCache.totalCount).equal(keyCount);
+        expect(diskCache.totalSize).equal(keyCount * data.length);
+        fileCounts[NSStringFromClass(cls)] = @([[NSFileManager defaultManager] contentsOfDirectoryAtPath:cachePath error:nil].count);
+    }
+    expect(fileCounts[NSStringFromClass([SDSegmentedDiskCache class])].unsignedIntegerValue).beLessThan(fileCounts[NSStringFromClass([SDDiskCache class])].unsignedIntegerValue);
+
+    NSString *cachePath = [basePath stringByAppendingPathComponent:@"Segments"];
+    SDSegmentedDiskCache *diskCache = [[SDSegmentedDiskCache alloc] initWithCachePath:cachePath config:config];
+    diskCache.maxSegmentSize = data.length * 10;
+    for (NSUInteger i = 0; i < 100; i++) {
+        [diskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+    }
+    [diskCache setExtendedData:extendedData forKey:@"key-99"];
+    expect([diskCache cachePathForKey:@"key-0"]).beNil();
+    expect([diskCache extendedDataForKey:@"key-99"]).equal(extendedData);
+    NSUInteger segmentCount = diskCache.segmentCount;
+    expect(segmentCount).beGreaterThan(1);
+    // Removal makes the old segments dead, which should be compacted
+    for (NSUInteger i = 0; i < 90; i++) {
+        [diskCache removeDataForKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+    }
+    [diskCache waitUntilCompactionFinished];
+    expect(diskCache.segmentCount).beLessThan(segmentCount);
+    expect(diskCache.totalCount).equal(10);
+    expect([diskCache containsDataForKey:@"key-0"]).beFalsy();
+    expect([diskCache dataForKey:@"key-95"]).equal(data);
+
+    // Index is rebuilt from the segments
+    diskCache = [[SDSegmentedDiskCache alloc] initWithCachePath:cachePath config:config];
+    expect(diskCache.totalCount).equal(10);
+    expect([diskCache containsDataForKey:@"key-0"]).beFalsy();
+    expect([diskCache dataForKey:@"key-95"]).equal(data);
+    expect([diskCache extendedDataForKey:@"key-99"]).equal(extendedData);
+    [diskCache removeAllData];
+    expect(diskCache.totalCount).equal(0);
+    
+    // Measure the write and read of the segmented cache
+    NSString *benchmarkPath = [basePath stringByAppendingPathComponent:@"Benchmark"];
+    __block NSUInteger measuredMismatchCount = 0;
+    [self measureBlock:^{
+        SDSegmentedDiskCache *benchmarkDiskCache = [[SDSegmentedDiskCache alloc] initWithCachePath:benchmarkPath config:config];
+        for (NSUInteger i = 0; i < 100; i++) {
+            [benchmarkDiskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+        }
+        for (NSUInteger i = 0; i < 100; i++) {
+            if (![[benchmarkDiskCache dataForKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]] isEqualToData:data]) {
+                measuredMismatchCount++;
+            }
+        }
+        [benchmarkDiskCache removeAllData];
+    }];
+    expect(measuredMismatchCount).equal(0);
+    [[NSFileManager defaultManager] removeItemAtPath:basePath error:nil];
+}
+
+- (void)test63SegmentedDiskCacheCompactionKeepConcurrentWrites {
+    NSString *cachePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"SDSegmentedDiskCacheCompactionTests"];
+    [[NSFileManager defaultManager] removeItemAtPath:cachePath error:nil];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    SDSegmentedDiskCache *diskCache = [[SDSegmentedDiskCache alloc] initWithCachePath:cachePath config:config];
+    NSData *data = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    diskCache.maxSegmentSize = data.length * 4;
+    // Overwrite the same keys from many threads, the segments keep rolling and being compacted while records are reserved but not yet written
+    NSUInteger keyCount = 20;
+    dispatch_apply(400, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        [diskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)(i % keyCount)]];
+    });
+    [diskCache waitUntilCompactionFinished];
+    expect(diskCache.totalCount).equal(keyCount);
+    expect(diskCache.totalSize).equal(keyCount * data.length);
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        expect([diskCache dataForKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]]).equal(data);
+    }
+    [diskCache removeAllData];
+    expect(diskCache.totalCount).equal(0);
+    [diskCache setData:data forKey:@"key-0"];
+    expect([diskCache dataForKey:@"key-0"]).equal(data);
+    [[NSFileManager defaultManager] removeItemAtPath:cachePath error:nil];
+}
+
+- (void)test64DiskCacheIndexPersistence {
+    NSString *cachePath = [[self userCacheDirectory] stringByAppendingPathComponent:@"index"];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    SDDiskCache *diskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+    [diskCache removeAllData];
+    NSData *data = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    for (NSUInteger i = 0; i < 10; i++) {
+        [diskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+    }
+    [diskCache removeDataForKey:@"key-0"];
+    expect(diskCache.totalCount).equal(9);
+    expect(diskCache.totalSize).equal(9 * data.length);
+    
+    // Load from the persistent index (snapshot + journal)
+    diskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+    expect(diskCache.totalCount).equal(9);
+    expect(diskCache.totalSize).equal(9 * data.length);
+    
+    // Rebuild from the directory when the index is missing
+    NSArray<NSString *> *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:cachePath error:nil];
+    for (NSString *fileName in fileNames) {
+        if ([fileName hasPrefix:@"."]) {
+            [[NSFileManager defaultManager] removeItemAtPath:[cachePath stringByAppendingPathComponent:fileName] error:nil];
+        }
+    }
+    diskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+    expect(diskCache.totalCount).equal(9);
+    expect(diskCache.totalSize).equal(9 * data.length);
+    
+    // Trim by size only reads the index
+    config.maxDiskSize = data.length * 4;
+    [diskCache removeExpiredData];
+    expect(diskCache.totalSize).beLessThan(data.length * 2);
+    expect(diskCache.totalCount).equal(1);
+    [diskCache removeAllData];
+    expect(diskCache.totalCount).equal(0);
+}
+
+- (void)test65DiskCacheSlicedEviction {
+    NSString *cachePath = [[self userCacheDirectory] stringByAppendingPathComponent:@"slice"];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.maxDiskSize = 100;
+    config.diskCacheHighWatermark = 0.8;
+    config.diskCacheLowWatermark = 0.3;
+    SDDiskCache *diskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+    [diskCache removeAllData];
+    NSData *data = [NSData dataWithBytes:"0123456789" length:10];
+    for (NSUInteger i = 0; i < 9; i++) {
+        [diskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+    }
+    // 90 bytes > high watermark (80 bytes), trim 2 files per slice until below low watermark (30 bytes)
+    NSUInteger sliceCount = 0;
+    while (![diskCache removeExpiredDataWithCountLimit:2 timeLimit:0]) {
+        sliceCount++;
+        expect(diskCache.totalCount).beGreaterThan(2);
+    }
+    expect(sliceCount).beGreaterThan(1);
+    expect(diskCache.totalSize).equal(20);
+    // Below high watermark, nothing to remove
+    [diskCache setData:data forKey:@"key-9"];
+    expect([diskCache removeExpiredDataWithCountLimit:2 timeLimit:0]).beTruthy();
+    expect(diskCache.totalSize).equal(30);
+    
+    // Sliced eviction through SDImageCache
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Sliced eviction"];
+    config.diskCacheEvictionSliceCount = 1;
+    config.maxDiskAge = 0;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"Slice" diskCacheDirectory:[self userCacheDirectory] config:config];
+    [cache storeImageDataToDisk:data forKey:@"key-0"];
+    [cache storeImageDataToDisk:data forKey:@"key-1"];
+    [cache deleteOldFilesWithCompletionBlock:^{
+        expect(cache.totalDiskCount).equal(0);
+        [cache clearDiskOnCompletion:^{
+            [expectation fulfill];
+        }];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+    [diskCache removeAllData];
+}
+
+- (void)test66DiskCacheMappedReading {
+    NSString *cachePath = [[self userCacheDirectory] stringByAppendingPathComponent:@"mapped"];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    SDDiskCache *plainDiskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+    [plainDiskCache removeAllData];
+    SDImageCacheConfig *mappedConfig = [config copy];
+    mappedConfig.diskCacheMappedReadingThreshold = 64 * 1024;
+    SDDiskCache *mappedDiskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:mappedConfig];
+    
+    NSMutableData *smallData = [NSMutableData dataWithLength:4 * 1024];
+    NSMutableData *largeData = [NSMutableData dataWithLength:4 * 1024 * 1024];
+    ((uint8_t *)largeData.mutableBytes)[largeData.length - 1] = 1;
+    [plainDiskCache setData:smallData forKey:@"small"];
+    [plainDiskCache setData:largeData forKey:@"large"];
+    expect([mappedDiskCache dataForKey:@"small"]).equal(smallData);
+    expect([mappedDiskCache dataForKey:@"large"]).equal(largeData);
+    expect([mappedDiskCache dataForKey:@"none"]).beNil();
+    
+    // Measure the mapped hits of the large file
+    __block NSUInteger measuredMismatchCount = 0;
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 100; i++) {
+            @autoreleasepool {
+                if ([mappedDiskCache dataForKey:@"large"].length != largeData.length) {
+                    measuredMismatchCount++;
+                }
+            }
+        }
+    }];
+    expect(measuredMismatchCount).equal(0);
+    [plainDiskCache removeAllData];
+}
+
+- (void)test67DecodedDiskCacheTier {
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.decodedDiskCacheLimit = 50 * 1024 * 1024;
+    config.decodedDiskCachePopulateThreshold = 2;
+    config.shouldCacheImagesInMemory = NO;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"Decoded" diskCacheDirectory:[self userCacheDirectory] config:config];
+    NSString *decodedPath = [cache.diskCachePath stringByAppendingPathExtension:@"decoded"];
+    NSData *data = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    [cache storeImageDataToDisk:data forKey:kTestImageKeyJPEG];
+    
+    // The first decode does not populate, the second one does
+    UIImage *decodedImage = [cache imageFromDiskCacheForKey:kTestImageKeyJPEG];
+    expect(decodedImage).notTo.beNil();
+    expect([[NSFileManager defaultManager] fileExistsAtPath:[decodedPath stringByAppendingPathComponent:[cache.diskCache cachePathForKey:kTestImageKeyJPEG].lastPathComponent]]).beFalsy();
+    decodedImage = [cache imageFromDiskCacheForKey:kTestImageKeyJPEG];
+    expect([[NSFileManager defaultManager] fileExistsAtPath:[decodedPath stringByAppendingPathComponent:[cache.diskCache cachePathForKey:kTestImageKeyJPEG].lastPathComponent]]).beTruthy();
+    
+    // Mapped back from the raw bitmap
+    UIImage *mappedImage = [cache imageFromDiskCacheForKey:kTestImageKeyJPEG];
+    expect(mappedImage.size).equal(decodedImage.size);
+    expect(mappedImage.scale).equal(decodedImage.scale);
+    expect(mappedImage.sd_isDecoded).beTruthy();
+    expect(mappedImage.sd_imageFormat).equal(SDImageFormatJPEG);
+    
+    // Measure the disk hits mapped from the raw bitmap
+    __block NSUInteger measuredMissCount = 0;
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 20; i++) {
+            @autoreleasepool {
+                if (![cache imageFromDiskCacheForKey:kTestImageKeyJPEG options:0 context:nil].sd_isDecoded) {
+                    measuredMissCount++;
+                }
+            }
+        }
+    }];
+    expect(measuredMissCount).equal(0);
+    
+    // Update the disk data drops the decoded image
+    [cache storeImageDataToDisk:data forKey:kTestImageKeyJPEG];
+    expect([[NSFileManager defaultManager] fileExistsAtPath:[decodedPath stringByAppendingPathComponent:[cache.diskCache cachePathForKey:kTestImageKeyJPEG].lastPathComponent]]).beFalsy();
+    
+    // The color space is kept, such as a wide gamut image
+    CGColorSpaceRef displayP3 = CGColorSpaceCreateWithName(kCGColorSpaceDisplayP3);
+    CGContextRef context = CGBitmapContextCreate(NULL, 16, 16, 8, 0, displayP3, kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst);
+    CGContextSetRGBFillColor(context, 1, 0, 0, 1);
+    CGContextFillRect(context, CGRectMake(0, 0, 16, 16));
+    CGImageRef imageRef = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    CGColorSpaceRelease(displayP3);
+#if SD_UIKIT
+    UIImage *wideGamutImage = [[UIImage alloc] initWithCGImage:imageRef];
+#else
+    UIImage *wideGamutImage = [[UIImage alloc] initWithCGImage:imageRef size:NSZeroSize];
+#endif
+    NSData *wideGamutData = [SDImageIOCoder.sharedCoder encodedDataWithImage:wideGamutImage format:SDImageFormatPNG options:nil];
+    CGImageRelease(imageRef);
+    NSString *wideGamutKey = @"WideGamut";
+    [cache storeImageDataToDisk:wideGamutData forKey:wideGamutKey];
+    [cache imageFromDiskCacheForKey:wideGamutKey];
+    decodedImage = [cache imageFromDiskCacheForKey:wideGamutKey];
+    mappedImage = [cache imageFromDiskCacheForKey:wideGamutKey];
+    expect(mappedImage).notTo.beNil();
+    expect(CFEqual(CGImageGetColorSpace(mappedImage.CGImage), CGImageGetColorSpace(decodedImage.CGImage))).beTruthy();
+    
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Clear decoded disk cache"];
+    [cache clearDiskOnCompletion:^{
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)test68DiskCacheGDSFEvictionReplay {
+    // Replay a captured trace (one "key size" per line) when provided, otherwise a seeded Zipf-like trace whose sizes are not correlated to the popularity
+    NSMutableArray<NSString *> *keys = [NSMutableArray array];
+    NSMutableArray<NSNumber *> *sizes = [NSMutableArray array];
+    NSUInteger workingSetSize = 0;
+    NSString *tracePath = NSProcessInfo.processInfo.environment[@"SD_DISK_CACHE_TRACE"];
+    if (tracePath) {
+        NSString *content = [NSString stringWithContentsOfFile:tracePath encoding:NSUTF8StringEncoding error:nil];
+        NSMutableSet<NSString *> *uniqueKeys = [NSMutableSet set];
+        for (NSString *line in [content componentsSeparatedByCharactersInSet:NSCharacterSet.newlineCharacterSet]) {
+            NSArray<NSString *> *components = [line componentsSeparatedByString:@" "];
+            if (components.count < 2) {
+                continue;
+            }
+            [keys addObject:components[0]];
+            [sizes addObject:@(components[1].integerValue)];
+            if (![uniqueKeys containsObject:components[0]]) {
+                [uniqueKeys addObject:components[0]];
+                workingSetSize += components[1].integerValue;
+            }
+        }
+    } else {
+        const NSUInteger keyCount = 200;
+        const NSUInteger requestCount = 2000;
+        __block uint64_t seed = 42;
+        double (^random)(void) = ^double(void) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            return (double)(seed >> 33) / (double)(1ULL << 31);
+        };
+        NSUInteger keySizes[keyCount];
+        double cdf[keyCount];
+        double weightSum = 0;
+        for (NSUInteger i = 0; i < keyCount; i++) {
+            keySizes[i] = 1024 + (NSUInteger)(random() * 31 * 1024);
+            workingSetSize += keySizes[i];
+            weightSum += 1 / pow(i + 1, 0.8);
+            cdf[i] = weightSum;
+        }
+        for (NSUInteger n = 0; n < requestCount; n++) {
+            double u = random() * weightSum;
+            NSUInteger i = 0;
+            while (i < keyCount - 1 && cdf[i] < u) {
+                i++;
+            }
+            [keys addObject:[NSString stringWithFormat:@"zipf-%lu", (unsigned long)i]];
+            [sizes addObject:@(keySizes[i])];
+        }
+    }
+    NSString *cachePath = [[self userCacheDirectory] stringByAppendingPathComponent:@"gdsf"];
+    void (^replay)(SDImageCacheConfigDiskEvictionPolicy, double *, double *) = ^(SDImageCacheConfigDiskEvictionPolicy policy, double *hitRatio, double *byteHitRatio) {
+        SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+        config.maxDiskAge = -1;
+        config.maxDiskSize = workingSetSize / 5;
+        config.diskCacheEvictionPolicy = policy;
+        SDDiskCache *diskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+        [diskCache removeAllData];
+        NSUInteger hitCount = 0;
+        NSUInteger hitBytes = 0;
+        NSUInteger requestBytes = 0;
+        for (NSUInteger i = 0; i < keys.count; i++) {
+            NSUInteger size = sizes[i].unsignedIntegerValue;
+            requestBytes += size;
+            if ([diskCache dataForKey:keys[i]]) {
+                hitCount++;
+                hitBytes += size;
+                continue;
+            }
+            [diskCache setData:[NSMutableData dataWithLength:size] forKey:keys[i]];
+            if (diskCache.totalSize > config.maxDiskSize) {
+                [diskCache removeExpiredData];
+            }
+        }
+        [diskCache removeAllData];
+        *hitRatio = keys.count > 0 ? (double)hitCount / keys.count : 0;
+        *byteHitRatio = requestBytes > 0 ? (double)hitBytes / requestBytes : 0;
+    };
+    double dateHitRatio, dateByteHitRatio;
+    double gdsfHitRatio, gdsfByteHitRatio;
+    double gdsfBytesHitRatio, gdsfBytesByteHitRatio;
+    replay(SDImageCacheConfigDiskEvictionPolicyDate, &dateHitRatio, &dateByteHitRatio);
+    replay(SDImageCacheConfigDiskEvictionPolicyGDSF, &gdsfHitRatio, &gdsfByteHitRatio);
+    replay(SDImageCacheConfigDiskEvictionPolicyGDSFByteHitRatio, &gdsfBytesHitRatio, &gdsfBytesByteHitRatio);
+    if (!tracePath) {
+        // The uniform cost keeps the small popular files, the size cost keeps the popular bytes
+        expect(gdsfHitRatio).beGreaterThan(dateHitRatio + 0.05);
+        expect(gdsfHitRatio).beGreaterThanOrEqualTo(gdsfBytesHitRatio);
+        expect(gdsfBytesByteHitRatio).beGreaterThanOrEqualTo(dateByteHitRatio);
+    }
+}
+
+- (void)test69ConcurrentDiskOperationsKeepPerKeyOrder {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Concurrent disk operations keep per-key order"];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.maxConcurrentDiskOperationCount = 4;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"ConcurrentDisk" diskCacheDirectory:[self userCacheDirectory] config:config];
+    [cache clearDiskOnCompletion:nil];
+    NSData *imageData = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    UIImage *image = [[UIImage alloc] initWithData:imageData];
+    NSUInteger keyCount = 16;
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        NSString *key = [NSString stringWithFormat:@"ConcurrentDisk-%lu", (unsigned long)i];
+        // Store then remove the odd keys, the removal must not run before the store
+        [cache storeImage:image imageData:imageData forKey:key toMemory:NO toDisk:YES completion:nil];
+        if (i % 2 == 1) {
+            [cache removeImageForKey:key fromMemory:NO fromDisk:YES withCompletion:nil];
+        }
+    }
+    // The barrier waits for all the operations submitted before
+    expect(cache.totalDiskCount).equal(keyCount / 2);
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        NSString *key = [NSString stringWithFormat:@"ConcurrentDisk-%lu", (unsigned long)i];
+        expect([cache diskImageDataExistsWithKey:key]).equal(i % 2 == 0);
+    }
+    [cache clearDiskOnCompletion:^{
+        expect(cache.totalDiskCount).equal(0);
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)test70ConcurrentDiskQueryBenchmark {
+    // Measure the concurrent queries, each query records its miss which is checked on the test thread
+    NSData *imageData = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    NSUInteger keyCount = 64;
+    NSUInteger queryCount = 2000;
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.maxConcurrentDiskOperationCount = 4;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"ConcurrentDiskBenchmark" diskCacheDirectory:[self userCacheDirectory] config:config];
+    for (NSUInteger i = 0; i < keyCount; i++) {
+        [cache storeImageDataToDisk:imageData forKey:[NSString stringWithFormat:@"ConcurrentDiskBenchmark-%lu", (unsigned long)i]];
+    }
+    NSUInteger (^query)(void) = ^NSUInteger {
+        BOOL *misses = calloc(queryCount, sizeof(BOOL));
+        dispatch_apply(queryCount, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            NSString *key = [NSString stringWithFormat:@"ConcurrentDiskBenchmark-%lu", (unsigned long)(i % keyCount)];
+            misses[i] = [cache diskImageDataForKey:key] == nil;
+        });
+        NSUInteger missCount = 0;
+        for (NSUInteger i = 0; i < queryCount; i++) {
+            missCount += misses[i] ? 1 : 0;
+        }
+        free(misses);
+        return missCount;
+    };
+    expect(query()).equal(0);
+    __block NSUInteger measuredMissCount = 0;
+    [self measureBlock:^{
+        measuredMissCount += query();
+    }];
+    expect(measuredMissCount).equal(0);
+    [cache clearDiskOnCompletion:nil];
+}
+
+- (void)test71QueryOperationDecodesOutOfIOScheduler {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Query operation decodes out of IO scheduler"];
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"QueryStages"];
+    NSString *key = @"QueryStages";
+    NSData *imageData = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    [cache storeImageDataToDisk:imageData forKey:key];
+    // Sync query decodes on the calling thread
+    SDImageCacheQueryOperation *syncOperation = (SDImageCacheQueryOperation *)[cache queryCacheOperationForKey:key options:SDImageCacheQueryDiskDataSync context:nil cacheType:SDImageCacheTypeDisk done:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {
+        expect(image).notTo.beNil();
+        expect(cacheType).equal(SDImageCacheTypeDisk);
+    }];
+    expect(syncOperation).beKindOf([SDImageCacheQueryOperation class]);
+    expect(syncOperation.decodeDuration).beGreaterThan(0);
+    expect(syncOperation.totalDuration).beGreaterThanOrEqualTo(syncOperation.ioDuration + syncOperation.decodeDuration);
+    // The cancelled query does not decode
+    SDImageCacheQueryOperation *cancelledOperation = (SDImageCacheQueryOperation *)[cache queryCacheOperationForKey:key options:0 context:nil cacheType:SDImageCacheTypeDisk done:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {
+        expect(image).beNil();
+    }];
+    [cancelledOperation cancel];
+    __block SDImageCacheQueryOperation *operation;
+    operation = (SDImageCacheQueryOperation *)[cache queryCacheOperationForKey:key options:0 context:nil cacheType:SDImageCacheTypeDisk done:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {
+        expect([NSThread isMainThread]).beTruthy();
+        expect(image).notTo.beNil();
+        expect(data).equal(imageData);
+        expect(cancelledOperation.decodeDuration).equal(0);
+        expect(operation.decodeDuration).beGreaterThan(0);
+        [cache clearDiskOnCompletion:^{
+            [expectation fulfill];
+        }];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)test72BatchQueryImagesForKeys {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Batch query images for keys"];
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.maxConcurrentDiskOperationCount = 2;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"BatchQuery" diskCacheDirectory:[self userCacheDirectory] config:config];
+    NSData *imageData = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    UIImage *image = [[UIImage alloc] initWithData:imageData];
+    [cache storeImageToMemory:image forKey:@"BatchQuery-Memory"];
+    for (NSUInteger i = 0; i < 4; i++) {
+        [cache storeImageDataToDisk:imageData forKey:[NSString stringWithFormat:@"BatchQuery-Disk-%lu", (unsigned long)i]];
+    }
+    NSArray<NSString *> *keys = @[@"BatchQuery-Memory", @"BatchQuery-Disk-0", @"BatchQuery-Disk-1", @"BatchQuery-Disk-2", @"BatchQuery-Disk-3", @"BatchQuery-Missing", @"BatchQuery-Disk-0"];
+    NSMutableSet<NSString *> *progressKeys = [NSMutableSet set];
+    [cache queryImagesForKeys:keys options:0 context:nil cacheType:SDImageCacheTypeAll progress:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType, NSString * _Nonnull key) {
+        // Including the memory results, because some keys need disk query
+        expect([NSThread isMainThread]).beTruthy();
+        expect([progressKeys containsObject:key]).beFalsy();
+        [progressKeys addObject:key];
+        expect(image == nil).equal([key isEqualToString:@"BatchQuery-Missing"]);
+    } completion:^(NSDictionary<NSString *,UIImage *> * _Nonnull images, NSDictionary<NSString *,NSNumber *> * _Nonnull cacheTypes) {
+        expect([NSThread isMainThread]).beTruthy();
+        expect(progressKeys.count).equal(6);
+        expect(images.count).equal(5);
+        expect(images[@"BatchQuery-Missing"]).beNil();
+        expect(cacheTypes[@"BatchQuery-Memory"].integerValue).equal(SDImageCacheTypeMemory);
+        expect(cacheTypes[@"BatchQuery-Disk-3"].integerValue).equal(SDImageCacheTypeDisk);
+        // The disk images are inserted into memory cache
+        expect([cache imageFromMemoryCacheForKey:@"BatchQuery-Disk-3"]).notTo.beNil();
+        // The caches manager coalesces the results from the caches
+        SDImageCachesManager *cachesManager = [[SDImageCachesManager alloc] init];
+        cachesManager.caches = @[[SDImageCache sharedImageCache], cache];
+        [cachesManager queryImagesForKeys:keys options:0 context:nil cacheType:SDImageCacheTypeAll progress:nil completion:^(NSDictionary<NSString *,UIImage *> * _Nonnull managerImages, NSDictionary<NSString *,NSNumber *> * _Nonnull managerCacheTypes) {
+            expect(managerImages.count).equal(5);
+            [cache clearMemory];
+            [cache clearDiskOnCompletion:^{
+                [expectation fulfill];
+            }];
+        }];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)test73BatchQueryCancelCallsCompletionWithPartialResults {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Batch query cancel calls completion with partial results"];
+    expectation.expectedFulfillmentCount = 2;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"BatchQueryCancel" diskCacheDirectory:[self userCacheDirectory]];
+    NSData *imageData = [NSData dataWithContentsOfFile:[self testJPEGPath]];
+    NSMutableArray<NSString *> *keys = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 20; i++) {
+        NSString *key = [NSString stringWithFormat:@"BatchQueryCancel-%lu", (unsigned long)i];
+        [cache storeImageDataToDisk:imageData forKey:key];
+        [keys addObject:key];
+    }
+    __block NSUInteger completionCount = 0;
+    id<SDWebImageOperation> operation = [cache queryImagesForKeys:keys options:0 context:nil cacheType:SDImageCacheTypeDisk progress:nil completion:^(NSDictionary<NSString *,UIImage *> * _Nonnull images, NSDictionary<NSString *,NSNumber *> * _Nonnull cacheTypes) {
+        expect([NSThread isMainThread]).beTruthy();
+        expect(images.count).beLessThanOrEqualTo(keys.count);
+        completionCount++;
+        expect(completionCount).equal(1);
+        [expectation fulfill];
+    }];
+    expect(operation).notTo.beNil();
+    [operation cancel];
+    // The caches manager cancels the inner batch operation of each cache, and calls the completion once as well
+    SDImageCachesManager *cachesManager = [[SDImageCachesManager alloc] init];
+    cachesManager.caches = @[[SDImageCache sharedImageCache], cache];
+    __block NSUInteger managerCompletionCount = 0;
+    id<SDWebImageOperation> managerOperation = [cachesManager queryImagesForKeys:keys options:0 context:nil cacheType:SDImageCacheTypeDisk progress:nil completion:^(NSDictionary<NSString *,UIImage *> * _Nonnull images, NSDictionary<NSString *,NSNumber *> * _Nonnull cacheTypes) {
+        managerCompletionCount++;
+        expect(managerCompletionCount).equal(1);
+        [expectation fulfill];
+    }];
+    [managerOperation cancel];
+    [self waitForExpectationsWithCommonTimeout];
+    [cache clearDiskOnCompletion:nil];
+}
+
+- (void)test74StaleTemporaryFilesAreRemovedWithExpiredData {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Stale temporary files are removed with expired data"];
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"TemporaryFile" diskCacheDirectory:[self userCacheDirectory]];
+    NSString *staleFilePath = [cache uniqueTemporaryFilePath];
+    NSString *activeFilePath = [cache uniqueTemporaryFilePath];
+    expect(staleFilePath).notTo.equal(activeFilePath);
+    [[NSData dataWithContentsOfFile:[self testJPEGPath]] writeToFile:staleFilePath atomically:YES];
+    [[NSData dataWithContentsOfFile:[self testJPEGPath]] writeToFile:activeFilePath atomically:YES];
+    [[NSFileManager defaultManager] setAttributes:@{NSFileModificationDate : [NSDate dateWithTimeIntervalSinceNow:-2 * 60 * 60]} ofItemAtPath:staleFilePath error:nil];
+    // The temporary files are not cache files
+    expect([cache totalDiskCount]).equal(0);
+    [cache deleteOldFilesWithCompletionBlock:^{
+        expect([[NSFileManager defaultManager] fileExistsAtPath:staleFilePath]).beFalsy();
+        expect([[NSFileManager defaultManager] fileExistsAtPath:activeFilePath]).beTruthy();
+        [[NSFileManager defaultManager] removeItemAtPath:activeFilePath error:nil];
+        [expectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)test75ConcurrentQueriesForSameKeyShareOneDecode {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Concurrent queries for same key share one decode"];
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"InflightQuery"];
+    NSString *key = @"InflightQuery";
+    [cache storeImageDataToDisk:[NSData dataWithContentsOfFile:[self testJPEGPath]] forKey:key];
+    NSUInteger queryCount = 10;
+    NSMutableArray<UIImage *> *images = [NSMutableArray array];
+    void(^checkBlock)(void) = ^{
+        if (images.count < queryCount - 1) {
+            return;
+        }
+        // All the queries receive the same decoded image
+        for (UIImage *image in images) {
+            expect(image).beIdenticalTo(images.firstObject);
+        }
+        [expectation fulfill];
+    };
+    NSMutableArray<NSOperation *> *operations = [NSMutableArray array];
+    for (NSUInteger i = 0; i < queryCount; i++) {
+        NSOperation *operation = [cache queryCacheOperationForKey:key options:0 context:nil cacheType:SDImageCacheTypeDisk done:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {
+            if (i == 0) {
+                // The cancelled query is still called back, without image
+                expect(image).beNil();
+                expect(cacheType).equal(SDImageCacheTypeNone);
+                return;
+            }
+            expect(image).notTo.beNil();
+            [images addObject:image];
+            checkBlock();
+        }];
+        [operations addObject:operation];
+    }
+    // Cancelling one query does not cancel the shared read/decode
+    [operations.firstObject cancel];
+    // The thumbnail query does not share the full size decode
+    XCTestExpectation *thumbnailExpectation = [self expectationWithDescription:@"Thumbnail query does not share the full size decode"];
+    __block UIImage *thumbnailImage;
+    [cache queryCacheOperationForKey:key options:0 context:@{SDWebImageContextImageThumbnailPixelSize : @(CGSizeMake(10, 10))} cacheType:SDImageCacheTypeDisk done:^(UIImage * _Nullable image, NSData * _Nullable data, SDImageCacheType cacheType) {
+        expect(image).notTo.beNil();
+        thumbnailImage = image;
+        [thumbnailExpectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+    expect(images.firstObject).notTo.beNil();
+    expect(thumbnailImage).notTo.beNil();
+    expect(thumbnailImage).notTo.beIdenticalTo(images.firstObject);
+    
+    XCTestExpectation *clearExpectation = [self expectationWithDescription:@"Clear inflight query cache"];
+    [cache clearMemory];
+    [cache clearDiskOnCompletion:^{
+        [clearExpectation fulfill];
+    }];
+    [self waitForExpectationsWithCommonTimeout];
+}
+
+- (void)test76MemoryCacheGraduatedPressureTrimming {
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.memoryCacheShardCount = 1;
+    config.shouldUseWeakMemoryCache = NO;
+    config.maxMemoryCost = 100;
+    config.memoryCachePressureTrimRatio = 0.5;
+    SDMemoryCache *memoryCache = [[SDMemoryCache alloc] initWithConfig:config];
+    // From the oldest to the newest: "0" (pinned), "big", "1" ... "7"
+    [memoryCache setObject:[NSObject new] forKey:@"0" cost:10];
+    [memoryCache setObject:[NSObject new] forKey:@"big" cost:20];
+    for (NSUInteger i = 1; i <= 7; i++) {
+        [memoryCache setObject:[NSObject new] forKey:@(i).stringValue cost:10];
+    }
+    [memoryCache pinObjectForKey:@"0"];
+    expect(memoryCache.totalCost).equal(100);
+    
+    // Normal does nothing
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelNormal];
+    expect(memoryCache.totalCount).equal(9);
+    // First warning trims to half, the large and old entry goes first, the pinned one is kept
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelWarning];
+    expect(memoryCache.totalCost).equal(50);
+    expect(memoryCache.totalCount).equal(5);
+    expect([memoryCache objectForKey:@"big"]).beNil();
+    expect([memoryCache objectForKey:@"3"]).beNil();
+    // Repeated warning trims to a quarter
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelUrgent];
+    expect(memoryCache.totalCost).equal(20);
+    expect([memoryCache objectForKey:@"7"]).notTo.beNil();
+    expect([memoryCache objectForKey:@"0"]).notTo.beNil();
+    // Critical removes all except pinned
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelCritical];
+    expect(memoryCache.totalCount).equal(1);
+    expect([memoryCache objectForKey:@"0"]).notTo.beNil();
+    [memoryCache unpinObjectForKey:@"0"];
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelCritical];
+    expect(memoryCache.totalCount).equal(0);
+}
+
+- (void)test77MemoryCachePressureTrimmingBenchmark {
+    const NSUInteger entryCount = 20000;
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.shouldUseWeakMemoryCache = NO;
+    config.memoryCachePressureTrimRatio = 0.5;
+    SDMemoryCache *memoryCache = [[SDMemoryCache alloc] initWithConfig:config];
+    void (^fill)(void) = ^{
+        [memoryCache removeAllObjects];
+        for (NSUInteger i = 0; i < entryCount; i++) {
+            [memoryCache setObject:[NSObject new] forKey:@(i).stringValue cost:(i % 1024) * 1024 + 1];
+        }
+    };
+    // Without limits, each level trims its fraction of the current total
+    fill();
+    NSUInteger totalCost = memoryCache.totalCost;
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelWarning];
+    expect(memoryCache.totalCost).beLessThanOrEqualTo(totalCost * 0.5);
+    expect(memoryCache.totalCount).beGreaterThan(0);
+    totalCost = memoryCache.totalCost;
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelUrgent];
+    expect(memoryCache.totalCost).beLessThanOrEqualTo(totalCost * 0.25);
+    [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelCritical];
+    expect(memoryCache.totalCount).equal(0);
+    
+    // Measure the warning level trimming only, not the filling
+    [self measureMetrics:[[self class] defaultPerformanceMetrics] automaticallyStartMeasuring:NO forBlock:^{
+        fill();
+        [self startMeasuring];
+        [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelWarning];
+        [self stopMeasuring];
+    }];
+    expect(memoryCache.totalCount).beLessThan(entryCount);
+}
+
+- (void)test78DiskCacheWatermarksAreValidated {
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.diskCacheHighWatermark = 2;
+    config.diskCacheLowWatermark = -1;
+    expect(config.diskCacheHighWatermark).equal(1);
+    expect(config.diskCacheLowWatermark).equal(0);
+    config.diskCacheHighWatermark = NAN;
+    config.diskCacheLowWatermark = NAN;
+    expect(config.diskCacheHighWatermark).equal(1);
+    expect(config.diskCacheLowWatermark).equal(0);
+    
+    // The low watermark above the high watermark still trims below the high watermark
+    NSString *cachePath = [[self userCacheDirectory] stringByAppendingPathComponent:@"watermark"];
+    config.maxDiskSize = 100;
+    config.diskCacheHighWatermark = 0.5;
+    config.diskCacheLowWatermark = 0.9;
+    SDDiskCache *diskCache = [[SDDiskCache alloc] initWithCachePath:cachePath config:config];
+    [diskCache removeAllData];
+    NSData *data = [NSData dataWithBytes:"0123456789" length:10];
+    for (NSUInteger i = 0; i < 6; i++) {
+        [diskCache setData:data forKey:[NSString stringWithFormat:@"key-%lu", (unsigned long)i]];
+    }
+    [diskCache removeExpiredData];
+    expect(diskCache.totalSize).beLessThanOrEqualTo(50);
+    [diskCache removeAllData];
+}
+
 #pragma mark - SDImageCache & SDImageCachesManager
 - (void)test49SDImageCacheQueryOp {
     XCTestExpectation *expectation = [self expectationWithDescription:@"SDImageCache query op works"];
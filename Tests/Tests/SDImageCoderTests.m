@@ -322,6 +322,261 @@
     }
 }
 
+- (void)test22ThatDecodedBufferIsReusedByBufferPool {
+    SDImageBufferPool *pool = SDImageBufferPool.sharedPool;
+    // The pooling is opt-in
+    expect(pool.maxPooledBytes).equal(0);
+    pool.maxPooledBytes = 16 * 1024 * 1024;
+    [pool removeAllBuffers];
+    [pool resetStatistics];
+    NSString *testImagePath = [[NSBundle bundleForClass:[self class]] pathForResource:@"TestImage" ofType:@"jpg"];
+    UIImage *image = [[UIImage alloc] initWithContentsOfFile:testImagePath];
+    CGImageRef imageRef = [SDImageCoderHelper CGImageCreateDecoded:image.CGImage];
+    expect(imageRef).notTo.beNil();
+    expect(pool.missCount).equal(1);
+    size_t bytesPerRow = CGImageGetBytesPerRow(imageRef);
+    size_t height = CGImageGetHeight(imageRef);
+    // Release the decoded image, the buffer goes back to pool
+    CGImageRelease(imageRef);
+    expect(pool.pooledBytes).equal(bytesPerRow * height);
+    // Decode the same size again, reuse the buffer
+    CGImageRef reusedImageRef = [SDImageCoderHelper CGImageCreateDecoded:image.CGImage];
+    expect(reusedImageRef).notTo.beNil();
+    expect(pool.hitCount).equal(1);
+    expect(pool.pooledBytes).equal(0);
+    expect(CGImageGetWidth(reusedImageRef)).equal(CGImageGetWidth(image.CGImage));
+    CGImageRelease(reusedImageRef);
+    // The byte cap evicts the idle buffers
+    pool.maxPooledBytes = 1;
+    void *buffer = [pool acquireBufferWithWidth:16 height:16 bytesPerRow:64 bitmapInfo:kCGBitmapByteOrder32Host];
+    [pool recycleBuffer:buffer width:16 height:16 bytesPerRow:64 bitmapInfo:kCGBitmapByteOrder32Host];
+    expect(pool.pooledBytes).equal(0);
+    // The overflowed size is rejected
+    expect([SDImageBufferPool bytesPerRowForWidth:SIZE_MAX bytesPerPixel:4]).equal(0);
+    expect([pool acquireBufferWithWidth:16 height:SIZE_MAX bytesPerRow:64 bitmapInfo:kCGBitmapByteOrder32Host] == NULL).beTruthy();
+    pool.maxPooledBytes = 0;
+    [pool removeAllBuffers];
+}
+
+- (void)test23BufferPoolAllocationBenchmark {
+    // 1024x1024 BGRA, same as a full screen image decoding
+    const size_t width = 1024, height = 1024;
+    const NSUInteger iterationCount = 200;
+    size_t bytesPerRow = [SDImageBufferPool bytesPerRowForWidth:width bytesPerPixel:4];
+    CGBitmapInfo bitmapInfo = kCGBitmapByteOrder32Host | kCGImageAlphaPremultipliedFirst;
+    SDImageBufferPool *pool = [[SDImageBufferPool alloc] init];
+    pool.maxPooledBytes = 16 * 1024 * 1024;
+    void (^acquireAndRecycle)(void) = ^{
+        for (NSUInteger i = 0; i < iterationCount; i++) {
+            void *buffer = [pool acquireBufferWithWidth:width height:height bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+            memset(buffer, (int)i, bytesPerRow * height);
+            [pool recycleBuffer:buffer width:width height:height bytesPerRow:bytesPerRow bitmapInfo:bitmapInfo];
+        }
+    };
+    // Only the first acquisition allocates
+    acquireAndRecycle();
+    expect(pool.hitCount).equal(iterationCount - 1);
+    expect(pool.missCount).equal(1);
+    expect(pool.pooledBytes).equal(bytesPerRow * height);
+    // The warm pool never allocates while measuring
+    [pool resetStatistics];
+    [self measureBlock:^{
+        acquireAndRecycle();
+    }];
+    expect(pool.missCount).equal(0);
+    expect(pool.hitCount).beGreaterThan(0);
+}
+
+- (void)test24ThatAppendIncrementalDataDecodeSameAsUpdate {
+    NSArray<NSString *> *names = @[@"jpg", @"gif"];
+    for (NSString *type in names) {
+        NSString *testImagePath = [[NSBundle bundleForClass:[self class]] pathForResource:@"TestImage" ofType:type];
+        NSData *testImageData = [NSData dataWithContentsOfFile:testImagePath];
+        UIImage *image = [SDImageCodersManager.sharedManager decodedImageWithData:testImageData options:nil];
+        expect(image).notTo.beNil();
+        id<SDProgressiveImageCoder> coder = [type isEqualToString:@"gif"] ? [[SDImageGIFCoder alloc] initIncrementalWithOptions:nil] : [[SDImageIOCoder alloc] initIncrementalWithOptions:nil];
+        expect([coder respondsToSelector:@selector(appendIncrementalData:finished:)]).beTruthy();
+        // Feed only the new bytes for each chunk
+        NSUInteger chunkLength = MAX(testImageData.length / 8, 1);
+        for (NSUInteger offset = 0; offset < testImageData.length; offset += chunkLength) {
+            NSUInteger length = MIN(chunkLength, testImageData.length - offset);
+            BOOL finished = offset + length == testImageData.length;
+            [coder appendIncrementalData:[testImageData subdataWithRange:NSMakeRange(offset, length)] finished:finished];
+        }
+        UIImage *progressiveImage = [coder incrementalDecodedImageWithOptions:nil];
+        expect(progressiveImage).notTo.beNil();
+        expect(progressiveImage.size).equal(image.size);
+        if ([coder conformsToProtocol:@protocol(SDAnimatedImageCoder)]) {
+            expect([(id<SDAnimatedImageCoder>)coder animatedImageData]).equal(testImageData);
+            expect([(id<SDAnimatedImageCoder>)coder animatedImageFrameCount]).equal([SDImageGIFCoder.sharedCoder decodedImageWithData:testImageData options:nil].sd_imageFrameCount);
+        }
+    }
+}
+
+- (void)test25ThatImageHeaderProberParseHeaderFromFirstBytes {
+    // name, extension, format, width, height, frame count
+    NSArray<NSArray *> *cases = @[
+        @[@"TestImage", @"jpg", @(SDImageFormatJPEG), @80, @60, @1],
+        @[@"TestImage", @"png", @(SDImageFormatPNG), @300, @300, @1],
+        @[@"TestImageAnimated", @"apng", @(SDImageFormatPNG), @320, @240, @101],
+        @[@"TestImage", @"gif", @(SDImageFormatGIF), @50, @50, @0],
+        @[@"TestImageStatic", @"webp", @(SDImageFormatWebP), @550, @368, @1],
+        @[@"TestImageAnimated", @"webp", @(SDImageFormatWebP), @990, @1050, @0],
+        @[@"TestImage", @"heic", @(SDImageFormatHEIC), @1440, @960, @1],
+        @[@"TestImage", @"heif", @(SDImageFormatHEIF), @1440, @960, @1],
+    ];
+    for (NSArray *testCase in cases) {
+        NSString *testImagePath = [[NSBundle bundleForClass:[self class]] pathForResource:testCase[0] ofType:testCase[1]];
+        NSData *testImageData = [NSData dataWithContentsOfFile:testImagePath];
+        CGSize pixelSize = CGSizeMake([testCase[3] doubleValue], [testCase[4] doubleValue]);
+        // Feed small chunks like the network, the parser resumes across the chunk boundaries
+        for (NSNumber *chunkLength in @[@1, @7, @64]) {
+            SDImageHeaderProber *prober = [[SDImageHeaderProber alloc] init];
+            NSUInteger offset = 0;
+            while (prober.status == SDImageHeaderProbeStatusNeedMoreData && offset < testImageData.length) {
+                NSUInteger length = MIN(chunkLength.unsignedIntegerValue, testImageData.length - offset);
+                [prober appendData:[testImageData subdataWithRange:NSMakeRange(offset, length)]];
+                offset += length;
+            }
+            expect(prober.status).equal(SDImageHeaderProbeStatusSucceeded);
+            // Only the first few KB are needed
+            expect(offset).beLessThanOrEqualTo(4096);
+            SDImageHeaderInfo *headerInfo = prober.headerInfo;
+            expect(headerInfo.format).equal([testCase[2] integerValue]);
+            expect(headerInfo.pixelSize).equal(pixelSize);
+            expect(headerInfo.frameCount).equal([testCase[5] unsignedIntegerValue]);
+        }
+        // Any prefix gives either nothing or the same header
+        for (NSUInteger length = 1; length <= MIN(testImageData.length, 4096); length++) {
+            SDImageHeaderInfo *headerInfo = [SDImageHeaderProber headerInfoWithData:[testImageData subdataWithRange:NSMakeRange(0, length)]];
+            if (headerInfo) {
+                expect(headerInfo.pixelSize).equal(pixelSize);
+            }
+        }
+    }
+    // Not supported, or truncated data
+    NSString *pdfPath = [[NSBundle bundleForClass:[self class]] pathForResource:@"TestImage" ofType:@"pdf"];
+    expect([SDImageHeaderProber headerInfoWithData:[NSData dataWithContentsOfFile:pdfPath]]).beNil();
+    NSString *jpegPath = [[NSBundle bundleForClass:[self class]] pathForResource:@"TestImage" ofType:@"jpg"];
+    NSData *jpegData = [NSData dataWithContentsOfFile:jpegPath];
+    expect([SDImageHeaderProber headerInfoWithData:[jpegData subdataWithRange:NSMakeRange(0, 100)]]).beNil();
+}
+
+- (void)test26ThatImageFormatSignaturesMatchCorpus {
+    // name, extension, format
+    NSArray<NSArray *> *cases = @[
+        @[@"TestImage", @"jpg", @(SDImageFormatJPEG)],
+        @[@"TestImageLarge", @"jpg", @(SDImageFormatJPEG)],
+        @[@"MonochromeTestImage", @"jpg", @(SDImageFormatJPEG)],
+        @[@"TestImage", @"png", @(SDImageFormatPNG)],
+        @[@"TestImageLarge", @"png", @(SDImageFormatPNG)],
+        @[@"TestEXIF", @"png", @(SDImageFormatPNG)],
+        @[@"TestImageAnimated", @"apng", @(SDImageFormatPNG)],
+        @[@"TestImage", @"gif", @(SDImageFormatGIF)],
+        @[@"TestLoopCount", @"gif", @(SDImageFormatGIF)],
+        @[@"1@2x", @"gif", @(SDImageFormatGIF)],
+        @[@"TestImageStatic", @"webp", @(SDImageFormatWebP)],
+        @[@"TestImageAnimated", @"webp", @(SDImageFormatWebP)],
+        @[@"TestAnimatedImageMemory", @"webp", @(SDImageFormatWebP)],
+        @[@"TestImage", @"heic", @(SDImageFormatHEIC)],
+        @[@"TestImage", @"heif", @(SDImageFormatHEIF)],
+        @[@"TestImageAnimated", @"heic", @(SDImageFormatHEIF)], // major brand msf1
+        @[@"TestImage", @"pdf", @(SDImageFormatPDF)],
+    ];
+    for (NSArray *testCase in cases) {
+        NSString *testImagePath = [[NSBundle bundleForClass:[self class]] pathForResource:testCase[0] ofType:testCase[1]];
+        NSData *testImageData = [NSData dataWithContentsOfFile:testImagePath];
+        SDImageFormatConfidence confidence;
+        expect([NSData sd_imageFormatForImageData:testImageData confidence:&confidence]).equal([testCase[2] integerValue]);
+        expect(confidence).equal(SDImageFormatConfidenceHigh);
+        // The truncated signature is a low confidence guess
+        [NSData sd_imageFormatForImageData:[testImageData subdataWithRange:NSMakeRange(0, 2)] confidence:&confidence];
+        expect(confidence).beLessThanOrEqualTo(SDImageFormatConfidenceLow);
+    }
+    // The formats without test image, AVIF and JPEG XL use the value of the coder plugins
+    NSArray<NSArray *> *signatures = @[
+        @[[NSData dataWithBytes:"\x00\x00\x00\x1C" "ftypavif\x00\x00\x00\x00" "avifmif1miaf" length:28], @15],
+        @[[NSData dataWithBytes:"\x00\x00\x00\x1C" "ftypmif1\x00\x00\x00\x00" "mif1avifmiaf" length:28], @15],
+        @[[NSData dataWithBytes:"\x00\x00\x00\x18" "ftypheix\x00\x00\x00\x00" "mif1heix" length:24], @(SDImageFormatHEIC)],
+        @[[NSData dataWithBytes:"\x00\x00\x00\x18" "ftypisom\x00\x00\x00\x00" "isomavc1" length:24], @(SDImageFormatUndefined)],
+        @[[NSData dataWithBytes:"\x00\x00\x00\x00" "ftypheic\x00\x00\x00\x00" "mif1heic" length:24], @(SDImageFormatUndefined)], // size 0
+        @[[NSData dataWithBytes:"\xFF\x0A\xFF\x07" length:4], @17],
+        @[[NSData dataWithBytes:"\x00\x00\x00\x0C" "JXL \x0D\x0A\x87\x0A" length:12], @17],
+        @[[NSData dataWithBytes:"BM\x36\x00\x00\x00\x00\x00\x00\x00\x36\x00\x00\x00\x28\x00\x00\x00" length:18], @(SDImageFormatBMP)],
+        @[[NSData dataWithBytes:"\x00\x00\x01\x00\x01\x00\x10\x10\x00\x00\x01\x00" length:12], @(SDImageFormatICO)],
+        @[[NSData dataWithBytes:"II*\x00\x08\x00\x00\x00" length:8], @(SDImageFormatTIFF)],
+        @[[@"<svg xmlns=\"http://www.w3.org/2000/svg\"></svg>" dataUsingEncoding:NSUTF8StringEncoding], @(SDImageFormatSVG)],
+        // Used to be detected by the first byte
+        @[[@"Internal Server Error" dataUsingEncoding:NSUTF8StringEncoding], @(SDImageFormatUndefined)],
+        @[[@"<html><body></body></html>" dataUsingEncoding:NSUTF8StringEncoding], @(SDImageFormatUndefined)],
+        @[[@"%PS-Adobe-3.0 </svg>" dataUsingEncoding:NSUTF8StringEncoding], @(SDImageFormatUndefined)],
+    ];
+    for (NSArray *signature in signatures) {
+        expect([NSData sd_imageFormatForImageData:signature[0]]).equal([signature[1] integerValue]);
+    }
+    expect(CFStringCompare([NSData sd_UTTypeFromImageFormat:SDImageFormatBMP], CFSTR("com.microsoft.bmp"), 0)).equal(kCFCompareEqualTo);
+    expect([NSData sd_imageFormatFromUTType:CFSTR("public.avif")]).equal(15);
+}
+
+- (void)test27ImageHeaderProberPerformance {
+    // The header is parsed without ImageIO, from the chunks of a large JPEG
+    NSString *jpegPath = [[NSBundle bundleForClass:[self class]] pathForResource:@"TestImageLarge" ofType:@"jpg"];
+    NSData *jpegData = [NSData dataWithContentsOfFile:jpegPath];
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 1000; i++) {
+            @autoreleasepool {
+                SDImageHeaderProber *prober = [[SDImageHeaderProber alloc] init];
+                NSUInteger offset = 0;
+                while (prober.status == SDImageHeaderProbeStatusNeedMoreData && offset < jpegData.length) {
+                    NSUInteger length = MIN(1024, jpegData.length - offset);
+                    [prober appendData:[jpegData subdataWithRange:NSMakeRange(offset, length)]];
+                    offset += length;
+                }
+            }
+        }
+    }];
+}
+
+- (void)test28ImageFormatSniffPerformance {
+    // The signatures are matched without allocation
+    NSMutableArray<NSData *> *corpus = [NSMutableArray array];
+    for (NSString *name in @[@"TestImage.jpg", @"TestImage.png", @"TestImage.gif", @"TestImageStatic.webp", @"TestImage.heic", @"TestImage.heif", @"TestImage.pdf"]) {
+        NSString *testImagePath = [[NSBundle bundleForClass:[self class]] pathForResource:name.stringByDeletingPathExtension ofType:name.pathExtension];
+        [corpus addObject:[NSData dataWithContentsOfFile:testImagePath]];
+    }
+    [corpus addObject:[@"<html><body></body></html>" dataUsingEncoding:NSUTF8StringEncoding]];
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 100000; i++) {
+            [NSData sd_imageFormatForImageData:corpus[i % corpus.count] confidence:NULL];
+        }
+    }];
+}
+
+- (void)test29ThatImageHeaderProberStopAtUnboundedBoxes {
+    NSData *fileType = [NSData dataWithBytes:"\x00\x00\x00\x18" "ftypheic\x00\x00\x00\x00" "mif1heic" length:24];
+    // A top level box of size 0 extends to the end, and a huge 64-bit size, the `meta` can never follow
+    NSArray<NSData *> *boxes = @[
+        [NSData dataWithBytes:"\x00\x00\x00\x00" "mdat" length:8],
+        [NSData dataWithBytes:"\x00\x00\x00\x01" "mdat" "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xF0" length:16],
+    ];
+    for (NSData *box in boxes) {
+        NSMutableData *data = [NSMutableData dataWithData:fileType];
+        [data appendData:box];
+        [data increaseLengthBy:64];
+        expect([SDImageHeaderProber headerInfoWithData:data]).beNil();
+        // Stop at once instead of resuming beyond the data
+        SDImageHeaderProber *prober = [[SDImageHeaderProber alloc] init];
+        for (NSUInteger offset = 0; offset < data.length && prober.status == SDImageHeaderProbeStatusNeedMoreData; offset += 8) {
+            [prober appendData:[data subdataWithRange:NSMakeRange(offset, MIN(8, data.length - offset))]];
+        }
+        expect(prober.status).equal(SDImageHeaderProbeStatusFailed);
+    }
+    // The `ftyp` of size 0 is not an image
+    NSMutableData *data = [NSMutableData dataWithBytes:"\x00\x00\x00\x00" "ftypheic\x00\x00\x00\x00" "mif1heic" length:24];
+    [data increaseLengthBy:64];
+    expect([SDImageHeaderProber headerInfoWithData:data]).beNil();
+}
+
 #pragma mark - Utils
 
 - (void)verifyCoder:(id<SDImageCoder>)coder
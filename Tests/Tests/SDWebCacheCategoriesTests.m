@@ -490,6 +490,35 @@
     [self waitForExpectationsWithCommonTimeout];
 }
 
+- (void)testUIViewPinImageInMemoryCacheWorks {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"UIView pin the image on screen in memory cache"];
+    
+    SDImageCacheConfig *config = [[SDImageCacheConfig alloc] init];
+    config.shouldUseWeakMemoryCache = NO;
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"PinMemoryCache" diskCacheDirectory:nil config:config];
+    SDWebImageManager *manager = [[SDWebImageManager alloc] initWithCache:cache loader:SDWebImageDownloader.sharedDownloader];
+    NSURL *url = [NSURL URLWithString:@"https://pin.example.com/image.jpg"];
+    NSString *key = [manager cacheKeyForURL:url];
+    UIImage *image = [[UIImage alloc] initWithContentsOfFile:[self testJPEGPath]];
+    [cache storeImageToMemory:image forKey:key];
+    SDMemoryCache *memoryCache = (SDMemoryCache *)cache.memoryCache;
+    
+    UIImageView *imageView = [[UIImageView alloc] init];
+    [imageView sd_setImageWithURL:url placeholderImage:nil options:0 context:@{SDWebImageContextCustomManager : manager} progress:nil completed:^(UIImage * _Nullable image, NSError * _Nullable error, SDImageCacheType cacheType, NSURL * _Nullable imageURL) {
+        expect(cacheType).equal(SDImageCacheTypeMemory);
+        // The critical pressure removes all the strong entries except the pinned ones
+        [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelCritical];
+        expect([memoryCache objectForKey:key]).equal(image);
+        // Cancel releases the pin
+        [imageView sd_cancelCurrentImageLoad];
+        [memoryCache trimForPressureLevel:SDMemoryCachePressureLevelCritical];
+        expect([memoryCache objectForKey:key]).beNil();
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithCommonTimeout];
+}
+
 #pragma mark - Helper
 - (UIWindow *)window {
     if (!_window) {
@@ -11,6 +11,8 @@
 #import "SDWebImageTestDownloadOperation.h"
 #import "SDWebImageTestCoder.h"
 #import "SDWebImageTestLoader.h"
+#import "SDWebImageDownloaderDeadlineQueue.h"
+#import "SDWebImageDownloaderProgressiveThrottle.h"
 #import <compression.h>
 
 #define kPlaceholderTestURLTemplate @"https://via.placeholder.com/10000x%d.png"
@@ -22,8 +24,18 @@
 @property (nonatomic, weak, nullable) NSOperation<SDWebImageDownloaderOperation> *downloadOperation;
 @end
 
-@interface SDWebImageDownloader ()
+@interface SDWebImageDownloader () <NSURLSessionDataDelegate>
 @property (strong, nonatomic, nonnull) NSOperationQueue *downloadQueue;
+@property (strong, nonatomic) NSURLSession *session;
+@property (strong, nonatomic, nonnull) SDWebImageDownloaderDeadlineQueue *deadlineQueue;
+- (nullable NSOperation<SDWebImageDownloaderOperation> *)operationWithTask:(nullable NSURLSessionTask *)task;
+- (void)releaseHostSlotForOperation:(nonnull NSOperation *)operation url:(nonnull NSURL *)url;
+@end
+
+@interface SDWebImageDownloaderOperation ()
+@property (strong, nonatomic, readwrite, nullable) NSURLSessionTask *dataTask;
+@property (strong, nonatomic, nullable) NSError *responseError;
+- (nullable NSData *)imageData;
 @end
 
 
@@ -768,6 +780,486 @@
     }];
 }
 
+- (void)test32OperationWithTaskBenchmark {
+    // Simulate the received chunks of the last operation in a queue of 1000 operations, every task maps to its own operation
+    const NSUInteger depth = 1000;
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] init];
+    downloader.suspended = YES;
+    NSMutableArray<NSURLSessionTask *> *tasks = [NSMutableArray arrayWithCapacity:depth];
+    for (NSUInteger i = 0; i < depth; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:kPlaceholderTestURLTemplate, (int)i + 1]];
+        SDWebImageDownloadToken *token = [downloader downloadImageWithURL:url completed:nil];
+        SDWebImageDownloaderOperation *operation = (SDWebImageDownloaderOperation *)token.downloadOperation;
+        operation.dataTask = [downloader.session dataTaskWithURL:url];
+        [tasks addObject:operation.dataTask];
+    }
+    NSUInteger mismatchCount = 0;
+    for (NSURLSessionTask *task in tasks) {
+        if ([downloader operationWithTask:task].dataTask != task) {
+            mismatchCount++;
+        }
+    }
+    expect(mismatchCount).equal(0);
+    NSURLSessionTask *lastTask = tasks.lastObject;
+    __block NSOperation<SDWebImageDownloaderOperation> *operation;
+    [self measureBlock:^{
+        for (NSUInteger i = 0; i < 10000; i++) {
+            operation = [downloader operationWithTask:lastTask];
+        }
+    }];
+    expect(operation.dataTask).beIdenticalTo(lastTask);
+    for (NSURLSessionTask *task in tasks) {
+        [task cancel];
+    }
+    [downloader invalidateSessionAndCancel:YES];
+}
+
+- (void)test33ThatOperationWithTaskRoutesCallbacksToItsOperation {
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] init];
+    downloader.suspended = YES;
+    NSMutableArray<SDWebImageDownloaderOperation *> *operations = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 5; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:kPlaceholderTestURLTemplate, (int)i + 1]];
+        SDWebImageDownloadToken *token = [downloader downloadImageWithURL:url completed:nil];
+        SDWebImageDownloaderOperation *operation = (SDWebImageDownloaderOperation *)token.downloadOperation;
+        operation.dataTask = [downloader.session dataTaskWithURL:url];
+        [operations addObject:operation];
+    }
+    // Interleave the chunks in the reverse queue order, the first lookup of each task scans the queue and the later ones hit the index
+    for (NSUInteger round = 0; round < 3; round++) {
+        for (NSUInteger i = operations.count; i > 0; i--) {
+            SDWebImageDownloaderOperation *operation = operations[i - 1];
+            expect([downloader operationWithTask:operation.dataTask]).beIdenticalTo(operation);
+            uint8_t byte = (uint8_t)(i - 1);
+            [downloader URLSession:downloader.session dataTask:(NSURLSessionDataTask *)operation.dataTask didReceiveData:[NSData dataWithBytes:&byte length:1]];
+        }
+    }
+    // Each operation only receives the chunks of its own task
+    for (NSUInteger i = 0; i < operations.count; i++) {
+        NSData *imageData = [operations[i] imageData];
+        expect(imageData.length).equal(3);
+        const uint8_t *bytes = imageData.bytes;
+        for (NSUInteger j = 0; j < imageData.length; j++) {
+            expect(bytes[j]).equal(i);
+        }
+    }
+    // The task of no operation is not routed
+    NSURLSessionTask *unknownTask = [downloader.session dataTaskWithURL:[NSURL URLWithString:kTestJPEGURL]];
+    expect([downloader operationWithTask:unknownTask]).beNil();
+    [unknownTask cancel];
+    for (SDWebImageDownloaderOperation *operation in operations) {
+        [operation.dataTask cancel];
+    }
+    [downloader invalidateSessionAndCancel:YES];
+}
+
+- (void)test34ThatReceivedChunksAreChainedWithoutCopy {
+    NSData *testData = [NSData dataWithContentsOfFile:[self testPNGPath]];
+    NSURLRequest *request = [NSURLRequest requestWithURL:[NSURL URLWithString:kTestPNGURL]];
+    SDWebImageDownloaderOperation *operation = [[SDWebImageDownloaderOperation alloc] initWithRequest:request inSession:nil options:0];
+    NSMutableArray<NSData *> *chunks = [NSMutableArray array];
+    NSUInteger chunkLength = 1024;
+    for (NSUInteger location = 0; location < testData.length; location += chunkLength) {
+        NSData *chunk = [testData subdataWithRange:NSMakeRange(location, MIN(chunkLength, testData.length - location))];
+        [chunks addObject:chunk];
+        [operation URLSession:NSURLSession.sharedSession dataTask:(NSURLSessionDataTask *)operation.dataTask didReceiveData:chunk];
+    }
+    NSData *imageData = [operation imageData];
+    expect(imageData).equal(testData);
+    // Each region is the received chunk itself
+    __block NSUInteger regionIndex = 0;
+    dispatch_data_apply((dispatch_data_t)imageData, ^bool(dispatch_data_t  _Nonnull region, size_t offset, const void * _Nonnull buffer, size_t size) {
+        expect(buffer == chunks[regionIndex].bytes).beTruthy();
+        regionIndex++;
+        return true;
+    });
+    expect(regionIndex).equal(chunks.count);
+}
+
+- (void)test35ThatAdaptiveConcurrentDownloadsUseConcurrencyController {
+    SDWebImageDownloaderConfig *config = [[SDWebImageDownloaderConfig alloc] init];
+    config.adaptiveConcurrentDownloads = YES;
+    config.minConcurrentDownloads = 3;
+    config.maxConcurrentDownloads = 12;
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] initWithConfig:config];
+    SDWebImageDownloaderConcurrencyController *controller = downloader.concurrencyController;
+    expect(controller).notTo.beNil();
+    expect(controller.minimumConcurrency).equal(3);
+    expect(controller.maximumConcurrency).equal(12);
+    expect(downloader.downloadQueue.maxConcurrentOperationCount).equal(3);
+    // The upper bound follows the config
+    downloader.config.maxConcurrentDownloads = 2;
+    expect(controller.maximumConcurrency).equal(3);
+    expect(downloader.downloadQueue.maxConcurrentOperationCount).equal(3);
+    [downloader invalidateSessionAndCancel:YES];
+    
+    SDWebImageDownloader *fixedDownloader = [[SDWebImageDownloader alloc] initWithConfig:nil];
+    expect(fixedDownloader.concurrencyController).beNil();
+    [fixedDownloader invalidateSessionAndCancel:YES];
+}
+
+- (void)test36ThatConcurrencyControllerAdaptsToSimulatedLink {
+    // A stand-in server: each window runs `concurrency` downloads at the same time, the link bandwidth is shared, and the server queues the requests beyond `serverSlots` which increase the time to first byte
+    NSInteger (^simulate)(SDWebImageDownloaderConcurrencyController *, NSInteger, double) = ^NSInteger(SDWebImageDownloaderConcurrencyController *controller, NSInteger serverSlots, double failureRate) {
+        const double bandwidth = 10 * 1024 * 1024;
+        const double latency = 0.05;
+        const int64_t imageBytes = 200 * 1024;
+        NSTimeInterval now = 0;
+        NSUInteger download = 0;
+        for (NSUInteger window = 0; window < 50; window++) {
+            NSInteger concurrency = controller.concurrency;
+            NSTimeInterval timeToFirstByte = latency * MAX(1.0, (double)concurrency / serverSlots);
+            NSTimeInterval duration = timeToFirstByte + imageBytes * concurrency / bandwidth;
+            for (NSInteger i = 0; i < concurrency; i++) {
+                // Spread the failures evenly
+                BOOL failed = fmod(download++ * failureRate, 1.0) + failureRate >= 1.0;
+                [controller recordDownloadWithReceivedBytes:failed ? 0 : imageBytes startTime:now firstByteTime:failed ? 0 : now + timeToFirstByte endTime:now + duration failed:failed];
+            }
+            now += duration;
+        }
+        return controller.concurrency;
+    };
+    
+    // Fast link, grow to the upper bound
+    SDWebImageDownloaderConcurrencyController *fastController = [[SDWebImageDownloaderConcurrencyController alloc] initWithMinimumConcurrency:2 maximumConcurrency:16 initialConcurrency:2];
+    expect(simulate(fastController, 32, 0)).equal(16);
+    expect(fastController.decreaseCount).equal(0);
+    expect(fastController.lastDecision).equal(SDWebImageDownloaderConcurrencyDecisionIncrease);
+    expect(fastController.throughput).beGreaterThan(0);
+    
+    // Congested server, the time to first byte doubles beyond 2 * 4 slots, stay around the knee
+    SDWebImageDownloaderConcurrencyController *congestedController = [[SDWebImageDownloaderConcurrencyController alloc] initWithMinimumConcurrency:2 maximumConcurrency:16 initialConcurrency:2];
+    NSInteger congestedConcurrency = simulate(congestedController, 4, 0);
+    expect(congestedConcurrency).beLessThanOrEqualTo(9);
+    expect(congestedController.decreaseCount).beGreaterThan(0);
+    expect(congestedController.baselineTimeToFirstByte).beCloseToWithin(0.05, 0.001);
+    
+    // Failing server, shrink to the lower bound
+    SDWebImageDownloaderConcurrencyController *failingController = [[SDWebImageDownloaderConcurrencyController alloc] initWithMinimumConcurrency:2 maximumConcurrency:16 initialConcurrency:8];
+    expect(simulate(failingController, 32, 0.5)).equal(2);
+    expect(failingController.errorRate).beGreaterThan(0.1);
+    expect(failingController.lastDecision).equal(SDWebImageDownloaderConcurrencyDecisionDecrease);
+    
+    // The simulation is deterministic, the same link gives the same result
+    SDWebImageDownloaderConcurrencyController *replayController = [[SDWebImageDownloaderConcurrencyController alloc] initWithMinimumConcurrency:2 maximumConcurrency:16 initialConcurrency:2];
+    expect(simulate(replayController, 4, 0)).equal(congestedConcurrency);
+    expect(replayController.increaseCount).equal(congestedController.increaseCount);
+    expect(replayController.decreaseCount).equal(congestedController.decreaseCount);
+}
+
+- (void)test37ThatConcurrencyControllerBaselineFollowsSlowerLink {
+    // The link latency grows 6 times after 20 windows (e.g. Wi-Fi to cellular), the server is never the bottleneck
+    SDWebImageDownloaderConcurrencyController *controller = [[SDWebImageDownloaderConcurrencyController alloc] initWithMinimumConcurrency:2 maximumConcurrency:16 initialConcurrency:2];
+    const double bandwidth = 10 * 1024 * 1024;
+    const int64_t imageBytes = 200 * 1024;
+    NSTimeInterval now = 0;
+    for (NSUInteger window = 0; window < 50; window++) {
+        NSInteger concurrency = controller.concurrency;
+        NSTimeInterval timeToFirstByte = window < 20 ? 0.05 : 0.3;
+        NSTimeInterval duration = timeToFirstByte + imageBytes * concurrency / bandwidth;
+        for (NSInteger i = 0; i < concurrency; i++) {
+            [controller recordDownloadWithReceivedBytes:imageBytes startTime:now firstByteTime:now + timeToFirstByte endTime:now + duration failed:NO];
+        }
+        now += duration;
+        if (window == 19) {
+            expect(controller.baselineTimeToFirstByte).beCloseToWithin(0.05, 0.001);
+        }
+    }
+    // The baseline is not pinned to the old link, so the concurrency recovers from the lower bound
+    expect(controller.decreaseCount).beGreaterThan(0);
+    expect(controller.baselineTimeToFirstByte).beGreaterThan(0.15);
+    expect(controller.concurrency).equal(16);
+}
+
+- (void)test38ThatPerHostConcurrencyLimitDoesNotBlockOtherHosts {
+    SDWebImageDownloaderConfig *config = [[SDWebImageDownloaderConfig alloc] init];
+    config.maxConcurrentDownloadsPerHost = 2;
+    config.maxConcurrentDownloadsForHosts = @{@"primary.example.com" : @3};
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] initWithConfig:config];
+    downloader.suspended = YES;
+    
+    NSMutableArray<SDWebImageDownloadToken *> *slowTokens = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 5; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"https://SLOW.example.com/%lu.png", (unsigned long)i]];
+        [slowTokens addObject:[downloader downloadImageWithURL:url completed:nil]];
+    }
+    NSMutableArray<SDWebImageDownloadToken *> *primaryTokens = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 4; i++) {
+        NSURL *url = [NSURL URLWithString:[NSString stringWithFormat:@"https://primary.example.com/%lu.png", (unsigned long)i]];
+        [primaryTokens addObject:[downloader downloadImageWithURL:url completed:nil]];
+    }
+    
+    // The slow host: only 2 in the download queue, the others wait outside without any dependency
+    NSArray<NSOperation *> *queuedOperations = downloader.downloadQueue.operations;
+    for (NSUInteger i = 0; i < slowTokens.count; i++) {
+        expect(slowTokens[i].downloadOperation.dependencies.count).equal(0);
+        expect([queuedOperations containsObject:slowTokens[i].downloadOperation]).equal(i < 2);
+    }
+    // The primary host has its own budget, and never waits for the slow host
+    for (NSUInteger i = 0; i < primaryTokens.count; i++) {
+        expect(primaryTokens[i].downloadOperation.dependencies.count).equal(0);
+        expect([queuedOperations containsObject:primaryTokens[i].downloadOperation]).equal(i < 3);
+    }
+    expect(downloader.currentDownloadCount).equal(9);
+    
+    // Any released slot admits the first waiting one, no head-of-line blocking behind the 1st slow download
+    NSURL *slowURL = slowTokens[1].url;
+    [downloader releaseHostSlotForOperation:slowTokens[1].downloadOperation url:slowURL];
+    expect([downloader.downloadQueue.operations containsObject:slowTokens[2].downloadOperation]).beTruthy();
+    expect([downloader.downloadQueue.operations containsObject:slowTokens[3].downloadOperation]).beFalsy();
+    // The cancelled waiting one is moved into the download queue to finish, but does not take the slot
+    [slowTokens[3].downloadOperation cancel];
+    [downloader releaseHostSlotForOperation:slowTokens[0].downloadOperation url:slowURL];
+    expect([downloader.downloadQueue.operations containsObject:slowTokens[3].downloadOperation]).beTruthy();
+    expect([downloader.downloadQueue.operations containsObject:slowTokens[4].downloadOperation]).beTruthy();
+    
+    [downloader cancelAllDownloads];
+    [downloader invalidateSessionAndCancel:YES];
+}
+
+- (void)test39ThatDeadlineQueuePopEarliestDeadlineFirst {
+    SDWebImageDownloaderDeadlineQueue *queue = [SDWebImageDownloaderDeadlineQueue new];
+    NSMutableArray<NSOperation *> *operations = [NSMutableArray array];
+    for (NSUInteger i = 0; i < 100; i++) {
+        NSOperation *operation = [NSOperation new];
+        [operations addObject:operation];
+        // Reverse order deadline, and the last 10 have no deadline
+        [queue addOperation:operation deadline:i < 90 ? 1000 - i : INFINITY];
+    }
+    // Move the first one to the front
+    expect([queue updateDeadline:0 forOperation:operations[0]]).beTruthy();
+    expect([queue updateDeadline:0 forOperation:[NSOperation new]]).beFalsy();
+    expect([queue deadlineForOperation:operations[0]]).equal(0);
+    // Remove one from the middle of the heap
+    expect([queue removeOperation:operations[50]]).beTruthy();
+    expect([queue removeOperation:operations[50]]).beFalsy();
+    expect(isnan([queue deadlineForOperation:operations[50]])).beTruthy();
+    expect(queue.count).equal(99);
+    
+    CFAbsoluteTime deadline;
+    expect([queue popOperationWithDeadline:&deadline]).equal(operations[0]);
+    expect(deadline).equal(0);
+    for (NSUInteger i = 89; i >= 1; i--) {
+        if (i == 50) {
+            continue;
+        }
+        expect([queue popOperationWithDeadline:nil]).equal(operations[i]);
+    }
+    // No deadline in FIFO order
+    for (NSUInteger i = 90; i < 100; i++) {
+        expect([queue popOperationWithDeadline:nil]).equal(operations[i]);
+    }
+    expect(queue.count).equal(0);
+    expect([queue popOperationWithDeadline:nil]).beNil();
+}
+
+- (void)test40ThatDeadlineExecutionOrderStartEarliestDeadlineFirst {
+    SDWebImageDownloaderConfig *config = [[SDWebImageDownloaderConfig alloc] init];
+    config.executionOrder = SDWebImageDownloaderDeadlineExecutionOrder;
+    config.maxConcurrentDownloads = 1;
+    config.shouldDropExpiredDownloads = YES;
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] initWithConfig:config];
+    downloader.suspended = YES;
+    
+    NSURL *runningURL = [NSURL URLWithString:@"https://deadline.example.com/running.png"];
+    SDWebImageDownloadToken *runningToken = [downloader downloadImageWithURL:runningURL options:0 context:nil progress:nil completed:nil];
+    // The download queue has a free slot, so the first one does not wait
+    expect(downloader.downloadQueue.operations).contain(runningToken.downloadOperation);
+    
+    SDWebImageDownloadToken *laterToken = [downloader downloadImageWithURL:[NSURL URLWithString:@"https://deadline.example.com/later.png"] options:0 context:@{SDWebImageContextDownloadDeadline : @(10)} progress:nil completed:nil];
+    SDWebImageDownloadToken *soonerToken = [downloader downloadImageWithURL:[NSURL URLWithString:@"https://deadline.example.com/sooner.png"] options:0 context:@{SDWebImageContextDownloadDeadline : @(1)} progress:nil completed:nil];
+    SDWebImageDownloadToken *sharedToken = [downloader downloadImageWithURL:[NSURL URLWithString:@"https://deadline.example.com/sooner.png"] options:0 context:@{SDWebImageContextDownloadDeadline : @(2)} progress:nil completed:nil];
+    SDWebImageDownloadToken *noDeadlineToken = [downloader downloadImageWithURL:[NSURL URLWithString:@"https://deadline.example.com/none.png"] options:0 context:nil progress:nil completed:nil];
+    expect(sharedToken.downloadOperation).equal(soonerToken.downloadOperation);
+    expect(downloader.deadlineQueue.count).equal(3);
+    expect(downloader.currentDownloadCount).equal(4);
+    
+    // The viewport moves, the later one becomes the most urgent
+    [downloader setDeadline:[NSDate dateWithTimeIntervalSinceNow:0.5] forDownloadToken:laterToken];
+    // The shared download follows the earliest deadline of its tokens
+    NSOperation *soonerOperation = soonerToken.downloadOperation;
+    [downloader setDeadline:nil forDownloadToken:soonerToken];
+    expect([downloader.deadlineQueue deadlineForOperation:soonerOperation]).beGreaterThan(CFAbsoluteTimeGetCurrent() + 1);
+    expect([downloader.deadlineQueue deadlineForOperation:soonerOperation]).beLessThan(CFAbsoluteTimeGetCurrent() + 3);
+    [downloader setDeadline:[NSDate dateWithTimeIntervalSinceNow:5] forDownloadToken:sharedToken];
+    expect([downloader.deadlineQueue deadlineForOperation:soonerOperation]).beGreaterThan(CFAbsoluteTimeGetCurrent() + 4);
+    // Cancelling a token drops its deadline, the download is kept by the other token
+    [sharedToken cancel];
+    expect(soonerOperation.isCancelled).beFalsy();
+    expect([downloader.deadlineQueue deadlineForOperation:soonerOperation]).equal(INFINITY);
+    [downloader setDeadline:[NSDate dateWithTimeIntervalSinceNow:1] forDownloadToken:soonerToken];
+    // The cancelled one does not stay in the deadline queue
+    NSOperation *noDeadlineOperation = noDeadlineToken.downloadOperation;
+    [noDeadlineToken cancel];
+    expect(downloader.deadlineQueue.count).equal(2);
+    expect(downloader.downloadQueue.operations).contain(noDeadlineOperation);
+    expect([downloader.deadlineQueue popOperationWithDeadline:nil]).equal(laterToken.downloadOperation);
+    expect([downloader.deadlineQueue popOperationWithDeadline:nil]).equal(soonerToken.downloadOperation);
+    
+    // The expired one is dropped when the slot is free
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Expired download is dropped"];
+    SDWebImageDownloadToken *expiredToken = [downloader downloadImageWithURL:[NSURL URLWithString:@"https://deadline.example.com/expired.png"] options:0 context:@{SDWebImageContextDownloadDeadline : [NSDate distantPast]} progress:nil completed:^(UIImage * _Nullable image, NSData * _Nullable data, NSError * _Nullable error, BOOL finished) {
+        expect(error.code).equal(SDWebImageErrorCancelled);
+        [expectation fulfill];
+    }];
+    expect(expiredToken).notTo.beNil();
+    [runningToken cancel];
+    downloader.suspended = NO;
+    
+    [self waitForExpectationsWithCommonTimeout];
+    [downloader invalidateSessionAndCancel:YES];
+}
+
+- (void)test41ThatProgressiveThrottleSkipFramesNotWorthTheCost {
+    // SOI, APP0 with a fake SOS inside, the first SOS and its entropy-coded data with stuffed byte and restart marker
+    const uint8_t header[] = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x06, 0xFF, 0xDA, 0x00, 0x00, 0xFF, 0xDA, 0x00, 0x03, 0x01, 0x12, 0xFF, 0x00, 0x34, 0xFF, 0xD0, 0x56};
+    // The second SOS completes the first scan
+    const uint8_t secondScan[] = {0xFF, 0xDA, 0x00, 0x03, 0x01, 0x78};
+    SDWebImageDownloaderProgressiveThrottle *throttle = [[SDWebImageDownloaderProgressiveThrottle alloc] initWithFrameBudget:2];
+    [throttle appendData:[NSData dataWithBytes:header length:sizeof(header)]];
+    expect(throttle.completedScanCount).equal(0);
+    // Not enough new bytes
+    expect([throttle shouldRenderFrameWithReceivedSize:100 expectedSize:1000 decoding:NO]).beFalsy();
+    // The remaining 2 frames and the final image spread over the data
+    expect([throttle shouldRenderFrameWithReceivedSize:400 expectedSize:1000 decoding:NO]).beTruthy();
+    [throttle didRenderFrameWithDuration:0];
+    [throttle appendData:[NSData dataWithBytes:secondScan length:sizeof(secondScan)]];
+    expect(throttle.completedScanCount).equal(1);
+    // Busy decoding
+    expect([throttle shouldRenderFrameWithReceivedSize:450 expectedSize:1000 decoding:YES]).beFalsy();
+    // A completed scan is worth a frame even with few new bytes
+    expect([throttle shouldRenderFrameWithReceivedSize:450 expectedSize:1000 decoding:NO]).beTruthy();
+    [throttle didRenderFrameWithDuration:0];
+    // Budget used up
+    expect([throttle shouldRenderFrameWithReceivedSize:900 expectedSize:1000 decoding:NO]).beFalsy();
+    expect(throttle.producedFrameCount).equal(2);
+    expect(throttle.skippedFrameCount).equal(3);
+    
+    // The non-JPEG data has no scan, and the measured cost delay the next frame
+    SDWebImageDownloaderProgressiveThrottle *unlimitedThrottle = [[SDWebImageDownloaderProgressiveThrottle alloc] initWithFrameBudget:0];
+    [unlimitedThrottle appendData:[@"GIF89a" dataUsingEncoding:NSASCIIStringEncoding]];
+    expect([unlimitedThrottle shouldRenderFrameWithReceivedSize:100 expectedSize:1000 decoding:NO]).beTruthy();
+    [unlimitedThrottle didRenderFrameWithDuration:60];
+    expect([unlimitedThrottle shouldRenderFrameWithReceivedSize:900 expectedSize:1000 decoding:NO]).beFalsy();
+    expect(unlimitedThrottle.completedScanCount).equal(0);
+    expect(unlimitedThrottle.producedFrameCount).equal(1);
+    expect(unlimitedThrottle.skippedFrameCount).equal(1);
+}
+
+- (void)test42ThatProgressiveDownloadReportFrameCounters {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Progressive download report the produced and skipped frames"];
+    SDWebImageDownloaderConfig *config = [[SDWebImageDownloaderConfig alloc] init];
+    config.progressiveFrameBudget = 3;
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] initWithConfig:config];
+    NSURL *imageURL = [NSURL URLWithString:kTestProgressiveJPEGURL];
+    __block NSUInteger progressiveImageCount = 0;
+    __block SDWebImageDownloaderOperation *operation;
+    SDWebImageDownloadToken *token = [downloader downloadImageWithURL:imageURL options:SDWebImageDownloaderProgressiveLoad | SDWebImageDownloaderIgnoreCachedResponse progress:nil completed:^(UIImage * _Nullable image, NSData * _Nullable data, NSError * _Nullable error, BOOL finished) {
+        if (!finished) {
+            progressiveImageCount++;
+            return;
+        }
+        expect(error).beNil();
+        expect(image).notTo.beNil();
+        expect(operation.producedProgressiveFrameCount).beLessThanOrEqualTo(3);
+        expect(progressiveImageCount).beLessThanOrEqualTo(operation.producedProgressiveFrameCount);
+        [expectation fulfill];
+    }];
+    operation = (SDWebImageDownloaderOperation *)token.downloadOperation;
+    expect(operation.progressiveFrameBudget).equal(3);
+    
+    [self waitForExpectationsWithCommonTimeoutUsingHandler:^(NSError * _Nullable error) {
+        [downloader invalidateSessionAndCancel:YES];
+    }];
+}
+
+- (void)test43ThatDownloadReceiveImageHeaderBeforeFinish {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Download receive the image header before finish"];
+    SDWebImageDownloader *downloader = [[SDWebImageDownloader alloc] init];
+    __block BOOL headerReceived = NO;
+    id observer = [[NSNotificationCenter defaultCenter] addObserverForName:SDWebImageDownloadReceiveImageHeaderNotification object:nil queue:nil usingBlock:^(NSNotification * _Nonnull note) {
+        SDWebImageDownloaderOperation *operation = note.object;
+        expect(operation.imageHeaderInfo.format).equal(SDImageFormatJPEG);
+        headerReceived = YES;
+    }];
+    __block SDWebImageDownloadToken *token;
+    token = [downloader downloadImageWithURL:[NSURL URLWithString:kTestJPEGURL] options:SDWebImageDownloaderIgnoreCachedResponse progress:nil completed:^(UIImage * _Nullable image, NSData * _Nullable data, NSError * _Nullable error, BOOL finished) {
+        expect(error).beNil();
+        expect(headerReceived).beTruthy();
+        SDImageHeaderInfo *headerInfo = token.imageHeaderInfo;
+        expect(headerInfo).notTo.beNil();
+        expect(headerInfo.pixelSize.width).equal(image.size.width * image.scale);
+        expect(headerInfo.pixelSize.height).equal(image.size.height * image.scale);
+        [[NSNotificationCenter defaultCenter] removeObserver:observer];
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithCommonTimeoutUsingHandler:^(NSError * _Nullable error) {
+        [downloader invalidateSessionAndCancel:YES];
+    }];
+}
+
+- (void)test44ThatSniffedDownloadAbortEarly {
+    NSURL *url = [NSURL URLWithString:kTestJPEGURL];
+    NSURLSessionDataTask *dataTask = [NSURLSession.sharedSession dataTaskWithURL:url];
+    // HTML error page
+    SDWebImageDownloaderOperation *operation1 = [[SDWebImageDownloaderOperation alloc] initWithRequest:[NSURLRequest requestWithURL:url] inSession:nil options:0];
+    operation1.abortsUndecodableDownloads = YES;
+    NSMutableString *html = [NSMutableString stringWithString:@"<!DOCTYPE html><html><head><title>502 Bad Gateway</title></head><body>"];
+    while (html.length < 512) {
+        [html appendString:@"<p>Bad Gateway</p>"];
+    }
+    [operation1 URLSession:NSURLSession.sharedSession dataTask:dataTask didReceiveData:[html dataUsingEncoding:NSUTF8StringEncoding]];
+    expect(operation1.responseError.code).equal(SDWebImageErrorUndecodableDownloadData);
+    expect([[SDWebImageDownloader sharedDownloader] shouldBlockFailedURLWithURL:url error:operation1.responseError]).beTruthy();
+    
+    // The XML may be a SVG, keep downloading
+    SDWebImageDownloaderOperation *operation2 = [[SDWebImageDownloaderOperation alloc] initWithRequest:[NSURLRequest requestWithURL:url] inSession:nil options:0];
+    operation2.abortsUndecodableDownloads = YES;
+    NSMutableString *xml = [NSMutableString stringWithString:@"<?xml version=\"1.0\" encoding=\"UTF-8\"?>"];
+    while (xml.length < 512) {
+        [xml appendString:@"<!-- comment -->"];
+    }
+    [operation2 URLSession:NSURLSession.sharedSession dataTask:dataTask didReceiveData:[xml dataUsingEncoding:NSUTF8StringEncoding]];
+    expect(operation2.responseError).beNil();
+    
+    // Oversized image, the header is in the first KB
+    NSString *largePath = [[NSBundle bundleForClass:[self class]] pathForResource:@"TestImageLarge" ofType:@"jpg"];
+    NSData *largeData = [NSData dataWithContentsOfFile:largePath];
+    SDWebImageDownloaderOperation *operation3 = [[SDWebImageDownloaderOperation alloc] initWithRequest:[NSURLRequest requestWithURL:url] inSession:nil options:0];
+    operation3.abortsUndecodableDownloads = YES;
+    operation3.maxDownloadPixelCount = 4000 * 3000;
+    [operation3 URLSession:NSURLSession.sharedSession dataTask:dataTask didReceiveData:[largeData subdataWithRange:NSMakeRange(0, 1024)]];
+    expect(operation3.responseError.code).equal(SDWebImageErrorDownloadPixelCountExceedLimit);
+    SDImageHeaderInfo *headerInfo = operation3.responseError.userInfo[SDWebImageErrorDownloadImageHeaderKey];
+    expect(headerInfo.pixelSize.width).equal(5250);
+    expect(headerInfo.pixelSize.height).equal(3450);
+    
+    // Image within the limit
+    SDWebImageDownloaderOperation *operation4 = [[SDWebImageDownloaderOperation alloc] initWithRequest:[NSURLRequest requestWithURL:url] inSession:nil options:0];
+    operation4.abortsUndecodableDownloads = YES;
+    operation4.maxDownloadPixelCount = 6000 * 4000;
+    [operation4 URLSession:NSURLSession.sharedSession dataTask:dataTask didReceiveData:[largeData subdataWithRange:NSMakeRange(0, 1024)]];
+    expect(operation4.responseError).beNil();
+    expect(operation4.imageHeaderInfo).notTo.beNil();
+    
+    // The magic bytes are recognized but the header is not understood, keep downloading
+    SDWebImageDownloaderOperation *operation5 = [[SDWebImageDownloaderOperation alloc] initWithRequest:[NSURLRequest requestWithURL:url] inSession:nil options:0];
+    operation5.abortsUndecodableDownloads = YES;
+    NSMutableData *jpeg = [NSMutableData dataWithBytes:"\xFF\xD8\xFF" length:3];
+    [jpeg increaseLengthBy:512];
+    [operation5 URLSession:NSURLSession.sharedSession dataTask:dataTask didReceiveData:jpeg];
+    expect(operation5.responseError).beNil();
+    
+    // The data streamed into file is sniffed from the received bytes
+    NSString *downloadFilePath = [NSTemporaryDirectory() stringByAppendingPathComponent:NSUUID.UUID.UUIDString];
+    SDWebImageDownloaderOperation *operation6 = [[SDWebImageDownloaderOperation alloc] initWithRequest:[NSURLRequest requestWithURL:url] inSession:nil options:0 context:@{SDWebImageContextDownloadFilePath : downloadFilePath}];
+    operation6.abortsUndecodableDownloads = YES;
+    [operation6 URLSession:NSURLSession.sharedSession dataTask:dataTask didReceiveData:[html dataUsingEncoding:NSUTF8StringEncoding]];
+    expect(operation6.responseError.code).equal(SDWebImageErrorUndecodableDownloadData);
+    [[NSFileManager defaultManager] removeItemAtPath:downloadFilePath error:nil];
+}
+
 #pragma mark - SDWebImageLoader
 - (void)test30CustomImageLoaderWorks {
     XCTestExpectation *expectation = [self expectationWithDescription:@"Custom image not works"];
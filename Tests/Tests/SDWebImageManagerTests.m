@@ -417,6 +417,35 @@
     [self waitForExpectationsWithTimeout:kAsyncTestTimeout * 10 handler:nil];
 }
 
+- (void)test17ThatStreamToDiskCacheMoveDownloadedFileIntoCache {
+    XCTestExpectation *expectation = [self expectationWithDescription:@"Stream to disk cache work"];
+    
+    // Use a fresh cache to avoid get effected by other test cases
+    SDImageCache *cache = [[SDImageCache alloc] initWithNamespace:@"SDWebImageStreamToDiskCache"];
+    [cache clearDiskOnCompletion:nil];
+    NSURL *url = [NSURL URLWithString:kTestJPEGURL];
+    NSString *key = [SDWebImageManager.sharedManager cacheKeyForURL:url];
+    
+    [[SDWebImageManager sharedManager] loadImageWithURL:url options:SDWebImageStreamToDiskCache | SDWebImageWaitStoreCache context:@{SDWebImageContextImageCache : cache} progress:nil completed:^(UIImage * _Nullable image, NSData * _Nullable data, NSError * _Nullable error, SDImageCacheType cacheType, BOOL finished, NSURL * _Nullable imageURL) {
+        expect(error).beNil();
+        expect(image).notTo.beNil();
+        expect(data).notTo.beNil();
+        // The downloaded file is moved into disk cache
+        NSData *diskData = [cache diskImageDataForKey:key];
+        expect(diskData).equal(data);
+        expect([cache imageFromMemoryCacheForKey:key]).equal(image);
+        // No temporary file left
+        NSArray<NSString *> *fileNames = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:cache.diskCachePath error:nil];
+        for (NSString *fileName in fileNames) {
+            expect([fileName hasSuffix:@".download"]).beFalsy();
+        }
+        [cache clearDiskOnCompletion:nil];
+        [expectation fulfill];
+    }];
+    
+    [self waitForExpectationsWithCommonTimeout];
+}
+
 - (NSString *)testJPEGPath {
     NSBundle *testBundle = [NSBundle bundleForClass:[self class]];
     return [testBundle pathForResource:@"TestImage" ofType:@"jpg"];